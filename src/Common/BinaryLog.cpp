@@ -0,0 +1,145 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QDataStream>
+#include <QIODevice>
+#include "BinaryLog.h"
+
+namespace {
+
+const char binaryLogMagic[] = "TROJITA-LOG";
+const int binaryLogMagicSize = sizeof(binaryLogMagic) - 1;
+
+/** @short Sanity limit on the size of a single record, anything larger means that we're reading garbage */
+const quint32 maxRecordSize = 64 * 1024 * 1024;
+
+const QDataStream::Version streamVersion = QDataStream::Qt_5_0;
+
+}
+
+namespace Common
+{
+
+bool writeBinaryLogHeader(QIODevice *device)
+{
+    if (device->write(binaryLogMagic, binaryLogMagicSize) != binaryLogMagicSize)
+        return false;
+    QDataStream stream(device);
+    stream.setVersion(streamVersion);
+    stream << static_cast<quint32>(BINARY_LOG_VERSION);
+    return stream.status() == QDataStream::Ok;
+}
+
+qint64 writeBinaryLogRecord(QIODevice *device, const uint connectionId, const LogMessage &message)
+{
+    QByteArray payload;
+    {
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        stream.setVersion(streamVersion);
+        const bool isRaw = !message.rawMessage.isNull();
+        stream << static_cast<qint64>(message.timestamp.toMSecsSinceEpoch())
+               << static_cast<quint32>(connectionId)
+               << static_cast<quint8>(message.kind)
+               << static_cast<quint32>(message.truncatedBytes)
+               << static_cast<quint8>(isRaw)
+               << message.source
+               << (isRaw ? message.rawMessage : message.message.toUtf8());
+    }
+
+    QByteArray record;
+    record.reserve(payload.size() + 4);
+    {
+        QDataStream stream(&record, QIODevice::WriteOnly);
+        stream.setVersion(streamVersion);
+        stream << static_cast<quint32>(payload.size());
+    }
+    record += payload;
+    return device->write(record) == record.size() ? record.size() : -1;
+}
+
+BinaryLogReader::BinaryLogReader(QIODevice *device):
+    m_device(device), m_valid(false), m_damaged(false)
+{
+    if (m_device->read(binaryLogMagicSize) != QByteArray::fromRawData(binaryLogMagic, binaryLogMagicSize))
+        return;
+    QDataStream stream(m_device);
+    stream.setVersion(streamVersion);
+    quint32 version;
+    stream >> version;
+    m_valid = stream.status() == QDataStream::Ok && version == BINARY_LOG_VERSION;
+}
+
+bool BinaryLogReader::isValid() const
+{
+    return m_valid;
+}
+
+bool BinaryLogReader::isDamaged() const
+{
+    return m_damaged;
+}
+
+bool BinaryLogReader::readNext(uint &connectionId, LogMessage &message)
+{
+    if (!m_valid || m_damaged || m_device->atEnd())
+        return false;
+
+    QByteArray lengthBytes = m_device->read(4);
+    QByteArray payload;
+    quint32 length = 0;
+    if (lengthBytes.size() == 4) {
+        QDataStream stream(lengthBytes);
+        stream.setVersion(streamVersion);
+        stream >> length;
+        if (length <= maxRecordSize)
+            payload = m_device->read(length);
+    }
+    if (lengthBytes.size() != 4 || length > maxRecordSize || static_cast<quint32>(payload.size()) != length) {
+        m_damaged = true;
+        return false;
+    }
+
+    QDataStream stream(payload);
+    stream.setVersion(streamVersion);
+    qint64 msecs;
+    quint32 id, truncatedBytes;
+    quint8 kind, isRaw;
+    QString source;
+    QByteArray data;
+    stream >> msecs >> id >> kind >> truncatedBytes >> isRaw >> source >> data;
+    if (stream.status() != QDataStream::Ok || kind > LOG_OTHER) {
+        m_damaged = true;
+        return false;
+    }
+
+    connectionId = id;
+    if (isRaw) {
+        message = LogMessage(QDateTime::fromMSecsSinceEpoch(msecs), static_cast<LogKind>(kind), source, data);
+        message.truncatedBytes = truncatedBytes;
+    } else {
+        message = LogMessage(QDateTime::fromMSecsSinceEpoch(msecs), static_cast<LogKind>(kind), source,
+                             QString::fromUtf8(data), truncatedBytes);
+    }
+    return true;
+}
+
+}
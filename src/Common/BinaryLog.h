@@ -0,0 +1,74 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COMMON_BINARYLOG_H
+#define COMMON_BINARYLOG_H
+
+#include "Logging.h"
+
+class QIODevice;
+
+namespace Common
+{
+
+/** @short Version of the on-disk format of the binary protocol log
+
+The file starts with the "TROJITA-LOG" magic followed by a big-endian quint32 holding this version. It is followed by
+a sequence of records, each of them prefixed by a quint32 length of its payload. The payload stores the timestamp as
+milliseconds since the epoch, the connection ID, the LogKind, the number of truncated bytes, a flag telling whether the
+data are raw protocol bytes, the source and the actual data, all of them serialized through QDataStream.
+
+The length prefix makes it possible to skip over records and to detect an incomplete last record which might get left
+behind when the application crashes in the middle of a write.
+*/
+enum { BINARY_LOG_VERSION = 1 };
+
+/** @short Write the header which has to be present at the beginning of each binary log file */
+bool writeBinaryLogHeader(QIODevice *device);
+
+/** @short Append a single message to the binary log, returning the number of bytes written or -1 on error */
+qint64 writeBinaryLogRecord(QIODevice *device, const uint connectionId, const LogMessage &message);
+
+/** @short Sequential reader of the binary protocol log */
+class BinaryLogReader
+{
+public:
+    explicit BinaryLogReader(QIODevice *device);
+
+    /** @short Was the file header recognized? */
+    bool isValid() const;
+
+    /** @short Read the next record, returning false at the end of the log or on a damaged record */
+    bool readNext(uint &connectionId, LogMessage &message);
+
+    /** @short Did the reader stop because of an incomplete or invalid record? */
+    bool isDamaged() const;
+
+private:
+    QIODevice *m_device;
+    bool m_valid;
+    bool m_damaged;
+};
+
+}
+
+#endif // COMMON_BINARYLOG_H
@@ -24,15 +24,24 @@
 #include <QDebug>
 #include <QFile>
 #include <QTextStream>
+#include <QTimer>
+#include "BinaryLog.h"
 #include "FileLogger.h"
 #include "../Imap/Model/Utils.h"
 
 namespace Common
 {
 
+/** @short How long to wait before the buffered log data are written to the disk when auto flushing is enabled */
+const int flushDelay = 500;
+
 FileLogger::FileLogger(QObject *parent) :
-    QObject(parent), m_fileLog(0), m_consoleLog(false), m_autoFlush(false)
+    QObject(parent), m_fileLog(0), m_binaryLog(0), m_binaryLogSize(0), m_flushTimer(new QTimer(this)), m_consoleLog(false),
+    m_autoFlush(false), m_maxFileSize(16 * 1024 * 1024), m_rotatedFiles(3)
 {
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(flushDelay);
+    connect(m_flushTimer, &QTimer::timeout, this, &FileLogger::flushLogs);
 }
 
 void FileLogger::setFileLogging(const bool enabled, const QString &fileName)
@@ -54,9 +63,73 @@ void FileLogger::setFileLogging(const bool enabled, const QString &fileName)
     }
 }
 
+/** @short Enable logging into a binary file which can be converted back to text by the trojita-log-viewer
+
+Unlike the text log, the binary log stores the protocol data verbatim without any formatting, and it gets rotated once
+it grows past the limit configured through setLogRotation().
+*/
+void FileLogger::setBinaryLogging(const bool enabled, const QString &fileName)
+{
+    if (enabled) {
+        if (m_binaryLog)
+            return;
+
+        m_binaryLogFileName = fileName;
+        openBinaryLog();
+    } else {
+        delete m_binaryLog;
+        m_binaryLog = 0;
+    }
+}
+
+/** @short Configure the size-based rotation of the binary log
+
+Once the current file grows past @arg maxFileSize bytes, it is renamed to "<name>.1", the older files get shifted, and
+at most @arg rotatedFiles of them are kept around.
+*/
+void FileLogger::setLogRotation(const qint64 maxFileSize, const int rotatedFiles)
+{
+    m_maxFileSize = maxFileSize;
+    m_rotatedFiles = rotatedFiles;
+}
+
+void FileLogger::openBinaryLog()
+{
+    m_binaryLog = new QFile(m_binaryLogFileName, this);
+    if (!m_binaryLog->open(QIODevice::Truncate | QIODevice::WriteOnly) || !writeBinaryLogHeader(m_binaryLog)) {
+        binaryLogFailed(tr("Cannot open the protocol log %1: %2").arg(m_binaryLogFileName, m_binaryLog->errorString()));
+        return;
+    }
+    m_binaryLogSize = m_binaryLog->pos();
+}
+
+void FileLogger::binaryLogFailed(const QString &message)
+{
+    delete m_binaryLog;
+    m_binaryLog = 0;
+    emit binaryLoggingFailed(message);
+}
+
+void FileLogger::rotateBinaryLog()
+{
+    delete m_binaryLog;
+    m_binaryLog = 0;
+
+    if (m_rotatedFiles > 0) {
+        const QString prefix = m_binaryLogFileName + QLatin1Char('.');
+        QFile::remove(prefix + QString::number(m_rotatedFiles));
+        for (int i = m_rotatedFiles - 1; i > 0; --i) {
+            QFile::rename(prefix + QString::number(i), prefix + QString::number(i + 1));
+        }
+        QFile::rename(m_binaryLogFileName, prefix + QLatin1Char('1'));
+    }
+    openBinaryLog();
+}
+
 FileLogger::~FileLogger()
 {
     delete m_fileLog;
+    delete m_binaryLog;
 }
 
 void FileLogger::escapeCrLf(QString &s)
@@ -67,6 +140,23 @@ void FileLogger::escapeCrLf(QString &s)
 
 void FileLogger::log(uint connectionId, Common::LogMessage message)
 {
+    if (m_binaryLog) {
+        // The raw data go straight to the disk, there's no need to format anything
+        if (m_binaryLogSize >= m_maxFileSize)
+            rotateBinaryLog();
+        if (m_binaryLog) {
+            const qint64 written = writeBinaryLogRecord(m_binaryLog, connectionId, message);
+            if (written < 0) {
+                binaryLogFailed(tr("Cannot write into the protocol log %1: %2").arg(m_binaryLogFileName, m_binaryLog->errorString()));
+            } else {
+                m_binaryLogSize += written;
+            }
+        }
+    }
+
+    if (m_autoFlush && (m_fileLog || m_binaryLog) && !m_flushTimer->isActive())
+        m_flushTimer->start();
+
     if (!m_fileLog && !m_consoleLog)
         return;
 
@@ -75,16 +165,13 @@ void FileLogger::log(uint connectionId, Common::LogMessage message)
 
     if (m_fileLog) {
         *m_fileLog << formatted << "\n";
-        if (m_autoFlush)
-            m_fileLog->flush();
     }
 
     enum {CUTOFF=200};
     if (m_consoleLog) {
-        if (message.message.size() > CUTOFF) {
+        if (message.size() > CUTOFF) {
             // Got to reformat the message
-            message.truncatedBytes = message.message.size() - CUTOFF;
-            message.message = message.message.left(CUTOFF);
+            message.truncate(CUTOFF);
             formatted = formatMessage(connectionId, message);
             escapeCrLf(formatted);
         }
@@ -92,7 +179,7 @@ void FileLogger::log(uint connectionId, Common::LogMessage message)
     }
 }
 
-QString FileLogger::formatMessage(uint parser, const Common::LogMessage &message) const
+QString FileLogger::formatMessage(uint parser, const Common::LogMessage &message)
 {
     using namespace Common;
     QString direction;
@@ -126,19 +213,30 @@ QString FileLogger::formatMessage(uint parser, const Common::LogMessage &message
         direction += QLatin1String("[truncated] ");
     }
     return message.timestamp.toString(QStringLiteral("hh:mm:ss.zzz")) + QString::number(parser) + QLatin1Char(' ') +
-            direction + message.source + QLatin1Char(' ') + message.message.trimmed();
+            direction + message.source + QLatin1Char(' ') + message.text().trimmed();
 }
 
-/** @short Enable flushing the on-disk log after each message
+/** @short Enable flushing the on-disk log shortly after each message
 
 Automatically flushing the log will make sure that all messages are actually stored in the log even in the event of a program
-crash, but at the cost of a rather high overhead.
+crash. Instead of syncing after each and every line, the data are flushed from a timer which fires shortly after the first
+unflushed message, so that a burst of protocol traffic results in a single write.
 */
 void FileLogger::setAutoFlush(const bool autoFlush)
 {
     m_autoFlush = autoFlush;
-    if (m_autoFlush && m_fileLog)
+    if (m_autoFlush)
+        flushLogs();
+    else
+        m_flushTimer->stop();
+}
+
+void FileLogger::flushLogs()
+{
+    if (m_fileLog)
         m_fileLog->flush();
+    if (m_binaryLog)
+        m_binaryLog->flush();
 }
 
 void FileLogger::setConsoleLogging(const bool enabled)
@@ -26,7 +26,9 @@
 #include <QObject>
 #include "Logging.h"
 
+class QFile;
 class QTextStream;
+class QTimer;
 
 namespace Common
 {
@@ -45,18 +47,42 @@ public slots:
     /** @short Enable/disable persistent logging */
     void setFileLogging(const bool enabled, const QString &fileName);
 
+    /** @short Enable/disable persistent logging into a compact, binary file */
+    void setBinaryLogging(const bool enabled, const QString &fileName);
+
     void setConsoleLogging(const bool enabled);
 
     void setAutoFlush(const bool autoFlush);
 
+public:
+    void setLogRotation(const qint64 maxFileSize, const int rotatedFiles);
+
+    static QString formatMessage(uint parser, const Common::LogMessage &message);
+    static void escapeCrLf(QString &s);
+
+signals:
+    /** @short The binary log cannot be written, so the binary logging got disabled */
+    void binaryLoggingFailed(const QString &message);
+
+private slots:
+    void flushLogs();
+
 protected:
-    QString formatMessage(uint parser, const Common::LogMessage &message) const;
-    void escapeCrLf(QString &s);
+    void openBinaryLog();
+    void rotateBinaryLog();
+    void binaryLogFailed(const QString &message);
 
     QTextStream *m_fileLog;
+    QFile *m_binaryLog;
+    QString m_binaryLogFileName;
+    /** @short Number of bytes written into the current binary log file; asking the QFile would flush its buffers */
+    qint64 m_binaryLogSize;
+    QTimer *m_flushTimer;
 
     bool m_consoleLog;
     bool m_autoFlush;
+    qint64 m_maxFileSize;
+    int m_rotatedFiles;
 };
 
 }
@@ -22,6 +22,7 @@
 #ifndef TROJITA_IMAP_LOGGING_H
 #define TROJITA_IMAP_LOGGING_H
 
+#include <QByteArray>
 #include <QDateTime>
 #include <QVector>
 
@@ -50,6 +51,12 @@ struct LogMessage {
     QString source;
     /** @short Actual message */
     QString message;
+    /** @short Raw data as it went over the wire
+
+    The protocol traffic is stored as-is, and it is converted to text only once somebody wants to display or save it.
+    Use text() for accessing the content of any message.
+    */
+    QByteArray rawMessage;
     /** @short Was it truncated? */
     uint truncatedBytes;
 
@@ -58,13 +65,42 @@ struct LogMessage {
     {
     }
 
+    LogMessage(const QDateTime &timestamp_, const LogKind kind_, const QString &source_, const QByteArray &rawMessage_):
+        timestamp(timestamp_), kind(kind_), source(source_), rawMessage(rawMessage_), truncatedBytes(0)
+    {
+    }
+
     // default constructor for QVector
     LogMessage() {}
+
+    /** @short Return the human-readable content of this message */
+    QString text() const
+    {
+        return rawMessage.isNull() ? message : QString::fromUtf8(rawMessage);
+    }
+
+    /** @short Size of the content, in bytes for the raw data and in characters otherwise */
+    int size() const
+    {
+        return rawMessage.isNull() ? message.size() : rawMessage.size();
+    }
+
+    /** @short Shorten the content to at most @arg maxSize bytes or characters, and remember how much was cut */
+    void truncate(const int maxSize)
+    {
+        if (size() <= maxSize)
+            return;
+        truncatedBytes += size() - maxSize;
+        if (rawMessage.isNull())
+            message = message.left(maxSize);
+        else
+            rawMessage = rawMessage.left(maxSize);
+    }
 };
 
 }
 
-// Both QString and QDateTime are movable, so our combination is movable as well
+// QString, QByteArray and QDateTime are movable, so our combination is movable as well
 Q_DECLARE_TYPEINFO(Common::LogMessage, Q_MOVABLE_TYPE);
 
 #endif // TROJITA_IMAP_LOGGING_H
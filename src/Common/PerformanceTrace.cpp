@@ -0,0 +1,220 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QSet>
+#include "PerformanceTrace.h"
+
+namespace {
+
+Q_GLOBAL_STATIC(Common::PerformanceTrace, globalPerformanceTrace)
+
+/** @short All events are reported as belonging to a single process */
+const int tracePid = 1;
+
+QJsonObject threadNameEvent(const uint connectionId)
+{
+    QJsonObject args;
+    args[QStringLiteral("name")] = connectionId ? QStringLiteral("Connection %1").arg(connectionId) : QStringLiteral("Model");
+    QJsonObject event;
+    event[QStringLiteral("name")] = QStringLiteral("thread_name");
+    event[QStringLiteral("ph")] = QStringLiteral("M");
+    event[QStringLiteral("pid")] = tracePid;
+    event[QStringLiteral("tid")] = static_cast<qint64>(connectionId);
+    event[QStringLiteral("args")] = args;
+    return event;
+}
+
+QJsonObject counterEvent(const QString &name, const qint64 timestamp, const QJsonObject &args)
+{
+    QJsonObject event;
+    event[QStringLiteral("name")] = name;
+    event[QStringLiteral("ph")] = QStringLiteral("C");
+    event[QStringLiteral("ts")] = timestamp;
+    event[QStringLiteral("pid")] = tracePid;
+    event[QStringLiteral("args")] = args;
+    return event;
+}
+
+}
+
+namespace Common
+{
+
+PerformanceTrace::PerformanceTrace(const int maxSpans): m_spans(maxSpans)
+{
+    m_clock.start();
+}
+
+PerformanceTrace *PerformanceTrace::instance()
+{
+    return globalPerformanceTrace();
+}
+
+qint64 PerformanceTrace::timestamp() const
+{
+    return m_clock.nsecsElapsed() / 1000;
+}
+
+void PerformanceTrace::recordSpan(const char *category, const QString &name, const QString &detail, const uint connectionId, const qint64 start)
+{
+    Span span;
+    span.category = category;
+    span.name = name;
+    span.detail = detail;
+    span.connectionId = connectionId;
+    span.start = start;
+    span.duration = qMax(Q_INT64_C(0), timestamp() - start);
+
+    QMutexLocker locker(&m_mutex);
+    SpanStatistics &stats = m_spanStatistics[qMakePair(QByteArray(category), name)];
+    if (!stats.count) {
+        stats.category = category;
+        stats.name = name;
+    }
+    ++stats.count;
+    stats.total += span.duration;
+    stats.max = qMax(stats.max, span.duration);
+    m_spans.append(span);
+}
+
+void PerformanceTrace::recordCacheLookup(const char *method, const bool hit)
+{
+    QMutexLocker locker(&m_mutex);
+    CacheStatistics &stats = m_cacheStatistics[QByteArray(method)];
+    if (hit)
+        ++stats.hits;
+    else
+        ++stats.misses;
+}
+
+void PerformanceTrace::recordTraffic(const uint connectionId, const qint64 bytesIn, const qint64 bytesOut)
+{
+    QMutexLocker locker(&m_mutex);
+    TrafficStatistics &stats = m_trafficStatistics[connectionId];
+    stats.bytesIn += bytesIn;
+    stats.bytesOut += bytesOut;
+}
+
+QVector<PerformanceTrace::SpanStatistics> PerformanceTrace::spanStatistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    QVector<SpanStatistics> res;
+    res.reserve(m_spanStatistics.size());
+    for (auto it = m_spanStatistics.constBegin(); it != m_spanStatistics.constEnd(); ++it) {
+        res << *it;
+    }
+    std::sort(res.begin(), res.end(), [](const SpanStatistics &a, const SpanStatistics &b) {
+        return a.total > b.total;
+    });
+    return res;
+}
+
+QMap<QByteArray, PerformanceTrace::CacheStatistics> PerformanceTrace::cacheStatistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_cacheStatistics;
+}
+
+QMap<uint, PerformanceTrace::TrafficStatistics> PerformanceTrace::trafficStatistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_trafficStatistics;
+}
+
+/** @short Produce a JSON document in the Trace Event Format
+
+Each recorded span becomes a "complete" (ph=X) event. The connection ID is used as a thread ID so that the events of
+each IMAP connection end up on their own track. The cache and traffic statistics are appended as counter (ph=C) events
+at the time of the export.
+*/
+QByteArray PerformanceTrace::toChromeTrace() const
+{
+    const qint64 now = timestamp();
+    QMutexLocker locker(&m_mutex);
+
+    QJsonArray events;
+    QSet<uint> connections;
+    connections << 0;
+
+    for (auto it = m_spans.begin(); it != m_spans.end(); ++it) {
+        QJsonObject event;
+        event[QStringLiteral("name")] = it->name;
+        event[QStringLiteral("cat")] = QString::fromUtf8(it->category);
+        event[QStringLiteral("ph")] = QStringLiteral("X");
+        event[QStringLiteral("ts")] = it->start;
+        event[QStringLiteral("dur")] = it->duration;
+        event[QStringLiteral("pid")] = tracePid;
+        event[QStringLiteral("tid")] = static_cast<qint64>(it->connectionId);
+        if (!it->detail.isEmpty()) {
+            QJsonObject args;
+            args[QStringLiteral("detail")] = it->detail;
+            event[QStringLiteral("args")] = args;
+        }
+        events.append(event);
+        connections << it->connectionId;
+    }
+
+    for (auto it = m_trafficStatistics.constBegin(); it != m_trafficStatistics.constEnd(); ++it) {
+        QJsonObject args;
+        args[QStringLiteral("in")] = static_cast<qint64>(it->bytesIn);
+        args[QStringLiteral("out")] = static_cast<qint64>(it->bytesOut);
+        events.append(counterEvent(QStringLiteral("Traffic of connection %1").arg(it.key()), now, args));
+        connections << it.key();
+    }
+
+    for (auto it = m_cacheStatistics.constBegin(); it != m_cacheStatistics.constEnd(); ++it) {
+        QJsonObject args;
+        args[QStringLiteral("hits")] = static_cast<qint64>(it->hits);
+        args[QStringLiteral("misses")] = static_cast<qint64>(it->misses);
+        events.append(counterEvent(QStringLiteral("Cache %1").arg(QString::fromUtf8(it.key())), now, args));
+    }
+
+    Q_FOREACH(const uint connectionId, connections) {
+        events.append(threadNameEvent(connectionId));
+    }
+
+    QJsonObject root;
+    root[QStringLiteral("traceEvents")] = events;
+    root[QStringLiteral("displayTimeUnit")] = QStringLiteral("ms");
+    if (m_spans.skippedCount()) {
+        QJsonObject other;
+        other[QStringLiteral("droppedEvents")] = static_cast<qint64>(m_spans.skippedCount());
+        root[QStringLiteral("otherData")] = other;
+    }
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+void PerformanceTrace::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_spans.clear();
+    m_spanStatistics.clear();
+    m_cacheStatistics.clear();
+    m_trafficStatistics.clear();
+}
+
+}
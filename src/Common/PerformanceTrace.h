@@ -0,0 +1,131 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COMMON_PERFORMANCETRACE_H
+#define COMMON_PERFORMANCETRACE_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include "RingBuffer.h"
+
+namespace Common
+{
+
+/** @short Lightweight recorder of where the time goes
+
+The recorder keeps aggregated statistics about durations of various activities (like the total wall time spent in each
+kind of an ImapTask or the round-trip time of each IMAP command), hit and miss counts of the cache lookups, and the
+amount of the protocol traffic on each connection. The most recent individual timed events are kept in a bounded ring
+buffer so that they can be exported in the Chrome trace event format and inspected with chrome://tracing or Perfetto.
+
+All timestamps are in microseconds since the recorder was created. The class is thread-safe, but all current users
+live in the GUI thread anyway, so the lock is never contended.
+*/
+class PerformanceTrace
+{
+public:
+    /** @short One timed event */
+    struct Span {
+        /** @short Static string describing the kind of this event, e.g. "task" or "imap" */
+        const char *category;
+        /** @short Name used for aggregating the statistics, e.g. the class name of a task */
+        QString name;
+        /** @short Free-form detail about this particular occurrence */
+        QString detail;
+        uint connectionId;
+        qint64 start;
+        qint64 duration;
+
+        Span(): category(nullptr), connectionId(0), start(0), duration(0) {}
+    };
+
+    /** @short Summary of all events of the same category and name */
+    struct SpanStatistics {
+        QByteArray category;
+        QString name;
+        quint64 count;
+        qint64 total;
+        qint64 max;
+
+        SpanStatistics(): count(0), total(0), max(0) {}
+    };
+
+    struct CacheStatistics {
+        quint64 hits;
+        quint64 misses;
+
+        CacheStatistics(): hits(0), misses(0) {}
+    };
+
+    struct TrafficStatistics {
+        quint64 bytesIn;
+        quint64 bytesOut;
+
+        TrafficStatistics(): bytesIn(0), bytesOut(0) {}
+    };
+
+    explicit PerformanceTrace(const int maxSpans = 10000);
+
+    /** @short The process-wide recorder */
+    static PerformanceTrace *instance();
+
+    /** @short Current time in microseconds, suitable for passing to recordSpan() later on */
+    qint64 timestamp() const;
+
+    /** @short Record an event which started at @arg start and ends right now */
+    void recordSpan(const char *category, const QString &name, const QString &detail, const uint connectionId, const qint64 start);
+
+    /** @short Record the result of a single cache lookup through the @arg method */
+    void recordCacheLookup(const char *method, const bool hit);
+
+    /** @short Account for the data which were received from or sent to the server over a given connection */
+    void recordTraffic(const uint connectionId, const qint64 bytesIn, const qint64 bytesOut);
+
+    QVector<SpanStatistics> spanStatistics() const;
+    QMap<QByteArray, CacheStatistics> cacheStatistics() const;
+    QMap<uint, TrafficStatistics> trafficStatistics() const;
+
+    /** @short Export the recorded events and counters as a Chrome trace event JSON document */
+    QByteArray toChromeTrace() const;
+
+    /** @short Forget everything which has been recorded so far */
+    void clear();
+
+private:
+    mutable QMutex m_mutex;
+    QElapsedTimer m_clock;
+    RingBuffer<Span> m_spans;
+    QHash<QPair<QByteArray, QString>, SpanStatistics> m_spanStatistics;
+    QMap<QByteArray, CacheStatistics> m_cacheStatistics;
+    QMap<uint, TrafficStatistics> m_trafficStatistics;
+
+    PerformanceTrace(const PerformanceTrace &); // don't implement
+    PerformanceTrace &operator=(const PerformanceTrace &); // don't implement
+};
+
+}
+
+#endif // COMMON_PERFORMANCETRACE_H
@@ -83,6 +83,7 @@ const QString SettingsNames::cacheOfflineNone = QStringLiteral("memory");
 const QString SettingsNames::cacheOfflineXDays = QStringLiteral("days");
 const QString SettingsNames::cacheOfflineAll = QStringLiteral("all");
 const QString SettingsNames::cacheOfflineNumberDaysKey = QStringLiteral("offline.cache.numDays");
+const QString SettingsNames::cacheOfflineSizeLimitKey = QStringLiteral("offline.cache.sizeLimitMiB");
 const QString SettingsNames::watchedFoldersKey = QStringLiteral("watchFolders");
 const QString SettingsNames::watchOnlyInbox = QStringLiteral("INBOX");
 const QString SettingsNames::watchSubscribed = QStringLiteral("subscribed");
@@ -95,6 +96,7 @@ const QString SettingsNames::xtDbDbName = QStringLiteral("xtconnect.db.dbname");
 const QString SettingsNames::xtDbUser = QStringLiteral("xtconnect.db.username");
 const QString SettingsNames::guiMsgListShowThreading = QStringLiteral("gui/msgList.showThreading");
 const QString SettingsNames::guiMsgListHideRead = QStringLiteral("gui/msgList.hideRead");
+const QString SettingsNames::guiMsgListShowPreviews = QStringLiteral("gui/msgList.showPreviews");
 const QString SettingsNames::guiMailboxListShowOnlySubscribed = QStringLiteral("gui/mailboxList.showOnlySubscribed");
 const QString SettingsNames::guiMainWindowLayout = QStringLiteral("gui/mainWindow.layout");
 const QString SettingsNames::guiMainWindowLayoutCompact = QStringLiteral("compact");
@@ -451,7 +451,7 @@ QByteArray ImapPartAttachmentItem::imapUrl() const
 
 void ImapPartAttachmentItem::preload() const
 {
-    index.data(RolePartData);
+    index.data(RolePartPrefetch);
 }
 
 void ImapPartAttachmentItem::asDroppableMimeData(QDataStream &stream) const
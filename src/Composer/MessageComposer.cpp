@@ -29,6 +29,7 @@
 #include "Common/Application.h"
 #include "Composer/ComposerAttachments.h"
 #include "Imap/Encoders.h"
+#include "Imap/TransferEncoding.h"
 #include "Imap/Model/DragAndDrop.h"
 #include "Imap/Model/ItemRoles.h"
 #include "Imap/Model/Model.h"
@@ -47,6 +48,33 @@
 
 namespace Composer {
 
+namespace {
+
+/** @short Pass the whole @arg source through an encoder in fixed-size chunks, reusing the buffers */
+template <typename Encoder>
+void encodeStream(QIODevice *source, QIODevice *target)
+{
+    const int chunkSize = 64 * 1024;
+    QByteArray buf(chunkSize, Qt::Uninitialized);
+    QByteArray encoded;
+    // A reserved capacity survives the resize(0) below
+    encoded.reserve(chunkSize * 4);
+    Encoder encoder;
+    while (!source->atEnd()) {
+        const qint64 size = source->read(buf.data(), chunkSize);
+        if (size <= 0) {
+            break;
+        }
+        encoder.encode(buf.constData(), size, &encoded);
+        target->write(encoded);
+        encoded.resize(0);
+    }
+    encoder.finish(&encoded);
+    target->write(encoded);
+}
+
+}
+
 MessageComposer::MessageComposer(Imap::Mailbox::Model *model) :
     QAbstractListModel(nullptr), m_model(model), m_shouldPreload(false), m_reportTrojitaVersions(true)
 {
@@ -635,22 +663,20 @@ bool MessageComposer::writeAttachmentBody(QIODevice *target, QString *errorMessa
         *errorMessage = tr("Attachment %1 disappeared").arg(attachment->caption());
         return false;
     }
-    while (!io->atEnd()) {
-        switch (attachment->suggestedCTE()) {
-        case AttachmentItem::ContentTransferEncoding::Base64:
-            // Base64 maps 6bit chunks into a single byte. Output shall have no more than 76 characters per line
-            // (not counting the CRLF pair).
-            target->write(io->read(76*6/8).toBase64() + "\r\n");
-            break;
-        case AttachmentItem::ContentTransferEncoding::QuotedPrintable:
-            target->write(Imap::quotedPrintableEncode(io->readAll()));
-            break;
-        case AttachmentItem::ContentTransferEncoding::SevenBit:
-        case AttachmentItem::ContentTransferEncoding::EightBit:
-        case AttachmentItem::ContentTransferEncoding::Binary:
+    switch (attachment->suggestedCTE()) {
+    case AttachmentItem::ContentTransferEncoding::Base64:
+        encodeStream<Imap::TransferEncoding::Base64Encoder>(io.data(), target);
+        break;
+    case AttachmentItem::ContentTransferEncoding::QuotedPrintable:
+        encodeStream<Imap::TransferEncoding::QuotedPrintableEncoder>(io.data(), target);
+        break;
+    case AttachmentItem::ContentTransferEncoding::SevenBit:
+    case AttachmentItem::ContentTransferEncoding::EightBit:
+    case AttachmentItem::ContentTransferEncoding::Binary:
+        while (!io->atEnd()) {
             target->write(io->readAll());
-            break;
         }
+        break;
     }
     return true;
 }
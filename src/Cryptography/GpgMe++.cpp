@@ -20,21 +20,28 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <cstring>
-#include <future>
 #include <mimetic/mimetic.h>
 #include <gpgme++/context.h>
 #include <gpgme++/data.h>
 #include <gpgme++/decryptionresult.h>
+#include <gpgme++/engineinfo.h>
 #include <gpgme++/key.h>
 #include <gpgme++/interfaces/progressprovider.h>
 #include <qgpgme/dataprovider.h>
+#include <QCryptographicHash>
+#include <QDir>
 #include <QElapsedTimer>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QThread>
 #include "Common/InvokeMethod.h"
 #include "Cryptography/GpgMe++.h"
 #include "Cryptography/MessagePart.h"
 #include "Cryptography/MessageModel.h"
 #include "Cryptography/MimeticUtils.h"
+#include "Cryptography/SignatureCache.h"
 #include "Imap/Model/ItemRoles.h"
 #include "Imap/Model/MailboxTree.h"
 
@@ -56,11 +63,54 @@ QByteArray getAuditLog(GpgME::Context *ctx)
 }
 #endif
 
-bool is_running(const std::future<void> &future)
+/** @short Something which changes whenever the keyring or the trust database gets modified
+
+GpgME has no notion of a "keyring version", so let's look at the files which back it. This has to be cheap enough
+for calling it each time a signed message gets opened.
+*/
+QByteArray keyringGeneration(const GpgME::Protocol protocol)
 {
-    return future.wait_for(std::chrono::duration_values<std::chrono::seconds>::zero()) == std::future_status::timeout;
+    QString home = QString::fromUtf8(GpgME::engineInfo(protocol).homeDirectory());
+    if (home.isEmpty()) {
+        home = QString::fromLocal8Bit(qgetenv("GNUPGHOME"));
+    }
+    if (home.isEmpty()) {
+#ifdef Q_OS_WIN
+        home = QString::fromLocal8Bit(qgetenv("APPDATA")) + QLatin1String("/gnupg");
+#else
+        home = QDir::homePath() + QLatin1String("/.gnupg");
+#endif
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(home.toUtf8());
+    for (const auto fileName: {"pubring.kbx", "pubring.gpg", "trustdb.gpg", "trustlist.txt"}) {
+        QFileInfo info(home + QLatin1Char('/') + QLatin1String(fileName));
+        if (info.exists()) {
+            hash.addData(QByteArray(fileName) + ':' + QByteArray::number(info.size()) + ':'
+                         + QByteArray::number(info.lastModified().toMSecsSinceEpoch()) + '\n');
+        }
+    }
+    return hash.result();
 }
 
+class CryptoRunnable: public QRunnable
+{
+public:
+    explicit CryptoRunnable(std::shared_ptr<Cryptography::CryptoTask> task)
+        : m_task(std::move(task))
+    {
+    }
+
+    void run() override
+    {
+        m_task->run();
+    }
+
+private:
+    std::shared_ptr<Cryptography::CryptoTask> m_task;
+};
+
 }
 
 namespace Cryptography {
@@ -76,27 +126,67 @@ QString protocolToString(const Protocol protocol)
     Q_UNREACHABLE();
 }
 
+CryptoTask::CryptoTask(std::shared_ptr<GpgME::Context> ctx, std::function<void()> body)
+    : m_ctx(std::move(ctx))
+    , m_body(std::move(body))
+    , m_state(QUEUED)
+{
+}
+
+/** @short Execute the operation unless it has been cancelled already; this runs in a worker thread */
+void CryptoTask::run()
+{
+    int expected = QUEUED;
+    if (!m_state.compare_exchange_strong(expected, RUNNING)) {
+        return;
+    }
+    m_body();
+    // Release the captured message data as soon as possible
+    m_body = nullptr;
+    m_state = FINISHED;
+}
+
+/** @short Make sure that this operation does not delay anything else */
+void CryptoTask::cancel()
+{
+    int expected = QUEUED;
+    if (!m_state.compare_exchange_strong(expected, CANCELLED) && expected == RUNNING) {
+        // this is documented to be thread safe at all times
+        m_ctx->cancelPendingOperation();
+    }
+}
+
+bool CryptoTask::isFinished() const
+{
+    const int state = m_state;
+    return state == FINISHED || state == CANCELLED;
+}
+
 GpgMeReplacer::GpgMeReplacer()
     : PartReplacer()
+    , m_verifications(1000)
 {
     GpgME::initializeLibrary();
     qRegisterMetaType<SignatureDataBundle>();
+
+    // Each operation runs a gpg process, so there's little point in having many of them; scrolling through
+    // a mailing list full of signed messages shall not fork dozens of them.
+    m_pool.setMaxThreadCount(qBound(1, QThread::idealThreadCount() / 2, 4));
 }
 
 GpgMeReplacer::~GpgMeReplacer()
 {
-    if (!m_orphans.empty()) {
+    for (const auto &weak: m_tasks) {
+        if (auto task = weak.lock()) {
+            task->cancel();
+        }
+    }
+    m_pool.clear();
+    if (m_pool.activeThreadCount()) {
         QElapsedTimer t;
         t.start();
-        qDebug() << "Cleaning" << m_orphans.size() << "orphaned crypto task: ";
-        for (auto &task: m_orphans) {
-            if (is_running(task)) {
-                qDebug() << " [waiting]";
-                task.get();
-            } else {
-                qDebug() << " [already completed]";
-            }
-        }
+        qDebug() << "Waiting for" << m_pool.activeThreadCount() << "crypto tasks...";
+        m_pool.waitForDone();
         qDebug() << " ...finished after" << t.elapsed() << "ms.";
     }
 }
@@ -134,22 +224,57 @@ MessagePart::Ptr GpgMeReplacer::createPart(MessageModel *model, MessagePart *par
     return original;
 }
 
-void GpgMeReplacer::registerOrhpanedCryptoTask(std::future<void> task)
+/** @short Queue the @arg body for execution in one of the worker threads
+
+The operations are executed in the order of their submission, with a bounded number of them running at once.
+The returned task shall be cancelled when its result is no longer needed.
+*/
+std::shared_ptr<CryptoTask> GpgMeReplacer::submitCryptoTask(std::shared_ptr<GpgME::Context> ctx, std::function<void()> body)
 {
-    auto it = m_orphans.begin();
-    while (it != m_orphans.end()) {
-        if (it->valid() && is_running(*it)) {
-            ++it;
-        } else {
-            qDebug() << "[cleaning an already-finished crypto orphan]";
-            it = m_orphans.erase(it);
-        }
+    m_tasks.erase(std::remove_if(m_tasks.begin(), m_tasks.end(), [](const std::weak_ptr<CryptoTask> &weak) {
+        return weak.expired();
+    }), m_tasks.end());
+
+    auto task = std::make_shared<CryptoTask>(std::move(ctx), std::move(body));
+    m_tasks.emplace_back(task);
+    m_pool.start(new CryptoRunnable(task));
+    return task;
+}
+
+/** @short Remember the results of signature verification across restarts in the specified database
+
+Passing an empty @arg fileName disables the persistent storage.
+*/
+void GpgMeReplacer::setPersistentCache(const QString &fileName)
+{
+    m_persistentVerifications.reset();
+    if (fileName.isEmpty())
+        return;
+    std::unique_ptr<SignatureCache> cache(new SignatureCache());
+    if (cache->open(fileName)) {
+        m_persistentVerifications = std::move(cache);
+    }
+}
+
+/** @short Look up an earlier result of verifying the very same signed data */
+bool GpgMeReplacer::cachedVerification(const QByteArray &key, SignatureDataBundle &result)
+{
+    if (const auto cached = m_verifications.object(key)) {
+        result = *cached;
+        return true;
     }
-    if (task.valid() && is_running(task)) {
-        m_orphans.emplace_back(std::move(task));
+    if (m_persistentVerifications && m_persistentVerifications->lookup(key, result)) {
+        m_verifications.insert(key, new SignatureDataBundle(result));
+        return true;
     }
-    if (!m_orphans.empty()) {
-        qDebug() << "We have" << m_orphans.size() << "orphaned crypto tasks";
+    return false;
+}
+
+void GpgMeReplacer::cacheVerification(const QByteArray &key, const SignatureDataBundle &result)
+{
+    m_verifications.insert(key, new SignatureDataBundle(result));
+    if (m_persistentVerifications) {
+        m_persistentVerifications->store(key, result);
     }
 }
 
@@ -193,26 +318,14 @@ GpgMePart::GpgMePart(const Protocol protocol, GpgMeReplacer *replacer, MessageMo
             index = index.parent();
         }
     }
-
-    // do the periodic cleanup
-    m_replacer->registerOrhpanedCryptoTask(std::future<void>());
 }
 
 GpgMePart::~GpgMePart()
 {
-    if (m_ctx && m_crypto.valid()) {
-        // this is documented to be thread safe at all times
-        m_ctx->cancelPendingOperation();
-
-        // Because std::future's destructor blocks/joins, we have a problem if the operation that is running
-        // in the std::async gets stuck for some reason. If we make no additional precautions, the GUI would freeze
-        // at the destruction time, which means that everything will run "smoothly" (with the GUI remaining responsive)
-        // until the time we move to another message -- and that's quite nasty surprise.
-        //
-        // To solve this thing, we send this background operation to a central registry in this destructor. Every now
-        // and then, that registry is checked and those which have already finished are reaped. This happens whenever
-        // a new crypto operation is started.
-        m_replacer->registerOrhpanedCryptoTask(std::move(m_crypto));
+    if (m_crypto) {
+        // The message view is going away. Operations which haven't started yet are simply dropped, and the running ones
+        // are interrupted. The worker thread will not report back because the QPointer to this object is null by then.
+        m_crypto->cancel();
     }
 }
 
@@ -227,7 +340,12 @@ void GpgMePart::internalUpdateState(const SignatureDataBundle &d)
     m_statusIcon = d.statusIcon;
     m_signatureIdentityName = d.signatureUid;
     m_signDate = d.signatureDate;
-    m_crypto.get();
+    m_crypto.reset();
+    if (!m_verificationCacheKey.isEmpty() && d.wasSigned && !d.signatureUid.isEmpty()) {
+        // Only remember those results where the key was available. A missing key might get imported later.
+        m_replacer->cacheVerification(m_verificationCacheKey, d);
+    }
+    m_verificationCacheKey.clear();
     emitDataChanged();
 }
 
@@ -270,9 +388,7 @@ QVariant GpgMePart::data(int role) const
     case RolePartDecryptionSupported:
         return m_isAllegedlyEncrypted;
     case RolePartCryptoNotFinishedYet:
-        return m_waitingForData ||
-                (m_crypto.valid() &&
-                 m_crypto.wait_for(std::chrono::duration_values<std::chrono::seconds>::zero()) == std::future_status::timeout);
+        return m_waitingForData || m_crypto;
     case RolePartCryptoTLDR:
         return m_statusTLDR;
     case RolePartCryptoDetailedMessage:
@@ -636,7 +752,14 @@ GpgMeSigned::~GpgMeSigned()
 
 void GpgMeSigned::handleDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
 {
-    Q_ASSERT(topLeft == bottomRight);
+    if (topLeft != bottomRight) {
+        // A range of messages; only the enclosing message might be of interest
+        if (m_enclosingMessage.isValid() && topLeft.parent() == m_enclosingMessage.parent() &&
+                m_enclosingMessage.row() >= topLeft.row() && m_enclosingMessage.row() <= bottomRight.row()) {
+            handleDataChanged(m_enclosingMessage, m_enclosingMessage);
+        }
+        return;
+    }
     if (!m_plaintextPart.isValid()) {
         forwardFailure(tr("Signed message is gone"), QString(), QStringLiteral("state-offline"));
         return;
@@ -678,9 +801,28 @@ void GpgMeSigned::handleDataChanged(const QModelIndex &topLeft, const QModelInde
     auto messageUids = extractMessageUids();
     auto ctx = m_ctx;
 
-    m_crypto = std::async(std::launch::async, [this, ctx, rawData, signatureData, messageUids, wasEncrypted](){
-        QPointer<QObject> p(this);
+    // The result depends on everything which goes into the verification, including the addresses we compare the signer with
+    // and the state of the keyring
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(QByteArray::number(static_cast<int>(ctx->protocol())) + (wasEncrypted ? "E" : "S"));
+    hash.addData(keyringGeneration(ctx->protocol()));
+    for (const auto &uid: messageUids) {
+        hash.addData(uid.c_str(), static_cast<int>(uid.size() + 1));
+    }
+    hash.addData(QByteArray::number(signatureData.size()) + ':');
+    hash.addData(signatureData);
+    hash.addData(rawData);
+    m_verificationCacheKey = hash.result();
+
+    SignatureDataBundle cached;
+    if (m_replacer->cachedVerification(m_verificationCacheKey, cached)) {
+        m_verificationCacheKey.clear();
+        internalUpdateState(cached);
+        return;
+    }
 
+    QPointer<QObject> p(this);
+    m_crypto = m_replacer->submitCryptoTask(ctx, [p, ctx, rawData, signatureData, messageUids, wasEncrypted](){
         GpgME::Data sigData(signatureData.data(), signatureData.size(), false);
         GpgME::Data msgData(rawData.data(), rawData.size(), false);
 
@@ -781,7 +923,14 @@ GpgMeEncrypted::~GpgMeEncrypted()
 
 void GpgMeEncrypted::handleDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
 {
-    Q_ASSERT(topLeft == bottomRight);
+    if (topLeft != bottomRight) {
+        // A range of messages; only the enclosing message might be of interest
+        if (m_enclosingMessage.isValid() && topLeft.parent() == m_enclosingMessage.parent() &&
+                m_enclosingMessage.row() >= topLeft.row() && m_enclosingMessage.row() <= bottomRight.row()) {
+            handleDataChanged(m_enclosingMessage, m_enclosingMessage);
+        }
+        return;
+    }
     if (!m_encPart.isValid()) {
         forwardFailure(tr("Encrypted message is gone"), QString(), QStringLiteral("state-offline"));
         return;
@@ -823,9 +972,8 @@ void GpgMeEncrypted::handleDataChanged(const QModelIndex &topLeft, const QModelI
     auto messageUids = extractMessageUids();
     auto ctx = m_ctx;
 
-    m_crypto = std::async(std::launch::async, [this, ctx, cipherData, messageUids ](){
-        QPointer<QObject> p(this);
-
+    QPointer<QObject> p(this);
+    m_crypto = m_replacer->submitCryptoTask(ctx, [p, ctx, cipherData, messageUids](){
         GpgME::Data encData(cipherData.data(), cipherData.size(), false);
         QGpgME::QByteArrayDataProvider dp;
         GpgME::Data plaintextData(&dp);
@@ -23,10 +23,14 @@
 #ifndef TROJITA_CRYPTO_GPGMEPP_H
 #define TROJITA_CRYPTO_GPGMEPP_H
 
-#include <future>
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <vector>
+#include <QCache>
 #include <QDateTime>
 #include <QModelIndex>
+#include <QThreadPool>
 #include "Cryptography/MessagePart.h"
 #include "Cryptography/PartReplacer.h"
 
@@ -37,6 +41,8 @@ class Signature;
 
 namespace Cryptography {
 
+class SignatureCache;
+
 struct SignatureDataBundle {
     bool wasSigned;
     bool isValidDisregardingTrust;
@@ -54,6 +60,32 @@ enum class Protocol {
     SMime,
 };
 
+/** @short A single GpgME operation which is executed by the GpgMeReplacer's worker threads
+
+The task can be cancelled at any time. A queued task will never start, and a running one gets its GpgME context
+interrupted.
+*/
+class CryptoTask {
+public:
+    CryptoTask(std::shared_ptr<GpgME::Context> ctx, std::function<void()> body);
+
+    void run();
+    void cancel();
+    bool isFinished() const;
+
+private:
+    enum State {
+        QUEUED,
+        RUNNING,
+        FINISHED,
+        CANCELLED,
+    };
+
+    std::shared_ptr<GpgME::Context> m_ctx;
+    std::function<void()> m_body;
+    std::atomic<int> m_state;
+};
+
 class GpgMeReplacer: public PartReplacer {
 public:
     GpgMeReplacer();
@@ -62,9 +94,17 @@ public:
     MessagePart::Ptr createPart(MessageModel *model, MessagePart *parentPart, MessagePart::Ptr original,
                                 const QModelIndex &sourceItemIndex, const QModelIndex &proxyParentIndex) override;
 
-    void registerOrhpanedCryptoTask(std::future<void> task);
+    std::shared_ptr<CryptoTask> submitCryptoTask(std::shared_ptr<GpgME::Context> ctx, std::function<void()> body);
+
+    void setPersistentCache(const QString &fileName);
+    bool cachedVerification(const QByteArray &key, SignatureDataBundle &result);
+    void cacheVerification(const QByteArray &key, const SignatureDataBundle &result);
+
 private:
-    std::vector<std::future<void>> m_orphans;
+    QThreadPool m_pool;
+    std::vector<std::weak_ptr<CryptoTask>> m_tasks;
+    QCache<QByteArray, SignatureDataBundle> m_verifications;
+    std::unique_ptr<SignatureCache> m_persistentVerifications;
 };
 
 /** @short Wrapper for asynchronous PGP related operations using GpgME++ */
@@ -106,7 +146,9 @@ protected:
     QDateTime m_signDate;
 
     std::shared_ptr<GpgME::Context> m_ctx;
-    std::future<void> m_crypto;
+    std::shared_ptr<CryptoTask> m_crypto;
+    /** @short Where to store the result of the signature verification once it finishes */
+    QByteArray m_verificationCacheKey;
 };
 
 class GpgMeSigned : public GpgMePart {
@@ -20,9 +20,14 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <iterator>
 #include <mimetic/mimetic.h>
 #include <QBrush>
+#include <QCoreApplication>
 #include <QFont>
+#include <QPointer>
+#include <QRunnable>
+#include <QThread>
 #include "Common/InvokeMethod.h"
 #include "Cryptography/LocalMimeParser.h"
 #include "Cryptography/MessageModel.h"
@@ -32,6 +37,261 @@
 
 namespace Cryptography {
 
+namespace {
+
+/** @short Iterate over a couple of byte arrays as if they were a single contiguous buffer
+
+This is what lets Mimetic parse the IMAP part data as-is, without concatenating them first.
+*/
+class ChainedBufferIterator
+{
+public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef char value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const char *pointer;
+    typedef const char &reference;
+
+    /** @short Construct the past-the-end iterator */
+    ChainedBufferIterator(): m_segments(nullptr), m_segment(0), m_pos(nullptr), m_end(nullptr)
+    {
+    }
+
+    explicit ChainedBufferIterator(const QVector<QByteArray> *segments): m_segments(segments), m_segment(-1), m_pos(nullptr), m_end(nullptr)
+    {
+        nextSegment();
+    }
+
+    reference operator*() const
+    {
+        return *m_pos;
+    }
+
+    ChainedBufferIterator &operator++()
+    {
+        if (++m_pos == m_end) {
+            nextSegment();
+        }
+        return *this;
+    }
+
+    ChainedBufferIterator operator++(int)
+    {
+        ChainedBufferIterator res = *this;
+        ++*this;
+        return res;
+    }
+
+    bool operator==(const ChainedBufferIterator &other) const
+    {
+        return m_pos == other.m_pos;
+    }
+
+    bool operator!=(const ChainedBufferIterator &other) const
+    {
+        return m_pos != other.m_pos;
+    }
+
+private:
+    void nextSegment()
+    {
+        // Empty segments are skipped so that a valid iterator never compares equal to the end
+        while (++m_segment < m_segments->size()) {
+            const QByteArray &segment = (*m_segments)[m_segment];
+            if (!segment.isEmpty()) {
+                m_pos = segment.constData();
+                m_end = m_pos + segment.size();
+                return;
+            }
+        }
+        m_pos = m_end = nullptr;
+    }
+
+    const QVector<QByteArray> *m_segments;
+    int m_segment;
+    const char *m_pos;
+    const char *m_end;
+};
+
+class LocalMimeParseJob: public QRunnable
+{
+public:
+    LocalMimeParseJob(LocalMimeParserPool *pool, const quint64 id, const QVector<QByteArray> &segments,
+                      const int skippedSegments, const int row)
+        : m_pool(pool)
+        , m_id(id)
+        , m_segments(segments)
+        , m_skippedSegments(skippedSegments)
+        , m_row(row)
+    {
+    }
+
+    void run() override
+    {
+        auto part = MimeticUtils::mimeEntityToPart(mimetic::MimeEntity(ChainedBufferIterator(&m_segments), ChainedBufferIterator()),
+                                                   nullptr, m_row);
+        int size = 0;
+        for (const auto &segment : m_segments) {
+            size += segment.size();
+        }
+        if (m_skippedSegments) {
+            // The leading segments are not a part of the message, they are just there to help the parser
+            QByteArray data;
+            data.reserve(size);
+            for (int i = m_skippedSegments; i < m_segments.size(); ++i) {
+                data += m_segments[i];
+            }
+            auto rawPart = dynamic_cast<LocalMessagePart *>(part.get());
+            Q_ASSERT(rawPart);
+            rawPart->setData(data);
+        }
+        m_pool->deliverResult(m_id, std::move(part), size);
+    }
+
+private:
+    LocalMimeParserPool *m_pool;
+    quint64 m_id;
+    QVector<QByteArray> m_segments;
+    int m_skippedSegments;
+    int m_row;
+};
+
+}
+
+LocalMimeParserPool::LocalMimeParserPool(QObject *parent)
+    : QObject(parent)
+    , m_cache(32 * 1024 * 1024)
+    , m_deliveringId(0)
+    , m_lastId(0)
+{
+    // Leave some CPU for the GUI and for the network
+    m_pool.setMaxThreadCount(qBound(1, QThread::idealThreadCount() - 1, 2));
+}
+
+LocalMimeParserPool::~LocalMimeParserPool()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+/** @short Return the shared instance, owned by the application object */
+LocalMimeParserPool *LocalMimeParserPool::instance()
+{
+    static QPointer<LocalMimeParserPool> pool;
+    if (!pool) {
+        pool = new LocalMimeParserPool(QCoreApplication::instance());
+    }
+    return pool;
+}
+
+/** @short Build a key identifying the specified message part
+
+An empty string is returned for parts which cannot be identified reliably. Such parts must not be cached.
+*/
+QString LocalMimeParserPool::cacheKey(const QModelIndex &partIndex)
+{
+    const QString mailbox = partIndex.data(Imap::Mailbox::RoleMailboxName).toString();
+    const uint uid = partIndex.data(Imap::Mailbox::RoleMessageUid).toUInt();
+    if (mailbox.isEmpty() || !uid)
+        return QString();
+    return QStringLiteral("%1\n%2\n%3\n%4").arg(mailbox,
+                                               QString::number(partIndex.data(Imap::Mailbox::RoleMailboxUidValidity).toUInt()),
+                                               QString::number(uid),
+                                               partIndex.data(Imap::Mailbox::RolePartPathToPart).toString());
+}
+
+/** @short Return a copy of the tree cached under the @arg key, or a null pointer */
+MessagePart::Ptr LocalMimeParserPool::cachedTree(const QString &key) const
+{
+    if (key.isEmpty())
+        return MessagePart::Ptr();
+    const MessagePart::Ptr *tree = m_cache.object(key);
+    if (!tree)
+        return MessagePart::Ptr();
+    auto local = dynamic_cast<const LocalMessagePart *>(tree->get());
+    Q_ASSERT(local);
+    return local->clone(nullptr);
+}
+
+/** @short Start parsing a MIME entity in the background
+
+The data to parse are the concatenation of all @arg segments. The first @arg skippedSegments are not stored as the raw data
+of the resulting part; this is useful for a helper header which describes the entity. The result is announced through the
+parsed() signal with the returned ID. When the @arg key is not empty, the result is also stored in the cache.
+*/
+quint64 LocalMimeParserPool::parse(const QString &key, const QVector<QByteArray> &segments, const int skippedSegments, const int row)
+{
+    const quint64 id = ++m_lastId;
+    if (!key.isEmpty())
+        m_pendingKeys[id] = key;
+    m_pool.start(new LocalMimeParseJob(this, id, segments, skippedSegments, row));
+    return id;
+}
+
+/** @short Take the tree which is being announced through the parsed() signal */
+MessagePart::Ptr LocalMimeParserPool::takeResult(const quint64 id)
+{
+    if (id != m_deliveringId)
+        return MessagePart::Ptr();
+    return std::move(m_delivering);
+}
+
+/** @short Hand over the result of parsing; this is called from the worker threads */
+void LocalMimeParserPool::deliverResult(const quint64 id, MessagePart::Ptr tree, const int cost)
+{
+    {
+        QMutexLocker locker(&m_resultsMutex);
+        Result &result = m_results[id];
+        result.tree = std::move(tree);
+        result.cost = cost;
+    }
+    bool ok = QMetaObject::invokeMethod(this, "slotParsed", Qt::QueuedConnection, Q_ARG(quint64, id));
+    Q_ASSERT(ok); Q_UNUSED(ok);
+}
+
+void LocalMimeParserPool::slotParsed(const quint64 id)
+{
+    Result result;
+    {
+        QMutexLocker locker(&m_resultsMutex);
+        auto it = m_results.find(id);
+        Q_ASSERT(it != m_results.end());
+        result = std::move(it->second);
+        m_results.erase(it);
+    }
+
+    auto key = m_pendingKeys.find(id);
+    if (key != m_pendingKeys.end()) {
+        auto local = dynamic_cast<const LocalMessagePart *>(result.tree.get());
+        Q_ASSERT(local);
+        m_cache.insert(*key, new MessagePart::Ptr(local->clone(nullptr)), qMax(1, result.cost));
+        m_pendingKeys.erase(key);
+    }
+
+    m_deliveringId = id;
+    m_delivering = std::move(result.tree);
+    emit parsed(id);
+    // Nobody was interested in this one anymore
+    m_delivering.reset();
+    m_deliveringId = 0;
+}
+
+/** @short Limit the total size of the data of the cached trees, in bytes */
+void LocalMimeParserPool::setMaxCacheSize(const int bytes)
+{
+    m_cache.setMaxCost(bytes);
+}
+
+void LocalMimeParserPool::setMaxThreadCount(const int threads)
+{
+    m_pool.setMaxThreadCount(threads);
+}
+
+void LocalMimeParserPool::clearCache()
+{
+    m_cache.clear();
+}
+
 LocalMimeMessageParser::LocalMimeMessageParser()
     : PartReplacer()
 {
@@ -60,6 +320,8 @@ LocallyParsedMimePart::LocallyParsedMimePart(MessageModel *model, MessagePart *p
     , m_sourceHeaderIndex(sourceItemIndex.child(0, Imap::Mailbox::TreeItem::OFFSET_HEADER))
     , m_sourceTextIndex(sourceItemIndex.child(0, Imap::Mailbox::TreeItem::OFFSET_TEXT))
     , m_proxyParentIndex(proxyParentIndex)
+    , m_cacheKey(LocalMimeParserPool::cacheKey(sourceItemIndex))
+    , m_parseRequest(0)
 {
     Q_ASSERT(m_proxyParentIndex.isValid());
     Q_ASSERT(m_proxyParentIndex.model() == model);
@@ -100,26 +362,53 @@ void LocallyParsedMimePart::messageMaybeAvailable(const QModelIndex &topLeft, co
         disconnect(m_sourceHeaderIndex.model(), &QAbstractItemModel::dataChanged, this, &LocallyParsedMimePart::messageMaybeAvailable);
         Q_ASSERT(m_localState == FetchingState::LOADING);
 
+        auto pool = LocalMimeParserPool::instance();
+        if (auto tree = pool->cachedTree(m_cacheKey)) {
+            replaceWithTree(std::move(tree));
+            return;
+        }
+
         // This part is rather fugly because we do not really have access to the full MIME plaintext of the "entire attachment",
         // including its *own* MIME headers such as Content-Type. In other words, the knowledge that the item's Content-Type
         // happens to be "message/rfc822" is communicated to us through an out-of-band channel, the IMAP's BODYSTRUCTURE.
         //
-        // We're simply reconstructing this piece of information by adding a hand-crafted header.
+        // We're simply reconstructing this piece of information by adding a hand-crafted header, which is not going to be stored
+        // as a part of the message data.
         const QByteArray header = QByteArrayLiteral("Content-Type: ") + m_mimetype + QByteArrayLiteral("\r\n\r\n");
-        const QByteArray data = header +
-                m_sourceHeaderIndex.data(Imap::Mailbox::RolePartData).toByteArray() +
-                m_sourceTextIndex.data(Imap::Mailbox::RolePartData).toByteArray();
-        auto part = MimeticUtils::mimeEntityToPart(mimetic::MimeEntity(data.begin(), data.end()), this, row());
-        auto rawPart = dynamic_cast<LocalMessagePart *>(part.get());
-        Q_ASSERT(rawPart);
+        QVector<QByteArray> segments;
+        segments << header
+                 << m_sourceHeaderIndex.data(Imap::Mailbox::RolePartData).toByteArray()
+                 << m_sourceTextIndex.data(Imap::Mailbox::RolePartData).toByteArray();
+        connect(pool, &LocalMimeParserPool::parsed, this, &LocallyParsedMimePart::slotParsed);
+        m_parseRequest = pool->parse(m_cacheKey, segments, 1, row());
+    }
+}
 
-        // Do not store our artificial header, though!
-        rawPart->setData(data.mid(header.length()));
-        m_localState = FetchingState::DONE;
+void LocallyParsedMimePart::slotParsed(const quint64 id)
+{
+    if (id != m_parseRequest)
+        return;
 
-        m_model->replaceMeWithSubtree(m_proxyParentIndex, this, std::move(part));
-        //m_model->insertSubtree(m_model->index(row(), 0, m_proxyParentIndex), std::move(part));
+    auto pool = LocalMimeParserPool::instance();
+    disconnect(pool, &LocalMimeParserPool::parsed, this, &LocallyParsedMimePart::slotParsed);
+    auto tree = pool->takeResult(id);
+    Q_ASSERT(tree);
+    if (!m_proxyParentIndex.isValid()) {
+        m_localState = FetchingState::UNAVAILABLE;
+        return;
     }
+    replaceWithTree(std::move(tree));
+}
+
+/** @short Put the parsed @arg tree into the model instead of this placeholder
+
+Note that this deletes the current object.
+*/
+void LocallyParsedMimePart::replaceWithTree(MessagePart::Ptr tree)
+{
+    Q_ASSERT(tree->row() == row());
+    m_localState = FetchingState::DONE;
+    m_model->replaceMeWithSubtree(m_proxyParentIndex, this, std::move(tree));
 }
 
 QVariant LocallyParsedMimePart::data(int role) const
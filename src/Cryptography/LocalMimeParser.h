@@ -23,11 +23,73 @@
 #ifndef TROJITA_CRYPTO_LOCAL_MIME_PARSER_H
 #define TROJITA_CRYPTO_LOCAL_MIME_PARSER_H
 
+#include <map>
+#include <QCache>
+#include <QHash>
+#include <QMutex>
 #include <QObject>
+#include <QThreadPool>
+#include <QVector>
 #include "Cryptography/PartReplacer.h"
 
 namespace Cryptography {
 
+/** @short Parse MIME data on a bounded pool of background threads and remember the results
+
+Parsing a big message through Mimetic and converting the result into a tree of LocalMessagePart instances is expensive,
+so it must not block the GUI. The resulting trees are also cached by the identity of the IMAP message part they were built
+from. Messages are immutable in IMAP, so reopening such a message can reuse the tree without any parsing.
+*/
+class LocalMimeParserPool: public QObject
+{
+    Q_OBJECT
+public:
+    static LocalMimeParserPool *instance();
+    virtual ~LocalMimeParserPool();
+
+    static QString cacheKey(const QModelIndex &partIndex);
+
+    MessagePart::Ptr cachedTree(const QString &key) const;
+    quint64 parse(const QString &key, const QVector<QByteArray> &segments, const int skippedSegments, const int row);
+    MessagePart::Ptr takeResult(const quint64 id);
+
+    void setMaxCacheSize(const int bytes);
+    void setMaxThreadCount(const int threads);
+    void clearCache();
+
+    void deliverResult(const quint64 id, MessagePart::Ptr tree, const int cost);
+
+signals:
+    /** @short The tree requested through parse() is ready and can be obtained via takeResult() */
+    void parsed(const quint64 id);
+
+private slots:
+    void slotParsed(const quint64 id);
+
+private:
+    explicit LocalMimeParserPool(QObject *parent);
+
+    struct Result {
+        MessagePart::Ptr tree;
+        int cost;
+    };
+
+    QThreadPool m_pool;
+    QCache<QString, MessagePart::Ptr> m_cache;
+    /** @short Cache keys of the requests which are being processed right now */
+    QHash<quint64, QString> m_pendingKeys;
+    /** @short Finished trees, protected by m_resultsMutex because they are produced by the worker threads */
+    std::map<quint64, Result> m_results;
+    QMutex m_resultsMutex;
+    /** @short The result which is being announced through parsed() right now */
+    MessagePart::Ptr m_delivering;
+    quint64 m_deliveringId;
+    quint64 m_lastId;
+
+    LocalMimeParserPool(const LocalMimeParserPool &); // don't implement
+    LocalMimeParserPool &operator=(const LocalMimeParserPool &); // don't implement
+};
+
 /** @short Local parsing of MIME messages */
 class LocalMimeMessageParser: public PartReplacer {
 public:
@@ -49,13 +111,18 @@ public:
 
 public slots:
     void messageMaybeAvailable(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+private slots:
+    void slotParsed(const quint64 id);
 private:
 #ifdef MIME_TREE_DEBUG
     QByteArray dumpLocalInfo() const override;
 #endif
+    void replaceWithTree(MessagePart::Ptr tree);
 
     MessageModel *m_model;
     QPersistentModelIndex m_sourceHeaderIndex, m_sourceTextIndex, m_proxyParentIndex;
+    QString m_cacheKey;
+    quint64 m_parseRequest;
 };
 
 }
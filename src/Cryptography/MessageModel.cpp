@@ -48,6 +48,13 @@ void MessageModel::mapDataChanged(const QModelIndex &topLeft, const QModelIndex
     Q_ASSERT(m_message.model());
     Q_ASSERT(topLeft.parent() == bottomRight.parent());
 
+    if (topLeft.row() != bottomRight.row()) {
+        // A range of messages, e.g. after changing flags of a selection
+        if (topLeft.parent() == m_message.parent() && m_message.row() >= topLeft.row() && m_message.row() <= bottomRight.row())
+            mapDataChanged(m_message, m_message);
+        return;
+    }
+
     QModelIndex root = index(0,0);
     if (!root.isValid())
         return;
@@ -31,6 +31,7 @@
 #include "Imap/Encoders.h"
 #include "Imap/Model/MailboxTree.h"
 #include "Imap/Model/ItemRoles.h"
+#include "Imap/Model/Utils.h"
 #include "UiUtils/Formatting.h"
 
 namespace Cryptography {
@@ -320,6 +321,53 @@ void LocalMessagePart::setChild(int row, Ptr part)
     m_children[row] = std::move(part);
 }
 
+/** @short Copy a part which is known to be a LocalMessagePart, including its children */
+static MessagePart::Ptr cloneLocalPart(const MessagePart::Ptr &part, MessagePart *parent)
+{
+    if (!part)
+        return MessagePart::Ptr();
+    auto local = dynamic_cast<const LocalMessagePart *>(part.get());
+    Q_ASSERT(local);
+    return local->clone(parent);
+}
+
+/** @short Create a deep copy of this part and of all its children
+
+This only works for trees which were built from local data, i.e. for those which consist of LocalMessageParts only.
+The actual data are implicitly shared, so this is cheap.
+*/
+MessagePart::Ptr LocalMessagePart::clone(MessagePart *parent) const
+{
+    std::unique_ptr<LocalMessagePart> res(new LocalMessagePart(parent, m_row, m_mimetype));
+    res->m_childrenState = m_childrenState;
+    res->m_localState = m_localState;
+    if (m_envelope) {
+        res->m_envelope.reset(new Imap::Message::Envelope(*m_envelope));
+    }
+    res->m_hdrReferences = m_hdrReferences;
+    res->m_hdrListPost = m_hdrListPost;
+    res->m_hdrListPostNo = m_hdrListPostNo;
+    res->m_hdrListId = m_hdrListId;
+    res->m_charset = m_charset;
+    res->m_contentFormat = m_contentFormat;
+    res->m_delSp = m_delSp;
+    res->m_data = m_data;
+    res->m_transferEncoding = m_transferEncoding;
+    res->m_bodyFldId = m_bodyFldId;
+    res->m_bodyDisposition = m_bodyDisposition;
+    res->m_multipartRelatedStartPart = m_multipartRelatedStartPart;
+    res->m_bodyFldParam = m_bodyFldParam;
+    res->m_filename = m_filename;
+    res->m_octets = m_octets;
+
+    for (const auto &child : m_children) {
+        res->m_children[child.first] = cloneLocalPart(child.second, res.get());
+    }
+    res->setSpecialParts(cloneLocalPart(m_headerPart, res.get()), cloneLocalPart(m_textPart, res.get()),
+                         cloneLocalPart(m_mimePart, res.get()), cloneLocalPart(m_rawPart, res.get()));
+    return MessagePart::Ptr(std::move(res));
+}
+
 void LocalMessagePart::setData(const QByteArray &data)
 {
     m_data = data;
@@ -391,6 +439,11 @@ void LocalMessagePart::setHdrListPostNo(const bool listPostNo)
     m_hdrListPostNo = listPostNo;
 }
 
+void LocalMessagePart::setHdrListId(const QByteArray &listId)
+{
+    m_hdrListId = listId;
+}
+
 void LocalMessagePart::setBodyFldParam(const QMap<QByteArray, QByteArray> &bodyFldParam)
 {
     m_bodyFldParam = bodyFldParam;
@@ -467,6 +520,8 @@ QVariant LocalMessagePart::data(int role) const
     }
     case Imap::Mailbox::RoleMessageHeaderListPostNo:
         return m_hdrListPostNo;
+    case Imap::Mailbox::RoleMessageHeaderListId:
+        return m_hdrListId;
     case Imap::Mailbox::RoleIsUnavailable:
         return m_localState == FetchingState::UNAVAILABLE;
     case Imap::Mailbox::RolePartData:
@@ -515,6 +570,8 @@ QVariant LocalMessagePart::data(int role) const
         return m_envelope ? m_envelope->date : QDateTime();
     case Imap::Mailbox::RoleMessageSubject:
         return m_envelope ? m_envelope->subject : QString();
+    case Imap::Mailbox::RoleMessageNormalizedSubject:
+        return m_envelope ? Imap::baseSubject(m_envelope->subject) : QString();
     case Imap::Mailbox::RoleMessageFrom:
         return m_envelope ? Imap::Mailbox::TreeItemMessage::addresListToQVariant(m_envelope->from) : QVariant();
     case Imap::Mailbox::RoleMessageSender:
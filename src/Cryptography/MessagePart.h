@@ -162,10 +162,13 @@ public:
     void setHdrReferences(const QList<QByteArray> &references);
     void setHdrListPost(const QList<QUrl> &listPost);
     void setHdrListPostNo(const bool listPostNo);
+    void setHdrListId(const QByteArray &listId);
     void setBodyFldParam(const QMap<QByteArray, QByteArray> &bodyFldParam);
 
     void setChild(int row, Ptr part);
 
+    Ptr clone(MessagePart *parent) const;
+
 private:
     bool isTopLevelMultipart() const;
     QByteArray partId() const;
@@ -180,6 +183,7 @@ protected:
     QList<QByteArray> m_hdrReferences;
     QList<QUrl> m_hdrListPost;
     bool m_hdrListPostNo;
+    QByteArray m_hdrListId;
     QByteArray m_charset;
     QByteArray m_contentFormat;
     QByteArray m_delSp;
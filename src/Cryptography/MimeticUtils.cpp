@@ -26,6 +26,7 @@
 #include "Cryptography/MimeticUtils.h"
 #include "Imap/Encoders.h"
 #include "Imap/Model/ItemRoles.h"
+#include "Imap/Parser/LowLevelParser.h"
 #include "Imap/Parser/Message.h"
 #include "Imap/Parser/Rfc5322HeaderParser.h"
 
@@ -185,6 +186,7 @@ MessagePart::Ptr MimeticUtils::mimeEntityToPart(const mimetic::MimeEntity &me, M
                 }
                 if (headerParser.listPostNo)
                     part->setHdrListPostNo(true);
+                part->setHdrListId(Imap::LowLevelParser::extractListId(rawHeader));
             }
             QByteArray messageId = headerParser.messageId.size() == 1 ? headerParser.messageId.front() : QByteArray();
             part->setEnvelope(std::unique_ptr<Imap::Message::Envelope>(
@@ -0,0 +1,159 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@kde.org>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include "Cryptography/SignatureCache.h"
+
+namespace {
+
+const int streamVersion = QDataStream::Qt_5_2;
+
+/** @short Bump this when the layout of the stored data changes */
+const int schemaVersion = 1;
+
+/** @short How long to trust a cached result, in seconds */
+const qint64 maxAge = 7 * 24 * 3600;
+
+/** @short Upper bound on the number of results to remember */
+const int maxEntries = 10000;
+
+}
+
+namespace Cryptography {
+
+SignatureCache::SignatureCache()
+{
+}
+
+SignatureCache::~SignatureCache()
+{
+    m_db.close();
+}
+
+bool SignatureCache::open(const QString &fileName)
+{
+    const QString name = QStringLiteral("trojita-signature-cache-%1").arg(reinterpret_cast<quintptr>(this));
+    m_db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), name);
+    m_cleanup.name = name;
+    m_db.setDatabaseName(fileName);
+    if (!m_db.open()) {
+        qWarning() << "SignatureCache: cannot open" << fileName << m_db.lastError().text();
+        return false;
+    }
+
+    QSqlQuery q(m_db);
+    // This is just a cache, so there's no need to pay for an fsync after each and every message which gets opened
+    q.exec(QStringLiteral("PRAGMA journal_mode = WAL"));
+    q.exec(QStringLiteral("PRAGMA synchronous = NORMAL"));
+
+    bool upToDate = false;
+    if (m_db.record(QStringLiteral("trojita_signatures")).contains(QStringLiteral("version"))
+            && q.exec(QStringLiteral("SELECT version FROM trojita_signatures")) && q.first()) {
+        upToDate = q.value(0).toInt() == schemaVersion;
+    }
+    if (!upToDate && !createTables()) {
+        m_db.close();
+        return false;
+    }
+
+    expireOldEntries();
+    return true;
+}
+
+bool SignatureCache::createTables()
+{
+    QSqlQuery q(m_db);
+    if (!q.exec(QStringLiteral("DROP TABLE IF EXISTS signatures"))
+            || !q.exec(QStringLiteral("DROP TABLE IF EXISTS trojita_signatures"))
+            || !q.exec(QStringLiteral("CREATE TABLE trojita_signatures (version INT NOT NULL)"))
+            || !q.exec(QStringLiteral("INSERT INTO trojita_signatures (version) VALUES (%1)").arg(schemaVersion))
+            || !q.exec(QStringLiteral("CREATE TABLE signatures (key BINARY NOT NULL PRIMARY KEY, data BINARY, verified INT NOT NULL)"))
+            || !q.exec(QStringLiteral("CREATE INDEX signatures_verified ON signatures (verified)"))) {
+        qWarning() << "SignatureCache: cannot create tables:" << q.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+/** @short Forget about results which are too old, and about the least recent ones when there are too many of them */
+void SignatureCache::expireOldEntries()
+{
+    QSqlQuery q(m_db);
+    q.prepare(QStringLiteral("DELETE FROM signatures WHERE verified < ?"));
+    q.bindValue(0, QDateTime::currentMSecsSinceEpoch() / 1000 - maxAge);
+    if (!q.exec()) {
+        qWarning() << "SignatureCache: cannot expire old entries:" << q.lastError().text();
+    }
+    q.prepare(QStringLiteral("DELETE FROM signatures WHERE key NOT IN (SELECT key FROM signatures ORDER BY verified DESC LIMIT ?)"));
+    q.bindValue(0, maxEntries);
+    if (!q.exec()) {
+        qWarning() << "SignatureCache: cannot limit the number of entries:" << q.lastError().text();
+    }
+}
+
+/** @short Find the result stored under the @arg key */
+bool SignatureCache::lookup(const QByteArray &key, SignatureDataBundle &result)
+{
+    if (!m_db.isOpen())
+        return false;
+
+    QSqlQuery q(m_db);
+    q.prepare(QStringLiteral("SELECT data FROM signatures WHERE key = ? AND verified >= ?"));
+    q.bindValue(0, key);
+    q.bindValue(1, QDateTime::currentMSecsSinceEpoch() / 1000 - maxAge);
+    if (!q.exec() || !q.first())
+        return false;
+
+    QDataStream stream(q.value(0).toByteArray());
+    stream.setVersion(streamVersion);
+    stream >> result.wasSigned >> result.isValidDisregardingTrust >> result.isValidTrusted >> result.tldrStatus
+           >> result.longStatus >> result.statusIcon >> result.signatureUid >> result.signatureDate;
+    return stream.status() == QDataStream::Ok;
+}
+
+void SignatureCache::store(const QByteArray &key, const SignatureDataBundle &result)
+{
+    if (!m_db.isOpen())
+        return;
+
+    QByteArray buf;
+    QDataStream stream(&buf, QIODevice::WriteOnly);
+    stream.setVersion(streamVersion);
+    stream << result.wasSigned << result.isValidDisregardingTrust << result.isValidTrusted << result.tldrStatus
+           << result.longStatus << result.statusIcon << result.signatureUid << result.signatureDate;
+
+    QSqlQuery q(m_db);
+    q.prepare(QStringLiteral("INSERT OR REPLACE INTO signatures (key, data, verified) VALUES (?, ?, ?)"));
+    q.bindValue(0, key);
+    q.bindValue(1, buf);
+    q.bindValue(2, QDateTime::currentMSecsSinceEpoch() / 1000);
+    if (!q.exec()) {
+        qWarning() << "SignatureCache: cannot store a result:" << q.lastError().text();
+    }
+}
+
+}
@@ -0,0 +1,61 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@kde.org>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TROJITA_CRYPTO_SIGNATURECACHE_H
+#define TROJITA_CRYPTO_SIGNATURECACHE_H
+
+#include <QSqlDatabase>
+#include "Cryptography/GpgMe++.h"
+#include "Imap/Model/SQLCache.h"
+
+namespace Cryptography {
+
+/** @short Persistent storage of the results of signature verification
+
+Verifying a signature means running gpg, which takes a noticeable amount of time. Unless either the signed data or
+the keyring change, the result is always the same, though. This cache stores the outcome in an SQLite database next
+to the IMAP cache. The caller is responsible for building a key which covers everything which could affect the result,
+including the state of the keyring.
+
+Entries are only kept for a limited time so that the expiration of keys and certificates is noticed eventually.
+*/
+class SignatureCache {
+public:
+    SignatureCache();
+    ~SignatureCache();
+
+    bool open(const QString &fileName);
+    bool lookup(const QByteArray &key, SignatureDataBundle &result);
+    void store(const QByteArray &key, const SignatureDataBundle &result);
+
+private:
+    bool createTables();
+    void expireOldEntries();
+
+    // this needs to go before all QSqlDatabase instances for proper destruction order
+    Imap::Mailbox::DbConnectionCleanup m_cleanup;
+    QSqlDatabase m_db;
+};
+
+}
+
+#endif
@@ -21,6 +21,7 @@
    You should have received a copy of the GNU General Public License
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <algorithm>
 #include <QAbstractProxyModel>
 #include <QBuffer>
 #include <QDesktopWidget>
@@ -57,6 +58,7 @@
 #include "Gui/ProgressPopUp.h"
 #include "Gui/Util.h"
 #include "Gui/Window.h"
+#include "Imap/Model/Correspondents.h"
 #include "Imap/Model/ImapAccess.h"
 #include "Imap/Model/ItemRoles.h"
 #include "Imap/Model/Model.h"
@@ -1392,6 +1394,20 @@ void ComposeWidget::sent()
 {
     // FIXME: move back to the currently selected mailbox
 
+    // Addresses which we write to often shall be offered first when completing
+    QList<QPair<Composer::RecipientKind, Imap::Message::MailAddress> > recipients;
+    QString errorMessage;
+    if (parseRecipients(recipients, errorMessage)) {
+        QStringList emails;
+        for (const auto &recipient : recipients) {
+            emails << recipient.second.mailbox + QLatin1Char('@') + recipient.second.host;
+        }
+        if (Plugins::AddressbookPlugin *addressbook = m_mainWindow->pluginManager()->addressbook())
+            addressbook->recordSentMail(emails);
+        if (Plugins::AddressbookPlugin *correspondents = m_mainWindow->imapAccess()->correspondents())
+            correspondents->recordSentMail(emails);
+    }
+
     m_sentMail = true;
     QTimer::singleShot(0, this, SLOT(close()));
 }
@@ -1445,6 +1461,8 @@ void ComposeWidget::completeRecipients(const QString &text)
 
     Plugins::AddressbookPlugin *addressbook = m_mainWindow->pluginManager()->addressbook();
     if (!addressbook || !(addressbook->features() & Plugins::AddressbookPlugin::FeatureCompletion))
+        addressbook = m_mainWindow->imapAccess()->correspondents();
+    if (!addressbook)
         return;
 
     auto newJob = addressbook->requestCompletion(text, QStringList(), m_completionCount);
@@ -1483,7 +1501,7 @@ void ComposeWidget::onCompletionFailed(Plugins::AddressbookJob::Error error)
     onCompletionAvailable(Plugins::NameEmailList());
 }
 
-void ComposeWidget::onCompletionAvailable(const Plugins::NameEmailList &completion)
+void ComposeWidget::onCompletionAvailable(const Plugins::NameEmailList &addressbookCompletion)
 {
     Plugins::AddressbookJob *job = qobject_cast<Plugins::AddressbookJob *>(sender());
     Q_ASSERT(job);
@@ -1515,6 +1533,23 @@ void ComposeWidget::onCompletionAvailable(const Plugins::NameEmailList &completi
         m_firstCompletionRequests.remove(toEdit);
     }
 
+    // The address book goes first, and the people we have exchanged mail with fill the rest of the list
+    Plugins::NameEmailList completion = addressbookCompletion;
+    auto correspondents = qobject_cast<Imap::Mailbox::CorrespondentsAddressbook *>(m_mainWindow->imapAccess()->correspondents());
+    if (correspondents && job->parent() != correspondents && completion.size() < m_completionCount) {
+        const auto harvested = correspondents->complete(toEdit->text(), QStringList(), m_completionCount);
+        for (const auto &item : harvested) {
+            auto known = std::find_if(completion.constBegin(), completion.constEnd(), [&item](const Plugins::NameEmail &other) {
+                return QString::compare(item.email, other.email, Qt::CaseInsensitive) == 0;
+            });
+            if (known != completion.constEnd())
+                continue;
+            completion << item;
+            if (completion.size() == m_completionCount)
+                break;
+        }
+    }
+
     QStringList contacts;
 
     for (int i = 0; i < completion.size(); ++i) {
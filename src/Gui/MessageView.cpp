@@ -156,6 +156,10 @@ void MessageView::unsetPreviousMessage()
 {
     clearWaitingConns();
     m_loadingItems.clear();
+    if (message.isValid()) {
+        if (auto model = dynamic_cast<Imap::Mailbox::Model *>(const_cast<QAbstractItemModel *>(message.model())))
+            model->unpinMessage(message);
+    }
     message = QModelIndex();
     markAsReadTimer->stop();
     if (auto w = bodyWidget()) {
@@ -200,6 +204,8 @@ void MessageView::setMessage(const QModelIndex &index)
     unsetPreviousMessage();
 
     message = messageIndex;
+    if (auto model = dynamic_cast<Imap::Mailbox::Model *>(const_cast<QAbstractItemModel *>(message.model())))
+        model->pinMessage(message);
     messageModel = new Cryptography::MessageModel(this, message);
     messageModel->setObjectName(QStringLiteral("cryptoMessageModel-%1-%2")
                                 .arg(message.data(Imap::Mailbox::RoleMailboxName).toString(),
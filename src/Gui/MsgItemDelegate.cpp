@@ -21,6 +21,7 @@
 */
 
 #include "MsgItemDelegate.h"
+#include <QApplication>
 #include <QTreeView>
 #include "Imap/Model/ItemRoles.h"
 #include "Imap/Model/MsgListModel.h"
@@ -30,10 +31,15 @@ namespace Gui
 {
 
 MsgItemDelegate::MsgItemDelegate(QObject *parent, Imap::Mailbox::FavoriteTagsModel *m_favoriteTagsModel) :
-    ColoredItemDelegate(parent), m_favoriteTagsModel(m_favoriteTagsModel)
+    ColoredItemDelegate(parent), m_favoriteTagsModel(m_favoriteTagsModel), m_showPreviews(true)
 {
 }
 
+void MsgItemDelegate::setShowPreviews(const bool show)
+{
+    m_showPreviews = show;
+}
+
 QColor MsgItemDelegate::itemColor(const QModelIndex &index) const
 {
     auto view = static_cast<MsgListView*>(parent());
@@ -91,6 +97,48 @@ void MsgItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &optio
         viewOption.palette.setColor(QPalette::Text, foregroundColor);
     viewOption.font = itemFont(index);
     ColoredItemDelegate::paintWithForeground(painter, viewOption, index, foregroundColor);
+    if (m_showPreviews && index.column() == Imap::Mailbox::MsgListModel::SUBJECT)
+        paintPreview(painter, viewOption, index);
+}
+
+/** @short Show the message preview in the space which is left after the subject
+
+Asking for the preview is what makes it load. The model queues these requests and fetches the previews of all rows
+which got painted at once, so scrolling through the list does not cause a round trip per message.
+*/
+void MsgItemDelegate::paintPreview(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    const QString preview = index.data(Imap::Mailbox::RoleMessagePreview).toString();
+    if (preview.isEmpty())
+        return;
+
+    QStyleOptionViewItem opt(option);
+    initStyleOption(&opt, index);
+    const QWidget *widget = opt.widget;
+    QStyle *style = widget ? widget->style() : QApplication::style();
+    QRect textRect = style->subElementRect(QStyle::SE_ItemViewItemText, &opt, widget);
+    const int margin = style->pixelMetric(QStyle::PM_FocusFrameHMargin, 0, widget) + 1;
+    const QFontMetrics subjectMetrics(opt.font);
+    textRect.setLeft(textRect.left() + 2 * margin + subjectMetrics.width(opt.text) + subjectMetrics.averageCharWidth() * 2);
+
+    QFont font(option.font);
+    font.setBold(false);
+    font.setItalic(false);
+    font.setUnderline(false);
+    font.setStrikeOut(false);
+    const QFontMetrics metrics(font);
+    if (textRect.width() < metrics.averageCharWidth() * 8) {
+        // Not worth showing just a few characters
+        return;
+    }
+
+    QColor color = opt.palette.color(opt.state & QStyle::State_Selected ? QPalette::HighlightedText : QPalette::Text);
+    color.setAlphaF(0.6);
+    painter->save();
+    painter->setFont(font);
+    painter->setPen(color);
+    painter->drawText(textRect, Qt::AlignLeft | Qt::AlignVCenter, metrics.elidedText(preview, Qt::ElideRight, textRect.width()));
+    painter->restore();
 }
 
 }
@@ -41,11 +41,15 @@ class MsgItemDelegate : public ColoredItemDelegate
 public:
     explicit MsgItemDelegate(QObject* parent, Imap::Mailbox::FavoriteTagsModel *m_favoriteTagsModel);
     void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+    /** @short Should the previews of messages be shown (and therefore fetched) along with their subjects? */
+    void setShowPreviews(const bool show);
 private:
     QColor itemColor(const QModelIndex &index) const;
     QFont itemFont(const QModelIndex &index) const;
+    void paintPreview(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const;
 
     Imap::Mailbox::FavoriteTagsModel *m_favoriteTagsModel;
+    bool m_showPreviews;
 };
 
 }
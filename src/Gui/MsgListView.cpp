@@ -29,18 +29,22 @@
 #include <QHeaderView>
 #include <QKeyEvent>
 #include <QPainter>
+#include <QScrollBar>
 #include <QSignalMapper>
 #include <QTimer>
 #include "MsgItemDelegate.h"
+#include "Imap/Model/Model.h"
 #include "Imap/Model/MsgListModel.h"
 #include "Imap/Model/PrettyMsgListModel.h"
 #include "Imap/Model/ThreadingMsgListModel.h"
+#include "Imap/Model/Utils.h"
 
 namespace Gui
 {
 
 MsgListView::MsgListView(QWidget *parent, Imap::Mailbox::FavoriteTagsModel *m_favoriteTagsModel):
-    QTreeView(parent), m_autoActivateAfterKeyNavigation(true), m_autoResizeSections(true)
+    QTreeView(parent), m_autoActivateAfterKeyNavigation(true), m_autoResizeSections(true), m_lastScrollValue(0),
+    m_scrollVelocity(0)
 {
     connect(header(), &QHeaderView::geometriesChanged, this, &MsgListView::slotFixSize);
     connect(this, &QTreeView::expanded, this, &MsgListView::slotExpandWholeSubtree);
@@ -66,6 +70,13 @@ MsgListView::MsgListView(QWidget *parent, Imap::Mailbox::FavoriteTagsModel *m_fa
     m_naviActivationTimer = new QTimer(this);
     m_naviActivationTimer->setSingleShot(true);
     connect(m_naviActivationTimer, &QTimer::timeout, this, &MsgListView::slotCurrentActivated);
+
+    m_viewportTimer = new QTimer(this);
+    m_viewportTimer->setSingleShot(true);
+    m_viewportTimer->setInterval(50);
+    connect(m_viewportTimer, &QTimer::timeout, this, &MsgListView::slotPublishViewport);
+    connect(verticalScrollBar(), &QAbstractSlider::valueChanged, this, &MsgListView::slotScrolled);
+    connect(verticalScrollBar(), &QAbstractSlider::rangeChanged, m_viewportTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
 }
 
 // left might collapse a thread, question is whether ending there (on closing the thread) should be
@@ -419,6 +430,8 @@ void MsgListView::setModel(QAbstractItemModel *model)
         }
     }
     QTreeView::setModel(model);
+    m_scrollVelocity = 0;
+    m_viewportTimer->start();
     if (Imap::Mailbox::PrettyMsgListModel *prettyModel = findPrettyMsgListModel(model)) {
         connect(prettyModel, &Imap::Mailbox::PrettyMsgListModel::sortingPreferenceChanged,
                 this, &MsgListView::slotHandleSortCriteriaChanged);
@@ -428,6 +441,75 @@ void MsgListView::setModel(QAbstractItemModel *model)
     }
 }
 
+void MsgListView::slotScrolled(int value)
+{
+    const int pageStep = qMax(1, verticalScrollBar()->pageStep());
+    const qreal pages = qreal(value - m_lastScrollValue) / pageStep;
+    m_lastScrollValue = value;
+
+    // A pause in scrolling starts the measurement anew
+    const qint64 elapsed = m_scrollClock.isValid() ? m_scrollClock.restart() : -1;
+    if (elapsed < 0 || elapsed > 250) {
+        m_scrollVelocity = pages > 0 ? 1 : -1;
+        if (!m_scrollClock.isValid())
+            m_scrollClock.start();
+    } else {
+        const qreal current = pages * 1000 / qMax<qint64>(elapsed, 1);
+        m_scrollVelocity = 0.7 * m_scrollVelocity + 0.3 * current;
+    }
+
+    if (!m_viewportTimer->isActive())
+        m_viewportTimer->start();
+}
+
+/** @short Tell the IMAP model which messages are shown and which will likely be shown soon
+
+The model would otherwise preload a fixed number of messages around each row that gets displayed, no matter where the user is
+heading and whether these rows will ever be looked at. Only the view knows the order in which the messages are shown, so it is
+also the view which determines which rows are ahead in the direction of scrolling.
+*/
+void MsgListView::slotPublishViewport()
+{
+    if (!model())
+        return;
+
+    QModelIndexList visible;
+    QModelIndex index = indexAt(QPoint(0, 0));
+    while (index.isValid() && visualRect(index).top() < viewport()->height()) {
+        visible << index.sibling(index.row(), 0);
+        index = indexBelow(index);
+    }
+
+    Imap::Mailbox::Model *imapModel = 0;
+    Q_FOREACH(const QModelIndex &message, visible) {
+        if (auto constModel = qobject_cast<const Imap::Mailbox::Model *>(Imap::deproxifiedIndex(message).model())) {
+            imapModel = const_cast<Imap::Mailbox::Model *>(constModel);
+            break;
+        }
+    }
+    if (!imapModel)
+        return;
+
+    // Look ahead by at least one page and by as much as could be scrolled through in the next half a second, within reason
+    const int lookahead = qRound(visible.size() * qBound<qreal>(1, qAbs(m_scrollVelocity) / 2, 4));
+    QModelIndexList upcoming;
+    if (m_scrollVelocity >= 0) {
+        index = indexBelow(visible.last());
+        while (index.isValid() && upcoming.size() < lookahead) {
+            upcoming << index.sibling(index.row(), 0);
+            index = indexBelow(index);
+        }
+    } else {
+        index = indexAbove(visible.first());
+        while (index.isValid() && upcoming.size() < lookahead) {
+            upcoming << index.sibling(index.row(), 0);
+            index = indexAbove(index);
+        }
+    }
+
+    imapModel->setMessageViewport(visible, upcoming);
+}
+
 /** @short Get ThreadingMsgListModel index and call the next handler */
 void MsgListView::slotMsgListModelRowsAboutToBeRemoved(const QModelIndex &parent, int start, int end)
 {
@@ -513,6 +595,16 @@ void MsgListView::setAutoActivateAfterKeyNavigation(bool enabled)
     m_autoActivateAfterKeyNavigation = enabled;
 }
 
+/** @short Show the message previews after the subjects
+
+Painting the preview of a message is what asks for it to be fetched, so with this disabled, no previews are loaded.
+*/
+void MsgListView::setShowPreviews(bool show)
+{
+    static_cast<MsgItemDelegate *>(itemDelegate())->setShowPreviews(show);
+    viewport()->update();
+}
+
 }
 
 
@@ -22,6 +22,7 @@
 #ifndef MSGLISTVIEW_H
 #define MSGLISTVIEW_H
 
+#include <QElapsedTimer>
 #include <QHeaderView>
 #include <QTreeView>
 #include "Imap/Model/FavoriteTagsModel.h"
@@ -50,6 +51,7 @@ public:
     virtual ~MsgListView() {}
     void setModel(QAbstractItemModel *model);
     void setAutoActivateAfterKeyNavigation(bool enabled);
+    void setShowPreviews(bool show);
     void updateActionsAfterRestoredState();
     virtual int sizeHintForColumn(int column) const;
     QHeaderView::ResizeMode resizeModeForColumn(const int column) const;
@@ -77,6 +79,10 @@ private slots:
     /** @short conditionally emits activated(currentIndex()) for keyboard events */
     void slotCurrentActivated();
     void slotHandleNewColumns(int oldCount, int newCount);
+    /** @short Track the scrolling speed and direction */
+    void slotScrolled(int value);
+    /** @short Tell the IMAP model which messages are shown and which will likely be shown soon */
+    void slotPublishViewport();
 private:
     /** @short Try to move the cursor to next message */
     void setCurrentIndexToNextValid(const QModelIndex &current);
@@ -87,6 +93,13 @@ private:
     bool m_autoActivateAfterKeyNavigation;
     bool m_autoResizeSections;
 
+    /** @short Rate-limits the viewport updates which are sent to the model */
+    QTimer *m_viewportTimer;
+    QElapsedTimer m_scrollClock;
+    int m_lastScrollValue;
+    /** @short Smoothed scrolling speed in pages per second, negative when scrolling up */
+    qreal m_scrollVelocity;
+
     friend class MainWindow; // needs access to slotHandleNewColumns
 };
 
@@ -346,9 +346,8 @@ QWidget *AsynchronousPartWidget::addingOneWidget(const QModelIndex &index, UiUti
 
 void AsynchronousPartWidget::handleDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
 {
-    Q_ASSERT(topLeft == bottomRight);
-    Q_UNUSED(bottomRight);
-    if (topLeft == m_partIndex || !m_partIndex.isValid())
+    if (!m_partIndex.isValid() || (topLeft.parent() == m_partIndex.parent() && topLeft.column() == m_partIndex.column() &&
+                                   m_partIndex.row() >= topLeft.row() && m_partIndex.row() <= bottomRight.row()))
         updateStatusIndicator();
 }
 
@@ -0,0 +1,156 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QFile>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+#include "PerformanceTraceWidget.h"
+#include "Common/PerformanceTrace.h"
+#include "UiUtils/Formatting.h"
+
+namespace {
+
+QString formatDuration(const qint64 microseconds)
+{
+    return QStringLiteral("%1 ms").arg(microseconds / 1000.0, 0, 'f', 1);
+}
+
+}
+
+namespace Gui {
+
+PerformanceTraceWidget::PerformanceTraceWidget(QWidget *parent) :
+    QWidget(parent)
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    m_tree = new QTreeWidget(this);
+    m_tree->setColumnCount(5);
+    m_tree->setHeaderLabels(QStringList() << tr("Activity") << tr("Count") << tr("Total") << tr("Average") << tr("Maximum"));
+    m_tree->setRootIsDecorated(true);
+    m_tree->setUniformRowHeights(true);
+    m_tree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    m_tree->header()->setStretchLastSection(false);
+    layout->addWidget(m_tree);
+
+    QHBoxLayout *buttons = new QHBoxLayout();
+    buttons->addStretch();
+    m_clear = new QPushButton(tr("Clear"), this);
+    connect(m_clear, &QAbstractButton::clicked, this, &PerformanceTraceWidget::slotClear);
+    buttons->addWidget(m_clear);
+    m_save = new QPushButton(tr("Save Chrome Trace..."), this);
+    connect(m_save, &QAbstractButton::clicked, this, &PerformanceTraceWidget::slotSaveTrace);
+    buttons->addWidget(m_save);
+    layout->addLayout(buttons);
+
+    m_refreshTimer = new QTimer(this);
+    m_refreshTimer->setInterval(1000);
+    connect(m_refreshTimer, &QTimer::timeout, this, &PerformanceTraceWidget::slotRefresh);
+}
+
+void PerformanceTraceWidget::slotRefresh()
+{
+    const Common::PerformanceTrace *trace = Common::PerformanceTrace::instance();
+
+    // Remember what the user has collapsed so that the periodic refresh doesn't fight them
+    QMap<QString, bool> expanded;
+    for (int i = 0; i < m_tree->topLevelItemCount(); ++i) {
+        expanded[m_tree->topLevelItem(i)->text(0)] = m_tree->topLevelItem(i)->isExpanded();
+    }
+    m_tree->clear();
+
+    QMap<QByteArray, QTreeWidgetItem *> categories;
+    Q_FOREACH(const Common::PerformanceTrace::SpanStatistics &stats, trace->spanStatistics()) {
+        QTreeWidgetItem *&parent = categories[stats.category];
+        if (!parent) {
+            parent = new QTreeWidgetItem(m_tree, QStringList() << (stats.category == "imap" ? tr("IMAP commands") :
+                                                                   stats.category == "task" ? tr("Tasks") :
+                                                                   QString::fromUtf8(stats.category)));
+        }
+        new QTreeWidgetItem(parent, QStringList() << stats.name << QString::number(stats.count) << formatDuration(stats.total)
+                            << formatDuration(stats.total / qMax<quint64>(stats.count, 1)) << formatDuration(stats.max));
+    }
+
+    auto cacheStatistics = trace->cacheStatistics();
+    if (!cacheStatistics.isEmpty()) {
+        //: Cache statistics, the columns contain the number of hits and misses
+        QTreeWidgetItem *parent = new QTreeWidgetItem(m_tree, QStringList() << tr("Cache lookups") << QString() << tr("Hits") << tr("Misses"));
+        for (auto it = cacheStatistics.constBegin(); it != cacheStatistics.constEnd(); ++it) {
+            new QTreeWidgetItem(parent, QStringList() << QString::fromUtf8(it.key()) << QString::number(it->hits + it->misses)
+                                << QString::number(it->hits) << QString::number(it->misses));
+        }
+    }
+
+    auto trafficStatistics = trace->trafficStatistics();
+    if (!trafficStatistics.isEmpty()) {
+        //: Traffic statistics, the columns contain the amount of received and sent data
+        QTreeWidgetItem *parent = new QTreeWidgetItem(m_tree, QStringList() << tr("Traffic") << QString() << tr("Received") << tr("Sent"));
+        for (auto it = trafficStatistics.constBegin(); it != trafficStatistics.constEnd(); ++it) {
+            new QTreeWidgetItem(parent, QStringList() << tr("Connection %1").arg(it.key()) << QString()
+                                << UiUtils::Formatting::prettySize(it->bytesIn) << UiUtils::Formatting::prettySize(it->bytesOut));
+        }
+    }
+
+    for (int i = 0; i < m_tree->topLevelItemCount(); ++i) {
+        QTreeWidgetItem *item = m_tree->topLevelItem(i);
+        item->setExpanded(expanded.value(item->text(0), true));
+    }
+}
+
+void PerformanceTraceWidget::slotClear()
+{
+    Common::PerformanceTrace::instance()->clear();
+    slotRefresh();
+}
+
+void PerformanceTraceWidget::slotSaveTrace()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Save Chrome Trace"), QStringLiteral("trojita-trace.json"),
+                                                    tr("Trace files") + QLatin1String(" (*.json)"));
+    if (fileName.isEmpty())
+        return;
+
+    QFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate) || f.write(Common::PerformanceTrace::instance()->toChromeTrace()) < 0) {
+        QMessageBox::critical(this, tr("Save Chrome Trace"), tr("Cannot save the trace into %1: %2").arg(fileName, f.errorString()));
+    }
+}
+
+void PerformanceTraceWidget::showEvent(QShowEvent *e)
+{
+    QWidget::showEvent(e);
+    slotRefresh();
+    m_refreshTimer->start();
+}
+
+void PerformanceTraceWidget::hideEvent(QHideEvent *e)
+{
+    m_refreshTimer->stop();
+    QWidget::hideEvent(e);
+}
+
+}
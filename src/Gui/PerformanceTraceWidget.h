@@ -0,0 +1,65 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GUI_PERFORMANCETRACEWIDGET_H
+#define GUI_PERFORMANCETRACEWIDGET_H
+
+#include <QWidget>
+
+class QPushButton;
+class QTimer;
+class QTreeWidget;
+
+namespace Gui {
+
+/** @short Debugging view of the timing, cache and traffic statistics
+
+The widget shows what Common::PerformanceTrace has collected so far. The numbers are refreshed periodically while the
+widget is visible, and the recorded events can be saved in the Chrome trace event format for further analysis.
+*/
+class PerformanceTraceWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit PerformanceTraceWidget(QWidget *parent = 0);
+
+private slots:
+    /** @short Re-read the statistics from the recorder */
+    void slotRefresh();
+    /** @short Forget everything which has been recorded so far */
+    void slotClear();
+    /** @short Ask for a file name and save the Chrome trace into it */
+    void slotSaveTrace();
+
+private:
+    QTreeWidget *m_tree;
+    QPushButton *m_clear;
+    QPushButton *m_save;
+    QTimer *m_refreshTimer;
+
+    virtual void showEvent(QShowEvent *e);
+    virtual void hideEvent(QHideEvent *e);
+};
+
+}
+
+#endif // GUI_PERFORMANCETRACEWIDGET_H
@@ -22,6 +22,7 @@
 
 #include <QDateTime>
 #include <QFile>
+#include <QMessageBox>
 #include <QPlainTextEdit>
 #include <QPushButton>
 #include <QTabWidget>
@@ -66,7 +67,10 @@ void ProtocolLoggerWidget::slotSetPersistentLogging(const bool enabled)
     if (enabled) {
         Q_ASSERT(!m_fileLogger);
         m_fileLogger = new Common::FileLogger(this);
-        m_fileLogger->setFileLogging(true, Imap::Mailbox::persistentLogFileName());
+        connect(m_fileLogger, &Common::FileLogger::binaryLoggingFailed, this, &ProtocolLoggerWidget::slotPersistentLoggingFailed);
+        m_fileLogger->setBinaryLogging(true, Imap::Mailbox::persistentLogFileName());
+        if (!m_fileLogger)
+            return;
         m_fileLogger->setAutoFlush(true);
     } else {
         delete m_fileLogger;
@@ -75,6 +79,16 @@ void ProtocolLoggerWidget::slotSetPersistentLogging(const bool enabled)
     emit persistentLoggingChanged(!!m_fileLogger);
 }
 
+/** @short The log file cannot be written to, so let the user know and turn the persistent logging off */
+void ProtocolLoggerWidget::slotPersistentLoggingFailed(const QString &message)
+{
+    // This is called from within the logger, so it cannot be deleted right away
+    m_fileLogger->deleteLater();
+    m_fileLogger = 0;
+    emit persistentLoggingChanged(false);
+    QMessageBox::warning(this, tr("Protocol Log"), message);
+}
+
 ProtocolLoggerWidget::~ProtocolLoggerWidget()
 {
 }
@@ -149,11 +163,9 @@ void ProtocolLoggerWidget::log(uint connectionId, Common::LogMessage message)
     if (m_fileLogger) {
         m_fileLogger->log(connectionId, message);
     }
+    // The raw data are kept as-is; they will only be converted to text when the widget gets shown
     enum {CUTOFF=200};
-    if (message.message.size() > CUTOFF) {
-        message.truncatedBytes = message.message.size() - CUTOFF;
-        message.message = message.message.left(CUTOFF);
-    }
+    message.truncate(CUTOFF);
     // we rely on the default constructor and QMap's behavior of operator[] to call it here
     logs[connectionId].buffer.append(message);
     if (loggingActive && !delayedDisplay->isActive())
@@ -172,6 +184,7 @@ void ProtocolLoggerWidget::flushToWidget(const uint connectionId, Common::RingBu
     }
 
     for (RingBuffer<LogMessage>::const_iterator it = buf.begin(); it != buf.end(); ++it) {
+        const QString text = it->text();
         QString message = QStringLiteral("<pre><span style=\"color: #808080\">%1</span> %2<span style=\"color: %3;%4\">%5</span>%6</pre>");
         QString direction;
         QString textColor;
@@ -180,7 +193,7 @@ void ProtocolLoggerWidget::flushToWidget(const uint connectionId, Common::RingBu
 
         switch (it->kind) {
         case LOG_IO_WRITTEN:
-            if (it->message.startsWith(QLatin1String("***"))) {
+            if (text.startsWith(QLatin1String("***"))) {
                 textColor = QStringLiteral("#800080");
                 bgColor = QStringLiteral("#d0d0d0");
             } else {
@@ -189,7 +202,7 @@ void ProtocolLoggerWidget::flushToWidget(const uint connectionId, Common::RingBu
             }
             break;
         case LOG_IO_READ:
-            if (it->message.startsWith(QLatin1String("***"))) {
+            if (text.startsWith(QLatin1String("***"))) {
                 textColor = QStringLiteral("#808000");
                 bgColor = QStringLiteral("#d0d0d0");
             } else {
@@ -211,7 +224,7 @@ void ProtocolLoggerWidget::flushToWidget(const uint connectionId, Common::RingBu
             trimmedInfo = tr("<br/><span style=\"color: #808080; font-style: italic;\">(+ %n more bytes)</span>", "", it->truncatedBytes);
         }
 
-        QString niceLine = it->message.toHtmlEscaped();
+        QString niceLine = text.toHtmlEscaped();
         niceLine.replace(QLatin1Char('\r'), 0x240d /* SYMBOL FOR CARRIAGE RETURN */)
         .replace(QLatin1Char('\n'), 0x240a /* SYMBOL FOR LINE FEED */);
 
@@ -79,6 +79,8 @@ private slots:
     /** @short Copy contents of all buffers into the GUI widgets */
     void slotShowLogs();
 
+    void slotPersistentLoggingFailed(const QString &message);
+
 signals:
     void persistentLoggingChanged(const bool active);
 
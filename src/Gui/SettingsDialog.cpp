@@ -52,10 +52,12 @@
 #include "Gui/Util.h"
 #include "Gui/Window.h"
 #include "Imap/Model/ImapAccess.h"
+#include "Imap/Model/Model.h"
 #include "MSA/Account.h"
 #include "Plugins/AddressbookPlugin.h"
 #include "Plugins/PasswordPlugin.h"
 #include "Plugins/PluginManager.h"
+#include "UiUtils/Formatting.h"
 #include "UiUtils/IconLoader.h"
 #include "UiUtils/PasswordWatcher.h"
 #include "ShortcutHandler/ShortcutHandler.h"
@@ -958,7 +960,7 @@ bool ImapPage::passwordFailures(QString &message) const
 }
 
 
-CachePage::CachePage(QWidget *parent, QSettings &s): QScrollArea(parent), Ui_CachePage()
+CachePage::CachePage(SettingsDialog *parent, QSettings &s): QScrollArea(parent), Ui_CachePage(), m_parent(parent)
 {
     Ui_CachePage::setupUi(this);
 
@@ -975,6 +977,23 @@ CachePage::CachePage(QWidget *parent, QSettings &s): QScrollArea(parent), Ui_Cac
 
     offlineNumberOfDays->setValue(s.value(SettingsNames::cacheOfflineNumberDaysKey, QVariant(30)).toInt());
 
+    const int sizeLimit = s.value(SettingsNames::cacheOfflineSizeLimitKey, 0).toInt();
+    offlineLimitSize->setChecked(sizeLimit > 0);
+    if (sizeLimit > 0)
+        offlineSizeLimit->setValue(sizeLimit);
+
+    offlineCacheUsage->setVisible(false);
+    if (auto model = qobject_cast<Imap::Mailbox::Model *>(m_parent->imapAccess()->imapModel())) {
+        auto usage = model->cache()->usage();
+        quint64 total = usage.metadata + usage.flags + usage.parts + usage.diskParts;
+        if (total) {
+            offlineCacheUsage->setText(tr("Currently using %1 (%2 in message data)").arg(
+                                           UiUtils::Formatting::prettySize(total),
+                                           UiUtils::Formatting::prettySize(usage.parts + usage.diskParts)));
+            offlineCacheUsage->setVisible(true);
+        }
+    }
+
     val = s.value(SettingsNames::watchedFoldersKey).toString();
     if (val == Common::SettingsNames::watchAll) {
         watchAll->setChecked(true);
@@ -989,11 +1008,14 @@ CachePage::CachePage(QWidget *parent, QSettings &s): QScrollArea(parent), Ui_Cac
     connect(offlineNope, &QAbstractButton::clicked, this, &CachePage::updateWidgets);
     connect(offlineXDays, &QAbstractButton::clicked, this, &CachePage::updateWidgets);
     connect(offlineEverything, &QAbstractButton::clicked, this, &CachePage::updateWidgets);
+    connect(offlineLimitSize, &QAbstractButton::clicked, this, &CachePage::updateWidgets);
 }
 
 void CachePage::updateWidgets()
 {
     offlineNumberOfDays->setEnabled(offlineXDays->isChecked());
+    offlineLimitSize->setEnabled(!offlineNope->isChecked());
+    offlineSizeLimit->setEnabled(!offlineNope->isChecked() && offlineLimitSize->isChecked());
     emit widgetsUpdated();
 }
 
@@ -1009,6 +1031,7 @@ void CachePage::save(QSettings &s)
         s.setValue(SettingsNames::cacheOfflineKey, SettingsNames::cacheOfflineNone);
 
     s.setValue(SettingsNames::cacheOfflineNumberDaysKey, offlineNumberOfDays->value());
+    s.setValue(SettingsNames::cacheOfflineSizeLimitKey, offlineLimitSize->isChecked() ? offlineSizeLimit->value() : 0);
 
     if (watchAll->isChecked()) {
         s.setValue(SettingsNames::watchedFoldersKey, SettingsNames::watchAll);
@@ -272,7 +272,7 @@ class CachePage : public QScrollArea, Ui_CachePage, public ConfigurationWidgetIn
 {
     Q_OBJECT
 public:
-    CachePage(QWidget *parent, QSettings &s);
+    CachePage(SettingsDialog *parent, QSettings &s);
     virtual void save(QSettings &s);
     virtual QWidget *asWidget();
     virtual bool checkValidity() const;
@@ -280,6 +280,7 @@ public:
 
 private:
     QCheckBox *startOffline;
+    SettingsDialog *m_parent;
 
 private slots:
     void updateWidgets();
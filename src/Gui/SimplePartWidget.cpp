@@ -41,14 +41,20 @@
 #include "Imap/Network/FileDownloadManager.h"
 #include "Imap/Model/Utils.h"
 #include "UiUtils/Color.h"
+#include "UiUtils/Formatting.h"
 #include "UiUtils/IconLoader.h"
+#include "UiUtils/PlainTextRenderer.h"
 
 namespace Gui
 {
 
+/** @short Plain text parts larger than this are loaded and shown progressively, chunk by chunk */
+const quint64 progressiveLoadingThreshold = 512 * 1024;
+
 SimplePartWidget::SimplePartWidget(QWidget *parent, Imap::Network::MsgPartNetAccessManager *manager,
                                    const QModelIndex &partIndex, MessageView *messageView):
-    EmbeddedWebView(parent, manager, messageView->profileSettings()), m_partIndex(partIndex), m_messageView(messageView), m_netAccessManager(manager)
+    EmbeddedWebView(parent, manager, messageView->profileSettings()), m_partIndex(partIndex), m_messageView(messageView), m_netAccessManager(manager),
+    m_progressiveLoading(false), m_renderRequest(0)
 {
     Q_ASSERT(partIndex.isValid());
 
@@ -57,11 +63,11 @@ SimplePartWidget::SimplePartWidget(QWidget *parent, Imap::Network::MsgPartNetAcc
         connect(this, &QWebView::loadFinished, m_messageView, &MessageView::onWebViewLoadFinished);
     }
 
-    QUrl url;
-    url.setScheme(QStringLiteral("trojita-imap"));
-    url.setHost(QStringLiteral("msg"));
-    url.setPath(partIndex.data(Imap::Mailbox::RolePartPathToPart).toString());
-    if (partIndex.data(Imap::Mailbox::RolePartMimeType).toString() == QLatin1String("text/plain")) {
+    m_url.setScheme(QStringLiteral("trojita-imap"));
+    m_url.setHost(QStringLiteral("msg"));
+    m_url.setPath(partIndex.data(Imap::Mailbox::RolePartPathToPart).toString());
+    const bool isPlainText = partIndex.data(Imap::Mailbox::RolePartMimeType).toString() == QLatin1String("text/plain");
+    if (isPlainText) {
         if (partIndex.data(Imap::Mailbox::RolePartOctets).toULongLong() < 100 * 1024) {
             connect(this, &QWebView::loadFinished, this, &SimplePartWidget::slotMarkupPlainText);
         } else {
@@ -72,7 +78,19 @@ SimplePartWidget::SimplePartWidget(QWidget *parent, Imap::Network::MsgPartNetAcc
             s->setFontFamily(QWebSettings::StandardFont, font.family());
         }
     }
-    load(url);
+
+    // Huge text parts which have not been downloaded yet are shown as soon as their first chunk arrives
+    partIndex.data(Imap::Mailbox::RolePartForceFetchFromCache);
+    if (isPlainText && partIndex.data(Imap::Mailbox::RolePartOctets).toULongLong() >= progressiveLoadingThreshold
+            && !partIndex.data(Imap::Mailbox::RoleIsFetched).toBool() && !partIndex.data(Imap::Mailbox::RoleIsUnavailable).toBool()) {
+        m_progressiveLoading = true;
+        connect(partIndex.model(), &QAbstractItemModel::dataChanged, this, &SimplePartWidget::slotPartialDataChanged);
+        connect(this, &QWebView::linkClicked, this, &SimplePartWidget::slotPartialLinkClicked);
+        partIndex.data(Imap::Mailbox::RolePartLoadNextChunk);
+        showPartialData();
+    } else {
+        load(m_url);
+    }
 
     m_savePart = new QAction(UiUtils::loadIcon(QStringLiteral("document-save")), tr("Save this message part..."), this);
     connect(m_savePart, &QAction::triggered, this, &SimplePartWidget::slotDownloadPart);
@@ -116,14 +134,83 @@ void SimplePartWidget::slotMarkupPlainText()
     if (!m_partIndex.isValid() || !m_partIndex.data(Imap::Mailbox::RoleIsFetched).toBool())
         return;
 
+    // The conversion is expensive for long texts, so it happens in a background thread and the result is cached
+    auto renderer = UiUtils::PlainTextRenderer::instance();
+    const QString key = UiUtils::PlainTextRenderer::cacheKey(m_partIndex);
+    const QString markup = renderer->cachedMarkup(key);
+    if (!markup.isNull()) {
+        showPlainTextMarkup(markup);
+        return;
+    }
+
+    connect(renderer, &UiUtils::PlainTextRenderer::rendered, this, &SimplePartWidget::slotPlainTextRendered, Qt::UniqueConnection);
+    // We cannot rely on the QWebFrame's toPlainText because of https://bugs.kde.org/show_bug.cgi?id=321160
+    m_renderRequest = renderer->render(key, m_partIndex.data(Imap::Mailbox::RolePartUnicodeText).toString(),
+                                       UiUtils::flowedFormatForPart(m_partIndex));
+}
+
+void SimplePartWidget::slotPlainTextRendered(const quint64 id, const QString &markup)
+{
+    if (id != m_renderRequest)
+        return;
+    m_renderRequest = 0;
+    disconnect(UiUtils::PlainTextRenderer::instance(), &UiUtils::PlainTextRenderer::rendered, this, &SimplePartWidget::slotPlainTextRendered);
+    showPlainTextMarkup(markup);
+}
+
+void SimplePartWidget::showPlainTextMarkup(const QString &markup)
+{
     QPalette palette = QApplication::palette();
 
     // and finally set the marked up page.
-    page()->mainFrame()->setHtml(UiUtils::htmlizedTextPart(m_partIndex, QFontDatabase::systemFont(QFontDatabase::FixedFont),
+    page()->mainFrame()->setHtml(UiUtils::htmlizedTextPart(markup, QFontDatabase::systemFont(QFontDatabase::FixedFont),
                                                            palette.base().color(), palette.text().color(),
                                                            palette.link().color(), palette.linkVisited().color()));
 }
 
+/** @short Render whatever part of a progressively loaded text part is available so far */
+void SimplePartWidget::showPartialData()
+{
+    const quint64 loaded = m_partIndex.data(Imap::Mailbox::RolePartPartialOctets).toULongLong();
+    const QString total = UiUtils::Formatting::prettySize(m_partIndex.data(Imap::Mailbox::RolePartOctets).toULongLong());
+    const QString text = Imap::decodeByteArray(m_partIndex.data(Imap::Mailbox::RolePartPartialData).toByteArray(),
+                                               m_partIndex.data(Imap::Mailbox::RolePartCharset).toByteArray());
+    const QString status = loaded ?
+                tr("Showing %1 of %2.").arg(UiUtils::Formatting::prettySize(loaded), total) :
+                tr("Loading %1...").arg(total);
+    page()->mainFrame()->setHtml(QStringLiteral("<pre>%1</pre><p>%2 <a href=\"trojita-partial:next\">%3</a> "
+                                                "<a href=\"trojita-partial:all\">%4</a></p>")
+                                 .arg(text.toHtmlEscaped(), status, tr("Show more"), tr("Show everything")));
+}
+
+void SimplePartWidget::slotPartialDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    Q_UNUSED(bottomRight);
+    if (!m_progressiveLoading || !m_partIndex.isValid() || topLeft != m_partIndex)
+        return;
+
+    if (m_partIndex.data(Imap::Mailbox::RoleIsFetched).toBool()) {
+        // Everything is here now, so let's switch to the regular way of showing the part
+        m_progressiveLoading = false;
+        disconnect(m_partIndex.model(), &QAbstractItemModel::dataChanged, this, &SimplePartWidget::slotPartialDataChanged);
+        load(m_url);
+    } else {
+        showPartialData();
+    }
+}
+
+void SimplePartWidget::slotPartialLinkClicked(const QUrl &url)
+{
+    if (!m_progressiveLoading || !m_partIndex.isValid() || url.scheme() != QLatin1String("trojita-partial"))
+        return;
+
+    if (url.path() == QLatin1String("all")) {
+        m_partIndex.data(Imap::Mailbox::RolePartLoadRemainingChunks);
+    } else {
+        m_partIndex.data(Imap::Mailbox::RolePartLoadNextChunk);
+    }
+}
+
 void SimplePartWidget::slotFileNameRequested(QString *fileName)
 {
     *fileName = QFileDialog::getSaveFileName(this, tr("Save Attachment"),
@@ -26,6 +26,7 @@
 #include <QAction>
 #include <QFile>
 #include <QPersistentModelIndex>
+#include <QUrl>
 #include "EmbeddedWebView.h"
 #include "UiUtils/PlainTextFormatter.h"
 
@@ -67,9 +68,12 @@ public:
 private slots:
     void slotFileNameRequested(QString *fileName);
     void slotMarkupPlainText();
+    void slotPlainTextRendered(const quint64 id, const QString &markup);
     void slotDownloadPart();
     void slotDownloadMessage();
     void slotDownloadImage(const QNetworkRequest &req);
+    void slotPartialDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    void slotPartialLinkClicked(const QUrl &url);
 protected:
 signals:
     void linkHovered(const QString &link, const QString &title, const QString &textContent);
@@ -81,6 +85,14 @@ private:
     QAction *m_copyMail;
     MessageView *m_messageView;
     Imap::Network::MsgPartNetAccessManager *m_netAccessManager;
+    QUrl m_url;
+    /** @short Are we showing just the chunks of the part's data which were loaded so far? */
+    bool m_progressiveLoading;
+    /** @short ID of the background conversion of this part's text to HTML, or 0 if none is pending */
+    quint64 m_renderRequest;
+
+    void showPartialData();
+    void showPlainTextMarkup(const QString &markup);
 
     SimplePartWidget(const SimplePartWidget &); // don't implement
     SimplePartWidget &operator=(const SimplePartWidget &); // don't implement
@@ -92,6 +92,7 @@
 #include "MsgListView.h"
 #include "OnePanelAtTimeWidget.h"
 #include "PasswordDialog.h"
+#include "PerformanceTraceWidget.h"
 #include "ProtocolLoggerWidget.h"
 #include "SettingsDialog.h"
 #include "SimplePartWidget.h"
@@ -135,7 +136,8 @@ MainWindow::MainWindow(QSettings *settings): QMainWindow(), m_imapAccess(0), m_m
 #ifdef TROJITA_HAVE_CRYPTO_MESSAGES
     Plugins::PluginManager::MimePartReplacers replacers;
 #ifdef TROJITA_HAVE_GPGMEPP
-    replacers.emplace_back(std::make_shared<Cryptography::GpgMeReplacer>());
+    m_gpgMeReplacer = std::make_shared<Cryptography::GpgMeReplacer>();
+    replacers.emplace_back(m_gpgMeReplacer);
 #endif
     m_pluginManager->setMimePartReplacers(replacers);
 #endif
@@ -359,9 +361,15 @@ void MainWindow::createActions()
     //: file to save the debug log into
     logPersistent = new QAction(tr("Log &into %1").arg(Imap::Mailbox::persistentLogFileName()), this);
     logPersistent->setCheckable(true);
+    logPersistent->setStatusTip(tr("The log is stored in a compact binary format; use trojita-log-viewer to read it"));
     connect(logPersistent, &QAction::triggered, protocolLogger, &ProtocolLoggerWidget::slotSetPersistentLogging);
     connect(protocolLogger, &ProtocolLoggerWidget::persistentLoggingChanged, logPersistent, &QAction::setChecked);
 
+    showPerformanceTrace = new QAction(tr("Show &performance statistics"), this);
+    showPerformanceTrace->setCheckable(true);
+    connect(showPerformanceTrace, &QAction::toggled, performanceTraceDock, &QWidget::setVisible);
+    connect(performanceTraceDock, &QDockWidget::visibilityChanged, showPerformanceTrace, &QAction::setChecked);
+
     showImapCapabilities = new QAction(tr("IMAP Server In&formation..."), this);
     connect(showImapCapabilities, &QAction::triggered, this, &MainWindow::slotShowImapInfo);
 
@@ -558,6 +566,12 @@ void MainWindow::createActions()
     }
     connect(actionHideRead, &QAction::triggered, this, &MainWindow::slotHideRead);
 
+    m_actionShowPreviews = new QAction(tr("Show Message &Previews"), this);
+    m_actionShowPreviews->setCheckable(true);
+    m_actionShowPreviews->setChecked(m_settings->value(Common::SettingsNames::guiMsgListShowPreviews, QVariant(true)).toBool());
+    msgListWidget->tree->setShowPreviews(m_actionShowPreviews->isChecked());
+    connect(m_actionShowPreviews, &QAction::triggered, this, &MainWindow::slotShowPreviews);
+
     QActionGroup *layoutGroup = new QActionGroup(this);
     m_actionLayoutCompact = new QAction(tr("&Compact"), layoutGroup);
     m_actionLayoutCompact->setCheckable(true);
@@ -700,6 +714,7 @@ void MainWindow::createMenus()
             ADD_ACTION(debugMenu, showMimeView);
             ADD_ACTION(debugMenu, showProtocolLogger);
             ADD_ACTION(debugMenu, logPersistent);
+            ADD_ACTION(debugMenu, showPerformanceTrace);
             debugMenu->addSeparator();
             ADD_ACTION(debugMenu, showImapCapabilities);
             debugMenu->addSeparator();
@@ -741,6 +756,7 @@ void MainWindow::createMenus()
             sortMenu->addSeparator();
             ADD_ACTION(sortMenu, actionThreadMsgList);
             ADD_ACTION(sortMenu, actionHideRead);
+            ADD_ACTION(sortMenu, m_actionShowPreviews);
         mailboxMenu->addSeparator();
         ADD_ACTION(mailboxMenu, m_previousMessage);
         ADD_ACTION(mailboxMenu, m_nextMessage);
@@ -870,6 +886,14 @@ void MainWindow::createWidgets()
     protocolLoggerDock->setWidget(protocolLogger);
     addDockWidget(Qt::BottomDockWidgetArea, protocolLoggerDock);
 
+    performanceTraceDock = new QDockWidget(tr("Performance statistics"), this);
+    performanceTraceDock->setObjectName(QStringLiteral("performanceTraceDock"));
+    performanceTraceWidget = new PerformanceTraceWidget(performanceTraceDock);
+    performanceTraceDock->hide();
+    performanceTraceDock->setWidget(performanceTraceWidget);
+    addDockWidget(Qt::BottomDockWidgetArea, performanceTraceDock);
+    tabifyDockWidget(protocolLoggerDock, performanceTraceDock);
+
     busyParsersIndicator = new TaskProgressIndicator(this);
 }
 
@@ -878,6 +902,11 @@ void MainWindow::setupModels()
     m_imapAccess->reloadConfiguration();
     m_imapAccess->doConnect();
 
+#if defined(TROJITA_HAVE_CRYPTO_MESSAGES) && defined(TROJITA_HAVE_GPGMEPP)
+    const QString cacheDir = m_imapAccess->persistentCacheDir();
+    m_gpgMeReplacer->setPersistentCache(cacheDir.isEmpty() ? QString() : cacheDir + QLatin1String("signatures.sqlite"));
+#endif
+
     m_messageWidget->messageView->setNetworkWatcher(qobject_cast<Imap::Mailbox::NetworkWatcher*>(m_imapAccess->networkWatcher()));
 
     auto realThreadingModel = qobject_cast<Imap::Mailbox::ThreadingMsgListModel*>(m_imapAccess->threadingMsgListModel());
@@ -1540,14 +1569,36 @@ QModelIndexList MainWindow::translatedSelection() const
     return translatedIndexes;
 }
 
+/** @short UIDs of the selected messages and the mailbox which they belong to
+
+Unlike translatedSelection(), this does not need one model index per message, which matters for huge selections.
+*/
+Imap::Uids MainWindow::selectedUids(QModelIndex &mailbox) const
+{
+    Imap::Uids uids;
+    Q_FOREACH(const QModelIndex &index, msgListWidget->tree->selectedTree()) {
+        const uint uid = index.data(Imap::Mailbox::RoleMessageUid).toUInt();
+        if (!uid)
+            continue;
+        if (!mailbox.isValid())
+            mailbox = Imap::deproxifiedIndex(index).parent().parent();
+        uids << uid;
+    }
+    return uids;
+}
+
 void MainWindow::handleMarkAsRead(bool value)
 {
-    const QModelIndexList translatedIndexes = translatedSelection();
-    if (translatedIndexes.isEmpty()) {
+    QModelIndex mailbox;
+    const Imap::Uids uids = selectedUids(mailbox);
+    if (uids.isEmpty()) {
         qDebug() << "Model::handleMarkAsRead: no valid messages";
     } else {
-        imapModel()->markMessagesRead(translatedIndexes, value ? Imap::Mailbox::FLAG_ADD : Imap::Mailbox::FLAG_REMOVE);
-        if (translatedIndexes.contains(m_messageWidget->messageView->currentMessage())) {
+        imapModel()->setMessageFlags(mailbox, uids, Imap::Mailbox::FlagNames::seen,
+                                     value ? Imap::Mailbox::FLAG_ADD : Imap::Mailbox::FLAG_REMOVE);
+        const QModelIndex current = m_messageWidget->messageView->currentMessage();
+        if (current.isValid() && current.parent().parent() == mailbox &&
+                uids.contains(current.data(Imap::Mailbox::RoleMessageUid).toUInt())) {
             m_messageWidget->messageView->stopAutoMarkAsRead();
         }
     }
@@ -1587,59 +1638,68 @@ void MainWindow::slotPreviousUnread()
 
 void MainWindow::handleTag(const bool checked, const int index)
 {
-    const QModelIndexList &translatedIndexes = translatedSelection();
-    if (translatedIndexes.isEmpty()) {
+    QModelIndex mailbox;
+    const Imap::Uids uids = selectedUids(mailbox);
+    if (uids.isEmpty()) {
         qDebug() << "Model::handleTag: no valid messages";
     } else {
         const auto &tagName = m_favoriteTags->tagNameByIndex(index);
         if (!tagName.isEmpty())
-            imapModel()->setMessageFlags(translatedIndexes, tagName, checked ? Imap::Mailbox::FLAG_ADD : Imap::Mailbox::FLAG_REMOVE);
+            imapModel()->setMessageFlags(mailbox, uids, tagName, checked ? Imap::Mailbox::FLAG_ADD : Imap::Mailbox::FLAG_REMOVE);
     }
 }
 
 void MainWindow::handleMarkAsDeleted(bool value)
 {
-    const QModelIndexList translatedIndexes = translatedSelection();
-    if (translatedIndexes.isEmpty()) {
+    QModelIndex mailbox;
+    const Imap::Uids uids = selectedUids(mailbox);
+    if (uids.isEmpty()) {
         qDebug() << "Model::handleMarkAsDeleted: no valid messages";
     } else {
-        imapModel()->markMessagesDeleted(translatedIndexes, value ? Imap::Mailbox::FLAG_ADD : Imap::Mailbox::FLAG_REMOVE);
+        imapModel()->setMessageFlags(mailbox, uids, Imap::Mailbox::FlagNames::deleted,
+                                     value ? Imap::Mailbox::FLAG_ADD : Imap::Mailbox::FLAG_REMOVE);
     }
 }
 
 void MainWindow::handleMarkAsFlagged(const bool value)
 {
-    const QModelIndexList translatedIndexes = translatedSelection();
-    if (translatedIndexes.isEmpty()) {
+    QModelIndex mailbox;
+    const Imap::Uids uids = selectedUids(mailbox);
+    if (uids.isEmpty()) {
         qDebug() << "Model::handleMarkAsFlagged: no valid messages";
     } else {
-        imapModel()->setMessageFlags(translatedIndexes, Imap::Mailbox::FlagNames::flagged, value ? Imap::Mailbox::FLAG_ADD : Imap::Mailbox::FLAG_REMOVE);
+        imapModel()->setMessageFlags(mailbox, uids, Imap::Mailbox::FlagNames::flagged,
+                                     value ? Imap::Mailbox::FLAG_ADD : Imap::Mailbox::FLAG_REMOVE);
     }
 }
 
 void MainWindow::handleMarkAsJunk(const bool value)
 {
-    const QModelIndexList translatedIndexes = translatedSelection();
-    if (translatedIndexes.isEmpty()) {
+    QModelIndex mailbox;
+    const Imap::Uids uids = selectedUids(mailbox);
+    if (uids.isEmpty()) {
         qDebug() << "Model::handleMarkAsJunk: no valid messages";
     } else {
         if (value) {
-            imapModel()->setMessageFlags(translatedIndexes, Imap::Mailbox::FlagNames::notjunk, Imap::Mailbox::FLAG_REMOVE);
+            imapModel()->setMessageFlags(mailbox, uids, Imap::Mailbox::FlagNames::notjunk, Imap::Mailbox::FLAG_REMOVE);
         }
-        imapModel()->setMessageFlags(translatedIndexes, Imap::Mailbox::FlagNames::junk, value ? Imap::Mailbox::FLAG_ADD : Imap::Mailbox::FLAG_REMOVE);
+        imapModel()->setMessageFlags(mailbox, uids, Imap::Mailbox::FlagNames::junk,
+                                     value ? Imap::Mailbox::FLAG_ADD : Imap::Mailbox::FLAG_REMOVE);
     }
 }
 
 void MainWindow::handleMarkAsNotJunk(const bool value)
 {
-    const QModelIndexList translatedIndexes = translatedSelection();
-    if (translatedIndexes.isEmpty()) {
+    QModelIndex mailbox;
+    const Imap::Uids uids = selectedUids(mailbox);
+    if (uids.isEmpty()) {
         qDebug() << "Model::handleMarkAsNotJunk: no valid messages";
     } else {
         if (value) {
-          imapModel()->setMessageFlags(translatedIndexes, Imap::Mailbox::FlagNames::junk, Imap::Mailbox::FLAG_REMOVE);
+            imapModel()->setMessageFlags(mailbox, uids, Imap::Mailbox::FlagNames::junk, Imap::Mailbox::FLAG_REMOVE);
         }
-        imapModel()->setMessageFlags(translatedIndexes, Imap::Mailbox::FlagNames::notjunk, value ? Imap::Mailbox::FLAG_ADD : Imap::Mailbox::FLAG_REMOVE);
+        imapModel()->setMessageFlags(mailbox, uids, Imap::Mailbox::FlagNames::notjunk,
+                                     value ? Imap::Mailbox::FLAG_ADD : Imap::Mailbox::FLAG_REMOVE);
     }
 }
 
@@ -2448,6 +2508,13 @@ void MainWindow::slotHideRead()
     m_settings->setValue(Common::SettingsNames::guiMsgListHideRead, QVariant(hideRead));
 }
 
+void MainWindow::slotShowPreviews()
+{
+    const bool showPreviews = m_actionShowPreviews->isChecked();
+    msgListWidget->tree->setShowPreviews(showPreviews);
+    m_settings->setValue(Common::SettingsNames::guiMsgListShowPreviews, QVariant(showPreviews));
+}
+
 void MainWindow::slotCapabilitiesUpdated(const QStringList &capabilities)
 {
     msgListWidget->tree->header()->viewport()->removeEventFilter(this);
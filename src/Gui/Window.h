@@ -23,6 +23,7 @@
 #ifndef TROJITA_WINDOW_H
 #define TROJITA_WINDOW_H
 
+#include <memory>
 #include <QMainWindow>
 #include <QModelIndex>
 #include <QPointer>
@@ -46,6 +47,11 @@ class QStackedWidget;
 class QToolButton;
 class QTreeView;
 
+namespace Cryptography
+{
+class GpgMeReplacer;
+}
+
 namespace Composer
 {
 class SenderIdentitiesModel;
@@ -84,6 +90,7 @@ class CompleteMessageWidget;
 class ComposeWidget;
 class MailBoxTreeView;
 class MessageListWidget;
+class PerformanceTraceWidget;
 class ProtocolLoggerWidget;
 class TaskProgressIndicator;
 
@@ -186,6 +193,7 @@ private slots:
     void slotViewMsgHeaders();
     void slotThreadMsgList();
     void slotHideRead();
+    void slotShowPreviews();
     void slotSortingPreferenceChanged();
     void slotSortingConfirmed(int column, Qt::SortOrder order);
     void slotSearchRequested(const QStringList &searchConditions);
@@ -249,6 +257,7 @@ private:
     void removeSysTray();
 
     QModelIndexList translatedSelection() const;
+    Imap::Uids selectedUids(QModelIndex &mailbox) const;
 
     Imap::ImapAccess *m_imapAccess;
 
@@ -270,6 +279,8 @@ private:
 
     ProtocolLoggerWidget *protocolLogger;
     QDockWidget *protocolLoggerDock;
+    PerformanceTraceWidget *performanceTraceWidget;
+    QDockWidget *performanceTraceDock;
 
     QPointer<QSplitter> m_mainHSplitter;
     QPointer<QSplitter> m_mainVSplitter;
@@ -292,6 +303,7 @@ private:
     QAction *showMimeView;
     QAction *showProtocolLogger;
     QAction *logPersistent;
+    QAction *showPerformanceTrace;
     QAction *showImapCapabilities;
     QAction *showMenuBar;
     QAction *showToolBar;
@@ -339,6 +351,7 @@ private:
 
     QAction *actionThreadMsgList;
     QAction *actionHideRead;
+    QAction *m_actionShowPreviews;
     QAction *m_actionSortByArrival;
     QAction *m_actionSortByCc;
     QAction *m_actionSortByDate;
@@ -374,6 +387,7 @@ private:
 
     QSettings *m_settings;
     Plugins::PluginManager *m_pluginManager;
+    std::shared_ptr<Cryptography::GpgMeReplacer> m_gpgMeReplacer;
 
     QMessageBox *m_networkErrorMessageBox;
 
@@ -64,8 +64,8 @@
 #include <QRegularExpressionMatch>
 
 #include "Encoders.h"
+#include "TransferEncoding.h"
 #include "Parser/3rdparty/rfccodecs.h"
-#include "Parser/3rdparty/kcodecs.h"
 
 namespace {
 
@@ -458,12 +458,12 @@ QString decodeImapFolderName(const QByteArray &raw)
 
 QByteArray quotedPrintableDecode( const QByteArray& raw )
 {
-    return KCodecs::quotedPrintableDecode( raw );
+    return TransferEncoding::QuotedPrintableDecoder::decode(raw);
 }
 
 QByteArray quotedPrintableEncode(const QByteArray &raw)
 {
-    return KCodecs::quotedPrintableEncode(raw);
+    return TransferEncoding::QuotedPrintableEncoder::encode(raw);
 }
 
 
@@ -734,7 +734,7 @@ void decodeContentTransferEncoding(const QByteArray &rawData, const QByteArray &
     if (encoding == "quoted-printable") {
         *outputData = quotedPrintableDecode(rawData);
     } else if (encoding == "base64") {
-        *outputData = QByteArray::fromBase64(rawData);
+        *outputData = TransferEncoding::Base64Decoder::decode(rawData);
     } else if (encoding.isEmpty() || encoding == "7bit" || encoding == "8bit" || encoding == "binary") {
         *outputData = rawData;
     } else {
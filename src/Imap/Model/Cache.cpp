@@ -35,6 +35,24 @@ void AbstractCache::setErrorHandler(const std::function<void(const QString &)> &
     m_errorHandler = handler;
 }
 
+AbstractCache::CacheUsage AbstractCache::usage() const
+{
+    return CacheUsage();
+}
+
+void AbstractCache::setSizeLimit(const quint64 bytes)
+{
+    Q_UNUSED(bytes);
+}
+
+AbstractCache::CacheUsage::CacheUsage()
+    : metadata(0)
+    , flags(0)
+    , parts(0)
+    , diskParts(0)
+{
+}
+
 AbstractCache::MessageDataBundle::MessageDataBundle(
         const uint uid, const Message::Envelope &envelope, const QDateTime &internalDate, const quint64 size,
         const QByteArray &serializedBodyStructure, const QList<QByteArray> &hdrReferences,
@@ -24,6 +24,7 @@
 #define IMAP_MODEL_CACHE_H
 
 #include <functional>
+#include <QMap>
 #include <QUrl>
 #include "MailboxMetadata.h"
 #include "Imap/Parser/Message.h"
@@ -69,6 +70,15 @@ public:
         QList<QUrl> hdrListPost;
         /** @short Is the List-Post set to "NO"? */
         bool hdrListPostNo;
+        /** @short The list identifier from the List-Id header as per RFC 2919 */
+        QByteArray hdrListId;
+
+        /** @short Short plaintext preview of the message, as per RFC 8970
+
+        A null string means that the preview is not known yet. An empty string says that the message has no text which
+        could be shown as its preview.
+        */
+        QString preview;
 
         MessageDataBundle();
         MessageDataBundle(const uint uid, const Imap::Message::Envelope &envelope, const QDateTime &internalDate,
@@ -80,10 +90,29 @@ public:
             return uid == other.uid && envelope == other.envelope && internalDate == other.internalDate &&
                     serializedBodyStructure == other.serializedBodyStructure && size == other.size &&
                     hdrReferences == other.hdrReferences && hdrListPost == other.hdrListPost &&
-                    hdrListPostNo == other.hdrListPostNo;
+                    hdrListPostNo == other.hdrListPostNo && hdrListId == other.hdrListId && preview == other.preview;
         }
     };
 
+    /** @short Storage footprint of the cache, in bytes
+
+    The sizes are reported as stored, i.e. after any compression which the backend might apply.
+    */
+    struct CacheUsage {
+        /** @short Size of the message metadata (ENVELOPE, BODYSTRUCTURE,...) */
+        quint64 metadata;
+        /** @short Size of the message flags */
+        quint64 flags;
+        /** @short Size of the message parts which live inside the database */
+        quint64 parts;
+        /** @short Size of the message parts which are stored in standalone files */
+        quint64 diskParts;
+        /** @short Total storage occupied by each mailbox */
+        QMap<QString, quint64> perMailbox;
+
+        CacheUsage();
+    };
+
     virtual ~AbstractCache();
 
     /** @short Return a list of all known child mailboxes */
@@ -125,6 +154,12 @@ public:
     virtual void setMsgPart(const QString &mailbox, const uint uid, const QByteArray &partId, const QByteArray &data) = 0;
     /** @short Drop the data for a message part which is no longer needed */
     virtual void forgetMessagePart(const QString &mailbox, const uint uid, const QByteArray &partId) = 0;
+    /** @short Make all cached parts of one message available under another mailbox and UID as well
+
+    This is useful after a COPY or a MOVE where the server told us about the new UID. The caches are encouraged to
+    share the actual data among the copies.
+    */
+    virtual void copyMessageParts(const QString &srcMailbox, const uint srcUid, const QString &dstMailbox, const uint dstUid) = 0;
 
     /** @short Return cached threading info for a given mailbox */
     virtual QVector<Imap::Responses::ThreadingNode> messageThreading(const QString &mailbox) = 0;
@@ -134,6 +169,18 @@ public:
     /** @short How many days is it OK not to mark entries as accessed? */
     virtual void setRenewalThreshold(const int days) = 0;
 
+    /** @short Report how much storage is occupied by the cached data
+
+    The default implementation reports nothing; only the persistent caches track their size.
+    */
+    virtual CacheUsage usage() const;
+    /** @short Do not keep more than @arg bytes of message parts around
+
+    The least recently used parts are evicted in the background once the limit is exceeded. A value of zero means
+    that there is no limit. The default implementation ignores the limit.
+    */
+    virtual void setSizeLimit(const quint64 bytes);
+
     /** @short Inform about runtime failures */
     void setErrorHandler(const std::function<void(const QString &)> &handler);
 
@@ -0,0 +1,128 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include "CacheSnapshot.h"
+#include "SQLCache.h"
+
+namespace
+{
+const quint32 snapshotMagic = 0x54725370;
+/** @short Bump this whenever the layout of the file changes; old snapshots are simply ignored */
+const quint32 snapshotVersion = 1;
+}
+
+namespace Imap
+{
+namespace Mailbox
+{
+
+const int CacheSnapshot::maxMessages = 500;
+
+CacheSnapshot::CacheSnapshot()
+    : hasUidMapping(false)
+{
+}
+
+/** @short Read the snapshot from @arg fileName and remove that file */
+bool CacheSnapshot::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray buf = file.readAll();
+    file.close();
+    file.remove();
+
+    QDataStream stream(buf);
+    stream.setVersion(QDataStream::Qt_5_2);
+    quint32 magic, version;
+    stream >> magic >> version;
+    if (stream.status() != QDataStream::Ok || magic != snapshotMagic || version != snapshotVersion)
+        return false;
+
+    QHash<QString, QList<MailboxMetadata>> newChildMailboxes;
+    QHash<QString, SyncState> newSyncStates;
+    QString newMailbox;
+    bool newHasUidMapping;
+    Imap::Uids newUidMapping;
+    QHash<uint, QByteArray> serializedMetadata;
+    QHash<uint, QStringList> newMsgFlags;
+    stream >> newChildMailboxes >> newSyncStates >> newMailbox >> newHasUidMapping >> newUidMapping
+           >> serializedMetadata >> newMsgFlags;
+    if (stream.status() != QDataStream::Ok)
+        return false;
+
+    QHash<uint, AbstractCache::MessageDataBundle> newMetadata;
+    for (auto it = serializedMetadata.constBegin(); it != serializedMetadata.constEnd(); ++it) {
+        AbstractCache::MessageDataBundle bundle;
+        if (!SQLCache::parseMessageMetadata(*it, bundle))
+            return false;
+        bundle.uid = it.key();
+        newMetadata[it.key()] = bundle;
+    }
+
+    childMailboxes = newChildMailboxes;
+    syncStates = newSyncStates;
+    mailbox = newMailbox;
+    hasUidMapping = newHasUidMapping;
+    uidMapping = newUidMapping;
+    messageMetadata = newMetadata;
+    msgFlags = newMsgFlags;
+    return true;
+}
+
+bool CacheSnapshot::save(const QString &fileName) const
+{
+    QHash<uint, QByteArray> serializedMetadata;
+    for (auto it = messageMetadata.constBegin(); it != messageMetadata.constEnd(); ++it) {
+        serializedMetadata[it.key()] = SQLCache::serializeMessageMetadata(*it);
+    }
+
+    QByteArray buf;
+    QDataStream stream(&buf, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_2);
+    stream << snapshotMagic << snapshotVersion << childMailboxes << syncStates << mailbox << hasUidMapping << uidMapping
+           << serializedMetadata << msgFlags;
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(buf);
+    return file.commit();
+}
+
+void CacheSnapshot::switchToMailbox(const QString &newMailbox)
+{
+    if (mailbox == newMailbox)
+        return;
+    mailbox = newMailbox;
+    hasUidMapping = false;
+    uidMapping.clear();
+    messageMetadata.clear();
+    msgFlags.clear();
+}
+
+}
+}
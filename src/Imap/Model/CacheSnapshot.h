@@ -0,0 +1,76 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAP_MODEL_CACHESNAPSHOT_H
+#define IMAP_MODEL_CACHESNAPSHOT_H
+
+#include <QHash>
+#include "Cache.h"
+
+namespace Imap
+{
+
+namespace Mailbox
+{
+
+/** @short In-memory copy of the part of the persistent cache which is needed right after the startup
+
+Populating the mailbox tree from the SQL cache means a couple of queries for each mailbox, and opening the last used
+mailbox means one query per each visible message. That adds up on accounts with hundreds of folders. The snapshot keeps
+everything which was used during a session -- the mailbox hierarchy with flags, the last known message counts, and the
+envelopes and flags of the most recently opened mailbox -- and saves it into a single file on shutdown, so that the next
+startup can restore it with one read.
+
+The snapshot is only a shortcut in front of the SQLCache, all modifications are still written to the database. The file
+is removed as soon as it has been read, so that a session which does not shut down cleanly cannot leave stale data behind.
+*/
+class CacheSnapshot
+{
+public:
+    CacheSnapshot();
+
+    bool load(const QString &fileName);
+    bool save(const QString &fileName) const;
+
+    /** @short Start tracking messages of a different mailbox, forgetting about the old one */
+    void switchToMailbox(const QString &mailbox);
+
+    /** @short Child mailboxes, only for those parents which have some */
+    QHash<QString, QList<MailboxMetadata>> childMailboxes;
+    QHash<QString, SyncState> syncStates;
+
+    /** @short Name of the mailbox whose messages are tracked */
+    QString mailbox;
+    bool hasUidMapping;
+    Imap::Uids uidMapping;
+    QHash<uint, AbstractCache::MessageDataBundle> messageMetadata;
+    QHash<uint, QStringList> msgFlags;
+
+    /** @short How many messages of the tracked mailbox to remember */
+    static const int maxMessages;
+};
+
+}
+
+}
+
+#endif /* IMAP_MODEL_CACHESNAPSHOT_H */
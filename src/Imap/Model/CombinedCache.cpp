@@ -20,10 +20,23 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <QTimer>
 #include "CombinedCache.h"
+#include "Common/PerformanceTrace.h"
 #include "DiskPartCache.h"
 #include "SQLCache.h"
 
+namespace {
+
+/** @short How many parts to evict at most in one go */
+const int evictionBatchSize = 50;
+/** @short Wait that long after storing a part before checking the total size */
+const int evictionDelay = 5000;
+/** @short Break between two successive eviction batches */
+const int evictionBatchDelay = 100;
+
+}
+
 namespace Imap
 {
 namespace Mailbox
@@ -34,98 +47,215 @@ CombinedCache::CombinedCache(const QString &name, const QString &cacheDir)
     , cacheDir(cacheDir)
     , sqlCache(new SQLCache())
     , diskPartCache(new DiskPartCache(cacheDir))
+    , m_sizeLimit(0)
+    , m_evictionTimer(new QTimer())
+    , m_opened(false)
 {
     sqlCache->setErrorHandler([this](const QString &e) { this->m_errorHandler(e); });
     diskPartCache->setErrorHandler([this](const QString &e) { this->m_errorHandler(e); });
+    m_evictionTimer->setSingleShot(true);
+    m_evictionTimer->setInterval(evictionDelay);
+    m_evictionTimer->setObjectName(QStringLiteral("evictionTimer"));
+    QObject::connect(m_evictionTimer.get(), &QTimer::timeout,
+                     m_evictionTimer.get(), [this](){ this->evictSomeParts(); });
 }
 
 CombinedCache::~CombinedCache()
 {
+    if (m_opened) {
+        m_snapshot.save(snapshotFileName());
+    }
 }
 
 bool CombinedCache::open()
 {
-    return sqlCache->open(name, cacheDir + QLatin1String("/imap.cache.sqlite"));
+    if (!sqlCache->open(name, databaseFileName()))
+        return false;
+    if (sqlCache->partStorageWasUpgraded()) {
+        // The big parts from the old layout are not referenced from the DB anymore
+        diskPartCache->removeLegacyFiles();
+    }
+    m_snapshot.load(snapshotFileName());
+    m_opened = true;
+    return true;
+}
+
+QString CombinedCache::databaseFileName() const
+{
+    return cacheDir + QLatin1String("/imap.cache.sqlite");
+}
+
+QString CombinedCache::snapshotFileName() const
+{
+    return cacheDir + QLatin1String("/startup.snapshot");
 }
 
 QList<MailboxMetadata> CombinedCache::childMailboxes(const QString &mailbox) const
 {
-    return sqlCache->childMailboxes(mailbox);
+    auto it = m_snapshot.childMailboxes.constFind(mailbox);
+    if (it != m_snapshot.childMailboxes.constEnd()) {
+        Common::PerformanceTrace::instance()->recordCacheLookup("childMailboxes", true);
+        return *it;
+    }
+    QList<MailboxMetadata> res = sqlCache->childMailboxes(mailbox);
+    if (!res.isEmpty())
+        m_snapshot.childMailboxes[mailbox] = res;
+    Common::PerformanceTrace::instance()->recordCacheLookup("childMailboxes", !res.isEmpty());
+    return res;
 }
 
 bool CombinedCache::childMailboxesFresh(const QString &mailbox) const
 {
-    return sqlCache->childMailboxesFresh(mailbox);
+    bool res = m_snapshot.childMailboxes.contains(mailbox) || sqlCache->childMailboxesFresh(mailbox);
+    Common::PerformanceTrace::instance()->recordCacheLookup("childMailboxesFresh", res);
+    return res;
 }
 
 void CombinedCache::setChildMailboxes(const QString &mailbox, const QList<MailboxMetadata> &data)
 {
     sqlCache->setChildMailboxes(mailbox, data);
+    // Mailboxes without children are never considered fresh, see SQLCache::childMailboxesFresh()
+    if (data.isEmpty())
+        m_snapshot.childMailboxes.remove(mailbox);
+    else
+        m_snapshot.childMailboxes[mailbox] = data;
 }
 
 SyncState CombinedCache::mailboxSyncState(const QString &mailbox) const
 {
-    return sqlCache->mailboxSyncState(mailbox);
+    auto it = m_snapshot.syncStates.constFind(mailbox);
+    if (it == m_snapshot.syncStates.constEnd())
+        it = m_snapshot.syncStates.insert(mailbox, sqlCache->mailboxSyncState(mailbox));
+    Common::PerformanceTrace::instance()->recordCacheLookup("mailboxSyncState", it->isUsableForSyncing());
+    return *it;
 }
 
 void CombinedCache::setMailboxSyncState(const QString &mailbox, const SyncState &state)
 {
     sqlCache->setMailboxSyncState(mailbox, state);
+    m_snapshot.syncStates[mailbox] = state;
 }
 
 Imap::Uids CombinedCache::uidMapping(const QString &mailbox) const
 {
-    return sqlCache->uidMapping(mailbox);
+    // This is what gets called when a mailbox is being opened, so let's follow the user to that mailbox
+    m_snapshot.switchToMailbox(mailbox);
+    if (!m_snapshot.hasUidMapping) {
+        m_snapshot.uidMapping = sqlCache->uidMapping(mailbox);
+        m_snapshot.hasUidMapping = true;
+    }
+    Common::PerformanceTrace::instance()->recordCacheLookup("uidMapping", !m_snapshot.uidMapping.isEmpty());
+    return m_snapshot.uidMapping;
 }
 
 void CombinedCache::setUidMapping(const QString &mailbox, const Imap::Uids &seqToUid)
 {
     sqlCache->setUidMapping(mailbox, seqToUid);
+    if (mailbox == m_snapshot.mailbox) {
+        m_snapshot.uidMapping = seqToUid;
+        m_snapshot.hasUidMapping = true;
+    }
 }
 
 void CombinedCache::clearUidMapping(const QString &mailbox)
 {
     sqlCache->clearUidMapping(mailbox);
+    if (mailbox == m_snapshot.mailbox) {
+        m_snapshot.uidMapping.clear();
+        m_snapshot.hasUidMapping = false;
+    }
 }
 
 void CombinedCache::clearAllMessages(const QString &mailbox)
 {
     sqlCache->clearAllMessages(mailbox);
-    diskPartCache->clearAllMessages(mailbox);
+    removeOrphanedBlobs();
+    m_snapshot.syncStates.remove(mailbox);
+    if (mailbox == m_snapshot.mailbox) {
+        m_snapshot.switchToMailbox(QString());
+    }
 }
 
 void CombinedCache::clearMessage(const QString mailbox, const uint uid)
 {
     sqlCache->clearMessage(mailbox, uid);
-    diskPartCache->clearMessage(mailbox, uid);
+    removeOrphanedBlobs();
+    if (mailbox == m_snapshot.mailbox) {
+        m_snapshot.messageMetadata.remove(uid);
+        m_snapshot.msgFlags.remove(uid);
+    }
 }
 
 QStringList CombinedCache::msgFlags(const QString &mailbox, const uint uid) const
 {
-    return sqlCache->msgFlags(mailbox, uid);
+    QStringList res;
+    if (mailbox != m_snapshot.mailbox) {
+        res = sqlCache->msgFlags(mailbox, uid);
+    } else {
+        auto it = m_snapshot.msgFlags.constFind(uid);
+        if (it != m_snapshot.msgFlags.constEnd()) {
+            res = *it;
+        } else {
+            res = sqlCache->msgFlags(mailbox, uid);
+            if (m_snapshot.msgFlags.size() < CacheSnapshot::maxMessages)
+                m_snapshot.msgFlags[uid] = res;
+        }
+    }
+    // There's no difference between "no flags" and "not cached" at this level, so the former counts as a miss
+    Common::PerformanceTrace::instance()->recordCacheLookup("msgFlags", !res.isEmpty());
+    return res;
 }
 
 void CombinedCache::setMsgFlags(const QString &mailbox, const uint uid, const QStringList &flags)
 {
     sqlCache->setMsgFlags(mailbox, uid, flags);
+    if (mailbox == m_snapshot.mailbox && (m_snapshot.msgFlags.contains(uid) || m_snapshot.msgFlags.size() < CacheSnapshot::maxMessages))
+        m_snapshot.msgFlags[uid] = flags;
 }
 
 AbstractCache::MessageDataBundle CombinedCache::messageMetadata(const QString &mailbox, const uint uid) const
 {
-    return sqlCache->messageMetadata(mailbox, uid);
+    MessageDataBundle res;
+    if (mailbox != m_snapshot.mailbox) {
+        res = sqlCache->messageMetadata(mailbox, uid);
+    } else {
+        auto it = m_snapshot.messageMetadata.constFind(uid);
+        if (it != m_snapshot.messageMetadata.constEnd()) {
+            res = *it;
+        } else {
+            res = sqlCache->messageMetadata(mailbox, uid);
+            if (res.uid == uid && m_snapshot.messageMetadata.size() < CacheSnapshot::maxMessages)
+                m_snapshot.messageMetadata[uid] = res;
+        }
+    }
+    Common::PerformanceTrace::instance()->recordCacheLookup("messageMetadata", res.uid == uid);
+    return res;
 }
 
 void CombinedCache::setMessageMetadata(const QString &mailbox, const uint uid, const MessageDataBundle &metadata)
 {
     sqlCache->setMessageMetadata(mailbox, uid, metadata);
+    if (mailbox == m_snapshot.mailbox
+            && (m_snapshot.messageMetadata.contains(uid) || m_snapshot.messageMetadata.size() < CacheSnapshot::maxMessages)) {
+        MessageDataBundle &stored = m_snapshot.messageMetadata[uid];
+        stored = metadata;
+        stored.uid = uid;
+    }
 }
 
 QByteArray CombinedCache::messagePart(const QString &mailbox, const uint uid, const QByteArray &partId) const
 {
     QByteArray res = sqlCache->messagePart(mailbox, uid, partId);
     if (res.isEmpty()) {
-        res = diskPartCache->messagePart(mailbox, uid, partId);
+        QByteArray hash = sqlCache->partContentHash(mailbox, uid, partId);
+        if (!hash.isEmpty()) {
+            res = diskPartCache->blob(hash);
+            if (!res.isNull()) {
+                sqlCache->noteBlobAccessed(hash);
+            }
+        }
     }
+    Common::PerformanceTrace::instance()->recordCacheLookup("messagePart", !res.isNull());
     return res;
 }
 
@@ -134,19 +264,45 @@ void CombinedCache::setMsgPart(const QString &mailbox, const uint uid, const QBy
     if (data.size() < 1024 * 1024) {
         sqlCache->setMsgPart(mailbox, uid, partId, data);
     } else {
-        diskPartCache->setMsgPart(mailbox, uid, partId, data);
+        // Identical big attachments are pretty common, so check whether we have these data already
+        QByteArray hash = SQLCache::contentHash(data);
+        if (!sqlCache->referenceExistingBlob(mailbox, uid, partId, hash)) {
+            qint64 size = diskPartCache->setBlob(hash, data);
+            if (size >= 0) {
+                sqlCache->setExternalMsgPart(mailbox, uid, partId, hash, size);
+            }
+        }
+        removeOrphanedBlobs();
+    }
+    if (m_sizeLimit && !m_evictionTimer->isActive()) {
+        m_evictionTimer->start(evictionDelay);
     }
 }
 
 void CombinedCache::forgetMessagePart(const QString &mailbox, const uint uid, const QByteArray &partId)
 {
     sqlCache->forgetMessagePart(mailbox, uid, partId);
-    diskPartCache->forgetMessagePart(mailbox, uid, partId);
+    removeOrphanedBlobs();
+}
+
+void CombinedCache::copyMessageParts(const QString &srcMailbox, const uint srcUid, const QString &dstMailbox, const uint dstUid)
+{
+    sqlCache->copyMessageParts(srcMailbox, srcUid, dstMailbox, dstUid);
+    removeOrphanedBlobs();
+}
+
+void CombinedCache::removeOrphanedBlobs()
+{
+    Q_FOREACH(const QByteArray &hash, sqlCache->takeOrphanedExternalBlobs()) {
+        diskPartCache->forgetBlob(hash);
+    }
 }
 
 QVector<Imap::Responses::ThreadingNode> CombinedCache::messageThreading(const QString &mailbox)
 {
-    return sqlCache->messageThreading(mailbox);
+    QVector<Imap::Responses::ThreadingNode> res = sqlCache->messageThreading(mailbox);
+    Common::PerformanceTrace::instance()->recordCacheLookup("messageThreading", !res.isEmpty());
+    return res;
 }
 
 void CombinedCache::setMessageThreading(const QString &mailbox, const QVector<Imap::Responses::ThreadingNode> &threading)
@@ -159,5 +315,46 @@ void CombinedCache::setRenewalThreshold(const int days)
     sqlCache->setRenewalThreshold(days);
 }
 
+AbstractCache::CacheUsage CombinedCache::usage() const
+{
+    return sqlCache->usage();
+}
+
+void CombinedCache::setSizeLimit(const quint64 bytes)
+{
+    m_sizeLimit = bytes;
+    if (m_sizeLimit) {
+        m_evictionTimer->start(evictionDelay);
+    } else {
+        m_evictionTimer->stop();
+    }
+}
+
+void CombinedCache::evictSomeParts()
+{
+    if (!m_sizeLimit)
+        return;
+
+    quint64 currentSize = sqlCache->partsSize();
+    if (currentSize <= m_sizeLimit)
+        return;
+
+    auto victims = sqlCache->leastRecentlyUsedBlobs(evictionBatchSize);
+    for (const auto &victim : victims) {
+        sqlCache->evictBlob(victim.hash);
+        if (victim.external) {
+            diskPartCache->forgetBlob(victim.hash);
+        }
+        currentSize -= qMin(currentSize, victim.size);
+        if (currentSize <= m_sizeLimit)
+            return;
+    }
+
+    if (victims.size() == evictionBatchSize) {
+        // There's still something left to evict, but let's give the event loop a chance to breathe
+        m_evictionTimer->start(evictionBatchDelay);
+    }
+}
+
 }
 }
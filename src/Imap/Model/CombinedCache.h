@@ -25,6 +25,9 @@
 
 #include <memory>
 #include "Cache.h"
+#include "CacheSnapshot.h"
+
+class QTimer;
 
 namespace Imap
 {
@@ -41,6 +44,12 @@ class DiskPartCache;
 This cache servers as a thin wrapper around the SQLCache. It uses
 the SQL facilities for most of the actual caching, but changes to
 a file-based cache when items are bigger than a certain threshold.
+Even in that case, the SQLCache keeps track of which message parts
+refer to which file, so that identical data are stored only once.
+
+The data which are needed at startup are served from a CacheSnapshot
+which is restored from a single file when the cache is opened, and
+saved again on destruction.
 
 In future, this should be extended with an in-memory cache (but
 only after the MemoryCache rework) which should only speed-up certain
@@ -83,16 +92,36 @@ public:
     virtual QByteArray messagePart(const QString &mailbox, const uint uid, const QByteArray &partId) const;
     virtual void setMsgPart(const QString &mailbox, const uint uid, const QByteArray &partId, const QByteArray &data);
     virtual void forgetMessagePart(const QString &mailbox, const uint uid, const QByteArray &partId);
+    virtual void copyMessageParts(const QString &srcMailbox, const uint srcUid, const QString &dstMailbox, const uint dstUid);
 
     virtual QVector<Imap::Responses::ThreadingNode> messageThreading(const QString &mailbox);
     virtual void setMessageThreading(const QString &mailbox, const QVector<Imap::Responses::ThreadingNode> &threading);
 
     virtual void setRenewalThreshold(const int days);
 
+    virtual CacheUsage usage() const;
+    virtual void setSizeLimit(const quint64 bytes);
+
     /** @short Open a connection to the cache */
     bool open();
 
+    /** @short Path to the SQLite database which holds the metadata */
+    QString databaseFileName() const;
+
+    /** @short Path to the file which holds the startup snapshot */
+    QString snapshotFileName() const;
+
 private:
+    /** @short Remove files with data which are no longer referenced by any message part */
+    void removeOrphanedBlobs();
+
+    /** @short Evict a batch of the least recently used message parts if the cache is over its size limit
+
+    The eviction is incremental so that the GUI is never blocked for too long. If there's still more work left after one
+    batch, another round is scheduled.
+    */
+    void evictSomeParts();
+
     /** @short Name of the DB connection */
     QString name;
     /** @short Directory to serve as a cache root */
@@ -101,6 +130,14 @@ private:
     std::unique_ptr<SQLCache> sqlCache;
     /** @short Cache for bigger message parts */
     std::unique_ptr<DiskPartCache> diskPartCache;
+    /** @short Maximal size of all message parts, or zero if unlimited */
+    quint64 m_sizeLimit;
+    /** @short Deferred, incremental eviction of message parts */
+    std::unique_ptr<QTimer> m_evictionTimer;
+    /** @short Data used during this session, to be restored quickly on the next startup */
+    mutable CacheSnapshot m_snapshot;
+    /** @short Was the cache opened successfully? */
+    bool m_opened;
 };
 
 }
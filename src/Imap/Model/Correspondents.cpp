@@ -0,0 +1,292 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include <initializer_list>
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QTimer>
+#include <QVariant>
+#include "Correspondents.h"
+
+namespace {
+
+/** @short How many messages to process in one go */
+const int batchSize = 500;
+
+/** @short How often to look for new messages once the whole cache was processed */
+const int pollInterval = 60 * 1000;
+
+/** @short Weight of a message which has just arrived; it halves every halfLifeDays */
+const int freshMessageWeight = 100;
+const double halfLifeDays = 180;
+
+class CorrespondentsCompletionJob : public Plugins::AddressbookCompletionJob
+{
+public:
+    CorrespondentsCompletionJob(const QString &input, const QStringList &ignores, int max,
+                                Imap::Mailbox::CorrespondentsAddressbook *parent) :
+        AddressbookCompletionJob(parent), m_input(input), m_ignores(ignores), m_max(max), m_parent(parent) {}
+
+protected:
+    virtual void doStart() override
+    {
+        emit completionAvailable(m_parent->complete(m_input, m_ignores, m_max));
+        finished();
+    }
+
+    virtual void doStop() override
+    {
+        emit error(AddressbookJob::Stopped);
+        finished();
+    }
+
+private:
+    QString m_input;
+    QStringList m_ignores;
+    int m_max;
+    Imap::Mailbox::CorrespondentsAddressbook *m_parent;
+};
+
+class CorrespondentsNamesJob : public Plugins::AddressbookNamesJob
+{
+public:
+    CorrespondentsNamesJob(const QString &email, Imap::Mailbox::CorrespondentsAddressbook *parent) :
+        AddressbookNamesJob(parent), m_email(email), m_parent(parent) {}
+
+protected:
+    virtual void doStart() override
+    {
+        emit prettyNamesForAddressAvailable(m_parent->prettyNamesForAddress(m_email));
+        finished();
+    }
+
+    virtual void doStop() override
+    {
+        emit error(AddressbookJob::Stopped);
+        finished();
+    }
+
+private:
+    QString m_email;
+    Imap::Mailbox::CorrespondentsAddressbook *m_parent;
+};
+
+}
+
+namespace Imap
+{
+
+namespace Mailbox
+{
+
+CorrespondentHarvester::CorrespondentHarvester(const QString &fileName):
+    m_fileName(fileName), m_timer(0), m_lastRowId(0)
+{
+}
+
+/** @short Open the DB and start walking through it; this has to be called from within the worker thread */
+void CorrespondentHarvester::start()
+{
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    connect(m_timer, &QTimer::timeout, this, &CorrespondentHarvester::harvestBatch);
+    if (openDatabase())
+        harvestBatch();
+}
+
+bool CorrespondentHarvester::openDatabase()
+{
+    const QString name = QStringLiteral("trojita-correspondents-%1").arg(reinterpret_cast<quintptr>(this));
+    m_db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), name);
+    m_cleanup.name = name;
+    m_db.setDatabaseName(m_fileName);
+    // The GUI thread might be in the middle of a transaction, so let's wait a bit instead of failing right away
+    m_db.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=5000"));
+    if (!m_db.open()) {
+        qWarning() << "CorrespondentHarvester: cannot open" << m_fileName << m_db.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+void CorrespondentHarvester::harvestBatch()
+{
+    QSqlQuery q(m_db);
+    q.setForwardOnly(true);
+    if (!q.prepare(QStringLiteral("SELECT rowid, mailbox, uid, data FROM msg_metadata WHERE rowid > ? ORDER BY rowid LIMIT ?"))) {
+        qWarning() << "CorrespondentHarvester: cannot prepare query" << q.lastError().text();
+        return;
+    }
+    q.bindValue(0, m_lastRowId);
+    q.bindValue(1, batchSize);
+    if (!q.exec()) {
+        // Most likely the DB is locked for too long; try again later
+        m_timer->start(pollInterval);
+        return;
+    }
+
+    QHash<QString, Correspondent> found;
+    int rows = 0;
+    while (q.next()) {
+        ++rows;
+        m_lastRowId = q.value(0).toLongLong();
+        AbstractCache::MessageDataBundle metadata;
+        metadata.uid = q.value(2).toUInt();
+        if (SQLCache::parseMessageMetadata(q.value(3).toByteArray(), metadata))
+            addMessage(metadata, q.value(1).toString(), found);
+    }
+
+    if (!found.isEmpty())
+        emit correspondentsFound(found.values().toVector());
+
+    // Yield to the event loop between the batches so that the thread can be stopped in a timely manner
+    m_timer->start(rows == batchSize ? 0 : pollInterval);
+}
+
+void CorrespondentHarvester::addMessage(const AbstractCache::MessageDataBundle &metadata, const QString &mailbox,
+                                        QHash<QString, Correspondent> &found)
+{
+    const Imap::Message::Envelope &envelope = metadata.envelope;
+
+    // The same message can be present in many mailboxes (and the row gets replaced when the metadata are updated)
+    QByteArray key = envelope.messageId;
+    if (key.isEmpty())
+        key = mailbox.toUtf8() + '\0' + QByteArray::number(metadata.uid) + '\0' + envelope.subject.toUtf8();
+    if (m_seenMessages.contains(key))
+        return;
+    m_seenMessages.insert(key);
+
+    const QDateTime date = envelope.date.isValid() ? envelope.date : metadata.internalDate;
+    int weight = freshMessageWeight;
+    if (date.isValid()) {
+        const qint64 age = qMax<qint64>(0, date.daysTo(QDateTime::currentDateTime()));
+        weight = qMax(1, static_cast<int>(freshMessageWeight * std::pow(0.5, age / halfLifeDays)));
+    }
+
+    for (const auto *list : {&envelope.from, &envelope.replyTo, &envelope.to, &envelope.cc, &envelope.bcc}) {
+        for (const auto &address : *list) {
+            if (address.mailbox.isEmpty() || address.host.isEmpty())
+                continue;
+            const QString email = address.mailbox + QLatin1Char('@') + address.host;
+            Correspondent &item = found[email.toCaseFolded()];
+            if (item.email.isEmpty()) {
+                item.email = email;
+                item.weight = 0;
+            }
+            item.weight += weight;
+            if (!address.name.isEmpty())
+                item.name = address.name;
+        }
+    }
+}
+
+CorrespondentsAddressbook::CorrespondentsAddressbook(QObject *parent, const QString &cacheFileName):
+    AddressbookPlugin(parent), m_thread(new QThread(this))
+{
+    qRegisterMetaType<QVector<Imap::Mailbox::Correspondent>>();
+
+    auto harvester = new CorrespondentHarvester(cacheFileName);
+    harvester->moveToThread(m_thread);
+    connect(m_thread, &QThread::started, harvester, &CorrespondentHarvester::start);
+    connect(m_thread, &QThread::finished, harvester, &QObject::deleteLater);
+    connect(harvester, &CorrespondentHarvester::correspondentsFound, this, &CorrespondentsAddressbook::slotCorrespondentsFound);
+    m_thread->setObjectName(QStringLiteral("CorrespondentHarvester"));
+    m_thread->start(QThread::LowestPriority);
+}
+
+CorrespondentsAddressbook::~CorrespondentsAddressbook()
+{
+    m_thread->quit();
+    m_thread->wait();
+}
+
+Plugins::AddressbookPlugin::Features CorrespondentsAddressbook::features() const
+{
+    return FeatureCompletion | FeaturePrettyNames;
+}
+
+void CorrespondentsAddressbook::slotCorrespondentsFound(const QVector<Correspondent> &correspondents)
+{
+    for (const Correspondent &item : correspondents) {
+        const QString folded = item.email.toCaseFolded();
+        auto key = m_keys.constFind(folded);
+        const bool isNew = key == m_keys.constEnd();
+        if (isNew)
+            key = m_keys.insert(folded, m_keys.size() + 1);
+        m_weights[folded] += item.weight;
+
+        // Only touch the index when something visible has changed
+        QString &name = m_names[folded];
+        if (isNew || (!item.name.isEmpty() && item.name != name)) {
+            if (!item.name.isEmpty())
+                name = item.name;
+            m_index.setContact(*key, name, QStringList() << item.email);
+        }
+    }
+    m_index.setUsageCounts(m_weights);
+}
+
+void CorrespondentsAddressbook::recordSentMail(const QStringList &emails)
+{
+    QVector<Correspondent> correspondents;
+    for (const QString &email : emails) {
+        correspondents.append(Correspondent{QString(), email, freshMessageWeight});
+    }
+    slotCorrespondentsFound(correspondents);
+}
+
+Plugins::NameEmailList CorrespondentsAddressbook::complete(const QString &input, const QStringList &ignores, int max) const
+{
+    return m_index.complete(input, ignores, max);
+}
+
+QStringList CorrespondentsAddressbook::prettyNamesForAddress(const QString &email) const
+{
+    return m_index.namesForAddress(email);
+}
+
+Plugins::AddressbookCompletionJob *CorrespondentsAddressbook::requestCompletion(const QString &input, const QStringList &ignores, int max)
+{
+    return new CorrespondentsCompletionJob(input, ignores, max, this);
+}
+
+Plugins::AddressbookNamesJob *CorrespondentsAddressbook::requestPrettyNamesForAddress(const QString &email)
+{
+    return new CorrespondentsNamesJob(email, this);
+}
+
+void CorrespondentsAddressbook::openAddressbookWindow()
+{
+}
+
+void CorrespondentsAddressbook::openContactWindow(const QString &email, const QString &displayName)
+{
+    Q_UNUSED(email);
+    Q_UNUSED(displayName);
+}
+
+}
+
+}
@@ -0,0 +1,131 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAP_MODEL_CORRESPONDENTS_H
+#define IMAP_MODEL_CORRESPONDENTS_H
+
+#include <QHash>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QVector>
+#include "Imap/Model/SQLCache.h"
+#include "Plugins/AddressbookPlugin.h"
+#include "Plugins/CompletionIndex.h"
+
+class QThread;
+class QTimer;
+
+namespace Imap
+{
+
+namespace Mailbox
+{
+
+/** @short An e-mail address which appeared in a cached message */
+struct Correspondent
+{
+    QString name;
+    QString email;
+    /** @short How much this address matters; both the number of messages and their age contribute */
+    int weight;
+};
+
+/** @short Collect e-mail addresses from the envelopes in the persistent cache
+
+The harvester lives in its own thread and reads the SQLite database through a separate, read-only connection, so the
+GUI thread is never blocked. The msg_metadata table is walked in the order of its rowids. Because the SQLCache replaces
+the rows when storing them, the newly arrived messages always get a higher rowid; polling for rows past the last one
+seen is therefore enough for picking up new mail incrementally.
+*/
+class CorrespondentHarvester : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CorrespondentHarvester(const QString &fileName);
+
+public slots:
+    void start();
+
+signals:
+    void correspondentsFound(const QVector<Imap::Mailbox::Correspondent> &correspondents);
+
+private slots:
+    void harvestBatch();
+
+private:
+    bool openDatabase();
+    void addMessage(const AbstractCache::MessageDataBundle &metadata, const QString &mailbox,
+                    QHash<QString, Correspondent> &found);
+
+    // this needs to go before all QSqlDatabase instances for proper destruction order
+    DbConnectionCleanup m_cleanup;
+    QSqlDatabase m_db;
+    QString m_fileName;
+    QTimer *m_timer;
+    qint64 m_lastRowId;
+    /** @short Messages which were counted already, so that copies of a message in several mailboxes only count once */
+    QSet<QByteArray> m_seenMessages;
+};
+
+/** @short Offer the addresses of the people we have exchanged mail with for completion
+
+This is not a real plugin; it's an AddressbookPlugin so that the composer can query it the same way as the address
+book. It works offline, and all queries are answered synchronously from an in-memory index.
+*/
+class CorrespondentsAddressbook : public Plugins::AddressbookPlugin
+{
+    Q_OBJECT
+public:
+    CorrespondentsAddressbook(QObject *parent, const QString &cacheFileName);
+    virtual ~CorrespondentsAddressbook();
+
+    virtual Features features() const override;
+
+    Plugins::NameEmailList complete(const QString &input, const QStringList &ignores, int max = -1) const;
+    QStringList prettyNamesForAddress(const QString &email) const;
+
+public slots:
+    virtual Plugins::AddressbookCompletionJob *requestCompletion(const QString &input, const QStringList &ignores = QStringList(), int max = -1) override;
+    virtual Plugins::AddressbookNamesJob *requestPrettyNamesForAddress(const QString &email) override;
+    virtual void openAddressbookWindow() override;
+    virtual void openContactWindow(const QString &email, const QString &displayName) override;
+    virtual void recordSentMail(const QStringList &emails) override;
+
+private slots:
+    void slotCorrespondentsFound(const QVector<Imap::Mailbox::Correspondent> &correspondents);
+
+private:
+    QThread *m_thread;
+    Plugins::CompletionIndex m_index;
+    /** @short Internal key of each address (as case folded) in the completion index */
+    QHash<QString, quintptr> m_keys;
+    QHash<QString, QString> m_names;
+    QHash<QString, int> m_weights;
+};
+
+}
+
+}
+
+Q_DECLARE_METATYPE(QVector<Imap::Mailbox::Correspondent>)
+
+#endif // IMAP_MODEL_CORRESPONDENTS_H
@@ -20,9 +20,12 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include "DiskPartCache.h"
 #include <QDebug>
 #include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
 
 namespace
 {
@@ -77,63 +80,73 @@ DiskPartCache::DiskPartCache(const QString &cacheDir_)
         cacheDir.append(QLatin1Char('/'));
 }
 
-void DiskPartCache::clearAllMessages(const QString &mailbox)
+QByteArray DiskPartCache::blob(const QByteArray &hash) const
 {
-    QDir dir(dirForMailbox(mailbox));
-    Q_FOREACH(const QString& fname, dir.entryList(QStringList() << QLatin1String("*.cache"))) {
-        if (! dir.remove(fname)) {
-            m_errorHandler(QObject::tr("Couldn't remove file %1 for mailbox %2").arg(fname, mailbox));
-        }
-    }
-}
-
-void DiskPartCache::clearMessage(const QString mailbox, const uint uid)
-{
-    QDir dir(dirForMailbox(mailbox));
-    Q_FOREACH(const QString& fname, dir.entryList(QStringList() << QString::fromUtf8("%1_*.cache").arg(QString::number(uid)))) {
-        if (! dir.remove(fname)) {
-            m_errorHandler(QObject::tr("Couldn't remove file %1 for message %2, mailbox %3").arg(fname, QString::number(uid), mailbox));
-        }
-    }
-}
-
-QByteArray DiskPartCache::messagePart(const QString &mailbox, const uint uid, const QByteArray &partId) const
-{
-    QFile buf(fileForPart(mailbox, uid, partId));
+    QFile buf(fileForBlob(hash));
     if (! buf.open(QIODevice::ReadOnly)) {
         return QByteArray();
     }
     return qUncompress(buf.readAll());
 }
 
-void DiskPartCache::setMsgPart(const QString &mailbox, const uint uid, const QByteArray &partId, const QByteArray &data)
+qint64 DiskPartCache::setBlob(const QByteArray &hash, const QByteArray &data)
 {
-    QString myPath = dirForMailbox(mailbox);
-    QDir dir(myPath);
-    dir.mkpath(myPath);
-    QString fileName(fileForPart(mailbox, uid, partId));
+    QString fileName(fileForBlob(hash));
+    QDir().mkpath(QFileInfo(fileName).path());
     QFile buf(fileName);
     if (! buf.open(QIODevice::WriteOnly)) {
-        m_errorHandler(QObject::tr("Couldn't save the part %1 of message %2 (mailbox %3) into file %4: %5 (%6)").arg(
-                           QString::fromUtf8(partId), QString::number(uid), mailbox, fileName, buf.errorString(),
-                           fileErrorToString(buf.error())));
+        m_errorHandler(QObject::tr("Couldn't save message data into file %1: %2 (%3)").arg(
+                           fileName, buf.errorString(), fileErrorToString(buf.error())));
+        return -1;
     }
-    buf.write(qCompress(data));
+    return buf.write(qCompress(data));
+}
+
+void DiskPartCache::forgetBlob(const QByteArray &hash)
+{
+    QFile(fileForBlob(hash)).remove();
 }
 
-void DiskPartCache::forgetMessagePart(const QString &mailbox, const uint uid, const QByteArray &partId)
+void DiskPartCache::removeLegacyFiles()
 {
-    QFile(fileForPart(mailbox, uid, partId)).remove();
+    // Previously, the parts were stored in a directory per mailbox as "<uid>_<partId>.cache". The names of these directories
+    // are base64-encoded mailbox names which might contain a slash, so they could be nested arbitrarily deep.
+    QDir root(cacheDir);
+    Q_FOREACH(const QString &subdir, root.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        if (subdir == QLatin1String("blobs"))
+            continue;
+        QStringList dirs;
+        QDirIterator it(root.filePath(subdir), QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            const QString path = it.next();
+            const QFileInfo info = it.fileInfo();
+            if (info.isDir()) {
+                dirs << path;
+            } else if (info.fileName().endsWith(QLatin1String(".cache")) && info.fileName().contains(QLatin1Char('_'))) {
+                if (!QFile::remove(path)) {
+                    m_errorHandler(QObject::tr("Couldn't remove obsolete file %1").arg(path));
+                }
+            }
+        }
+        // Remove the directories deepest first; rmdir() refuses to remove anything which is not empty, which is exactly right
+        std::sort(dirs.begin(), dirs.end(), [](const QString &a, const QString &b) { return a.size() > b.size(); });
+        Q_FOREACH(const QString &dir, dirs) {
+            root.rmdir(dir);
+        }
+        root.rmdir(subdir);
+    }
 }
 
-QString DiskPartCache::dirForMailbox(const QString &mailbox) const
+QString DiskPartCache::blobDir() const
 {
-    return cacheDir + QString::fromUtf8(mailbox.toUtf8().toBase64());
+    return cacheDir + QLatin1String("blobs");
 }
 
-QString DiskPartCache::fileForPart(const QString &mailbox, const uint uid, const QByteArray &partId) const
+QString DiskPartCache::fileForBlob(const QByteArray &hash) const
 {
-    return QStringLiteral("%1/%2_%3.cache").arg(dirForMailbox(mailbox), QString::number(uid), QString::fromUtf8(partId));
+    // Spread the files into a couple of subdirectories so that none of them grows too big
+    QString hex = QString::fromUtf8(hash.toHex());
+    return QStringLiteral("%1/%2/%3.cache").arg(blobDir(), hex.left(2), hex);
 }
 
 void DiskPartCache::setErrorHandler(const std::function<void(const QString &)> &handler)
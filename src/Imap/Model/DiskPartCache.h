@@ -34,9 +34,8 @@ namespace Mailbox
 
 /** @short Cache for storing big message parts using plain files on the disk
 
-The API is designed to be "similar" to the AbstractCache, but because certain
-operations do not really make much sense (like working with a list of mailboxes),
-we do not inherit from that abstract base class.
+The files are addressed by the hash of their content; the mapping from the message parts to these hashes, as well as
+the reference counting, is a job for the SQLCache. This is why we do not inherit from AbstractCache.
 */
 class DiskPartCache
 {
@@ -44,25 +43,30 @@ public:
     /** @short Create the cache occupying the @arg cacheDir directory */
     explicit DiskPartCache(const QString &cacheDir);
 
-    /** @short Delete all data of message parts which belongs to that particular mailbox */
-    void clearAllMessages(const QString &mailbox);
-    /** @short Delete all data for a particular message in the given mailbox */
-    void clearMessage(const QString mailbox, const uint uid);
+    /** @short Return data stored under the given @arg hash, or a null QByteArray if not found */
+    QByteArray blob(const QByteArray &hash) const;
+    /** @short Store the data under the specified @arg hash
 
-    /** @short Return data for some message part, or a null QByteArray if not found */
-    QByteArray messagePart(const QString &mailbox, const uint uid, const QByteArray &partId) const;
-    /** @short Store the data for a specified message part */
-    void setMsgPart(const QString &mailbox, const uint uid, const QByteArray &partId, const QByteArray &data);
-    void forgetMessagePart(const QString &mailbox, const uint uid, const QByteArray &partId);
+    Returns the number of bytes which the data occupy on the disk, or -1 upon failure.
+    */
+    qint64 setBlob(const QByteArray &hash, const QByteArray &data);
+    /** @short Remove the data stored under the given @arg hash */
+    void forgetBlob(const QByteArray &hash);
+
+    /** @short Remove the files from the old, per-mailbox layout of the cache which are no longer used
+
+    This walks the whole cache directory, so it should only be done once after the cache got upgraded.
+    */
+    void removeLegacyFiles();
 
     /** @short Inform about runtime failures */
     void setErrorHandler(const std::function<void(const QString &)> &handler);
 
 private:
-    /** @short Return the directory which should be used as a storage dir for a particular mailbox */
-    QString dirForMailbox(const QString &mailbox) const;
+    /** @short Return the directory which holds all blobs */
+    QString blobDir() const;
 
-    QString fileForPart(const QString &mailbox, const uint uid, const QByteArray &partId) const;
+    QString fileForBlob(const QByteArray &hash) const;
 
     /** @short The root directory for all caching */
     QString cacheDir;
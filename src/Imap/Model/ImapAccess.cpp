@@ -30,6 +30,7 @@
 #include "Common/PortNumbers.h"
 #include "Common/SettingsNames.h"
 #include "Imap/Model/CombinedCache.h"
+#include "Imap/Model/Correspondents.h"
 #include "Imap/Model/DummyNetworkWatcher.h"
 #include "Imap/Model/MailboxModel.h"
 #include "Imap/Model/MemoryCache.h"
@@ -51,7 +52,7 @@ namespace Imap {
 ImapAccess::ImapAccess(QObject *parent, QSettings *settings, Plugins::PluginManager *pluginManager, const QString &accountName) :
     QObject(parent), m_settings(settings), m_imapModel(0), m_mailboxModel(0), m_mailboxSubtreeModel(0), m_msgListModel(0),
     m_threadingMsgListModel(0), m_visibleTasksModel(0), m_oneMessageModel(0), m_netWatcher(0), m_msgQNAM(0),
-    m_pluginManager(pluginManager), m_passwordWatcher(0), m_port(0),
+    m_correspondents(0), m_pluginManager(pluginManager), m_passwordWatcher(0), m_port(0),
     m_connectionMethod(Common::ConnectionMethod::Invalid),
     m_sslInfoIcon(UiUtils::Formatting::IconType::NoIcon),
     m_accountName(accountName)
@@ -113,7 +114,7 @@ void ImapAccess::networkError(const QString &message)
 void ImapAccess::slotLogged(uint parserId, const Common::LogMessage &message)
 {
     if (message.kind != Common::LOG_IO_READ) {
-        qDebug() << "LOG" << parserId << message.timestamp << message.kind << message.source << message.message;
+        qDebug() << "LOG" << parserId << message.timestamp << message.kind << message.source << message.text();
     }
 }
 
@@ -276,6 +277,9 @@ void ImapAccess::doConnect()
         delete m_imapModel;
         m_imapModel = 0;
     }
+    delete m_correspondents;
+    m_correspondents = 0;
+    m_persistentCacheDir.clear();
 
     Q_ASSERT(!m_imapModel);
 
@@ -341,6 +345,9 @@ void ImapAccess::doConnect()
             // Error message was already shown by the cacheError() slot
             cache.reset(new Imap::Mailbox::MemoryCache());
         } else {
+            m_persistentCacheDir = m_cacheDir;
+            m_correspondents = new Imap::Mailbox::CorrespondentsAddressbook(
+                        this, static_cast<Imap::Mailbox::CombinedCache *>(cache.get())->databaseFileName());
             if (m_settings->value(Common::SettingsNames::cacheOfflineKey).toString() == Common::SettingsNames::cacheOfflineAll) {
                 cache->setRenewalThreshold(0);
             } else {
@@ -351,6 +358,7 @@ void ImapAccess::doConnect()
                     num = defaultCacheLifetime;
                 cache->setRenewalThreshold(num);
             }
+            cache->setSizeLimit(m_settings->value(Common::SettingsNames::cacheOfflineSizeLimitKey, 0).toULongLong() * 1024 * 1024);
         }
     }
 
@@ -464,6 +472,18 @@ UiUtils::PasswordWatcher *ImapAccess::passwordWatcher() const
     return m_passwordWatcher;
 }
 
+/** @short Completion of the addresses found in the cached messages, or nullptr if there's no persistent cache */
+Plugins::AddressbookPlugin *ImapAccess::correspondents() const
+{
+    return m_correspondents;
+}
+
+/** @short Directory for storing additional cached data, or a null string when the user doesn't want anything on disk */
+QString ImapAccess::persistentCacheDir() const
+{
+    return m_persistentCacheDir;
+}
+
 void ImapAccess::openMessage(const QString &mailboxName, const uint uid)
 {
     QModelIndex msgIndex = m_imapModel->messageIndexByUid(mailboxName, uid);
@@ -36,6 +36,7 @@ class QNetworkAccessManager;
 class QSettings;
 
 namespace Plugins {
+class AddressbookPlugin;
 class PluginManager;
 }
 
@@ -46,6 +47,7 @@ class PasswordWatcher;
 namespace Imap {
 
 namespace Mailbox {
+class CorrespondentsAddressbook;
 class MailboxModel;
 class Model;
 class MsgListModel;
@@ -92,6 +94,8 @@ public:
     QAbstractItemModel *threadingMsgListModel() const;
     QObject *msgQNAM() const;
     UiUtils::PasswordWatcher *passwordWatcher() const;
+    Plugins::AddressbookPlugin *correspondents() const;
+    QString persistentCacheDir() const;
 
     QString server() const;
     void setServer(const QString &server);
@@ -167,6 +171,7 @@ private:
     Imap::Mailbox::OneMessageModel *m_oneMessageModel;
     Imap::Mailbox::NetworkWatcher *m_netWatcher;
     QNetworkAccessManager *m_msgQNAM;
+    Imap::Mailbox::CorrespondentsAddressbook *m_correspondents;
     Plugins::PluginManager *m_pluginManager;
     UiUtils::PasswordWatcher *m_passwordWatcher;
 
@@ -184,6 +189,8 @@ private:
 
     QString m_accountName;
     QString m_cacheDir;
+    /** @short Same as m_cacheDir, but only when the persistent cache is actually in use */
+    QString m_persistentCacheDir;
 };
 
 }
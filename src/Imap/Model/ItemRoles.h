@@ -130,6 +130,10 @@ enum {
     RoleMessageHeaderListPost,
     /** @short Is the List-Post set to a special value of "NO"? */
     RoleMessageHeaderListPostNo,
+    /** @short The list identifier from the List-Id header, see RFC 2919 */
+    RoleMessageHeaderListId,
+    /** @short Subject without the "Re:", "Fwd:" and mailing list prefixes, i.e. the base subject from RFC 5256 */
+    RoleMessageNormalizedSubject,
     /** @short A full message envelope */
     RoleMessageEnvelope,
     /** @short Is this a mail with at least one attachment?
@@ -137,6 +141,12 @@ enum {
     The returned value might be a bit fuzzy.
     */
     RoleMessageHasAttachments,
+    /** @short A short plaintext preview of the message body
+
+    Asking for this role will make the preview available in a batched manner, either via the RFC 8970 PREVIEW or by
+    fetching the beginning of the main text part.
+    */
+    RoleMessagePreview,
 
     /** @short Contents of a message part */
     RolePartData,
@@ -173,8 +183,18 @@ enum {
 
     /** @short Fetch a part from the cache if it's available, but do not request it from the server */
     RolePartForceFetchFromCache,
+    /** @short Download a part with a low priority so that it does not delay the data the user is waiting for */
+    RolePartPrefetch,
     /** @short Pointer to the internal buffer */
     RolePartBufferPtr,
+    /** @short Request the next chunk of the part's data through a partial fetch, without downloading the whole part */
+    RolePartLoadNextChunk,
+    /** @short Request the rest of the part's data, continuing from what was loaded through partial fetches so far */
+    RolePartLoadRemainingChunks,
+    /** @short Contents of a message part which are available so far, i.e. RolePartData of a partially loaded part */
+    RolePartPartialData,
+    /** @short Number of bytes (as counted by RolePartOctets) which were loaded so far */
+    RolePartPartialOctets,
 
     /** @short QModelIndex of the message a part is associated to */
     RolePartMessageIndex,
@@ -26,6 +26,7 @@
 #include "Common/InvokeMethod.h"
 #include "Common/MetaTypes.h"
 #include "Imap/Encoders.h"
+#include "Imap/Parser/LowLevelParser.h"
 #include "Imap/Parser/Rfc5322HeaderParser.h"
 #include "Imap/Tasks/KeepMailboxOpenTask.h"
 #include "UiUtils/Formatting.h"
@@ -33,6 +34,7 @@
 #include "MailboxTree.h"
 #include "Model.h"
 #include "SpecialFlagNames.h"
+#include "Utils.h"
 #include <QtDebug>
 
 
@@ -328,11 +330,26 @@ void TreeItemMailbox::handleFetchResponse(Model *const model,
     bool ignoreImmutableData = !list->fetched() && uidRecord == response.data.constEnd();
 
     int number = response.number - 1;
-    if (number < 0 || number >= list->m_children.size())
+    if (number < 0 || number >= list->m_rows.size())
         throw UnknownMessageIndex(QStringLiteral("Got FETCH that is out of bounds -- got %1 messages").arg(
-                                      QString::number(list->m_children.size())).toUtf8().constData(), response);
+                                      QString::number(list->m_rows.size())).toUtf8().constData(), response);
 
-    TreeItemMessage *message = static_cast<TreeItemMessage *>(list->child(number, model));
+    // The flags of each and every message arrive when syncing a mailbox. These updates are kept in the list of messages
+    // without instantiating a TreeItemMessage for messages which nobody has asked for yet. That is only needed when there
+    // is something new for the views which might be showing that message already.
+    bool needsMessage = list->existingMessageAt(number);
+    for (auto it = response.data.constBegin(); !needsMessage && it != response.data.constEnd(); ++it) {
+        if (it.key() == "UID") {
+            needsMessage = static_cast<const Responses::RespData<uint>&>(*(it.value())).data != list->uidAt(number);
+        } else if (it.key() == "FLAGS") {
+            needsMessage = list->m_rows[number].flagsHandled && list->flagsAt(number) !=
+                    model->normalizeFlags(static_cast<const Responses::RespData<QStringList>&>(*(it.value())).data);
+        } else {
+            needsMessage = it.key() != "MODSEQ";
+        }
+    }
+    TreeItemMessage *message = needsMessage ? list->messageAt(number) : 0;
+    const int oldUnreadCount = list->m_unreadMessageCount;
 
     // At first, have a look at the response and check the UID of the message
     if (uidRecord != response.data.constEnd()) {
@@ -340,11 +357,12 @@ void TreeItemMailbox::handleFetchResponse(Model *const model,
         if (receivedUid == 0) {
             throw MailboxException(QStringLiteral("Server claims that message #%1 has UID 0")
                                    .arg(QString::number(response.number)).toUtf8().constData(), response);
-        } else if (message->uid() == receivedUid) {
+        } else if (list->uidAt(number) == receivedUid) {
             // That's what we expect -> do nothing
-        } else if (message->uid() == 0) {
+        } else if (list->uidAt(number) == 0) {
             // This is the first time we see the UID, so let's take a note
-            message->m_uid = receivedUid;
+            Q_ASSERT(message);
+            list->m_rows[number].uid = receivedUid;
             changedMessage = message;
             if (message->loading()) {
                 // The Model tried to ask for data for this message. That couldn't succeeded because the UID
@@ -372,14 +390,14 @@ void TreeItemMailbox::handleFetchResponse(Model *const model,
             }
         } else {
             throw MailboxException(QStringLiteral("FETCH response: UID consistency error for message #%1 -- expected UID %2, got UID %3").arg(
-                                       QString::number(response.number), QString::number(message->uid()), QString::number(receivedUid)
+                                       QString::number(response.number), QString::number(list->uidAt(number)), QString::number(receivedUid)
                                        ).toUtf8().constData(), response);
         }
-    } else if (! message->uid()) {
+    } else if (! list->uidAt(number)) {
         qDebug() << "FETCH: received a FETCH response for message #" << response.number << "whose UID is not yet known. This sucks.";
         QList<uint> uidsInMailbox;
-        Q_FOREACH(TreeItem *node, list->m_children) {
-            uidsInMailbox << static_cast<TreeItemMessage *>(node)->uid();
+        for (int i = 0; i < list->m_rows.size(); ++i) {
+            uidsInMailbox << list->uidAt(i);
         }
         qDebug() << "UIDs in the mailbox now: " << uidsInMailbox;
     }
@@ -389,15 +407,16 @@ void TreeItemMailbox::handleFetchResponse(Model *const model,
     for (Responses::Fetch::dataType::const_iterator it = response.data.begin(); it != response.data.end(); ++ it) {
         if (it.key() == "UID") {
             // established above
-            Q_ASSERT(static_cast<const Responses::RespData<uint>&>(*(it.value())).data == message->uid());
+            Q_ASSERT(static_cast<const Responses::RespData<uint>&>(*(it.value())).data == list->uidAt(number));
         } else if (it.key() == "FLAGS") {
             // Only emit signals when the flags have actually changed
             QStringList newFlags = model->normalizeFlags(static_cast<const Responses::RespData<QStringList>&>(*(it.value())).data);
-            bool forceChange = !message->m_flagsHandled || (message->m_flags != newFlags);
-            message->setFlags(list, newFlags);
+            bool forceChange = !list->m_rows[number].flagsHandled || (list->flagsAt(number) != newFlags);
+            list->setFlagsAt(number, newFlags);
             if (forceChange) {
                 updatedFlags = true;
-                changedMessage = message;
+                if (message)
+                    changedMessage = message;
             }
         } else if (it.key() == "MODSEQ") {
             quint64 num = static_cast<const Responses::RespData<quint64>&>(*(it.value())).data;
@@ -452,6 +471,54 @@ void TreeItemMailbox::handleFetchResponse(Model *const model,
             const QByteArray &rawHeaders = static_cast<const Responses::RespData<QByteArray>&>(*(it.value())).data;
             message->processAdditionalHeaders(model, rawHeaders);
             changedMessage = message;
+        } else if (it.key().startsWith("BODY[") && it.key().endsWith('>')) {
+            // A chunk of a partially fetched part
+            const int originPos = it.key().lastIndexOf("]<");
+            bool ok = false;
+            const quint64 origin = originPos == -1 ? 0 : it.key().mid(originPos + 2, it.key().size() - originPos - 3).toULongLong(&ok);
+            if (!ok)
+                throw UnknownMessageIndex("Can't parse the origin of a partial BODY[]", response);
+            TreeItemPart *part = partIdToPtr(model, message, it.key().left(originPos + 1));
+            if (!part)
+                throw UnknownMessageIndex("Got a partial BODY[] fetch that did not resolve to any known part", response);
+            const QByteArray &data = static_cast<const Responses::RespData<QByteArray>&>(*(it.value())).data;
+            if (part->fetched() || !part->m_partialChunkRequested || origin != static_cast<quint64>(part->m_partialData.size())) {
+                // An unexpected chunk, perhaps a leftover from before the part got loaded in full
+                continue;
+            }
+            const quint64 requested = part->m_partialChunkRequested;
+            const bool forPreview = part->m_partialChunkForPreview;
+            part->m_partialChunkRequested = 0;
+            part->m_partialChunkForPreview = false;
+            part->m_partialData.append(data);
+            if (static_cast<quint64>(data.size()) < requested) {
+                // The server has sent less than what we asked for, which means that we've got everything now
+                if (!part->fetched()) {
+                    Imap::decodeContentTransferEncoding(part->m_partialData, part->transferEncoding(), part->dataPtr());
+                    part->setFetchStatus(DONE);
+                    if (message->uid()) {
+                        model->cache()->setMsgPart(mailbox(), message->uid(), part->partId(), part->m_data);
+                    }
+                }
+                if (message->uid() && part->m_partialDataSaved) {
+                    model->cache()->forgetMessagePart(mailbox(), message->uid(), part->partId() + ".X-PARTIAL");
+                }
+                part->m_partialData.clear();
+                part->m_partialDataSaved = 0;
+            } else if (!forPreview && message->uid()
+                       && static_cast<quint64>(part->m_partialData.size()) >= 2 * part->m_partialDataSaved) {
+                // Each checkpoint stores the whole prefix, so they have to get exponentially further apart in order not to
+                // write a quadratic amount of data. A chunk which was only asked for because of the preview is not worth
+                // keeping; the preview itself goes to the cache with the rest of the message metadata, and nobody would
+                // ever remove these leftovers for all the messages which are never opened.
+                model->cache()->setMsgPart(mailbox(), message->uid(), part->partId() + ".X-PARTIAL", part->m_partialData);
+                part->m_partialDataSaved = part->m_partialData.size();
+            }
+            changedParts.append(part);
+            if (!message->data()->gotPreview() && message->data()->previewPartId() == part->partId()) {
+                message->setPreviewFromPart(model, part);
+                changedMessage = message;
+            }
         } else if (it.key().startsWith("BODY[") || it.key().startsWith("BINARY[")) {
             if (it.key()[ it.key().size() - 1 ] != ']')
                 throw UnknownMessageIndex("Can't parse such BODY[]/BINARY[]", response);
@@ -498,31 +565,54 @@ void TreeItemMailbox::handleFetchResponse(Model *const model,
                     model->cache()->setMsgPart(mailbox(), message->uid(), part->partId(), part->m_data);
                 }
             }
+            if (part->fetched() && part->m_partialDataSaved) {
+                // Whatever got loaded through the partial fetches before is superseded by the complete data now
+                if (message->uid())
+                    model->cache()->forgetMessagePart(mailbox(), message->uid(), part->partId() + ".X-PARTIAL");
+                part->m_partialData.clear();
+                part->m_partialDataSaved = 0;
+            }
+            if (part->fetched() && !message->data()->gotPreview() && message->data()->previewPartId() == part->partId()) {
+                message->setPreviewFromPart(model, part);
+                changedMessage = message;
+            }
+        } else if (it.key() == "PREVIEW") {
+            // RFC 8970 says that the preview is in UTF-8; a NIL means that the server could not produce any
+            QString preview = QString::fromUtf8(static_cast<const Responses::RespData<QByteArray>&>(*(it.value())).data);
+            if (preview.isNull())
+                preview = QLatin1String("");
+            message->setPreview(model, preview);
+            changedMessage = message;
         } else if (it.key() == "INTERNALDATE") {
             message->data()->setInternalDate(static_cast<const Responses::RespData<QDateTime>&>(*(it.value())).data);
         } else {
             qDebug() << "TreeItemMailbox::handleFetchResponse: unknown FETCH identifier" << it.key();
         }
     }
-    if (message->uid()) {
+    if (message && message->uid()) {
         if (message->data()->isComplete() && model->cache()->messageMetadata(mailbox(), message->uid()).uid == 0) {
-             model->cache()->setMessageMetadata(
-                         mailbox(), message->uid(),
-                         Imap::Mailbox::AbstractCache::MessageDataBundle(
-                             message->uid(),
-                             message->data()->envelope(),
-                             message->data()->internalDate(),
-                             message->data()->size(),
-                             message->data()->rememberedBodyStructure(),
-                             message->data()->hdrReferences(),
-                             message->data()->hdrListPost(),
-                             message->data()->hdrListPostNo()
-                         ));
+             Imap::Mailbox::AbstractCache::MessageDataBundle bundle(
+                         message->uid(),
+                         message->data()->envelope(),
+                         message->data()->internalDate(),
+                         message->data()->size(),
+                         message->data()->rememberedBodyStructure(),
+                         message->data()->hdrReferences(),
+                         message->data()->hdrListPost(),
+                         message->data()->hdrListPostNo()
+                         );
+             bundle.preview = message->data()->preview();
+             bundle.hdrListId = message->data()->hdrListId();
+             model->cache()->setMessageMetadata(mailbox(), message->uid(), bundle);
              message->setFetchStatus(DONE);
         }
-        if (updatedFlags) {
-            model->cache()->setMsgFlags(mailbox(), message->uid(), message->m_flags);
-        }
+    }
+    if (updatedFlags && list->uidAt(number)) {
+        model->cache()->setMsgFlags(mailbox(), list->uidAt(number), list->flagsAt(number));
+    }
+    if (!changedMessage && list->m_unreadMessageCount != oldUnreadCount) {
+        // Nobody is going to announce this on behalf of the message itself
+        model->emitMessageCountChanged(this);
     }
 }
 
@@ -557,25 +647,20 @@ void TreeItemMailbox::handleExpunge(Model *const model, const Responses::NumberR
     Q_ASSERT(resp.kind == Responses::EXPUNGE);
     TreeItemMsgList *list = dynamic_cast<TreeItemMsgList *>(m_children[ 0 ]);
     Q_ASSERT(list);
-    if (resp.number > static_cast<uint>(list->m_children.size()) || resp.number == 0) {
+    if (resp.number > static_cast<uint>(list->m_rows.size()) || resp.number == 0) {
         throw UnknownMessageIndex("EXPUNGE references message number which is out-of-bounds");
     }
     uint offset = resp.number - 1;
 
     model->beginRemoveRows(list->toIndex(model), offset, offset);
-    auto it = list->m_children.begin() + offset;
-    TreeItemMessage *message = static_cast<TreeItemMessage *>(*it);
-    list->m_children.erase(it);
-    model->cache()->clearMessage(static_cast<TreeItemMailbox *>(list->parent())->mailbox(), message->uid());
-    for (int i = offset; i < list->m_children.size(); ++i) {
-        --static_cast<TreeItemMessage *>(list->m_children[i])->m_offset;
-    }
+    const MessageRow message = list->takeRows(offset, 1).front();
+    model->cache()->clearMessage(static_cast<TreeItemMailbox *>(list->parent())->mailbox(), message.uid);
     model->endRemoveRows();
 
     --list->m_totalMessageCount;
     list->recalcVariousMessageCountsOnExpunge(const_cast<Model *>(model), message);
 
-    delete message;
+    delete message.item;
 
     // The UID map is not synced at this time, though, and we defer a decision on when to do this to the context
     // of the task which invoked this method. The idea is that this task has a better insight for potentially
@@ -594,7 +679,6 @@ void TreeItemMailbox::handleVanished(Model *const model, const Responses::Vanish
     // Remove duplicates -- even that garbage can be present in a perfectly valid VANISHED :(
     uids.erase(std::unique(uids.begin(), uids.end()), uids.end());
 
-    auto it = list->m_children.end();
     while (!uids.isEmpty()) {
         // We have to process each UID separately because the UIDs in the mailbox are not necessarily present
         // in a continuous range; zeros might be present
@@ -608,7 +692,7 @@ void TreeItemMailbox::handleVanished(Model *const model, const Responses::Vanish
             break;
         }
 
-        if (list->m_children.isEmpty()) {
+        if (list->m_rows.isEmpty()) {
             // Well, it'd be cool to throw an exception here but VANISHED is free to contain references to UIDs which are not here
             // at all...
             qDebug() << "VANISHED attempted to remove too many messages";
@@ -619,37 +703,35 @@ void TreeItemMailbox::handleVanished(Model *const model, const Responses::Vanish
 
         // Find a highest message with UID zero such as no message with non-zero UID higher than the current UID exists
         // at a position after the target message
-        it = model->findMessageOrNextOneByUid(list, uid);
+        int row = model->findMessageOrNextOneByUid(list, uid);
 
-        if (it == list->m_children.end()) {
+        if (row == list->m_rows.size()) {
             // this is a legitimate situation, the UID of the last message in the mailbox which is getting expunged right now
             // could very well be not know at this point
-            --it;
+            --row;
         }
         // there's a special case above guarding against an empty list
-        Q_ASSERT(it >= list->m_children.begin());
+        Q_ASSERT(row >= 0);
 
-        TreeItemMessage *msgCandidate = static_cast<TreeItemMessage*>(*it);
-        if (msgCandidate->uid() == uid) {
+        if (list->uidAt(row) == uid) {
             // will be deleted
         } else if (resp.earlier == Responses::Vanished::EARLIER) {
             // We don't have any such UID in our UID mapping, so we can safely ignore this one
             continue;
-        } else if (msgCandidate->uid() == 0) {
+        } else if (list->uidAt(row) == 0) {
             // will be deleted
         } else {
-            if (it != list->m_children.begin()) {
-                --it;
-                msgCandidate = static_cast<TreeItemMessage*>(*it);
-                if (msgCandidate->uid() == 0) {
+            if (row > 0) {
+                --row;
+                if (list->uidAt(row) == 0) {
                     // will be deleted
                 } else {
                     // VANISHED is free to refer to a non-existing UID...
                     QString str;
                     QTextStream ss(&str);
                     ss << "VANISHED refers to UID " << uid << " which wasn't found in the mailbox (found adjacent UIDs " <<
-                          msgCandidate->uid() << " and " << static_cast<TreeItemMessage*>(*(it + 1))->uid() << " with " <<
-                          static_cast<TreeItemMessage*>(*(list->m_children.end() - 1))->uid() << " at the end)";
+                          list->uidAt(row) << " and " << list->uidAt(row + 1) << " with " <<
+                          list->uidAt(list->m_rows.size() - 1) << " at the end)";
                     ss.flush();
                     qDebug() << str.toUtf8().constData();
                     model->logTrace(listIndex.parent(), Common::LOG_MAILBOX_SYNC, QStringLiteral("TreeItemMailbox::handleVanished"), str);
@@ -660,7 +742,7 @@ void TreeItemMailbox::handleVanished(Model *const model, const Responses::Vanish
                 QString str;
                 QTextStream ss(&str);
                 ss << "VANISHED refers to UID " << uid << " which is too low (lowest UID is " <<
-                      static_cast<TreeItemMessage*>(list->m_children.front())->uid() << ")";
+                      list->uidAt(0) << ")";
                 ss.flush();
                 qDebug() << str.toUtf8().constData();
                 model->logTrace(listIndex.parent(), Common::LOG_MAILBOX_SYNC, QStringLiteral("TreeItemMailbox::handleVanished"), str);
@@ -668,13 +750,8 @@ void TreeItemMailbox::handleVanished(Model *const model, const Responses::Vanish
             }
         }
 
-        int row = msgCandidate->row();
-        Q_ASSERT(row == it - list->m_children.begin());
         model->beginRemoveRows(listIndex, row, row);
-        it = list->m_children.erase(it);
-        for (auto furtherMessage = it; furtherMessage != list->m_children.end(); ++furtherMessage) {
-            --static_cast<TreeItemMessage *>(*furtherMessage)->m_offset;
-        }
+        const MessageRow message = list->takeRows(row, 1).front();
         model->endRemoveRows();
 
         if (syncState.uidNext() <= uid) {
@@ -683,27 +760,23 @@ void TreeItemMailbox::handleVanished(Model *const model, const Responses::Vanish
             syncState.setUidNext(uid + 1);
         }
         model->cache()->clearMessage(mailbox(), uid);
-        delete msgCandidate;
+        delete message.item;
     }
 
-    if (resp.earlier == Responses::Vanished::EARLIER && static_cast<uint>(list->m_children.size()) < syncState.exists()) {
+    if (resp.earlier == Responses::Vanished::EARLIER && static_cast<uint>(list->m_rows.size()) < syncState.exists()) {
         // Okay, there were some new arrivals which we failed to take into account because we had processed EXISTS
         // before VANISHED (EARLIER). That means that we have to add some of that messages back right now.
-        int newArrivals = syncState.exists() - list->m_children.size();
+        int newArrivals = syncState.exists() - list->m_rows.size();
         Q_ASSERT(newArrivals > 0);
         QModelIndex parent = list->toIndex(model);
-        int offset = list->m_children.size();
+        int offset = list->m_rows.size();
         model->beginInsertRows(parent, offset, syncState.exists() - 1);
-        for (int i = 0; i < newArrivals; ++i) {
-            TreeItemMessage *msg = new TreeItemMessage(list);
-            msg->m_offset = i + offset;
-            list->m_children << msg;
-            // yes, we really have to add this message with UID 0 :(
-        }
+        // yes, we really have to add these messages with UID 0 :(
+        list->appendRows(newArrivals);
         model->endInsertRows();
     }
 
-    list->m_totalMessageCount = list->m_children.size();
+    list->m_totalMessageCount = list->m_rows.size();
     syncState.setExists(list->m_totalMessageCount);
     list->recalcVariousMessageCounts(const_cast<Model *>(model));
 
@@ -725,7 +798,7 @@ void TreeItemMailbox::handleExists(Model *const model, const Responses::NumberRe
     // This is a bit tricky -- unfortunately, we can't assume anything about the UID of new arrivals. On the other hand,
     // these messages can be referenced by (even unrequested) FETCH responses and deleted by EXPUNGE, so we really want
     // to add them to the tree.
-    int newArrivals = resp.number - list->m_children.size();
+    int newArrivals = resp.number - list->m_rows.size();
     if (newArrivals < 0) {
         throw UnexpectedResponseReceived("EXISTS response attempted to decrease number of messages", resp);
     }
@@ -736,22 +809,20 @@ void TreeItemMailbox::handleExists(Model *const model, const Responses::NumberRe
     }
 
     QModelIndex parent = list->toIndex(model);
-    int offset = list->m_children.size();
+    int offset = list->m_rows.size();
     model->beginInsertRows(parent, offset, resp.number - 1);
-    for (int i = 0; i < newArrivals; ++i) {
-        TreeItemMessage *msg = new TreeItemMessage(list);
-        msg->m_offset = i + offset;
-        list->m_children << msg;
-        // yes, we really have to add this message with UID 0 :(
-    }
+    // yes, we really have to add these messages with UID 0 :(
+    list->appendRows(newArrivals);
     model->endInsertRows();
     list->m_totalMessageCount = resp.number;
     list->setFetchStatus(LOADING);
     model->emitMessageCountChanged(this);
 }
 
-TreeItemPart *TreeItemMailbox::partIdToPtr(Model *const model, TreeItemMessage *message, const QByteArray &msgId)
+TreeItemPart *TreeItemMailbox::partIdToPtr(Model *const model, TreeItemMessage *message, const QByteArray &fetchId)
 {
+    // The "<offset.length>" of a partial fetch does not matter when looking for the part
+    QByteArray msgId = fetchId.endsWith('>') ? fetchId.left(fetchId.lastIndexOf('<')) : fetchId;
     QByteArray partIdentification;
     if (msgId.startsWith("BODY[")) {
         partIdentification = msgId.mid(5, msgId.size() - 6);
@@ -812,6 +883,39 @@ bool TreeItemMailbox::isSelectable() const
 
 
 
+namespace {
+
+/** @short Find a string based on d-ptr equality
+
+This works because our flags always use implicit sharing. If they didn't use that, this method wouldn't work.
+*/
+bool containsStringByDPtr(const QStringList &haystack, const QString &needle)
+{
+    const auto sentinel = const_cast<QString&>(needle).data_ptr();
+    Q_FOREACH(const auto &item, haystack) {
+        if (const_cast<QString&>(item).data_ptr() == sentinel)
+            return true;
+    }
+    return false;
+}
+
+/** @short Check the \\Seen and \\Recent flags in one pass */
+void findReadRecentFlags(const QStringList &flags, bool &isRead, bool &isRecent)
+{
+    const auto dRead = const_cast<QString&>(FlagNames::seen).data_ptr();
+    const auto dRecent = const_cast<QString&>(FlagNames::recent).data_ptr();
+    auto end = flags.end();
+    auto it = flags.begin();
+    isRead = isRecent = false;
+    while (it != end && !(isRead && isRecent)) {
+        isRead |= const_cast<QString&>(*it).data_ptr() == dRead;
+        isRecent |= const_cast<QString&>(*it).data_ptr() == dRecent;
+        ++it;
+    }
+}
+
+}
+
 TreeItemMsgList::TreeItemMsgList(TreeItem *parent):
     TreeItem(parent), m_numberFetchingStatus(NONE), m_totalMessageCount(-1),
     m_unreadMessageCount(-1), m_recentMessageCount(-1)
@@ -820,6 +924,96 @@ TreeItemMsgList::TreeItemMsgList(TreeItem *parent):
         setFetchStatus(DONE);
 }
 
+TreeItemMsgList::~TreeItemMsgList()
+{
+    for (auto it = m_rows.constBegin(); it != m_rows.constEnd(); ++it) {
+        delete it->item;
+    }
+}
+
+unsigned int TreeItemMsgList::childrenCount(Model *const model)
+{
+    fetch(model);
+    return m_rows.size();
+}
+
+TreeItem *TreeItemMsgList::child(const int offset, Model *const model)
+{
+    fetch(model);
+    if (offset >= 0 && offset < m_rows.size())
+        return messageAt(offset);
+    else
+        return 0;
+}
+
+/** @short Return the message at the given row, creating its TreeItemMessage when it is needed for the first time */
+TreeItemMessage *TreeItemMsgList::messageAt(const int row)
+{
+    Q_ASSERT(row >= 0 && row < m_rows.size());
+    MessageRow &messageRow = m_rows[row];
+    if (!messageRow.item) {
+        messageRow.item = new TreeItemMessage(this);
+        messageRow.item->m_offset = row;
+    }
+    return messageRow.item;
+}
+
+bool TreeItemMsgList::isMarkedAsReadAt(const int row) const
+{
+    return containsStringByDPtr(m_rows[row].flags, FlagNames::seen);
+}
+
+/** @short Set FLAGS of a message and maintain the unread message counter */
+void TreeItemMsgList::setFlagsAt(const int row, const QStringList &flags)
+{
+    MessageRow &message = m_rows[row];
+    // wasSeen is used to determine if the message was marked as read before this operation
+    bool wasSeen = containsStringByDPtr(message.flags, FlagNames::seen);
+    message.flags = flags;
+    if (m_numberFetchingStatus == DONE) {
+        bool isSeen = containsStringByDPtr(message.flags, FlagNames::seen);
+        if (message.flagsHandled) {
+            if (wasSeen && !isSeen) {
+                ++m_unreadMessageCount;
+                // leave the message as "was unread" so it persists in the view when read messages are hidden
+                message.wasUnread = true;
+            } else if (!wasSeen && isSeen) {
+                --m_unreadMessageCount;
+            }
+        } else {
+            // it's a new message
+            message.flagsHandled = true;
+            if (!isSeen) {
+                ++m_unreadMessageCount;
+                // mark the message as "was unread" so it shows up in the view when read messages are hidden
+                message.wasUnread = true;
+            }
+        }
+    }
+}
+
+/** @short Add messages whose UIDs are not known yet to the end of the list */
+void TreeItemMsgList::appendRows(const int count)
+{
+    m_rows.resize(m_rows.size() + count);
+}
+
+/** @short Remove a range of messages from the list
+
+The caller becomes the owner of the TreeItemMessage instances of the returned rows; they have to be deleted only after
+the model is done with announcing the removal.
+*/
+QVector<MessageRow> TreeItemMsgList::takeRows(const int first, const int count)
+{
+    QVector<MessageRow> removed = m_rows.mid(first, count);
+    m_rows.remove(first, count);
+    for (int i = first; i < m_rows.size(); ++i) {
+        if (m_rows[i].item)
+            m_rows[i].item->m_offset = i;
+    }
+    return removed;
+}
+
 void TreeItemMsgList::fetch(Model *const model)
 {
     if (fetched() || isUnavailable())
@@ -905,24 +1099,23 @@ void TreeItemMsgList::recalcVariousMessageCounts(Model *model)
 {
     m_unreadMessageCount = 0;
     m_recentMessageCount = 0;
-    for (int i = 0; i < m_children.size(); ++i) {
-        TreeItemMessage *message = static_cast<TreeItemMessage *>(m_children[i]);
+    for (auto it = m_rows.begin(); it != m_rows.end(); ++it) {
         bool isRead, isRecent;
-        message->checkFlagsReadRecent(isRead, isRecent);
-        if (!message->m_flagsHandled)
-            message->m_wasUnread = ! isRead;
-        message->m_flagsHandled = true;
+        findReadRecentFlags(it->flags, isRead, isRecent);
+        if (!it->flagsHandled)
+            it->wasUnread = ! isRead;
+        it->flagsHandled = true;
         if (!isRead)
             ++m_unreadMessageCount;
         if (isRecent)
             ++m_recentMessageCount;
     }
-    m_totalMessageCount = m_children.size();
+    m_totalMessageCount = m_rows.size();
     m_numberFetchingStatus = DONE;
     model->emitMessageCountChanged(static_cast<TreeItemMailbox *>(parent()));
 }
 
-void TreeItemMsgList::recalcVariousMessageCountsOnExpunge(Model *model, TreeItemMessage *expungedMessage)
+void TreeItemMsgList::recalcVariousMessageCountsOnExpunge(Model *model, const MessageRow &expungedMessage)
 {
     if (m_numberFetchingStatus != DONE) {
         // In case the counts weren't synced before, we cannot really rely on them now -> go to the slow path
@@ -931,8 +1124,8 @@ void TreeItemMsgList::recalcVariousMessageCountsOnExpunge(Model *model, TreeItem
     }
 
     bool isRead, isRecent;
-    expungedMessage->checkFlagsReadRecent(isRead, isRecent);
-    if (expungedMessage->m_flagsHandled) {
+    findReadRecentFlags(expungedMessage.flags, isRead, isRecent);
+    if (expungedMessage.flagsHandled) {
         if (!isRead)
             --m_unreadMessageCount;
         if (isRecent)
@@ -943,9 +1136,8 @@ void TreeItemMsgList::recalcVariousMessageCountsOnExpunge(Model *model, TreeItem
 
 void TreeItemMsgList::resetWasUnreadState()
 {
-    for (int i = 0; i < m_children.size(); ++i) {
-        TreeItemMessage *message = static_cast<TreeItemMessage *>(m_children[i]);
-        message->m_wasUnread = ! message->isMarkedAsRead();
+    for (auto it = m_rows.begin(); it != m_rows.end(); ++it) {
+        it->wasUnread = ! containsStringByDPtr(it->flags, FlagNames::seen);
     }
 }
 
@@ -967,6 +1159,7 @@ MessageDataPayload::MessageDataPayload()
     , m_gotBodystructure(false)
     , m_gotHdrReferences(false)
     , m_gotHdrListPost(false)
+    , m_previewRequested(false)
 {
 }
 
@@ -1008,9 +1201,16 @@ const Message::Envelope &MessageDataPayload::envelope() const
 void MessageDataPayload::setEnvelope(const Message::Envelope &envelope)
 {
     m_envelope = envelope;
+    m_normalizedSubject = baseSubject(envelope.subject);
     m_gotEnvelope = true;
 }
 
+/** @short The base subject as per RFC 5256, computed just once when the envelope arrives */
+const QString &MessageDataPayload::normalizedSubject() const
+{
+    return m_normalizedSubject;
+}
+
 const QDateTime &MessageDataPayload::internalDate() const
 {
     return m_internalDate;
@@ -1066,6 +1266,16 @@ void MessageDataPayload::setHdrListPostNo(const bool hdrListPostNo)
     m_gotHdrListPost = true;
 }
 
+const QByteArray &MessageDataPayload::hdrListId() const
+{
+    return m_hdrListId;
+}
+
+void MessageDataPayload::setHdrListId(const QByteArray &hdrListId)
+{
+    m_hdrListId = hdrListId;
+}
+
 const QByteArray &MessageDataPayload::rememberedBodyStructure() const
 {
     return m_rememberedBodyStructure;
@@ -1082,6 +1292,44 @@ bool MessageDataPayload::gotRemeberedBodyStructure() const
     return m_gotBodystructure;
 }
 
+/** @short The preview is known when it is not null; an empty preview means that there's nothing to show */
+bool MessageDataPayload::gotPreview() const
+{
+    return !m_preview.isNull();
+}
+
+const QString &MessageDataPayload::preview() const
+{
+    return m_preview;
+}
+
+void MessageDataPayload::setPreview(const QString &preview)
+{
+    Q_ASSERT(!preview.isNull());
+    m_preview = preview;
+    m_previewPartId.clear();
+}
+
+bool MessageDataPayload::previewRequested() const
+{
+    return m_previewRequested;
+}
+
+void MessageDataPayload::setPreviewRequested(const bool requested)
+{
+    m_previewRequested = requested;
+}
+
+const QByteArray &MessageDataPayload::previewPartId() const
+{
+    return m_previewPartId;
+}
+
+void MessageDataPayload::setPreviewPartId(const QByteArray &partId)
+{
+    m_previewPartId = partId;
+}
+
 TreeItemPart *MessageDataPayload::partHeader() const
 {
     return m_partHeader.get();
@@ -1104,7 +1352,7 @@ void MessageDataPayload::setPartText(std::unique_ptr<TreeItemPart> part)
 
 
 TreeItemMessage::TreeItemMessage(TreeItem *parent):
-    TreeItem(parent), m_offset(-1), m_uid(0), m_data(0), m_flagsHandled(false), m_wasUnread(false)
+    TreeItem(parent), m_offset(-1), m_data(0)
 {
 }
 
@@ -1118,7 +1366,7 @@ void TreeItemMessage::fetch(Model *const model)
     if (fetched() || loading() || isUnavailable())
         return;
 
-    if (m_uid) {
+    if (uid()) {
         // Message UID is already known, which means that we can request data for this message
         model->askForMsgMetadata(this, Model::PRELOAD_PER_POLICY);
     } else {
@@ -1201,14 +1449,14 @@ QVariant TreeItemMessage::data(Model *const model, int role)
     // Special item roles which should not trigger fetching of message metadata
     switch (role) {
     case RoleMessageUid:
-        return m_uid ? QVariant(m_uid) : QVariant();
+        return uid() ? QVariant(uid()) : QVariant();
     case RoleIsFetched:
         return fetched();
     case RoleIsUnavailable:
         return isUnavailable();
     case RoleMessageFlags:
         // The flags are already sorted by Model::normalizeFlags()
-        return m_flags;
+        return flags();
     case RoleMessageIsMarkedDeleted:
         return isMarkedAsDeleted();
     case RoleMessageIsMarkedRead:
@@ -1253,7 +1501,10 @@ QVariant TreeItemMessage::data(Model *const model, int role)
                       "For valid specifiers see http://doc.qt.io/qt-5/qdate.html#toString"));
     }
     case RoleMessageWasUnread:
-        return m_wasUnread;
+    {
+        const MessageRow *row = messageRow();
+        return row && row->wasUnread;
+    }
     case RoleThreadRootWithUnreadMessages:
         // This one doesn't really make much sense here, but we do want to catch it to prevent a fetch request from this context
         qDebug() << "Warning: asked for RoleThreadRootWithUnreadMessages on TreeItemMessage. This does not make sense.";
@@ -1264,10 +1515,10 @@ QVariant TreeItemMessage::data(Model *const model, int role)
     case RolePartMimeType:
         return QByteArrayLiteral("message/rfc822");
     case RoleIMAPRelativeUrl:
-        if (m_uid) {
+        if (uid()) {
             return QByteArray("/" + QUrl::toPercentEncoding(data(model, RoleMailboxName).toString())
                               + ";UIDVALIDITY=" + data(model, RoleMailboxUidValidity).toByteArray()
-                              + "/;UID=" + QByteArray::number(m_uid));
+                              + "/;UID=" + QByteArray::number(uid()));
         } else {
             return QVariant();
         }
@@ -1311,6 +1562,13 @@ QVariant TreeItemMessage::data(Model *const model, int role)
         }
     case RoleMessageHeaderListPostNo:
         return data()->gotHdrListPost() ? QVariant(data()->hdrListPostNo()) : QVariant();
+    case RoleMessageHeaderListId:
+        // The List-Id is fetched along with the References
+        return data()->gotHdrReferences() ? QVariant(data()->hdrListId()) : QVariant();
+    case RoleMessagePreview:
+        if (!data()->gotPreview())
+            model->askForMsgPreview(this);
+        return data()->gotPreview() ? QVariant(data()->preview()) : QVariant();
     }
 
     if (data()->gotEnvelope()) {
@@ -1320,6 +1578,8 @@ QVariant TreeItemMessage::data(Model *const model, int role)
         switch (role) {
         case RoleMessageSubject:
             return data()->gotEnvelope() ? QVariant(data()->envelope().subject) : QVariant();
+        case RoleMessageNormalizedSubject:
+            return data()->normalizedSubject();
         case RoleMessageDate:
             return data()->gotEnvelope() ? envelope(model).date : QVariant();
         case RoleMessageFrom:
@@ -1358,81 +1618,71 @@ QVariantList TreeItemMessage::addresListToQVariant(const QList<Imap::Message::Ma
 }
 
 
-namespace {
-
-/** @short Find a string based on d-ptr equality
-
-This works because our flags always use implicit sharing. If they didn't use that, this method wouldn't work.
-*/
-bool containsStringByDPtr(const QStringList &haystack, const QString &needle)
-{
-    const auto sentinel = const_cast<QString&>(needle).data_ptr();
-    Q_FOREACH(const auto &item, haystack) {
-        if (const_cast<QString&>(item).data_ptr() == sentinel)
-            return true;
-    }
-    return false;
-}
-
-}
-
 bool TreeItemMessage::isMarkedAsDeleted() const
 {
-    return containsStringByDPtr(m_flags, FlagNames::deleted);
+    return containsStringByDPtr(flags(), FlagNames::deleted);
 }
 
 bool TreeItemMessage::isMarkedAsRead() const
 {
-    return containsStringByDPtr(m_flags, FlagNames::seen);
+    return containsStringByDPtr(flags(), FlagNames::seen);
 }
 
 bool TreeItemMessage::isMarkedAsReplied() const
 {
-    return containsStringByDPtr(m_flags, FlagNames::answered);
+    return containsStringByDPtr(flags(), FlagNames::answered);
 }
 
 bool TreeItemMessage::isMarkedAsForwarded() const
 {
-    return containsStringByDPtr(m_flags, FlagNames::forwarded);
+    return containsStringByDPtr(flags(), FlagNames::forwarded);
 }
 
 bool TreeItemMessage::isMarkedAsRecent() const
 {
-    return containsStringByDPtr(m_flags, FlagNames::recent);
+    return containsStringByDPtr(flags(), FlagNames::recent);
 }
 
 bool TreeItemMessage::isMarkedAsFlagged() const
 {
-    return containsStringByDPtr(m_flags, FlagNames::flagged);
+    return containsStringByDPtr(flags(), FlagNames::flagged);
 }
 
 bool TreeItemMessage::isMarkedAsJunk() const
 {
-    return containsStringByDPtr(m_flags, FlagNames::junk);
+    return containsStringByDPtr(flags(), FlagNames::junk);
 }
 
 bool TreeItemMessage::isMarkedAsNotJunk() const
 {
-    return containsStringByDPtr(m_flags, FlagNames::notjunk);
+    return containsStringByDPtr(flags(), FlagNames::notjunk);
 }
 
 void TreeItemMessage::checkFlagsReadRecent(bool &isRead, bool &isRecent) const
 {
-    const auto dRead = const_cast<QString&>(FlagNames::seen).data_ptr();
-    const auto dRecent = const_cast<QString&>(FlagNames::recent).data_ptr();
-    auto end = m_flags.end();
-    auto it = m_flags.begin();
-    isRead = isRecent = false;
-    while (it != end && !(isRead && isRecent)) {
-        isRead |= const_cast<QString&>(*it).data_ptr() == dRead;
-        isRecent |= const_cast<QString&>(*it).data_ptr() == dRecent;
-        ++it;
-    }
+    findReadRecentFlags(flags(), isRead, isRecent);
+}
+
+/** @short The record which holds the UID and the flags of this message, or nullptr if the message is no longer in the list */
+const MessageRow *TreeItemMessage::messageRow() const
+{
+    const TreeItemMsgList *list = static_cast<const TreeItemMsgList *>(parent());
+    if (!list || m_offset < 0 || m_offset >= list->m_rows.size() || list->m_rows[m_offset].item != this)
+        return 0;
+    return &list->m_rows[m_offset];
 }
 
 uint TreeItemMessage::uid() const
 {
-    return m_uid;
+    const MessageRow *row = messageRow();
+    return row ? row->uid : 0;
+}
+
+const QStringList &TreeItemMessage::flags() const
+{
+    static const QStringList noFlags;
+    const MessageRow *row = messageRow();
+    return row ? row->flags : noFlags;
 }
 
 Message::Envelope TreeItemMessage::envelope(Model *const model)
@@ -1453,33 +1703,6 @@ quint64 TreeItemMessage::size(Model *const model)
     return data()->size();
 }
 
-void TreeItemMessage::setFlags(TreeItemMsgList *list, const QStringList &flags)
-{
-    // wasSeen is used to determine if the message was marked as read before this operation
-    bool wasSeen = isMarkedAsRead();
-    m_flags = flags;
-    if (list->m_numberFetchingStatus == DONE) {
-        bool isSeen = isMarkedAsRead();
-        if (m_flagsHandled) {
-            if (wasSeen && !isSeen) {
-                ++list->m_unreadMessageCount;
-                // leave the message as "was unread" so it persists in the view when read messages are hidden
-                m_wasUnread = true;
-            } else if (!wasSeen && isSeen) {
-                --list->m_unreadMessageCount;
-            }
-        } else {
-            // it's a new message
-            m_flagsHandled = true;
-            if (!isSeen) {
-                ++list->m_unreadMessageCount;
-                // mark the message as "was unread" so it shows up in the view when read messages are hidden
-                m_wasUnread = true;
-            }
-        }
-    }
-}
-
 /** @short Process the data found in the headers passed along and file in auxiliary metadata
 
 This function accepts a snippet containing some RFC5322 headers of a message, no matter what headers are actually
@@ -1507,6 +1730,48 @@ void TreeItemMessage::processAdditionalHeaders(Model *model, const QByteArray &r
     // This is because we absolutely want to support incremental header arrival.
     if (parser.listPostNo)
         data()->setHdrListPostNo(true);
+    QByteArray listId = Imap::LowLevelParser::extractListId(rawHeaders);
+    if (!listId.isEmpty())
+        data()->setHdrListId(listId);
+}
+
+/** @short Remember the preview of this message and make sure that it is saved along with the rest of the metadata */
+void TreeItemMessage::setPreview(Model *const model, const QString &preview)
+{
+    data()->setPreview(preview);
+    const uint uid = this->uid();
+    if (!uid)
+        return;
+
+    // If the metadata have not been saved yet, the preview will be stored along with them
+    TreeItemMailbox *mailbox = static_cast<TreeItemMailbox *>(parent()->parent());
+    AbstractCache::MessageDataBundle bundle = model->cache()->messageMetadata(mailbox->mailbox(), uid);
+    if (bundle.uid == uid && bundle.preview != preview) {
+        bundle.preview = preview;
+        model->cache()->setMessageMetadata(mailbox->mailbox(), uid, bundle);
+    }
+}
+
+/** @short Build the preview from whatever data of the main text part are available
+
+This is a fallback for servers without support for RFC 8970. Quoted text and signatures are skipped because they do not
+say much about what's new in this message, and the result is limited to 256 characters like the server-side one would be.
+*/
+void TreeItemMessage::setPreviewFromPart(Model *const model, TreeItemPart *part)
+{
+    const QString text = decodeByteArray(part->fetched() ? part->m_data : part->decodedPartialData(), part->charset());
+    QStringList lines;
+    Q_FOREACH(const QString &line, text.split(QLatin1Char('\n'))) {
+        if (line == QLatin1String("-- ") || line == QLatin1String("-- \r"))
+            break;
+        if (line.startsWith(QLatin1Char('>')))
+            continue;
+        lines << line;
+    }
+    QString preview = lines.join(QLatin1Char(' ')).simplified().left(256);
+    if (preview.isNull())
+        preview = QLatin1String("");
+    setPreview(model, preview);
 }
 
 bool TreeItemMessage::hasAttachments(Model *const model)
@@ -1571,6 +1836,10 @@ TreeItemPart::TreeItemPart(TreeItem *parent, const QByteArray &mimeType)
     , m_partMime(nullptr)
     , m_partRaw(nullptr)
     , m_binaryCTEFailed(false)
+    , m_partialChunkRequested(0)
+    , m_partialDataSaved(0)
+    , m_partialChunkForPreview(false)
+    , m_fetchingInBackground(false)
 {
 }
 
@@ -1581,6 +1850,10 @@ TreeItemPart::TreeItemPart(TreeItem *parent)
     , m_partMime(nullptr)
     , m_partRaw(nullptr)
     , m_binaryCTEFailed(false)
+    , m_partialChunkRequested(0)
+    , m_partialDataSaved(0)
+    , m_partialChunkForPreview(false)
+    , m_fetchingInBackground(false)
 {
 }
 
@@ -1615,7 +1888,16 @@ TreeItemChildrenList TreeItemPart::setChildren(const TreeItemChildrenList &items
 
 void TreeItemPart::fetch(Model *const model)
 {
-    if (fetched() || loading() || isUnavailable())
+    if (loading()) {
+        // Somebody is waiting for the data now, so a request which was queued as a background one has to hurry up
+        if (m_fetchingInBackground) {
+            m_fetchingInBackground = false;
+            model->raiseMsgPartPriority(this);
+        }
+        return;
+    }
+
+    if (fetched() || isUnavailable())
         return;
 
     if (isTopLevelMultiPart()) {
@@ -1626,9 +1908,26 @@ void TreeItemPart::fetch(Model *const model)
     }
 
     setFetchStatus(LOADING);
+    m_fetchingInBackground = false;
     model->askForMsgPart(this);
 }
 
+/** @short Request the part's data with a low priority, see RolePartPrefetch */
+void TreeItemPart::fetchInBackground(Model *const model)
+{
+    if (fetched() || loading() || isUnavailable())
+        return;
+
+    if (isTopLevelMultiPart()) {
+        setFetchStatus(DONE);
+        return;
+    }
+
+    setFetchStatus(LOADING);
+    m_fetchingInBackground = true;
+    model->askForMsgPart(this, false, TaskPriority::BACKGROUND);
+}
+
 void TreeItemPart::fetchFromCache(Model *const model)
 {
     if (fetched() || loading() || isUnavailable())
@@ -1694,8 +1993,21 @@ QVariant TreeItemPart::data(Model *const model, int role)
     case RolePartForceFetchFromCache:
         fetchFromCache(model);
         return QVariant();
+    case RolePartPrefetch:
+        fetchInBackground(model);
+        return QVariant();
     case RolePartBufferPtr:
         return QVariant::fromValue(dataPtr());
+    case RolePartLoadNextChunk:
+        model->askForMsgPartChunk(this, Model::PARTIAL_NEXT_CHUNK);
+        return QVariant();
+    case RolePartLoadRemainingChunks:
+        model->askForMsgPartChunk(this, Model::PARTIAL_REMAINING);
+        return QVariant();
+    case RolePartPartialData:
+        return fetched() ? m_data : decodedPartialData();
+    case RolePartPartialOctets:
+        return QVariant::fromValue<quint64>(fetched() ? m_octets : m_partialData.size());
     case RolePartBodyFldParam:
         return QVariant::fromValue(m_bodyFldParam);
     case RoleIMAPRelativeUrl:
@@ -1789,6 +2101,31 @@ QByteArray TreeItemPart::partIdForFetch(const PartFetchingMode mode) const
     return QByteArray(mode == FETCH_PART_BINARY ? "BINARY" : "BODY") + ".PEEK[" + partId() + "]";
 }
 
+/** @short Identification of a part for fetching a chunk of its raw data, see RFC 3501's "partial" */
+QByteArray TreeItemPart::partIdForPartialFetch(const quint64 offset, const quint64 length) const
+{
+    return partIdForFetch(FETCH_PART_IMAP) + '<' + QByteArray::number(offset) + '.' + QByteArray::number(length) + '>';
+}
+
+/** @short Undo the CTE of the data which were received through partial fetches so far */
+QByteArray TreeItemPart::decodedPartialData() const
+{
+    if (m_partialData.isEmpty())
+        return QByteArray();
+
+    QByteArray raw = m_partialData;
+    if (m_transferEncoding == "quoted-printable") {
+        // The chunk boundary might have split an escape sequence, so let's not feed a truncated one to the decoder.
+        // The base64 decoder does not need any help because it only emits complete octets.
+        int pos = raw.lastIndexOf('=');
+        if (pos != -1 && pos >= raw.size() - 2)
+            raw.truncate(pos);
+    }
+    QByteArray res;
+    Imap::decodeContentTransferEncoding(raw, m_transferEncoding, &res);
+    return res;
+}
+
 QByteArray TreeItemPart::pathToPart() const
 {
     TreeItemPart *part = dynamic_cast<TreeItemPart *>(parent());
@@ -1869,6 +2206,11 @@ void TreeItemPart::silentlyReleaseMemoryRecursive()
         m_partRaw = 0;
     }
     m_data.clear();
+    m_partialData.clear();
+    m_partialChunkRequested = 0;
+    m_partialDataSaved = 0;
+    m_partialChunkForPreview = false;
+    m_fetchingInBackground = false;
     setFetchStatus(NONE);
     qDeleteAll(m_children);
     m_children.clear();
@@ -1990,8 +2332,11 @@ QVariant TreeItemPartMultipartMessage::data(Model * const model, int role)
     case RoleMessageHeaderReferences:
     case RoleMessageHeaderListPost:
     case RoleMessageHeaderListPostNo:
+    case RoleMessageHeaderListId:
         // FIXME: implement me; TreeItemPart has no path for this
         return QVariant();
+    case RoleMessageNormalizedSubject:
+        return baseSubject(m_envelope.subject);
     default:
         return TreeItemPart::data(model, role);
     }
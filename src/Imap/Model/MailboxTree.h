@@ -28,6 +28,8 @@
 #include <QModelIndex>
 #include <QPointer>
 #include <QString>
+#include <QStringList>
+#include <QVector>
 #include "../Parser/Response.h"
 #include "../Parser/Message.h"
 #include "MailboxMetadata.h"
@@ -55,6 +57,7 @@ class TreeItem
     friend class MsgListModel; // for direct access to m_children
     friend class ThreadingMsgListModel; // for direct access to m_children
     friend class UpdateFlagsOfAllMessagesTask; // for direct access to m_children
+    friend class UpdateFlagsTask; // for direct access to m_children
     friend class FetchMsgPartTask; // for direct access to m_children
 
 protected:
@@ -132,6 +135,35 @@ public:
 class TreeItemPart;
 class TreeItemMessage;
 
+/** @short Whatever has to be known about each message in a mailbox, even about those which nobody has looked at yet
+
+The TreeItemMessage is only created when somebody actually asks for it; huge mailboxes are therefore represented by a compact
+array of these records, and the full tree items exist only for the messages which are shown or otherwise worked with.
+*/
+struct MessageRow {
+    /** @short The corresponding tree item, or nullptr if it hasn't been needed yet */
+    TreeItemMessage *item;
+    /** @short UID of the message, or zero if not known yet */
+    uint uid;
+    /** @short Have the flags of this message been accounted for in the message counts? */
+    bool flagsHandled;
+    /** @short Was the message unread when the list was shown? */
+    bool wasUnread;
+    /** @short Message flags, always passed through Model::normalizeFlags() */
+    QStringList flags;
+    MessageRow(): item(0), uid(0), flagsHandled(false), wasUnread(false) {}
+};
+
+}
+}
+
+Q_DECLARE_TYPEINFO(Imap::Mailbox::MessageRow, Q_MOVABLE_TYPE);
+
+namespace Imap
+{
+namespace Mailbox
+{
+
 class TreeItemMailbox: public TreeItem
 {
     void operator=(const TreeItem &);  // don't implement
@@ -213,9 +245,14 @@ class TreeItemMsgList: public TreeItem
     int m_totalMessageCount;
     int m_unreadMessageCount;
     int m_recentMessageCount;
+    /** @short All messages in this mailbox; the TreeItemMessage instances are created lazily, see messageAt() */
+    QVector<MessageRow> m_rows;
 public:
     explicit TreeItemMsgList(TreeItem *parent);
+    ~TreeItemMsgList();
 
+    virtual unsigned int childrenCount(Model *const model);
+    virtual TreeItem *child(const int offset, Model *const model);
     virtual void fetch(Model *const model);
     virtual unsigned int rowCount(Model *const model);
     virtual QVariant data(Model *const model, int role);
@@ -226,9 +263,22 @@ public:
     int recentMessageCount(Model *const model);
     void fetchNumbers(Model *const model);
     void recalcVariousMessageCounts(Model *model);
-    void recalcVariousMessageCountsOnExpunge(Model *model, TreeItemMessage *expungedMessage);
+    void recalcVariousMessageCountsOnExpunge(Model *model, const MessageRow &expungedMessage);
     void resetWasUnreadState();
     bool numbersFetched() const;
+
+    /** @short Number of messages in the list, without triggering any fetching */
+    int messageRowCount() const { return m_rows.size(); }
+    uint uidAt(const int row) const { return m_rows[row].uid; }
+    const QStringList &flagsAt(const int row) const { return m_rows[row].flags; }
+    bool isMarkedAsReadAt(const int row) const;
+    bool wasUnreadAt(const int row) const { return m_rows[row].wasUnread; }
+    TreeItemMessage *messageAt(const int row);
+    /** @short The TreeItemMessage at the given row, or nullptr if it has never been needed */
+    TreeItemMessage *existingMessageAt(const int row) const { return m_rows[row].item; }
+    void setFlagsAt(const int row, const QStringList &flags);
+    void appendRows(const int count);
+    QVector<MessageRow> takeRows(const int first, const int count);
 };
 
 class MessageDataPayload
@@ -248,8 +298,17 @@ public:
     void setHdrListPost(const QList<QUrl> &hdrListPost);
     bool hdrListPostNo() const;
     void setHdrListPostNo(const bool hdrListPostNo);
+    const QByteArray &hdrListId() const;
+    void setHdrListId(const QByteArray &hdrListId);
+    const QString &normalizedSubject() const;
     const QByteArray &rememberedBodyStructure() const;
     void setRememberedBodyStructure(const QByteArray &blob);
+    const QString &preview() const;
+    void setPreview(const QString &preview);
+    bool previewRequested() const;
+    void setPreviewRequested(const bool requested);
+    const QByteArray &previewPartId() const;
+    void setPreviewPartId(const QByteArray &partId);
 
     TreeItemPart *partHeader() const;
     void setPartHeader(std::unique_ptr<TreeItemPart> part);
@@ -264,6 +323,7 @@ public:
     bool gotHdrReferences() const;
     bool gotHdrListPost() const;
     bool gotRemeberedBodyStructure() const;
+    bool gotPreview() const;
 
 private:
     Message::Envelope m_envelope;
@@ -271,7 +331,12 @@ private:
     quint64 m_size;
     QList<QByteArray> m_hdrReferences;
     QList<QUrl> m_hdrListPost;
+    QByteArray m_hdrListId;
+    QString m_normalizedSubject;
     QByteArray m_rememberedBodyStructure;
+    QString m_preview;
+    /** @short Part whose partial data are being fetched for building the preview */
+    QByteArray m_previewPartId;
     bool m_hdrListPostNo;
     std::unique_ptr<TreeItemPart> m_partHeader;
     std::unique_ptr<TreeItemPart> m_partText;
@@ -282,6 +347,7 @@ private:
     bool m_gotBodystructure : 1;
     bool m_gotHdrReferences : 1;
     bool m_gotHdrListPost : 1;
+    bool m_previewRequested : 1;
 };
 
 class TreeItemMessage: public TreeItem
@@ -292,18 +358,12 @@ class TreeItemMessage: public TreeItem
     friend class Model;
     friend class ObtainSynchronizedMailboxTask; // needs access to m_offset
     friend class KeepMailboxOpenTask; // needs access to m_offset
-    friend class ThreadingMsgListModel; // needs access to m_flags
-    friend class UpdateFlagsTask; // needs access to m_flags
-    friend class UpdateFlagsOfAllMessagesTask; // needs access to m_flags
     int m_offset;
-    uint m_uid;
     mutable MessageDataPayload *m_data;
-    QStringList m_flags;
-    bool m_flagsHandled;
-    bool m_wasUnread;
-    /** @short Set FLAGS and maintain the unread message counter */
-    void setFlags(TreeItemMsgList *list, const QStringList &flags);
+    const MessageRow *messageRow() const;
     void processAdditionalHeaders(Model *model, const QByteArray &rawHeaders);
+    void setPreview(Model *const model, const QString &preview);
+    void setPreviewFromPart(Model *const model, TreeItemPart *part);
     static bool hasNestedAttachments(Model *const model, TreeItemPart *part);
 
     MessageDataPayload *data() const
@@ -335,6 +395,7 @@ public:
     bool isMarkedAsNotJunk() const;
     void checkFlagsReadRecent(bool &isRead, bool &isRecent) const;
     uint uid() const;
+    const QStringList &flags() const;
     virtual TreeItem *specialColumnPtr(int row, int column) const;
     bool hasAttachments(Model *const model);
 
@@ -346,7 +407,8 @@ class TreeItemPart: public TreeItem
     void operator=(const TreeItem &);  // don't implement
     friend class TreeItemMailbox; // needs access to m_data
     friend class Model; // dtto
-    friend class FetchMsgPartTask; // needs m_binaryCTEFailed
+    friend class FetchMsgPartTask; // needs m_binaryCTEFailed and m_partialChunkRequested
+    friend class TreeItemMessage; // needs access to m_data and the partial data for building previews
     QByteArray m_mimeType;
     QByteArray m_charset;
     QByteArray m_contentFormat;
@@ -362,6 +424,16 @@ class TreeItemPart: public TreeItem
     mutable TreeItemPart *m_partMime;
     mutable TreeItemPart *m_partRaw;
     bool m_binaryCTEFailed;
+    /** @short Raw data, prior to the CTE decoding, which were loaded via partial fetches so far */
+    QByteArray m_partialData;
+    /** @short Size of the currently requested chunk of m_partialData, or zero if no chunk is being loaded */
+    quint64 m_partialChunkRequested;
+    /** @short How many bytes of m_partialData are already in the cache */
+    quint64 m_partialDataSaved;
+    /** @short Is the currently requested chunk only needed for building a preview of the message? */
+    bool m_partialChunkForPreview;
+    /** @short Was the pending download requested with a low priority which can still be raised? */
+    bool m_fetchingInBackground;
 public:
     TreeItemPart(TreeItem *parent, const QByteArray &mimeType);
     ~TreeItemPart();
@@ -372,6 +444,7 @@ public:
 
     virtual void fetchFromCache(Model *const model);
     virtual void fetch(Model *const model);
+    void fetchInBackground(Model *const model);
     virtual unsigned int rowCount(Model *const model);
     virtual unsigned int columnCount();
     virtual QVariant data(Model *const model, int role);
@@ -388,6 +461,7 @@ public:
     } PartFetchingMode;
 
     virtual QByteArray partIdForFetch(const PartFetchingMode fetchingMode) const;
+    QByteArray partIdForPartialFetch(const quint64 offset, const quint64 length) const;
     virtual QByteArray pathToPart() const;
     TreeItemMessage *message() const;
 
@@ -425,6 +499,8 @@ public:
     virtual void silentlyReleaseMemoryRecursive();
 protected:
     TreeItemPart(TreeItem *parent);
+private:
+    QByteArray decodedPartialData() const;
 };
 
 /** @short A message part with a modifier
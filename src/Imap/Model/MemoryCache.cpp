@@ -119,6 +119,18 @@ void MemoryCache::forgetMessagePart(const QString &mailbox, const uint uid, cons
 
 }
 
+void MemoryCache::copyMessageParts(const QString &srcMailbox, const uint srcUid, const QString &dstMailbox, const uint dstUid)
+{
+#ifdef CACHE_DEBUG
+    qDebug() << "copy message parts" << srcMailbox << srcUid << dstMailbox << dstUid;
+#endif
+    if (!parts.contains(srcMailbox) || !parts[srcMailbox].contains(srcUid))
+        return;
+    // The QByteArrays are implicitly shared, so this doesn't duplicate the actual data
+    const auto srcParts = parts[srcMailbox][srcUid];
+    parts[dstMailbox][dstUid] = srcParts;
+}
+
 void MemoryCache::setMsgFlags(const QString &mailbox, uint uid, const QStringList &newFlags)
 {
 #ifdef CACHE_DEBUG
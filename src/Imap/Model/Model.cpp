@@ -25,11 +25,14 @@
 #include <QAuthenticator>
 #include <QCoreApplication>
 #include <QDebug>
+#include <QMetaMethod>
 #include <QtAlgorithms>
+#include "configure.cmake.h"
 #include "Model.h"
 #include "Common/FindWithUnknown.h"
 #include "Common/InvokeMethod.h"
 #include "Imap/Encoders.h"
+#include "Imap/Model/FindInterestingPart.h"
 #include "Imap/Model/ItemRoles.h"
 #include "Imap/Model/MailboxTree.h"
 #include "Imap/Model/SpecialFlagNames.h"
@@ -82,20 +85,26 @@ bool MailboxNameComparator(const TreeItem *const a, const TreeItem *const b)
     return mailboxA->mailbox().compare(mailboxB->mailbox(), Qt::CaseInsensitive) < 1;
 }
 
-bool uidComparator(const TreeItem *const item, const uint uid)
+bool uidComparator(const MessageRow &message, const uint uid)
 {
-    const TreeItemMessage *const message = static_cast<const TreeItemMessage *const>(item);
-    uint messageUid = message->uid();
-    Q_ASSERT(messageUid);
-    return messageUid < uid;
+    Q_ASSERT(message.uid);
+    return message.uid < uid;
 }
 
-bool messageHasUidZero(const TreeItem *const item)
+bool messageHasUidZero(const MessageRow &message)
 {
-    const TreeItemMessage *const message = static_cast<const TreeItemMessage *const>(item);
-    return message->uid() == 0;
+    return message.uid == 0;
 }
 
+/** @short Size of the first chunk of a progressively loaded message part; it should be enough to fill the first screen */
+const quint64 partialFetchFirstChunkSize = 64 * 1024;
+/** @short Size of the subsequent chunks of a progressively loaded message part */
+const quint64 partialFetchChunkSize = 256 * 1024;
+/** @short How much of the main text part to fetch when the server cannot provide a preview through RFC 8970 */
+const quint64 partialFetchPreviewSize = 1024;
+/** @short How many distinct flag combinations to share among messages, see Model::normalizeFlags() */
+const int maxSharedFlagLists = 1000;
+
 }
 
 namespace Imap
@@ -113,6 +122,8 @@ Model::Model(QObject *parent, std::shared_ptr<AbstractCache> cache, SocketFactor
     , m_netPolicy(NETWORK_OFFLINE)
     , m_taskModel(nullptr)
     , m_hasImapPassword(PasswordAvailability::NOT_REQUESTED)
+    , m_viewportGeneration(0)
+    , m_materializedMessagesLimit(2000)
 {
     m_startTls = m_socketFactory->startTlsRequired();
 
@@ -820,7 +831,7 @@ void Model::askForMessagesInMailbox(TreeItemMsgList *item)
 
     QString mailbox = mailboxPtr->mailbox();
 
-    Q_ASSERT(item->m_children.size() == 0);
+    Q_ASSERT(item->m_rows.isEmpty());
 
     auto uidMapping = cache()->uidMapping(mailbox);
     auto oldSyncState = cache()->mailboxSyncState(mailbox);
@@ -835,20 +846,20 @@ void Model::askForMessagesInMailbox(TreeItemMsgList *item)
         // Nothing in the cache
         item->setFetchStatus(TreeItem::UNAVAILABLE);
     } else if (oldSyncState.isUsableForSyncing()) {
-        // We can pre-populate the tree with data from cache
-        Q_ASSERT(item->m_children.isEmpty());
+        // We can pre-populate the tree with data from cache. Only the UIDs and flags are loaded; the messages themselves
+        // are created once somebody asks for them.
+        Q_ASSERT(item->m_rows.isEmpty());
         Q_ASSERT(item->accessFetchStatus() == TreeItem::LOADING);
         QModelIndex listIndex = item->toIndex(this);
         if (uidMapping.size()) {
             beginInsertRows(listIndex, 0, uidMapping.size() - 1);
-            for (uint seq = 0; seq < static_cast<uint>(uidMapping.size()); ++seq) {
-                TreeItemMessage *message = new TreeItemMessage(item);
-                message->m_offset = seq;
-                message->m_uid = uidMapping[seq];
-                item->m_children << message;
-                QStringList flags = cache()->msgFlags(mailbox, message->m_uid);
+            item->m_rows.resize(uidMapping.size());
+            for (int seq = 0; seq < uidMapping.size(); ++seq) {
+                MessageRow &message = item->m_rows[seq];
+                message.uid = uidMapping[seq];
+                QStringList flags = cache()->msgFlags(mailbox, message.uid);
                 flags.removeOne(QStringLiteral("\\Recent"));
-                message->m_flags = normalizeFlags(flags);
+                message.flags = normalizeFlags(flags);
             }
             endInsertRows();
         }
@@ -886,7 +897,7 @@ void Model::askForNumberOfMessages(TreeItemMsgList *item)
     }
 }
 
-void Model::askForMsgMetadata(TreeItemMessage *item, const PreloadingMode preloadMode)
+void Model::askForMsgMetadata(TreeItemMessage *item, const PreloadingMode preloadMode, const TaskPriority priority)
 {
     Q_ASSERT(item->uid());
     Q_ASSERT(!item->fetched());
@@ -903,6 +914,9 @@ void Model::askForMsgMetadata(TreeItemMessage *item, const PreloadingMode preloa
             item->data()->setHdrReferences(data.hdrReferences);
             item->data()->setHdrListPost(data.hdrListPost);
             item->data()->setHdrListPostNo(data.hdrListPostNo);
+            item->data()->setHdrListId(data.hdrListId);
+            if (!data.preview.isNull())
+                item->data()->setPreview(data.preview);
             QDataStream stream(&data.serializedBodyStructure, QIODevice::ReadOnly);
             stream.setVersion(QDataStream::Qt_4_6);
             QVariantList unserialized;
@@ -940,32 +954,36 @@ void Model::askForMsgMetadata(TreeItemMessage *item, const PreloadingMode preloa
     case NETWORK_EXPENSIVE:
         if (item->accessFetchStatus() != TreeItem::DONE) {
             item->setFetchStatus(TreeItem::LOADING);
-            findTaskResponsibleFor(mailboxPtr)->requestEnvelopeDownload(item->uid());
+            findTaskResponsibleFor(mailboxPtr)->requestEnvelopeDownload(item->uid(), priority);
         }
         break;
     case NETWORK_ONLINE:
     {
         if (item->accessFetchStatus() != TreeItem::DONE) {
             item->setFetchStatus(TreeItem::LOADING);
-            findTaskResponsibleFor(mailboxPtr)->requestEnvelopeDownload(item->uid());
+            findTaskResponsibleFor(mailboxPtr)->requestEnvelopeDownload(item->uid(), priority);
         }
 
         // preload
         if (preloadMode != PRELOAD_PER_POLICY)
             break;
+        // a view tells us which messages it is going to show, so there's no point in guessing
+        if (m_viewportMailbox.isValid() && m_viewportMailbox.internalPointer() == mailboxPtr)
+            break;
         bool ok;
         int preload = property("trojita-imap-preload-msg-metadata").toInt(&ok);
         if (! ok)
             preload = 50;
         int order = item->row();
-        for (int i = qMax(0, order - preload); i < qMin(list->m_children.size(), order + preload); ++i) {
-            TreeItemMessage *message = dynamic_cast<TreeItemMessage *>(list->m_children[i]);
-            Q_ASSERT(message);
+        for (int i = qMax(0, order - preload); i < qMin(list->messageRowCount(), order + preload); ++i) {
+            if (!list->uidAt(i))
+                continue;
+            TreeItemMessage *message = list->messageAt(i);
             if (item != message && !message->fetched() && !message->loading() && message->uid()) {
                 message->setFetchStatus(TreeItem::LOADING);
                 // cannot ask the KeepTask directly, that'd completely ignore the cache
                 // but we absolutely have to block the preload :)
-                askForMsgMetadata(message, PRELOAD_DISABLED);
+                askForMsgMetadata(message, PRELOAD_DISABLED, TaskPriority::PRELOAD);
             }
         }
     }
@@ -974,7 +992,7 @@ void Model::askForMsgMetadata(TreeItemMessage *item, const PreloadingMode preloa
     EMIT_LATER(this, dataChanged, Q_ARG(QModelIndex, item->toIndex(this)), Q_ARG(QModelIndex, item->toIndex(this)));
 }
 
-void Model::askForMsgPart(TreeItemPart *item, bool onlyFromCache)
+void Model::askForMsgPart(TreeItemPart *item, bool onlyFromCache, const TaskPriority priority)
 {
     Q_ASSERT(item->message());   // TreeItemMessage
     Q_ASSERT(item->message()->parent());   // TreeItemMsgList
@@ -1036,8 +1054,139 @@ void Model::askForMsgPart(TreeItemPart *item, bool onlyFromCache)
                 fetchingMode = TreeItemPart::FETCH_PART_BINARY;
             }
         }
-        keepTask->requestPartDownload(item->message()->m_uid, itemForFetchOperation->partIdForFetch(fetchingMode), item->octets());
+        keepTask->requestPartDownload(item->message()->uid(), itemForFetchOperation->partIdForFetch(fetchingMode), item->octets(),
+                                      priority);
+    }
+}
+
+/** @short Make sure that a part which is being loaded with a low priority gets fetched as soon as possible */
+void Model::raiseMsgPartPriority(TreeItemPart *item)
+{
+    TreeItemMessage *message = item->message();
+    if (!message || !message->uid() || !message->parent())
+        return;
+    TreeItemMailbox *mailboxPtr = dynamic_cast<TreeItemMailbox *>(message->parent()->parent());
+    if (!mailboxPtr || !mailboxPtr->maintainingTask)
+        return;
+
+    // The same logic as in askForMsgPart(): the raw data are fetched through their parent part
+    TreeItemPart *itemForFetchOperation = item;
+    TreeItemModifiedPart *modifiedPart = dynamic_cast<TreeItemModifiedPart*>(item);
+    if (modifiedPart && modifiedPart->kind() == TreeItem::OFFSET_RAW_CONTENTS) {
+        itemForFetchOperation = dynamic_cast<TreeItemPart*>(item->parent());
+        Q_ASSERT(itemForFetchOperation);
+    }
+    mailboxPtr->maintainingTask->raisePartPriority(message->uid(), QList<QByteArray>()
+                                                   << itemForFetchOperation->partIdForFetch(TreeItemPart::FETCH_PART_IMAP)
+                                                   << itemForFetchOperation->partIdForFetch(TreeItemPart::FETCH_PART_BINARY));
+}
+
+/** @short Ask for the next chunk of a message part's raw data through a partial fetch
+
+Unless the @arg mode asks for all remaining data, a chunk of the part's data which is already in the cache is used without
+any network activity. When the last chunk arrives, the part is finalized in the same way as if it was fetched in full.
+*/
+void Model::askForMsgPartChunk(TreeItemPart *item, const PartialFetchMode mode)
+{
+    if (item->fetched() || item->loading() || item->isUnavailable() || item->m_partialChunkRequested)
+        return;
+
+    if (item->isTopLevelMultiPart() || dynamic_cast<TreeItemModifiedPart*>(item)) {
+        // Only the real leaf parts can be loaded progressively
+        return;
+    }
+
+    Q_ASSERT(item->message());   // TreeItemMessage
+    Q_ASSERT(item->message()->parent());   // TreeItemMsgList
+    Q_ASSERT(item->message()->parent()->parent());   // TreeItemMailbox
+    TreeItemMailbox *mailboxPtr = dynamic_cast<TreeItemMailbox *>(item->message()->parent()->parent());
+    Q_ASSERT(mailboxPtr);
+    uint uid = static_cast<TreeItemMessage *>(item->message())->uid();
+    Q_ASSERT(uid);
+
+    if (item->m_partialData.isNull()) {
+        const QByteArray &data = cache()->messagePart(mailboxPtr->mailbox(), uid, item->partId() + ".X-PARTIAL");
+        if (!data.isNull()) {
+            item->m_partialData = data;
+            item->m_partialDataSaved = data.size();
+            if (mode == PARTIAL_NEXT_CHUNK) {
+                EMIT_LATER(this, dataChanged, Q_ARG(QModelIndex, item->toIndex(this)), Q_ARG(QModelIndex, item->toIndex(this)));
+                return;
+            }
+        }
+    }
+
+    if (mode == PARTIAL_PREVIEW && !item->m_partialData.isEmpty()) {
+        // Whatever we have is enough for a preview
+        return;
+    }
+
+    if (networkPolicy() == NETWORK_OFFLINE)
+        return;
+
+    const quint64 offset = item->m_partialData.size();
+    quint64 length;
+    if (mode == PARTIAL_REMAINING && item->octets() > offset) {
+        // Ask for one more byte than what should be left so that the short read tells us that this was the last chunk
+        length = item->octets() - offset + 1;
+    } else if (mode == PARTIAL_PREVIEW) {
+        length = partialFetchPreviewSize;
+    } else {
+        length = offset ? partialFetchChunkSize : partialFetchFirstChunkSize;
+    }
+    item->m_partialChunkRequested = length;
+    item->m_partialChunkForPreview = mode == PARTIAL_PREVIEW;
+    findTaskResponsibleFor(mailboxPtr)->requestPartDownload(uid, item->partIdForPartialFetch(offset, length), length,
+                                                            mode == PARTIAL_PREVIEW ? TaskPriority::PRELOAD : TaskPriority::INTERACTIVE);
+}
+
+/** @short Obtain a short plaintext preview of a message
+
+If the server supports RFC 8970, the preview is requested through the PREVIEW FETCH attribute. Otherwise, the first
+kilobyte of the message's main text part is fetched and the preview is built from that. In both cases, the requests go
+through the KeepMailboxOpenTask's queue, so the previews of all messages which are shown at once are fetched in a batch.
+*/
+void Model::askForMsgPreview(TreeItemMessage *item)
+{
+    if (!item->fetched() || !item->uid() || item->data()->gotPreview() || item->data()->previewRequested())
+        return;
+
+    TreeItemMailbox *mailboxPtr = dynamic_cast<TreeItemMailbox *>(item->parent()->parent());
+    Q_ASSERT(mailboxPtr);
+
+    if (networkPolicy() != NETWORK_OFFLINE) {
+        KeepMailboxOpenTask *keepTask = findTaskResponsibleFor(mailboxPtr);
+        if (keepTask->parser && accessParser(keepTask->parser).capabilitiesFresh &&
+                accessParser(keepTask->parser).capabilities.contains(QStringLiteral("PREVIEW"))) {
+            item->data()->setPreviewRequested(true);
+            keepTask->requestPartDownload(item->uid(), QByteArrayLiteral("PREVIEW"), 0, TaskPriority::PRELOAD);
+            return;
+        }
+    }
+
+    QModelIndex mainPartIndex;
+    QString partMessage;
+    switch (FindInterestingPart::findMainPartOfMessage(item->toIndex(this), mainPartIndex, partMessage, 0)) {
+    case FindInterestingPart::MAINPART_MESSAGE_NOT_LOADED:
+        return;
+    case FindInterestingPart::MAINPART_PART_CANNOT_DETERMINE:
+        // There's nothing which we could show
+        item->setPreview(this, QLatin1String(""));
+        return;
+    case FindInterestingPart::MAINPART_FOUND:
+    case FindInterestingPart::MAINPART_PART_LOADING:
+        break;
     }
+
+    TreeItemPart *part = dynamic_cast<TreeItemPart *>(static_cast<TreeItem *>(mainPartIndex.internalPointer()));
+    Q_ASSERT(part);
+    item->data()->setPreviewRequested(true);
+    item->data()->setPreviewPartId(part->partId());
+    part->fetchFromCache(this);
+    if (!part->fetched())
+        askForMsgPartChunk(part, PARTIAL_PREVIEW);
+    if (part->fetched() || !part->m_partialData.isEmpty())
+        item->setPreviewFromPart(this, part);
 }
 
 void Model::resyncMailbox(const QModelIndex &mbox)
@@ -1214,7 +1363,23 @@ ImapTask *Model::setMessageFlags(const QModelIndexList &messages, const QString
 {
     Q_ASSERT(!messages.isEmpty());
     Q_ASSERT(messages.front().model() == this);
-    return m_taskFactory->createUpdateFlagsTask(this, messages, marked, QLatin1Char('(') + flag + QLatin1Char(')'));
+    Imap::Uids uids;
+    uids.reserve(messages.size());
+    Q_FOREACH(const QModelIndex &index, messages) {
+        TreeItemMessage *message = dynamic_cast<TreeItemMessage *>(static_cast<TreeItem *>(index.internalPointer()));
+        Q_ASSERT(message);
+        uids << message->uid();
+    }
+    return setMessageFlags(findMailboxForItems(messages), uids, flag, marked);
+}
+
+ImapTask *Model::setMessageFlags(const QModelIndex &mailbox, const Imap::Uids &uids, const QString flag, const FlagsOperation marked)
+{
+    TreeItemMailbox *mailboxPtr = mailboxForSomeItem(mailbox);
+    if (!mailboxPtr || std::all_of(uids.constBegin(), uids.constEnd(), [](const uint uid) { return uid == 0; }))
+        return 0;
+    return m_taskFactory->createUpdateFlagsTask(this, mailboxPtr->toIndex(this), uids, marked,
+                                                QLatin1Char('(') + flag + QLatin1Char(')'));
 }
 
 void Model::markMessagesDeleted(const QModelIndexList &messages, const FlagsOperation marked)
@@ -1265,13 +1430,28 @@ void Model::copyMoveMessages(TreeItemMailbox *sourceMbox, const QString &destMai
     m_taskFactory->createCopyMoveMessagesTask(this, messages, destMailboxName, op);
 }
 
-/** @short Convert a list of UIDs to a list of pointers to the relevant message nodes */
+/** @short Convert a list of UIDs to a list of pointers to the relevant message nodes
+
+The messages are instantiated if they haven't been needed so far; use findMessageRowsByUids() for working with many messages.
+*/
 QList<TreeItemMessage *> Model::findMessagesByUids(const TreeItemMailbox *const mailbox, const Imap::Uids &uids)
 {
-    const TreeItemMsgList *const list = dynamic_cast<const TreeItemMsgList *const>(mailbox->m_children[0]);
+    TreeItemMsgList *const list = dynamic_cast<TreeItemMsgList *const>(mailbox->m_children[0]);
     Q_ASSERT(list);
     QList<TreeItemMessage *> res;
-    auto it = list->m_children.constBegin();
+    Q_FOREACH(const int row, findMessageRowsByUids(mailbox, uids)) {
+        res << list->messageAt(row);
+    }
+    return res;
+}
+
+/** @short Convert a sorted list of UIDs to the rows of the corresponding messages */
+QVector<int> Model::findMessageRowsByUids(const TreeItemMailbox *const mailbox, const Imap::Uids &uids) const
+{
+    const TreeItemMsgList *const list = dynamic_cast<const TreeItemMsgList *const>(mailbox->m_children[0]);
+    Q_ASSERT(list);
+    QVector<int> res;
+    auto it = list->m_rows.constBegin();
     uint lastUid = 0;
     Q_FOREACH(const uint uid, uids) {
         if (lastUid == uid) {
@@ -1279,9 +1459,9 @@ QList<TreeItemMessage *> Model::findMessagesByUids(const TreeItemMailbox *const
             continue;
         }
         lastUid = uid;
-        it = Common::lowerBoundWithUnknownElements(it, list->m_children.constEnd(), uid, messageHasUidZero, uidComparator);
-        if (it != list->m_children.end() && static_cast<TreeItemMessage *>(*it)->uid() == uid) {
-            res << static_cast<TreeItemMessage *>(*it);
+        it = Common::lowerBoundWithUnknownElements(it, list->m_rows.constEnd(), uid, messageHasUidZero, uidComparator);
+        if (it != list->m_rows.constEnd() && it->uid == uid) {
+            res << it - list->m_rows.constBegin();
         } else {
             qDebug() << "Can't find UID" << uid;
         }
@@ -1291,12 +1471,13 @@ QList<TreeItemMessage *> Model::findMessagesByUids(const TreeItemMailbox *const
 
 /** @short Find a message with UID that matches the passed key, handling those with UID zero correctly
 
-If there's no such message, the next message with a valid UID is returned instead. If there are no such messages, the iterator can
-point to a message with UID zero or to the end of the list.
+The row of that message is returned. If there's no such message, the row of the next message with a valid UID is returned
+instead. If there are no such messages, the row can point to a message with UID zero or past the end of the list.
 */
-TreeItemChildrenList::iterator Model::findMessageOrNextOneByUid(TreeItemMsgList *list, const uint uid)
+int Model::findMessageOrNextOneByUid(const TreeItemMsgList *list, const uint uid) const
 {
-    return Common::lowerBoundWithUnknownElements(list->m_children.begin(), list->m_children.end(), uid, messageHasUidZero, uidComparator);
+    return Common::lowerBoundWithUnknownElements(list->m_rows.constBegin(), list->m_rows.constEnd(), uid,
+                                                 messageHasUidZero, uidComparator) - list->m_rows.constBegin();
 }
 
 TreeItemMailbox *Model::findMailboxByName(const QString &name) const
@@ -1412,9 +1593,9 @@ void Model::unsubscribeMailbox(const QString &name)
 
 void Model::saveUidMap(TreeItemMsgList *list)
 {
-    Imap::Uids seqToUid(list->m_children.size(), 0);
-    std::transform(list->m_children.constBegin(), list->m_children.cend(), seqToUid.begin(), [](TreeItem *item) {
-        return static_cast<TreeItemMessage *>(item)->uid();
+    Imap::Uids seqToUid(list->m_rows.size(), 0);
+    std::transform(list->m_rows.constBegin(), list->m_rows.cend(), seqToUid.begin(), [](const MessageRow &message) {
+        return message.uid;
     });
     cache()->setUidMapping(static_cast<TreeItemMailbox *>(list->parent())->mailbox(), seqToUid);
 }
@@ -1482,12 +1663,12 @@ void Model::killParser(Parser *parser, ParserKillingMethod method)
 
 void Model::slotParserLineReceived(Parser *parser, const QByteArray &line)
 {
-    logTrace(parser->parserId(), Common::LOG_IO_READ, QString(), QString::fromUtf8(line));
+    logRawTrace(parser->parserId(), Common::LOG_IO_READ, line);
 }
 
 void Model::slotParserLineSent(Parser *parser, const QByteArray &line)
 {
-    logTrace(parser->parserId(), Common::LOG_IO_WRITTEN, QString(), QString::fromUtf8(line));
+    logRawTrace(parser->parserId(), Common::LOG_IO_WRITTEN, line);
 }
 
 void Model::setCache(std::shared_ptr<AbstractCache> cache)
@@ -1681,9 +1862,11 @@ void Model::releaseMessageData(const QModelIndex &message)
         return;
 
     msg->setFetchStatus(TreeItem::NONE);
+    const bool hasChildren = !msg->m_children.isEmpty();
 
 #ifndef XTUPLE_CONNECT
-    beginRemoveRows(realMessage, 0, msg->m_children.size() - 1);
+    if (hasChildren)
+        beginRemoveRows(realMessage, 0, msg->m_children.size() - 1);
 #endif
     if (msg->data()->partHeader()) {
         msg->data()->partHeader()->silentlyReleaseMemoryRecursive();
@@ -1703,11 +1886,170 @@ void Model::releaseMessageData(const QModelIndex &message)
     }
     msg->m_children.clear();
 #ifndef XTUPLE_CONNECT
-    endRemoveRows();
+    if (hasChildren)
+        endRemoveRows();
     emit dataChanged(realMessage, realMessage);
 #endif
 }
 
+void Model::setMessageViewport(const QModelIndexList &visible, const QModelIndexList &upcoming)
+{
+    TreeItemMailbox *mailboxPtr = 0;
+    QSet<uint> wanted;
+    QList<TreeItemMessage *> visibleMessages, upcomingMessages;
+
+    auto collect = [this, &mailboxPtr, &wanted](const QModelIndexList &indexes, QList<TreeItemMessage *> &messages) {
+        Q_FOREACH(const QModelIndex &index, indexes) {
+            // Proxies might contain items which do not map to any real message, e.g. the placeholders in threading
+            const QModelIndex realIndex = Imap::deproxifiedIndex(index);
+            if (realIndex.model() != this)
+                continue;
+            TreeItemMessage *msg = dynamic_cast<TreeItemMessage *>(static_cast<TreeItem *>(realIndex.internalPointer()));
+            if (!msg || !msg->uid())
+                continue;
+            TreeItemMailbox *mailbox = static_cast<TreeItemMailbox *>(msg->parent()->parent());
+            if (!mailboxPtr)
+                mailboxPtr = mailbox;
+            else if (mailboxPtr != mailbox)
+                continue;
+            wanted.insert(msg->uid());
+            messages << msg;
+        }
+    };
+    collect(visible, visibleMessages);
+    collect(upcoming, upcomingMessages);
+
+    const QModelIndex viewportMailbox = mailboxPtr ? mailboxPtr->toIndex(this) : QModelIndex();
+    if (m_viewportMailbox != viewportMailbox) {
+        // The flag combinations of the previous mailbox are not interesting anymore; the lists in use stay shared anyway
+        m_viewportLastSeen.clear();
+        m_flagLists.clear();
+        // Nobody is going to tell the previous mailbox which of its envelopes are still wanted
+        TreeItemMailbox *previous = m_viewportMailbox.isValid() ?
+                    dynamic_cast<TreeItemMailbox *>(static_cast<TreeItem *>(m_viewportMailbox.internalPointer())) : 0;
+        if (previous && previous->maintainingTask)
+            previous->maintainingTask->stopFollowingViewport();
+    }
+    m_viewportMailbox = viewportMailbox;
+    if (!mailboxPtr)
+        return;
+
+    ++m_viewportGeneration;
+    Q_FOREACH(const uint uid, wanted) {
+        m_viewportLastSeen[uid] = m_viewportGeneration;
+    }
+    if (m_viewportLastSeen.size() > m_materializedMessagesLimit)
+        releaseStaleMessages(mailboxPtr, wanted);
+
+    if (mailboxPtr->maintainingTask && visibleMessages.isEmpty()) {
+        // With nothing on the screen, there is no viewport to follow and no reason to hold the requests back
+        mailboxPtr->maintainingTask->stopFollowingViewport();
+    } else if (mailboxPtr->maintainingTask) {
+        // Whatever got queued for the messages which have scrolled away in the meanwhile is not interesting anymore
+        Imap::Uids abandoned = mailboxPtr->maintainingTask->abandonEnvelopeRequests(wanted);
+        if (!abandoned.isEmpty()) {
+            qSort(abandoned);
+            TreeItemMsgList *list = static_cast<TreeItemMsgList *>(mailboxPtr->m_children[0]);
+            Q_FOREACH(const int row, findMessageRowsByUids(mailboxPtr, abandoned)) {
+                TreeItemMessage *msg = list->existingMessageAt(row);
+                if (msg && msg->loading()) {
+                    msg->setFetchStatus(TreeItem::NONE);
+                    QModelIndex idx = msg->toIndex(this);
+                    emit dataChanged(idx, idx);
+                }
+            }
+        }
+    }
+
+    if (!isNetworkAvailable())
+        return;
+
+    // The visible messages will likely get requested by the view anyway, but the order matters here
+    Q_FOREACH(TreeItemMessage *msg, visibleMessages) {
+        if (!msg->fetched() && !msg->loading())
+            askForMsgMetadata(msg, PRELOAD_DISABLED);
+    }
+    if (!isNetworkOnline())
+        return;
+    Q_FOREACH(TreeItemMessage *msg, upcomingMessages) {
+        if (!msg->fetched() && !msg->loading())
+            askForMsgMetadata(msg, PRELOAD_DISABLED, TaskPriority::PRELOAD);
+    }
+}
+
+/** @short Release metadata of messages which have not been shown by a view for the longest time
+
+This keeps the memory usage of huge mailboxes proportional to what the user actually looks at. Messages are released in
+batches, so that this doesn't have to run each time the view scrolls by a single line.
+*/
+void Model::releaseStaleMessages(TreeItemMailbox *mailbox, const QSet<uint> &wanted)
+{
+    // Messages which are open in a viewer have to stay around. There are just a few of them.
+    QSet<uint> pinned;
+    for (auto it = m_pinnedMessages.begin(); it != m_pinnedMessages.end(); /* nothing */) {
+        if (!it->isValid()) {
+            it = m_pinnedMessages.erase(it);
+            continue;
+        }
+        TreeItemMessage *msg = static_cast<TreeItemMessage *>(static_cast<TreeItem *>(it->internalPointer()));
+        if (msg->parent()->parent() == mailbox)
+            pinned.insert(msg->uid());
+        ++it;
+    }
+
+    QVector<QPair<quint64, uint> > candidates;
+    candidates.reserve(m_viewportLastSeen.size());
+    for (auto it = m_viewportLastSeen.constBegin(); it != m_viewportLastSeen.constEnd(); ++it) {
+        if (!wanted.contains(it.key()) && !pinned.contains(it.key()))
+            candidates << qMakePair(it.value(), it.key());
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.resize(qMin(candidates.size(), m_viewportLastSeen.size() - m_materializedMessagesLimit * 3 / 4));
+    if (candidates.isEmpty())
+        return;
+
+    Imap::Uids uids;
+    uids.reserve(candidates.size());
+    Q_FOREACH(const auto &candidate, candidates) {
+        uids << candidate.second;
+        m_viewportLastSeen.remove(candidate.second);
+    }
+    qSort(uids);
+
+    TreeItemMsgList *list = static_cast<TreeItemMsgList *>(mailbox->m_children[0]);
+    Q_FOREACH(const int row, findMessageRowsByUids(mailbox, uids)) {
+        TreeItemMessage *msg = list->existingMessageAt(row);
+        if (!msg)
+            continue;
+        if (msg->loading()) {
+            // The data are on their way, so give it another chance in a later batch
+            m_viewportLastSeen[msg->uid()] = m_viewportGeneration;
+            continue;
+        }
+        if (msg->m_data || !msg->m_children.isEmpty())
+            releaseMessageData(msg->toIndex(this));
+    }
+}
+
+void Model::pinMessage(const QModelIndex &message)
+{
+    Q_ASSERT(!message.isValid() || message.model() == this);
+    if (dynamic_cast<TreeItemMessage *>(static_cast<TreeItem *>(message.internalPointer())))
+        m_pinnedMessages << message;
+}
+
+void Model::unpinMessage(const QModelIndex &message)
+{
+    const int pos = m_pinnedMessages.indexOf(message);
+    if (pos != -1)
+        m_pinnedMessages.removeAt(pos);
+}
+
+void Model::setMaterializedMessagesLimit(const int limit)
+{
+    m_materializedMessagesLimit = limit;
+}
+
 QStringList Model::capabilities() const
 {
     if (m_parsers.isEmpty())
@@ -1719,12 +2061,40 @@ QStringList Model::capabilities() const
     return QStringList();
 }
 
+/** @short Is there anybody who listens to our log messages? */
+bool Model::isLoggingActive() const
+{
+    static const QMetaMethod loggedSignal = QMetaMethod::fromSignal(&Model::logged);
+    return isSignalConnected(loggedSignal);
+}
+
 void Model::logTrace(uint parserId, const Common::LogKind kind, const QString &source, const QString &message)
 {
+    if (!isLoggingActive())
+        return;
     Common::LogMessage m(QDateTime::currentDateTime(), kind, source,  message, 0);
     emit logged(parserId, m);
 }
 
+/** @short Log the protocol traffic
+
+The data are passed along without any conversion (and without copying, thanks to the implicit sharing); it's up to the
+consumers to turn them into text if they actually need that. If the protocol tracing is disabled at build time, this is
+a no-op.
+*/
+void Model::logRawTrace(uint parserId, const Common::LogKind kind, const QByteArray &line)
+{
+#ifdef TROJITA_HAVE_PROTOCOL_TRACING
+    if (!isLoggingActive())
+        return;
+    emit logged(parserId, Common::LogMessage(QDateTime::currentDateTime(), kind, QString(), line));
+#else
+    Q_UNUSED(parserId);
+    Q_UNUSED(kind);
+    Q_UNUSED(line);
+#endif
+}
+
 /** @short Overloaded version which accepts a QModelIndex of an item which is somehow "related" to the logged message
 
 The relevantIndex argument is used for finding out what parser to send the message to.
@@ -1798,9 +2168,20 @@ QStringList Model::normalizeFlags(const QStringList &source) const
             res.append(*it);
         }
     }
-    // Always sort the flags when performing normalization to obtain reasonable results and be ready for possible future
-    // deduplication of the actual QLists
+    // Always sort the flags when performing normalization to obtain reasonable results and to make the deduplication work
     res.sort();
+
+    // Most messages share one of a handful of flag combinations, so there's no need to keep a separate list for each of them.
+    // This matters a lot in huge mailboxes.
+    const QString key = res.join(QLatin1Char(' '));
+    QHash<QString, QStringList>::const_iterator known = m_flagLists.constFind(key);
+    if (known != m_flagLists.constEnd())
+        return *known;
+    if (m_flagLists.size() >= maxSharedFlagLists) {
+        // Somebody is using way too many distinct flags, so start over instead of growing without any limit
+        m_flagLists.clear();
+    }
+    m_flagLists.insert(key, res);
     return res;
 }
 
@@ -171,6 +171,8 @@ public:
     void markMailboxAsRead(const QModelIndex &mailbox);
     /** @short Add/Remove a flag for the indicated message */
     ImapTask *setMessageFlags(const QModelIndexList &messages, const QString flag, const FlagsOperation marked);
+    /** @short Add/Remove a flag for messages with the given UIDs in the specified mailbox */
+    ImapTask *setMessageFlags(const QModelIndex &mailbox, const Imap::Uids &uids, const QString flag, const FlagsOperation marked);
     /** @short Ask the server to set/unset the \\Deleted flag for the indicated messages */
     void markMessagesDeleted(const QModelIndexList &messages, const FlagsOperation marked);
     /** @short Ask the server to set/unset the \\Seen flag for the indicated messages */
@@ -245,6 +247,29 @@ public:
     */
     void releaseMessageData(const QModelIndex &message);
 
+    /** @short Inform the model about the messages which are shown by a view
+
+    The @arg visible messages are those which are on screen right now, the @arg upcoming ones are expected to scroll into view
+    soon, with the closest ones first. Their metadata are requested in this order. Queued requests for messages which are not
+    listed in either of these lists are dropped as long as they have not been sent to the server yet.
+
+    While a viewport is set for a mailbox, the fixed preloading of metadata around each requested message is disabled for it.
+    Passing empty lists clears the viewport.
+    */
+    void setMessageViewport(const QModelIndexList &visible, const QModelIndexList &upcoming);
+
+    /** @short Limit the number of messages which keep their metadata in memory after they have been shown by a view
+
+    Once more messages than this have been shown through setMessageViewport(), those which have not been visible for the longest
+    time get their metadata released, see releaseMessageData(). They are loaded again (usually from the cache) when a view asks
+    for them. Messages which were pinned through pinMessage(), such as an opened message, are kept.
+    */
+    void setMaterializedMessagesLimit(const int limit);
+    /** @short Keep the metadata of a message in memory even after it has scrolled out of sight, e.g. while it is opened */
+    void pinMessage(const QModelIndex &message);
+    /** @short Undo one previous pinMessage() call */
+    void unpinMessage(const QModelIndex &message);
+
     /** @short Return a list of capabilities which are supported by the server */
     QStringList capabilities() const;
 
@@ -483,14 +508,28 @@ private:
     friend class Composer::ImapPartAttachmentItem; // dtto
     friend class Composer::MessageComposer; // dtto
 
+    bool isLoggingActive() const;
+    void logRawTrace(uint parserId, const Common::LogKind kind, const QByteArray &line);
+
     void askForChildrenOfMailbox(TreeItemMailbox *item, bool forceReload);
     void askForMessagesInMailbox(TreeItemMsgList *item);
     void askForNumberOfMessages(TreeItemMsgList *item);
 
     typedef enum {PRELOAD_PER_POLICY, PRELOAD_DISABLED} PreloadingMode;
 
-    void askForMsgMetadata(TreeItemMessage *item, PreloadingMode preloadMode);
-    void askForMsgPart(TreeItemPart *item, bool onlyFromCache=false);
+    void askForMsgMetadata(TreeItemMessage *item, PreloadingMode preloadMode,
+                           const TaskPriority priority=TaskPriority::INTERACTIVE);
+    void askForMsgPart(TreeItemPart *item, bool onlyFromCache=false, const TaskPriority priority=TaskPriority::INTERACTIVE);
+    void raiseMsgPartPriority(TreeItemPart *item);
+    /** @short How much data should be requested through a partial fetch */
+    typedef enum {
+        PARTIAL_NEXT_CHUNK, /**< @short Just the next chunk of a progressively loaded part */
+        PARTIAL_REMAINING, /**< @short Everything which has not been received yet */
+        PARTIAL_PREVIEW /**< @short A tiny chunk which is enough for building a preview of the message */
+    } PartialFetchMode;
+
+    void askForMsgPartChunk(TreeItemPart *item, const PartialFetchMode mode);
+    void askForMsgPreview(TreeItemMessage *item);
 
     void finalizeList(Parser *parser, TreeItemMailbox *const mailboxPtr);
     void finalizeIncrementalList(Parser *parser, const QString &parentMailboxName);
@@ -507,7 +546,9 @@ private:
     TreeItemMailbox *findMailboxByName(const QString &name, const TreeItemMailbox *const root) const;
     TreeItemMailbox *findParentMailboxByName(const QString &name) const;
     QList<TreeItemMessage *> findMessagesByUids(const TreeItemMailbox *const mailbox, const Imap::Uids &uids);
-    TreeItemChildrenList::iterator findMessageOrNextOneByUid(TreeItemMsgList *list, const uint uid);
+    QVector<int> findMessageRowsByUids(const TreeItemMailbox *const mailbox, const Imap::Uids &uids) const;
+    void releaseStaleMessages(TreeItemMailbox *mailbox, const QSet<uint> &wanted);
+    int findMessageOrNextOneByUid(const TreeItemMsgList *list, const uint uid) const;
 
     static TreeItemMailbox *mailboxForSomeItem(QModelIndex index);
 
@@ -562,6 +603,8 @@ private:
     QMap<QByteArray,QByteArray> m_idResult;
 
     mutable QSet<QString> m_flagLiterals;
+    /** @short Shared copies of all flag combinations seen so far, see normalizeFlags() */
+    mutable QHash<QString, QStringList> m_flagLists;
 
     /** @short Username for login */
     QString m_imapUser;
@@ -581,6 +624,15 @@ private:
 
     QStringList m_capabilitiesBlacklist;
 
+    /** @short Mailbox whose message list is currently driven by the viewport of a view, see setMessageViewport() */
+    QPersistentModelIndex m_viewportMailbox;
+    /** @short When was each message of the m_viewportMailbox last shown by a view */
+    QHash<uint, quint64> m_viewportLastSeen;
+    /** @short Messages which shall keep their metadata, see pinMessage() */
+    QList<QPersistentModelIndex> m_pinnedMessages;
+    quint64 m_viewportGeneration;
+    int m_materializedMessagesLimit;
+
 protected slots:
     void responseReceived();
     void responseReceived(Imap::Parser *parser);
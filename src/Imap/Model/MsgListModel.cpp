@@ -82,10 +82,13 @@ QHash<int, QByteArray> MsgListModel::roleNames() const
         roleNames[RoleMessageInReplyTo] = "inReplyTo";
         roleNames[RoleMessageMessageId] = "messageId";
         roleNames[RoleMessageSubject] = "subject";
+        roleNames[RoleMessageNormalizedSubject] = "normalizedSubject";
         roleNames[RoleMessageFlags] = "flags";
         roleNames[RoleMessageSize] = "size";
         roleNames[RoleMessageFuzzyDate] = "fuzzyDate";
         roleNames[RoleMessageHasAttachments] = "hasAttachments";
+        roleNames[RoleMessagePreview] = "preview";
+        roleNames[RoleMessageHeaderListId] = "listId";
     }
     return roleNames;
 }
@@ -132,10 +135,10 @@ QModelIndex MsgListModel::index(int row, int column, const QModelIndex &parent)
     if (column < 0 || column >= COLUMN_COUNT)
         return QModelIndex();
 
-    if (row >= msgListPtr->m_children.size() || row < 0)
+    if (row >= msgListPtr->messageRowCount() || row < 0)
         return QModelIndex();
 
-    return createIndex(row, column, msgListPtr->m_children[row]);
+    return createIndex(row, column, msgListPtr->messageAt(row));
 }
 
 QModelIndex MsgListModel::parent(const QModelIndex &index) const
@@ -181,7 +184,7 @@ QModelIndex MsgListModel::mapToSource(const QModelIndex &proxyIndex) const
 
     Model *model = dynamic_cast<Model *>(sourceModel());
     Q_ASSERT(model);
-    return model->createIndex(proxyIndex.row(), 0, msgListPtr->m_children[proxyIndex.row()]);
+    return model->createIndex(proxyIndex.row(), 0, msgListPtr->messageAt(proxyIndex.row()));
 }
 
 QModelIndex MsgListModel::mapFromSource(const QModelIndex &sourceIndex) const
@@ -261,7 +264,10 @@ QVariant MsgListModel::data(const QModelIndex &proxyIndex, int role) const
     case RoleMessageHeaderReferences:
     case RoleMessageHeaderListPost:
     case RoleMessageHeaderListPostNo:
+    case RoleMessageHeaderListId:
+    case RoleMessageNormalizedSubject:
     case RoleMessageHasAttachments:
+    case RoleMessagePreview:
         return dynamic_cast<TreeItemMessage *>(Model::realTreeItem(
                 proxyIndex))->data(static_cast<Model *>(sourceModel()), role);
     default:
@@ -400,8 +406,11 @@ void MsgListModel::handleRowsAboutToBeRemoved(const QModelIndex &parent, int sta
     if (newList) {
         if (newList == msgListPtr) {
             beginRemoveRows(mapFromSource(parent), start, end);
-            for (int i = start; i <= end; ++i)
-                emit messageRemoved(msgListPtr->m_children[i]);
+            for (int i = start; i <= end; ++i) {
+                // Messages which were never instantiated could not have been seen by anybody
+                if (TreeItemMessage *message = msgListPtr->existingMessageAt(i))
+                    emit messageRemoved(message);
+            }
         }
     } else if (mailbox) {
         Q_ASSERT(start > 0);
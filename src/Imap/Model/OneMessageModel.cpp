@@ -72,7 +72,12 @@ void OneMessageModel::setMessage(const QString &mailbox, const uint uid)
 void OneMessageModel::setMessage(const QModelIndex &message)
 {
     Q_ASSERT(!message.isValid() || message.model() == QObject::parent());
+    Model *model = qobject_cast<Model*>(QObject::parent());
+    if (m_message.isValid())
+        model->unpinMessage(m_message);
     m_message = message;
+    if (m_message.isValid())
+        model->pinMessage(m_message);
     m_subtree->setRootItem(message);
 
     // Now try to locate the interesting part of the current message
@@ -229,11 +234,11 @@ void OneMessageModel::setMarkedRead(const bool marked)
 
 void OneMessageModel::handleModelDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
 {
-    Q_ASSERT(topLeft.row() == bottomRight.row());
     Q_ASSERT(topLeft.parent() == bottomRight.parent());
     Q_ASSERT(topLeft.model() == bottomRight.model());
 
-    if (m_message.isValid() && topLeft == m_message)
+    if (m_message.isValid() && m_message.parent() == topLeft.parent() &&
+            m_message.row() >= topLeft.row() && m_message.row() <= bottomRight.row())
         emit flagsChanged();
 }
 
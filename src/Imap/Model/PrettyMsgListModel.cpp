@@ -19,6 +19,7 @@
    You should have received a copy of the GNU General Public License
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <QTimer>
 #include "PrettyMsgListModel.h"
 #include "ItemRoles.h"
 #include "MsgListModel.h"
@@ -27,6 +28,11 @@
 #include "UiUtils/IconLoader.h"
 
 
+namespace {
+    /** @short How many messages shall have their formatted texts cached */
+    const int displayCacheSize = 5000;
+}
+
 namespace Imap
 {
 
@@ -34,9 +40,64 @@ namespace Mailbox
 {
 
 PrettyMsgListModel::PrettyMsgListModel(QObject *parent):
-    QSortFilterProxyModel(parent), m_hideRead(false)
+    QSortFilterProxyModel(parent), m_hideRead(false), m_displayCache(displayCacheSize), m_clockTimer(new QTimer(this))
 {
     setDynamicSortFilter(true);
+    m_clockTimer->setSingleShot(true);
+    connect(m_clockTimer, &QTimer::timeout, this, &PrettyMsgListModel::slotClockTick);
+    scheduleClockTick();
+}
+
+void PrettyMsgListModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    if (QAbstractItemModel *oldModel = this->sourceModel()) {
+        disconnect(oldModel, &QAbstractItemModel::dataChanged, this, &PrettyMsgListModel::handleSourceDataChanged);
+        disconnect(oldModel, &QAbstractItemModel::layoutChanged, this, &PrettyMsgListModel::clearDisplayCache);
+        disconnect(oldModel, &QAbstractItemModel::modelReset, this, &PrettyMsgListModel::clearDisplayCache);
+    }
+    clearDisplayCache();
+    QSortFilterProxyModel::setSourceModel(sourceModel);
+    if (!sourceModel)
+        return;
+
+    connect(sourceModel, &QAbstractItemModel::dataChanged, this, &PrettyMsgListModel::handleSourceDataChanged);
+    // The relayout and reset invalidate the internal IDs which we use as a key
+    connect(sourceModel, &QAbstractItemModel::layoutChanged, this, &PrettyMsgListModel::clearDisplayCache);
+    connect(sourceModel, &QAbstractItemModel::modelReset, this, &PrettyMsgListModel::clearDisplayCache);
+}
+
+void PrettyMsgListModel::handleSourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    if (!topLeft.isValid() || !bottomRight.isValid())
+        return;
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        m_displayCache.remove(topLeft.sibling(row, 0).internalId());
+    }
+}
+
+void PrettyMsgListModel::clearDisplayCache()
+{
+    m_displayCache.clear();
+}
+
+/** @short Forget all cached texts at the top of each hour
+
+The fuzzy dates change their format not only at midnight, but also once a message gets older than a few hours, so the day
+boundary alone is not enough.
+*/
+void PrettyMsgListModel::slotClockTick()
+{
+    clearDisplayCache();
+    scheduleClockTick();
+}
+
+void PrettyMsgListModel::scheduleClockTick()
+{
+    QDateTime now = QDateTime::currentDateTime();
+    QDateTime nextHour(now.date(), QTime(now.time().hour(), 0));
+    nextHour = nextHour.addSecs(3600);
+    // Add a bit of slack so that we don't fire a few milliseconds too early
+    m_clockTimer->start(now.msecsTo(nextHour) + 1000);
 }
 
 QVariant PrettyMsgListModel::data(const QModelIndex &index, int role) const
@@ -56,65 +117,42 @@ QVariant PrettyMsgListModel::data(const QModelIndex &index, int role) const
 
     case Qt::DisplayRole:
     case Qt::ToolTipRole:
-        switch (index.column()) {
+    {
+        const int column = index.column();
+        switch (column) {
         case MsgListModel::TO:
         case MsgListModel::FROM:
         case MsgListModel::CC:
         case MsgListModel::BCC:
-        {
-            int backendRole = 0;
-            switch (index.column()) {
-            case MsgListModel::FROM:
-                backendRole = RoleMessageFrom;
-                break;
-            case MsgListModel::TO:
-                backendRole = RoleMessageTo;
-                break;
-            case MsgListModel::CC:
-                backendRole = RoleMessageCc;
-                break;
-            case MsgListModel::BCC:
-                backendRole = RoleMessageBcc;
-                break;
-            }
-            QVariantList items = translated.data(backendRole).toList();
-            if (role == Qt::DisplayRole) {
-                return Imap::Message::MailAddress::prettyList(items, Imap::Message::MailAddress::FORMAT_JUST_NAME);
-            } else {
-                return UiUtils::Formatting::htmlEscaped(Imap::Message::MailAddress::prettyList(items, Imap::Message::MailAddress::FORMAT_READABLE));
-            }
-        }
         case MsgListModel::DATE:
         case MsgListModel::RECEIVED_DATE:
-        {
-            QDateTime res = translated.data(RoleMessageDate).toDateTime();
-            if (role == Qt::ToolTipRole) {
-                // tooltips shall always show the full and complete data
-                return res.toLocalTime().toString(Qt::DefaultLocaleLongDate);
-            }
-            return UiUtils::Formatting::prettyDate(res.toLocalTime());
-        }
         case MsgListModel::SIZE:
-        {
-            QVariant size = translated.data(RoleMessageSize);
-            if (!size.isValid()) {
-                return QVariant();
-            }
-            return UiUtils::Formatting::prettySize(size.toULongLong());
-        }
         case MsgListModel::SUBJECT:
-        {
-            if (!translated.data(RoleIsFetched).toBool())
-                return tr("Loading...");
-            QString subject = translated.data(RoleMessageSubject).toString();
-            if (role == Qt::ToolTipRole) {
-                subject = UiUtils::Formatting::htmlEscaped(subject);
-            }
-            return subject.isEmpty() ? tr("(no subject)") : subject;
+            break;
+        default:
+            return QSortFilterProxyModel::data(index, role);
         }
+
+        if (DisplayCacheEntry *entry = m_displayCache.object(translated.internalId())) {
+            const QVariant &cached = role == Qt::DisplayRole ? entry->display[column] : entry->toolTip[column];
+            if (cached.isValid())
+                return cached;
         }
-        break;
 
+        QVariant res = formatText(translated, column, role);
+
+        // Don't cache placeholders of the messages which are still being loaded. Their data will change soon, and going
+        // through the source model is also what asks for the missing data.
+        if (res.isValid() && translated.data(RoleIsFetched).toBool()) {
+            DisplayCacheEntry *entry = m_displayCache.object(translated.internalId());
+            if (!entry) {
+                entry = new DisplayCacheEntry();
+                m_displayCache.insert(translated.internalId(), entry);
+            }
+            (role == Qt::DisplayRole ? entry->display[column] : entry->toolTip[column]) = res;
+        }
+        return res;
+    }
 
     case Qt::TextAlignmentRole:
         switch (index.column()) {
@@ -177,6 +215,69 @@ QVariant PrettyMsgListModel::data(const QModelIndex &index, int role) const
     return QSortFilterProxyModel::data(index, role);
 }
 
+/** @short Produce the human-readable text of a column of the message pointed to by the @arg translated index */
+QVariant PrettyMsgListModel::formatText(const QModelIndex &translated, const int column, const int role) const
+{
+    switch (column) {
+    case MsgListModel::TO:
+    case MsgListModel::FROM:
+    case MsgListModel::CC:
+    case MsgListModel::BCC:
+    {
+        int backendRole = 0;
+        switch (column) {
+        case MsgListModel::FROM:
+            backendRole = RoleMessageFrom;
+            break;
+        case MsgListModel::TO:
+            backendRole = RoleMessageTo;
+            break;
+        case MsgListModel::CC:
+            backendRole = RoleMessageCc;
+            break;
+        case MsgListModel::BCC:
+            backendRole = RoleMessageBcc;
+            break;
+        }
+        QVariantList items = translated.data(backendRole).toList();
+        if (role == Qt::DisplayRole) {
+            return Imap::Message::MailAddress::prettyList(items, Imap::Message::MailAddress::FORMAT_JUST_NAME);
+        } else {
+            return UiUtils::Formatting::htmlEscaped(Imap::Message::MailAddress::prettyList(items, Imap::Message::MailAddress::FORMAT_READABLE));
+        }
+    }
+    case MsgListModel::DATE:
+    case MsgListModel::RECEIVED_DATE:
+    {
+        QDateTime res = translated.data(RoleMessageDate).toDateTime();
+        if (role == Qt::ToolTipRole) {
+            // tooltips shall always show the full and complete data
+            return res.toLocalTime().toString(Qt::DefaultLocaleLongDate);
+        }
+        return UiUtils::Formatting::prettyDate(res.toLocalTime());
+    }
+    case MsgListModel::SIZE:
+    {
+        QVariant size = translated.data(RoleMessageSize);
+        if (!size.isValid()) {
+            return QVariant();
+        }
+        return UiUtils::Formatting::prettySize(size.toULongLong());
+    }
+    case MsgListModel::SUBJECT:
+    {
+        if (!translated.data(RoleIsFetched).toBool())
+            return tr("Loading...");
+        QString subject = translated.data(RoleMessageSubject).toString();
+        if (role == Qt::ToolTipRole) {
+            subject = UiUtils::Formatting::htmlEscaped(subject);
+        }
+        return subject.isEmpty() ? tr("(no subject)") : subject;
+    }
+    }
+    return QVariant();
+}
+
 void PrettyMsgListModel::setHideRead(bool value)
 {
     m_hideRead = value;
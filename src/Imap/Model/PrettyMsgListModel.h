@@ -22,9 +22,13 @@
 #ifndef PRETTYMSGLISTMODEL_H
 #define PRETTYMSGLISTMODEL_H
 
+#include <QCache>
 #include <QSortFilterProxyModel>
 #include "Imap/Model/MailboxModel.h"
 #include "Imap/Model/FavoriteTagsModel.h"
+#include "Imap/Model/MsgListModel.h"
+
+class QTimer;
 
 namespace Imap
 {
@@ -39,6 +43,7 @@ class PrettyMsgListModel: public QSortFilterProxyModel
 public:
     explicit PrettyMsgListModel(QObject *parent);
     virtual QVariant data(const QModelIndex &index, int role) const;
+    virtual void setSourceModel(QAbstractItemModel *sourceModel);
     void setHideRead(bool value);
     virtual bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const;
     virtual void sort(int column, Qt::SortOrder order);
@@ -46,8 +51,31 @@ public:
 signals:
     void sortingPreferenceChanged(int column, Qt::SortOrder order);
 
+private slots:
+    void handleSourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    void clearDisplayCache();
+    void slotClockTick();
+
 private:
+    QVariant formatText(const QModelIndex &translated, const int column, const int role) const;
+    void scheduleClockTick();
+
+    /** @short Already formatted texts of all columns of a single message */
+    struct DisplayCacheEntry {
+        QVariant display[MsgListModel::COLUMN_COUNT];
+        QVariant toolTip[MsgListModel::COLUMN_COUNT];
+    };
+
     bool m_hideRead;
+
+    /** @short Cache of the formatted texts, indexed by the internal ID of the source model's index
+
+    The ThreadingMsgListModel never reuses the internal ID of a node until its next relayout, so this is a stable key.
+    */
+    mutable QCache<quintptr, DisplayCacheEntry> m_displayCache;
+
+    /** @short Invalidate the time-dependent texts like "today's" dates once in a while */
+    QTimer *m_clockTimer;
 };
 
 }
@@ -21,6 +21,8 @@
 */
 
 #include "SQLCache.h"
+#include <QCryptographicHash>
+#include <QSet>
 #include <QSqlError>
 #include <QSqlRecord>
 #include <QTimer>
@@ -31,6 +33,18 @@
 namespace
 {
 static int streamVersion = QDataStream::Qt_4_6;
+
+/** @short Where is the actual data of a message part stored? */
+enum PartLocation {
+    PART_LOCATION_DB = 0, /**< In the "parts" table */
+    PART_LOCATION_EXTERNAL = 1, /**< Somewhere else, typically in the DiskPartCache */
+};
+
+/** @short Timestamp for the LRU bookkeeping of message parts */
+qint64 partAccessTimestamp()
+{
+    return QDateTime::currentMSecsSinceEpoch() / 1000;
+}
 }
 
 namespace Imap
@@ -62,6 +76,10 @@ QDate SQLCache::accessingThresholdDate = QDate(2012, 11, 1);
 SQLCache::SQLCache()
     : inTransaction(false)
     , m_updateAccessIfOlder(0)
+    , m_partsSize(-1)
+    , m_usageValid(false)
+    , m_partStorageUpgraded(false)
+    , m_externalOrphansPossible(true)
 {
 }
 
@@ -198,7 +216,74 @@ bool SQLCache::open(const QString &name, const QString &fileName)
         }
     }
 
-    if (version != 7) {
+    if (version == 7) {
+        // V8 stores the data of message parts just once per their content, no matter how many messages they belong to.
+        // The "parts" table now only refers to a blob in the "part_blobs" table by the hash of its content. The blobs also
+        // carry the bookkeeping about their size and the last access time, which is needed for enforcing a size limit
+        // on the cache. Big parts are no longer stored in per-mailbox directories, so these files get removed as well.
+        if (!q.exec(QStringLiteral("ALTER TABLE parts RENAME TO parts_v7"))) {
+            emitError(QObject::tr("Failed to rename old table parts"), q);
+            return false;
+        }
+        if (!q.exec(QStringLiteral("CREATE TABLE parts ("
+                                   "mailbox STRING NOT NULL, "
+                                   "uid INT NOT NULL, "
+                                   "part_id BINARY, "
+                                   "hash BINARY NOT NULL, "
+                                   "PRIMARY KEY (mailbox, uid, part_id)"
+                                   ")"))) {
+            emitError(QObject::tr("Can't create table parts"), q);
+            return false;
+        }
+        if (!q.exec(QStringLiteral("CREATE INDEX parts_hash ON parts (hash)"))) {
+            emitError(QObject::tr("Can't create index parts_hash"), q);
+            return false;
+        }
+        if (!q.exec(QStringLiteral("CREATE TABLE part_blobs ("
+                                   "hash BINARY NOT NULL PRIMARY KEY, "
+                                   "data BINARY, "
+                                   "size INT NOT NULL, "
+                                   "location INT NOT NULL, "
+                                   "lastAccess INT NOT NULL, "
+                                   "hits INT NOT NULL, "
+                                   "refcount INT NOT NULL"
+                                   ")"))) {
+            emitError(QObject::tr("Can't create table part_blobs"), q);
+            return false;
+        }
+        if (!migratePartsFromV7())
+            return false;
+        if (!q.exec(QStringLiteral("DROP TABLE parts_v7"))) {
+            emitError(QObject::tr("Failed to drop old table parts"), q);
+            return false;
+        }
+        m_partStorageUpgraded = true;
+        version = 8;
+        if (!q.exec(QStringLiteral("UPDATE trojita SET version = 8;"))) {
+            emitError(QObject::tr("Failed to update cache DB scheme from v7 to v8"), q);
+            return false;
+        }
+    }
+
+    if (version == 8) {
+        // V9 adds indexes for finding the blobs which are no longer referenced and for the LRU ordering, so that neither
+        // has to scan the whole part_blobs table
+        if (!q.exec(QStringLiteral("CREATE INDEX part_blobs_orphans ON part_blobs (refcount) WHERE refcount <= 0"))) {
+            emitError(QObject::tr("Can't create index part_blobs_orphans"), q);
+            return false;
+        }
+        if (!q.exec(QStringLiteral("CREATE INDEX part_blobs_lastAccess ON part_blobs (lastAccess, hits)"))) {
+            emitError(QObject::tr("Can't create index part_blobs_lastAccess"), q);
+            return false;
+        }
+        version = 9;
+        if (!q.exec(QStringLiteral("UPDATE trojita SET version = 9;"))) {
+            emitError(QObject::tr("Failed to update cache DB scheme from v8 to v9"), q);
+            return false;
+        }
+    }
+
+    if (version != 9) {
         emitError(QObject::tr("Unknown version of sqlite cache"));
         return false;
     }
@@ -274,6 +359,76 @@ bool SQLCache::createTables()
     return true;
 }
 
+/** @short Move the message parts from the v7 layout of the "parts" table into the content-addressed storage
+
+The old data were stored compressed, so they can be moved to the blobs without compressing them again, but they have to be
+uncompressed once for computing the hash of their content.
+*/
+bool SQLCache::migratePartsFromV7()
+{
+    QSqlQuery old(QString(), db);
+    old.setForwardOnly(true);
+    if (!old.exec(QStringLiteral("SELECT mailbox, uid, part_id, data FROM parts_v7"))) {
+        emitError(QObject::tr("Failed to read old table parts"), old);
+        return false;
+    }
+
+    QSqlQuery insertBlob(QString(), db);
+    QSqlQuery referenceBlob(QString(), db);
+    QSqlQuery insertPart(QString(), db);
+    if (!insertBlob.prepare(QStringLiteral("INSERT INTO part_blobs (hash, data, size, location, lastAccess, hits, refcount) "
+                                           "VALUES (?, ?, ?, %1, 0, 0, 1)").arg(PART_LOCATION_DB))) {
+        emitError(QObject::tr("Failed to prepare insertBlob"), insertBlob);
+        return false;
+    }
+    if (!referenceBlob.prepare(QStringLiteral("UPDATE part_blobs SET refcount = refcount + 1 WHERE hash = ?"))) {
+        emitError(QObject::tr("Failed to prepare referenceBlob"), referenceBlob);
+        return false;
+    }
+    if (!insertPart.prepare(QStringLiteral("INSERT INTO parts (mailbox, uid, part_id, hash) VALUES (?, ?, ?, ?)"))) {
+        emitError(QObject::tr("Failed to prepare insertPart"), insertPart);
+        return false;
+    }
+
+    QSet<QByteArray> knownHashes;
+    while (old.next()) {
+        const QByteArray compressed = old.value(3).toByteArray();
+        const QByteArray hash = contentHash(qUncompress(compressed));
+        if (knownHashes.contains(hash)) {
+            referenceBlob.bindValue(0, hash);
+            if (!referenceBlob.exec()) {
+                emitError(QObject::tr("Failed to migrate message parts"), referenceBlob);
+                return false;
+            }
+        } else {
+            insertBlob.bindValue(0, hash);
+            insertBlob.bindValue(1, compressed);
+            insertBlob.bindValue(2, compressed.size());
+            if (!insertBlob.exec()) {
+                emitError(QObject::tr("Failed to migrate message parts"), insertBlob);
+                return false;
+            }
+            knownHashes.insert(hash);
+        }
+        insertPart.bindValue(0, old.value(0));
+        insertPart.bindValue(1, old.value(1));
+        insertPart.bindValue(2, old.value(2));
+        insertPart.bindValue(3, hash);
+        if (!insertPart.exec()) {
+            emitError(QObject::tr("Failed to migrate message parts"), insertPart);
+            return false;
+        }
+    }
+    // The old table is about to be dropped, which won't work while it's still being read
+    old.finish();
+    return true;
+}
+
+bool SQLCache::partStorageWasUpgraded() const
+{
+    return m_partStorageUpgraded;
+}
+
 bool SQLCache::prepareQueries()
 {
     queryChildMailboxes = QSqlQuery(db);
@@ -404,14 +559,51 @@ bool SQLCache::prepareQueries()
         return false;
     }
 
-    queryMessagePart = QSqlQuery(db);
-    if (! queryMessagePart.prepare(QStringLiteral("SELECT data FROM parts WHERE mailbox = ? AND uid = ? AND part_id = ?"))) {
-        emitError(QObject::tr("Failed to prepare queryMessagePart"), queryMessagePart);
+    queryMessageThreading = QSqlQuery(db);
+    if (! queryMessageThreading.prepare(QStringLiteral("SELECT threading FROM msg_threading WHERE mailbox = ?"))) {
+        emitError(QObject::tr("Failed to prepare queryMessageThreading"), queryMessageThreading);
+        return false;
+    }
+
+    querySetMessageThreading = QSqlQuery(db);
+    if (! querySetMessageThreading.prepare(QStringLiteral("INSERT OR REPLACE INTO msg_threading (mailbox, threading) VALUES  ( ?, ? )"))) {
+        emitError(QObject::tr("Failed to prepare querySetMessageThreading"), querySetMessageThreading);
+        return false;
+    }
+
+    queryPartContentHash = QSqlQuery(db);
+    if (!queryPartContentHash.prepare(QStringLiteral("SELECT hash FROM parts WHERE mailbox = ? AND uid = ? AND part_id = ?"))) {
+        emitError(QObject::tr("Failed to prepare queryPartContentHash"), queryPartContentHash);
+        return false;
+    }
+
+    queryBlob = QSqlQuery(db);
+    if (!queryBlob.prepare(QStringLiteral("SELECT data, location FROM part_blobs WHERE hash = ?"))) {
+        emitError(QObject::tr("Failed to prepare queryBlob"), queryBlob);
+        return false;
+    }
+
+    queryAccessBlob = QSqlQuery(db);
+    if (!queryAccessBlob.prepare(QStringLiteral("UPDATE part_blobs SET lastAccess = ?, hits = hits + ? WHERE hash = ?"))) {
+        emitError(QObject::tr("Failed to prepare queryAccessBlob"), queryAccessBlob);
+        return false;
+    }
+
+    queryReferenceBlob = QSqlQuery(db);
+    if (!queryReferenceBlob.prepare(QStringLiteral("UPDATE part_blobs SET refcount = refcount + 1 WHERE hash = ?"))) {
+        emitError(QObject::tr("Failed to prepare queryReferenceBlob"), queryReferenceBlob);
+        return false;
+    }
+
+    queryInsertBlob = QSqlQuery(db);
+    if (!queryInsertBlob.prepare(QStringLiteral("INSERT INTO part_blobs (hash, data, size, location, lastAccess, hits, refcount) "
+                                                "VALUES (?, ?, ?, ?, ?, 0, 1)"))) {
+        emitError(QObject::tr("Failed to prepare queryInsertBlob"), queryInsertBlob);
         return false;
     }
 
     querySetMessagePart = QSqlQuery(db);
-    if (! querySetMessagePart.prepare(QStringLiteral("INSERT OR REPLACE INTO parts ( mailbox, uid, part_id, data ) VALUES (?, ?, ?, ?)"))) {
+    if (!querySetMessagePart.prepare(QStringLiteral("INSERT INTO parts (mailbox, uid, part_id, hash) VALUES (?, ?, ?, ?)"))) {
         emitError(QObject::tr("Failed to prepare querySetMessagePart"), querySetMessagePart);
         return false;
     }
@@ -422,15 +614,84 @@ bool SQLCache::prepareQueries()
         return false;
     }
 
-    queryMessageThreading = QSqlQuery(db);
-    if (! queryMessageThreading.prepare(QStringLiteral("SELECT threading FROM msg_threading WHERE mailbox = ?"))) {
-        emitError(QObject::tr("Failed to prepare queryMessageThreading"), queryMessageThreading);
+    queryReleaseBlobsMailbox = QSqlQuery(db);
+    if (!queryReleaseBlobsMailbox.prepare(QStringLiteral("UPDATE part_blobs SET refcount = refcount - "
+                                                         "(SELECT COUNT(*) FROM parts WHERE parts.hash = part_blobs.hash AND parts.mailbox = ?) "
+                                                         "WHERE hash IN (SELECT hash FROM parts WHERE mailbox = ?)"))) {
+        emitError(QObject::tr("Failed to prepare queryReleaseBlobsMailbox"), queryReleaseBlobsMailbox);
         return false;
     }
 
-    querySetMessageThreading = QSqlQuery(db);
-    if (! querySetMessageThreading.prepare(QStringLiteral("INSERT OR REPLACE INTO msg_threading (mailbox, threading) VALUES  ( ?, ? )"))) {
-        emitError(QObject::tr("Failed to prepare querySetMessageThreading"), querySetMessageThreading);
+    queryReleaseBlobsMessage = QSqlQuery(db);
+    if (!queryReleaseBlobsMessage.prepare(QStringLiteral("UPDATE part_blobs SET refcount = refcount - "
+                                                         "(SELECT COUNT(*) FROM parts WHERE parts.hash = part_blobs.hash AND parts.mailbox = ? AND parts.uid = ?) "
+                                                         "WHERE hash IN (SELECT hash FROM parts WHERE mailbox = ? AND uid = ?)"))) {
+        emitError(QObject::tr("Failed to prepare queryReleaseBlobsMessage"), queryReleaseBlobsMessage);
+        return false;
+    }
+
+    queryReleaseBlobsPart = QSqlQuery(db);
+    if (!queryReleaseBlobsPart.prepare(QStringLiteral("UPDATE part_blobs SET refcount = refcount - 1 "
+                                                      "WHERE hash = (SELECT hash FROM parts WHERE mailbox = ? AND uid = ? AND part_id = ?)"))) {
+        emitError(QObject::tr("Failed to prepare queryReleaseBlobsPart"), queryReleaseBlobsPart);
+        return false;
+    }
+
+    queryReferenceMessageBlobs = QSqlQuery(db);
+    if (!queryReferenceMessageBlobs.prepare(QStringLiteral("UPDATE part_blobs SET refcount = refcount + "
+                                                           "(SELECT COUNT(*) FROM parts WHERE parts.hash = part_blobs.hash AND parts.mailbox = ? AND parts.uid = ?) "
+                                                           "WHERE hash IN (SELECT hash FROM parts WHERE mailbox = ? AND uid = ?)"))) {
+        emitError(QObject::tr("Failed to prepare queryReferenceMessageBlobs"), queryReferenceMessageBlobs);
+        return false;
+    }
+
+    queryCopyMessageParts = QSqlQuery(db);
+    if (!queryCopyMessageParts.prepare(QStringLiteral("INSERT INTO parts (mailbox, uid, part_id, hash) "
+                                                      "SELECT ?, ?, part_id, hash FROM parts WHERE mailbox = ? AND uid = ?"))) {
+        emitError(QObject::tr("Failed to prepare queryCopyMessageParts"), queryCopyMessageParts);
+        return false;
+    }
+
+    queryDropUnreferencedBlobs = QSqlQuery(db);
+    if (!queryDropUnreferencedBlobs.prepare(QStringLiteral("DELETE FROM part_blobs WHERE refcount <= 0 AND location = %1").arg(PART_LOCATION_DB))) {
+        emitError(QObject::tr("Failed to prepare queryDropUnreferencedBlobs"), queryDropUnreferencedBlobs);
+        return false;
+    }
+
+    queryOrphanedExternalBlobs = QSqlQuery(db);
+    if (!queryOrphanedExternalBlobs.prepare(QStringLiteral("SELECT hash FROM part_blobs WHERE refcount <= 0 AND location = %1").arg(PART_LOCATION_EXTERNAL))) {
+        emitError(QObject::tr("Failed to prepare queryOrphanedExternalBlobs"), queryOrphanedExternalBlobs);
+        return false;
+    }
+
+    queryDropOrphanedExternalBlobs = QSqlQuery(db);
+    if (!queryDropOrphanedExternalBlobs.prepare(QStringLiteral("DELETE FROM part_blobs WHERE refcount <= 0 AND location = %1").arg(PART_LOCATION_EXTERNAL))) {
+        emitError(QObject::tr("Failed to prepare queryDropOrphanedExternalBlobs"), queryDropOrphanedExternalBlobs);
+        return false;
+    }
+
+    queryPartsSize = QSqlQuery(db);
+    if (!queryPartsSize.prepare(QStringLiteral("SELECT SUM(size) FROM part_blobs"))) {
+        emitError(QObject::tr("Failed to prepare queryPartsSize"), queryPartsSize);
+        return false;
+    }
+
+    queryLeastRecentlyUsedBlobs = QSqlQuery(db);
+    if (!queryLeastRecentlyUsedBlobs.prepare(QStringLiteral("SELECT hash, size, location FROM part_blobs "
+                                                            "ORDER BY lastAccess ASC, hits ASC LIMIT ?"))) {
+        emitError(QObject::tr("Failed to prepare queryLeastRecentlyUsedBlobs"), queryLeastRecentlyUsedBlobs);
+        return false;
+    }
+
+    queryEvictBlob1 = QSqlQuery(db);
+    if (!queryEvictBlob1.prepare(QStringLiteral("DELETE FROM parts WHERE hash = ?"))) {
+        emitError(QObject::tr("Failed to prepare queryEvictBlob1"), queryEvictBlob1);
+        return false;
+    }
+
+    queryEvictBlob2 = QSqlQuery(db);
+    if (!queryEvictBlob2.prepare(QStringLiteral("DELETE FROM part_blobs WHERE hash = ?"))) {
+        emitError(QObject::tr("Failed to prepare queryEvictBlob2"), queryEvictBlob2);
         return false;
     }
 
@@ -613,6 +874,11 @@ void SQLCache::clearAllMessages(const QString &mailbox)
     queryClearAllMessages2.bindValue(0, mailboxName(mailbox));
     queryClearAllMessages3.bindValue(0, mailboxName(mailbox));
     queryClearAllMessages4.bindValue(0, mailboxName(mailbox));
+    queryReleaseBlobsMailbox.bindValue(0, mailboxName(mailbox));
+    queryReleaseBlobsMailbox.bindValue(1, mailboxName(mailbox));
+    if (!queryReleaseBlobsMailbox.exec()) {
+        emitError(QObject::tr("Query queryReleaseBlobsMailbox failed"), queryReleaseBlobsMailbox);
+    }
     if (! queryClearAllMessages1.exec()) {
         emitError(QObject::tr("Query queryClearAllMessages1 failed"), queryClearAllMessages1);
     }
@@ -625,6 +891,7 @@ void SQLCache::clearAllMessages(const QString &mailbox)
     if (! queryClearAllMessages4.exec()) {
         emitError(QObject::tr("Query queryClearAllMessages4 failed"), queryClearAllMessages4);
     }
+    dropUnreferencedBlobs(queryReleaseBlobsMailbox);
     clearUidMapping(mailbox);
 }
 
@@ -640,6 +907,7 @@ void SQLCache::clearMessage(const QString mailbox, uint uid)
     queryClearMessage2.bindValue(1, uid);
     queryClearMessage3.bindValue(0, mailboxName(mailbox));
     queryClearMessage3.bindValue(1, uid);
+    releaseMessageBlobs(mailbox, uid);
     if (! queryClearMessage1.exec()) {
         emitError(QObject::tr("Query queryClearMessage1 failed"), queryClearMessage1);
     }
@@ -649,6 +917,7 @@ void SQLCache::clearMessage(const QString mailbox, uint uid)
     if (! queryClearMessage3.exec()) {
         emitError(QObject::tr("Query queryClearMessage3 failed"), queryClearMessage3);
     }
+    dropUnreferencedBlobs(queryReleaseBlobsMessage);
 }
 
 QStringList SQLCache::msgFlags(const QString &mailbox, const uint uid) const
@@ -698,10 +967,7 @@ AbstractCache::MessageDataBundle SQLCache::messageMetadata(const QString &mailbo
     }
     if (queryMessageMetadata.first()) {
         res.uid = uid;
-        QDataStream stream(qUncompress(queryMessageMetadata.value(0).toByteArray()));
-        stream.setVersion(streamVersion);
-        stream >> res.envelope >> res.internalDate >> res.size >> res.serializedBodyStructure >> res.hdrReferences
-                  >> res.hdrListPost >> res.hdrListPostNo;
+        parseMessageMetadata(queryMessageMetadata.value(0).toByteArray(), res);
 
         if (m_updateAccessIfOlder) {
             int lastAccessTimestamp = queryMessageMetadata.value(1).toInt();
@@ -720,6 +986,31 @@ AbstractCache::MessageDataBundle SQLCache::messageMetadata(const QString &mailbo
     return res;
 }
 
+bool SQLCache::parseMessageMetadata(const QByteArray &data, MessageDataBundle &bundle)
+{
+    QDataStream stream(qUncompress(data));
+    stream.setVersion(streamVersion);
+    stream >> bundle.envelope >> bundle.internalDate >> bundle.size >> bundle.serializedBodyStructure >> bundle.hdrReferences
+              >> bundle.hdrListPost >> bundle.hdrListPostNo;
+    // The preview and the List-Id were added later; older entries simply do not have them
+    if (!stream.atEnd())
+        stream >> bundle.preview;
+    if (!stream.atEnd())
+        stream >> bundle.hdrListId;
+    return stream.status() == QDataStream::Ok;
+}
+
+QByteArray SQLCache::serializeMessageMetadata(const MessageDataBundle &bundle)
+{
+    QByteArray buf;
+    QDataStream stream(&buf, QIODevice::ReadWrite);
+    stream.setVersion(streamVersion);
+    stream << bundle.envelope << bundle.internalDate << bundle.size << bundle.serializedBodyStructure
+           << bundle.hdrReferences << bundle.hdrListPost << bundle.hdrListPostNo << bundle.preview
+           << bundle.hdrListId;
+    return qCompress(buf);
+}
+
 void SQLCache::setMessageMetadata(const QString &mailbox, const uint uid, const MessageDataBundle &metadata)
 {
 #ifdef CACHE_DEBUG
@@ -729,31 +1020,56 @@ void SQLCache::setMessageMetadata(const QString &mailbox, const uint uid, const
     // Order of values: mailbox, uid, data
     querySetMessageMetadata.bindValue(0, mailboxName(mailbox));
     querySetMessageMetadata.bindValue(1, uid);
-    QByteArray buf;
-    QDataStream stream(&buf, QIODevice::ReadWrite);
-    stream.setVersion(streamVersion);
-    stream << metadata.envelope << metadata.internalDate << metadata.size << metadata.serializedBodyStructure
-           << metadata.hdrReferences << metadata.hdrListPost << metadata.hdrListPostNo;
-    querySetMessageMetadata.bindValue(2, qCompress(buf));
+    querySetMessageMetadata.bindValue(2, serializeMessageMetadata(metadata));
     querySetMessageMetadata.bindValue(3, accessingThresholdDate.daysTo(QDate::currentDate()));
     if (! querySetMessageMetadata.exec()) {
         emitError(QObject::tr("Query querySetMessageMetadata failed"), querySetMessageMetadata);
     }
 }
 
+QByteArray SQLCache::contentHash(const QByteArray &data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+}
+
+QByteArray SQLCache::partContentHash(const QString &mailbox, const uint uid, const QByteArray &partId) const
+{
+    QByteArray res;
+    queryPartContentHash.bindValue(0, mailboxName(mailbox));
+    queryPartContentHash.bindValue(1, uid);
+    queryPartContentHash.bindValue(2, partId);
+    if (!queryPartContentHash.exec()) {
+        emitError(QObject::tr("Query queryPartContentHash failed"), queryPartContentHash);
+        return res;
+    }
+    if (queryPartContentHash.first()) {
+        res = queryPartContentHash.value(0).toByteArray();
+        queryPartContentHash.finish();
+    }
+    return res;
+}
+
 QByteArray SQLCache::messagePart(const QString &mailbox, const uint uid, const QByteArray &partId) const
 {
     QByteArray res;
-    queryMessagePart.bindValue(0, mailboxName(mailbox));
-    queryMessagePart.bindValue(1, uid);
-    queryMessagePart.bindValue(2, partId);
-    if (! queryMessagePart.exec()) {
-        emitError(QObject::tr("Query queryMessagePart failed"), queryMessagePart);
+    QByteArray hash = partContentHash(mailbox, uid, partId);
+    if (hash.isEmpty())
+        return res;
+
+    queryBlob.bindValue(0, hash);
+    if (!queryBlob.exec()) {
+        emitError(QObject::tr("Query queryBlob failed"), queryBlob);
         return res;
     }
-    if (queryMessagePart.first()) {
-        res = qUncompress(queryMessagePart.value(0).toByteArray());
-        queryMessagePart.finish();
+    if (queryBlob.first()) {
+        // Data which are stored externally are not our business, they are just being accounted for
+        if (queryBlob.value(1).toInt() == PART_LOCATION_DB) {
+            res = qUncompress(queryBlob.value(0).toByteArray());
+        }
+        queryBlob.finish();
+        if (!res.isNull()) {
+            noteBlobAccessed(hash);
+        }
     }
     return res;
 }
@@ -764,13 +1080,24 @@ void SQLCache::setMsgPart(const QString &mailbox, const uint uid, const QByteArr
     qDebug() << "Saving message part" << partId << uid << mailbox;
 #endif
     touchingDB();
-    querySetMessagePart.bindValue(0, mailboxName(mailbox));
-    querySetMessagePart.bindValue(1, uid);
-    querySetMessagePart.bindValue(2, partId);
-    querySetMessagePart.bindValue(3, qCompress(data));
-    if (! querySetMessagePart.exec()) {
-        emitError(QObject::tr("Query querySetMessagePart failed"), querySetMessagePart);
+    const QByteArray hash = contentHash(data);
+    if (referenceExistingBlob(mailbox, uid, partId, hash))
+        return;
+
+    releasePartBlob(mailbox, uid, partId);
+    QByteArray compressed = qCompress(data);
+    queryInsertBlob.bindValue(0, hash);
+    queryInsertBlob.bindValue(1, compressed);
+    queryInsertBlob.bindValue(2, compressed.size());
+    queryInsertBlob.bindValue(3, PART_LOCATION_DB);
+    queryInsertBlob.bindValue(4, partAccessTimestamp());
+    if (!queryInsertBlob.exec()) {
+        emitError(QObject::tr("Query queryInsertBlob failed"), queryInsertBlob);
+        return;
     }
+    if (m_partsSize >= 0)
+        m_partsSize += compressed.size();
+    insertPartReference(mailbox, uid, partId, hash);
 }
 
 void SQLCache::forgetMessagePart(const QString &mailbox, const uint uid, const QByteArray &partId)
@@ -778,13 +1105,298 @@ void SQLCache::forgetMessagePart(const QString &mailbox, const uint uid, const Q
 #ifdef CACHE_DEBUG
     qDebug() << "Forgetting message part" << partId << uid << mailbox;
 #endif
+    // Forgetting a part which is not there is common, and it shouldn't cost a write
+    if (partContentHash(mailbox, uid, partId).isEmpty())
+        return;
+    touchingDB();
+    releasePartBlob(mailbox, uid, partId);
+}
+
+bool SQLCache::referenceExistingBlob(const QString &mailbox, const uint uid, const QByteArray &partId, const QByteArray &hash)
+{
+    touchingDB();
+    // Bump the reference count first so that the blob cannot disappear when releasing whatever this part pointed to
+    queryReferenceBlob.bindValue(0, hash);
+    if (!queryReferenceBlob.exec()) {
+        emitError(QObject::tr("Query queryReferenceBlob failed"), queryReferenceBlob);
+        return false;
+    }
+    if (queryReferenceBlob.numRowsAffected() < 1)
+        return false;
+
+    releasePartBlob(mailbox, uid, partId);
+    insertPartReference(mailbox, uid, partId, hash);
+    return true;
+}
+
+void SQLCache::setExternalMsgPart(const QString &mailbox, const uint uid, const QByteArray &partId, const QByteArray &hash, const quint64 size)
+{
+    touchingDB();
+    releasePartBlob(mailbox, uid, partId);
+    queryInsertBlob.bindValue(0, hash);
+    queryInsertBlob.bindValue(1, QVariant(QVariant::ByteArray));
+    queryInsertBlob.bindValue(2, size);
+    queryInsertBlob.bindValue(3, PART_LOCATION_EXTERNAL);
+    queryInsertBlob.bindValue(4, partAccessTimestamp());
+    if (!queryInsertBlob.exec()) {
+        emitError(QObject::tr("Query queryInsertBlob failed"), queryInsertBlob);
+        return;
+    }
+    if (m_partsSize >= 0)
+        m_partsSize += size;
+    insertPartReference(mailbox, uid, partId, hash);
+}
+
+void SQLCache::copyMessageParts(const QString &srcMailbox, const uint srcUid, const QString &dstMailbox, const uint dstUid)
+{
+    if (srcMailbox == dstMailbox && srcUid == dstUid)
+        return;
+
+    touchingDB();
+    queryReferenceMessageBlobs.bindValue(0, mailboxName(srcMailbox));
+    queryReferenceMessageBlobs.bindValue(1, srcUid);
+    queryReferenceMessageBlobs.bindValue(2, mailboxName(srcMailbox));
+    queryReferenceMessageBlobs.bindValue(3, srcUid);
+    if (!queryReferenceMessageBlobs.exec()) {
+        emitError(QObject::tr("Query queryReferenceMessageBlobs failed"), queryReferenceMessageBlobs);
+        return;
+    }
+
+    releaseMessageBlobs(dstMailbox, dstUid);
+    queryClearMessage3.bindValue(0, mailboxName(dstMailbox));
+    queryClearMessage3.bindValue(1, dstUid);
+    if (!queryClearMessage3.exec()) {
+        emitError(QObject::tr("Query queryClearMessage3 failed"), queryClearMessage3);
+    }
+    dropUnreferencedBlobs(queryReleaseBlobsMessage);
+
+    queryCopyMessageParts.bindValue(0, mailboxName(dstMailbox));
+    queryCopyMessageParts.bindValue(1, dstUid);
+    queryCopyMessageParts.bindValue(2, mailboxName(srcMailbox));
+    queryCopyMessageParts.bindValue(3, srcUid);
+    if (!queryCopyMessageParts.exec()) {
+        emitError(QObject::tr("Query queryCopyMessageParts failed"), queryCopyMessageParts);
+    }
+}
+
+void SQLCache::noteBlobAccessed(const QByteArray &hash) const
+{
+    // Reading a part shouldn't cost a write transaction of its own, so the accesses are only remembered here and written
+    // along with the next delayed commit
+    auto &access = m_pendingBlobAccesses[hash];
+    access.first = partAccessTimestamp();
+    ++access.second;
+    delayedCommit->start();
+}
+
+/** @short Write the access times which were collected by noteBlobAccessed() */
+void SQLCache::flushBlobAccesses()
+{
+    if (m_pendingBlobAccesses.isEmpty())
+        return;
+
     touchingDB();
+    for (auto it = m_pendingBlobAccesses.constBegin(); it != m_pendingBlobAccesses.constEnd(); ++it) {
+        queryAccessBlob.bindValue(0, it->first);
+        queryAccessBlob.bindValue(1, it->second);
+        queryAccessBlob.bindValue(2, it.key());
+        if (!queryAccessBlob.exec()) {
+            emitError(QObject::tr("Query queryAccessBlob failed"), queryAccessBlob);
+        }
+    }
+    m_pendingBlobAccesses.clear();
+}
+
+/** @short Remove the data which are no longer referenced after the @arg releaseQuery has dropped some references
+
+This is a no-op unless the @arg releaseQuery has actually released something. Otherwise, the orphans are found through the
+part_blobs_orphans partial index, so the cost does not depend on the size of the cache.
+*/
+void SQLCache::dropUnreferencedBlobs(const QSqlQuery &releaseQuery)
+{
+    if (releaseQuery.numRowsAffected() <= 0)
+        return;
+    m_externalOrphansPossible = true;
+    if (!queryDropUnreferencedBlobs.exec()) {
+        emitError(QObject::tr("Query queryDropUnreferencedBlobs failed"), queryDropUnreferencedBlobs);
+    }
+    blobsDropped(queryDropUnreferencedBlobs);
+}
+
+/** @short Some blobs might have been deleted by the @arg query, so the cached total size cannot be trusted anymore */
+void SQLCache::blobsDropped(const QSqlQuery &query)
+{
+    if (query.numRowsAffected() > 0)
+        m_partsSize = -1;
+}
+
+quint64 SQLCache::partsSize() const
+{
+    if (m_partsSize >= 0)
+        return m_partsSize;
+
+    if (!queryPartsSize.exec()) {
+        emitError(QObject::tr("Query queryPartsSize failed"), queryPartsSize);
+        return 0;
+    }
+    quint64 res = 0;
+    if (queryPartsSize.first()) {
+        // SUM() over an empty table yields NULL, which converts to zero just fine
+        res = queryPartsSize.value(0).toULongLong();
+    }
+    queryPartsSize.finish();
+    m_partsSize = res;
+    return res;
+}
+
+QVector<SQLCache::BlobUsage> SQLCache::leastRecentlyUsedBlobs(const int limit)
+{
+    // The recent accesses have to be known to the DB for the ordering to work
+    flushBlobAccesses();
+    QVector<BlobUsage> res;
+    queryLeastRecentlyUsedBlobs.bindValue(0, limit);
+    if (!queryLeastRecentlyUsedBlobs.exec()) {
+        emitError(QObject::tr("Query queryLeastRecentlyUsedBlobs failed"), queryLeastRecentlyUsedBlobs);
+        return res;
+    }
+    while (queryLeastRecentlyUsedBlobs.next()) {
+        BlobUsage item;
+        item.hash = queryLeastRecentlyUsedBlobs.value(0).toByteArray();
+        item.size = queryLeastRecentlyUsedBlobs.value(1).toULongLong();
+        item.external = queryLeastRecentlyUsedBlobs.value(2).toInt() == PART_LOCATION_EXTERNAL;
+        res << item;
+    }
+    return res;
+}
+
+void SQLCache::evictBlob(const QByteArray &hash)
+{
+    touchingDB();
+    queryEvictBlob1.bindValue(0, hash);
+    if (!queryEvictBlob1.exec()) {
+        emitError(QObject::tr("Query queryEvictBlob1 failed"), queryEvictBlob1);
+    }
+    queryEvictBlob2.bindValue(0, hash);
+    if (!queryEvictBlob2.exec()) {
+        emitError(QObject::tr("Query queryEvictBlob2 failed"), queryEvictBlob2);
+    }
+    blobsDropped(queryEvictBlob2);
+    m_pendingBlobAccesses.remove(hash);
+}
+
+QVector<QByteArray> SQLCache::takeOrphanedExternalBlobs()
+{
+    QVector<QByteArray> res;
+    if (!m_externalOrphansPossible)
+        return res;
+    m_externalOrphansPossible = false;
+    if (!queryOrphanedExternalBlobs.exec()) {
+        emitError(QObject::tr("Query queryOrphanedExternalBlobs failed"), queryOrphanedExternalBlobs);
+        return res;
+    }
+    while (queryOrphanedExternalBlobs.next()) {
+        res << queryOrphanedExternalBlobs.value(0).toByteArray();
+    }
+    if (res.isEmpty())
+        return res;
+
+    touchingDB();
+    if (!queryDropOrphanedExternalBlobs.exec()) {
+        emitError(QObject::tr("Query queryDropOrphanedExternalBlobs failed"), queryDropOrphanedExternalBlobs);
+    }
+    blobsDropped(queryDropOrphanedExternalBlobs);
+    return res;
+}
+
+void SQLCache::insertPartReference(const QString &mailbox, const uint uid, const QByteArray &partId, const QByteArray &hash)
+{
+    querySetMessagePart.bindValue(0, mailboxName(mailbox));
+    querySetMessagePart.bindValue(1, uid);
+    querySetMessagePart.bindValue(2, partId);
+    querySetMessagePart.bindValue(3, hash);
+    if (!querySetMessagePart.exec()) {
+        emitError(QObject::tr("Query querySetMessagePart failed"), querySetMessagePart);
+    }
+}
+
+void SQLCache::releasePartBlob(const QString &mailbox, const uint uid, const QByteArray &partId)
+{
+    queryReleaseBlobsPart.bindValue(0, mailboxName(mailbox));
+    queryReleaseBlobsPart.bindValue(1, uid);
+    queryReleaseBlobsPart.bindValue(2, partId);
+    if (!queryReleaseBlobsPart.exec()) {
+        emitError(QObject::tr("Query queryReleaseBlobsPart failed"), queryReleaseBlobsPart);
+    }
     queryForgetMessagePart.bindValue(0, mailboxName(mailbox));
     queryForgetMessagePart.bindValue(1, uid);
     queryForgetMessagePart.bindValue(2, partId);
-    if (! queryForgetMessagePart.exec()) {
+    if (!queryForgetMessagePart.exec()) {
         emitError(QObject::tr("Query queryForgetMessagePart failed"), queryForgetMessagePart);
     }
+    dropUnreferencedBlobs(queryReleaseBlobsPart);
+}
+
+void SQLCache::releaseMessageBlobs(const QString &mailbox, const uint uid)
+{
+    queryReleaseBlobsMessage.bindValue(0, mailboxName(mailbox));
+    queryReleaseBlobsMessage.bindValue(1, uid);
+    queryReleaseBlobsMessage.bindValue(2, mailboxName(mailbox));
+    queryReleaseBlobsMessage.bindValue(3, uid);
+    if (!queryReleaseBlobsMessage.exec()) {
+        emitError(QObject::tr("Query queryReleaseBlobsMessage failed"), queryReleaseBlobsMessage);
+    }
+}
+
+AbstractCache::CacheUsage SQLCache::usage() const
+{
+    // The totals remain valid until the next write to the DB
+    if (m_usageValid)
+        return m_usage;
+
+    // This is not used on any hot path, so there's no point in keeping prepared queries around
+    CacheUsage res;
+    QSqlQuery q(QString(), db);
+
+    if (!q.exec(QStringLiteral("SELECT SUM(LENGTH(data)) FROM msg_metadata"))) {
+        emitError(QObject::tr("Failed to compute size of msg_metadata"), q);
+        return res;
+    }
+    if (q.first())
+        res.metadata = q.value(0).toULongLong();
+
+    if (!q.exec(QStringLiteral("SELECT SUM(LENGTH(flags)) FROM flags"))) {
+        emitError(QObject::tr("Failed to compute size of flags"), q);
+        return res;
+    }
+    if (q.first())
+        res.flags = q.value(0).toULongLong();
+
+    if (!q.exec(QStringLiteral("SELECT location, SUM(size) FROM part_blobs GROUP BY location"))) {
+        emitError(QObject::tr("Failed to compute size of message parts"), q);
+        return res;
+    }
+    while (q.next()) {
+        if (q.value(0).toInt() == PART_LOCATION_DB) {
+            res.parts += q.value(1).toULongLong();
+        } else {
+            res.diskParts += q.value(1).toULongLong();
+        }
+    }
+
+    if (!q.exec(QStringLiteral("SELECT mailbox, SUM(bytes) FROM ("
+                               "SELECT mailbox, LENGTH(data) AS bytes FROM msg_metadata "
+                               "UNION ALL SELECT mailbox, LENGTH(flags) AS bytes FROM flags "
+                               "UNION ALL SELECT parts.mailbox, part_blobs.size AS bytes FROM parts JOIN part_blobs ON parts.hash = part_blobs.hash"
+                               ") GROUP BY mailbox"))) {
+        emitError(QObject::tr("Failed to compute per-mailbox cache usage"), q);
+        return res;
+    }
+    while (q.next()) {
+        res.perMailbox[q.value(0).toString()] = q.value(1).toULongLong();
+    }
+    m_usage = res;
+    m_usageValid = true;
+    return res;
 }
 
 QVector<Imap::Responses::ThreadingNode> SQLCache::messageThreading(const QString &mailbox)
@@ -823,6 +1435,7 @@ void SQLCache::setMessageThreading(const QString &mailbox, const QVector<Imap::R
 
 void SQLCache::touchingDB()
 {
+    m_usageValid = false;
     delayedCommit->start();
     if (! inTransaction) {
 #ifdef CACHE_DEBUG
@@ -836,6 +1449,7 @@ void SQLCache::touchingDB()
 
 void SQLCache::timeToCommit()
 {
+    flushBlobAccesses();
     if (inTransaction) {
 #ifdef CACHE_DEBUG
         qDebug() << "Commit";
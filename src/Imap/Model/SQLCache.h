@@ -64,6 +64,9 @@ et cetera. In short, the layout of the database is supposed to act as a quick an
 cache and is certainly *not* meant to be accessed by third-party applications. Please, do
 consider it an opaque format.
 
+The data of message parts are stored just once per their content (see contentHash()), no matter how many messages
+(or mailboxes) they belong to. The parts only refer to the data, which are reference counted.
+
 Some ideas for improvements:
 - Don't store full string mailbox names in each table, use another table for it
 - Merge uid_mapping with mailbox_sync_state, and also msg_metadata with flags
@@ -74,6 +77,16 @@ Some ideas for improvements:
 class SQLCache : public AbstractCache
 {
 public:
+    /** @short Bookkeeping about the data of cached message parts, as used for cache eviction */
+    struct BlobUsage {
+        /** @short Hash of the content, see contentHash() */
+        QByteArray hash;
+        /** @short Number of bytes which the data occupy in the storage */
+        quint64 size;
+        /** @short Are the data stored outside of this cache? */
+        bool external;
+    };
+
     SQLCache();
     virtual ~SQLCache();
 
@@ -100,15 +113,56 @@ public:
     virtual QByteArray messagePart(const QString &mailbox, const uint uid, const QByteArray &partId) const;
     virtual void setMsgPart(const QString &mailbox, const uint uid, const QByteArray &partId, const QByteArray &data);
     virtual void forgetMessagePart(const QString &mailbox, const uint uid, const QByteArray &partId);
+    virtual void copyMessageParts(const QString &srcMailbox, const uint srcUid, const QString &dstMailbox, const uint dstUid);
 
     virtual QVector<Imap::Responses::ThreadingNode> messageThreading(const QString &mailbox);
     virtual void setMessageThreading(const QString &mailbox, const QVector<Imap::Responses::ThreadingNode> &threading);
 
     /** @short Open a connection to the cache */
     bool open(const QString &name, const QString &fileName);
+    /** @short Has open() converted the DB from the layout which stored message parts per mailbox? */
+    bool partStorageWasUpgraded() const;
 
     virtual void setRenewalThreshold(const int days);
 
+    virtual CacheUsage usage() const;
+
+    /** @short Decode the metadata of a message as stored in the msg_metadata table
+
+    This is useful for code which walks the DB through its own connection, typically from another thread.
+    */
+    static bool parseMessageMetadata(const QByteArray &data, MessageDataBundle &bundle);
+    /** @short Encode the metadata of a message in the format understood by parseMessageMetadata() */
+    static QByteArray serializeMessageMetadata(const MessageDataBundle &bundle);
+
+    /** @short The key under which the data of message parts are stored */
+    static QByteArray contentHash(const QByteArray &data);
+    /** @short Return the hash of the content of the given message part, or a null QByteArray if not cached */
+    QByteArray partContentHash(const QString &mailbox, const uint uid, const QByteArray &partId) const;
+    /** @short Make the message part refer to the data with the given @arg hash if they are known already
+
+    Returns false if no data with such a hash are stored, in which case nothing is changed.
+    */
+    bool referenceExistingBlob(const QString &mailbox, const uint uid, const QByteArray &partId, const QByteArray &hash);
+    /** @short Remember that the data of a message part got stored outside of this cache, under the given @arg hash */
+    void setExternalMsgPart(const QString &mailbox, const uint uid, const QByteArray &partId, const QByteArray &hash, const quint64 size);
+    /** @short Record an access to the data of a message part, for the purposes of LRU eviction
+
+    The access is written to the DB along with the next delayed commit.
+    */
+    void noteBlobAccessed(const QByteArray &hash) const;
+    /** @short Total size of all message parts, both these in the DB and in any external storage */
+    quint64 partsSize() const;
+    /** @short Return at most @arg limit blobs, ordered by the time of their last access, oldest first */
+    QVector<BlobUsage> leastRecentlyUsedBlobs(const int limit);
+    /** @short Forget the data with the given @arg hash, along with all message parts which refer to them */
+    void evictBlob(const QByteArray &hash);
+    /** @short Forget all externally stored data which are no longer referenced, and return their hashes
+
+    The caller is responsible for removing the actual data from the external storage.
+    */
+    QVector<QByteArray> takeOrphanedExternalBlobs();
+
 private:
     /** @short Broadcast an error from the SQL query */
     void emitError(const QString &message, const QSqlQuery &query) const;
@@ -121,6 +175,7 @@ private:
     bool createTables();
     /** @short Initialize the prepared queries */
     bool prepareQueries();
+    bool migratePartsFromV7();
 
     /** @short We're about to touch the DB, so it might be a good time to start a transaction */
     void touchingDB();
@@ -128,6 +183,16 @@ private:
     /** @short Initialize the database */
     void init();
 
+    /** @short Store a reference from a message part to the data identified by @arg hash */
+    void insertPartReference(const QString &mailbox, const uint uid, const QByteArray &partId, const QByteArray &hash);
+    /** @short Drop the reference from a message part to its data, removing the data if they are no longer used */
+    void releasePartBlob(const QString &mailbox, const uint uid, const QByteArray &partId);
+    /** @short Decrement the reference count of data of all parts of a message, without touching the parts themselves */
+    void releaseMessageBlobs(const QString &mailbox, const uint uid);
+    void flushBlobAccesses();
+    void dropUnreferencedBlobs(const QSqlQuery &releaseQuery);
+    void blobsDropped(const QSqlQuery &query);
+
     static QString mailboxName(const QString &mailbox);
 
 private slots:
@@ -161,11 +226,27 @@ private:
     mutable QSqlQuery queryClearMessage1;
     mutable QSqlQuery queryClearMessage2;
     mutable QSqlQuery queryClearMessage3;
-    mutable QSqlQuery queryMessagePart;
+    mutable QSqlQuery queryPartContentHash;
+    mutable QSqlQuery queryBlob;
+    mutable QSqlQuery queryAccessBlob;
+    mutable QSqlQuery queryReferenceBlob;
+    mutable QSqlQuery queryInsertBlob;
     mutable QSqlQuery querySetMessagePart;
     mutable QSqlQuery queryForgetMessagePart;
+    mutable QSqlQuery queryReleaseBlobsMailbox;
+    mutable QSqlQuery queryReleaseBlobsMessage;
+    mutable QSqlQuery queryReleaseBlobsPart;
+    mutable QSqlQuery queryReferenceMessageBlobs;
+    mutable QSqlQuery queryCopyMessageParts;
+    mutable QSqlQuery queryDropUnreferencedBlobs;
+    mutable QSqlQuery queryOrphanedExternalBlobs;
+    mutable QSqlQuery queryDropOrphanedExternalBlobs;
     mutable QSqlQuery queryMessageThreading;
     mutable QSqlQuery querySetMessageThreading;
+    mutable QSqlQuery queryPartsSize;
+    mutable QSqlQuery queryLeastRecentlyUsedBlobs;
+    mutable QSqlQuery queryEvictBlob1;
+    mutable QSqlQuery queryEvictBlob2;
 
     std::unique_ptr<QTimer> delayedCommit;
     std::unique_ptr<QTimer> tooMuchTimeWithoutCommit;
@@ -179,6 +260,16 @@ private:
     To disable updating of the DB accesses, set to zero.
     */
     int m_updateAccessIfOlder;
+
+    /** @short Accesses to message part data which haven't been written to the DB yet: time of the last one and their count */
+    mutable QHash<QByteArray, QPair<qint64, int> > m_pendingBlobAccesses;
+    /** @short Total size of all message parts, or -1 if it has to be computed again */
+    mutable qint64 m_partsSize;
+    mutable CacheUsage m_usage;
+    mutable bool m_usageValid;
+    bool m_partStorageUpgraded;
+    /** @short Could there be some unreferenced external blobs, see takeOrphanedExternalBlobs() */
+    bool m_externalOrphansPossible;
 };
 
 }
@@ -96,14 +96,20 @@ ExpungeMailboxTask *TaskFactory::createExpungeMailboxTask(Model *model, const QM
     return new ExpungeMailboxTask(model, mailbox);
 }
 
-FetchMsgMetadataTask *TaskFactory::createFetchMsgMetadataTask(Model *model, const QModelIndex &mailbox, const Imap::Uids &uids)
+FetchMsgMetadataTask *TaskFactory::createFetchMsgMetadataTask(Model *model, const QModelIndex &mailbox, const Imap::Uids &uids,
+                                                              const TaskPriority priority)
 {
-    return new FetchMsgMetadataTask(model, mailbox, uids);
+    auto task = new FetchMsgMetadataTask(model, mailbox, uids);
+    task->setPriority(priority);
+    return task;
 }
 
-FetchMsgPartTask *TaskFactory::createFetchMsgPartTask(Model *model, const QModelIndex &mailbox, const Imap::Uids &uids, const QList<QByteArray> &parts)
+FetchMsgPartTask *TaskFactory::createFetchMsgPartTask(Model *model, const QModelIndex &mailbox, const Imap::Uids &uids, const QList<QByteArray> &parts,
+                                                      const TaskPriority priority)
 {
-    return new FetchMsgPartTask(model, mailbox, uids, parts);
+    auto task = new FetchMsgPartTask(model, mailbox, uids, parts);
+    task->setPriority(priority);
+    return task;
 }
 
 IdTask *TaskFactory::createIdTask(Model *model, ImapTask *dependingTask)
@@ -138,14 +144,14 @@ UpdateFlagsOfAllMessagesTask *TaskFactory::createUpdateFlagsOfAllMessagesTask(Mo
     return new UpdateFlagsOfAllMessagesTask(model, mailbox, flagOperation, flags);
 }
 
-UpdateFlagsTask *TaskFactory::createUpdateFlagsTask(Model *model, const QModelIndexList &messages, const FlagsOperation flagOperation, const QString &flags)
+UpdateFlagsTask *TaskFactory::createUpdateFlagsTask(Model *model, const QModelIndex &mailbox, const Imap::Uids &uids, const FlagsOperation flagOperation, const QString &flags)
 {
-    return new UpdateFlagsTask(model, messages, flagOperation, flags);
+    return new UpdateFlagsTask(model, mailbox, uids, flagOperation, flags);
 }
 
-UpdateFlagsTask *TaskFactory::createUpdateFlagsTask(Model *model, CopyMoveMessagesTask *copyTask, const QList<QPersistentModelIndex> &messages, const FlagsOperation flagOperation, const QString &flags)
+UpdateFlagsTask *TaskFactory::createUpdateFlagsTask(Model *model, CopyMoveMessagesTask *copyTask, const QModelIndex &mailbox, const Imap::Uids &uids, const FlagsOperation flagOperation, const QString &flags)
 {
-    return new UpdateFlagsTask(model, copyTask, messages, flagOperation, flags);
+    return new UpdateFlagsTask(model, copyTask, mailbox, uids, flagOperation, flags);
 }
 
 ThreadTask *TaskFactory::createThreadTask(Model *model, const QModelIndex &mailbox, const QByteArray &algorithm, const QStringList &searchCriteria)
@@ -30,6 +30,7 @@
 #include "CopyMoveOperation.h"
 #include "FlagsOperation.h"
 #include "SubscribeUnSubscribeOperation.h"
+#include "TaskPriority.h"
 #include "UidSubmitData.h"
 #include "Imap/Parser/Uids.h"
 
@@ -80,8 +81,10 @@ public:
     virtual DeleteMailboxTask *createDeleteMailboxTask(Model *model, const QString &mailbox);
     virtual EnableTask *createEnableTask(Model *model, ImapTask *dependingTask, const QList<QByteArray> &extensions);
     virtual ExpungeMailboxTask *createExpungeMailboxTask(Model *model, const QModelIndex &mailbox);
-    virtual FetchMsgMetadataTask *createFetchMsgMetadataTask(Model *model, const QModelIndex &mailbox, const Imap::Uids &uid);
-    virtual FetchMsgPartTask *createFetchMsgPartTask(Model *model, const QModelIndex &mailbox, const Imap::Uids &uids, const QList<QByteArray> &parts);
+    virtual FetchMsgMetadataTask *createFetchMsgMetadataTask(Model *model, const QModelIndex &mailbox, const Imap::Uids &uid,
+                                                             const TaskPriority priority = TaskPriority::INTERACTIVE);
+    virtual FetchMsgPartTask *createFetchMsgPartTask(Model *model, const QModelIndex &mailbox, const Imap::Uids &uids, const QList<QByteArray> &parts,
+                                                     const TaskPriority priority = TaskPriority::INTERACTIVE);
     virtual GetAnyConnectionTask *createGetAnyConnectionTask(Model *model);
     virtual IdTask *createIdTask(Model *model, ImapTask *dependingTask);
     virtual KeepMailboxOpenTask *createKeepMailboxOpenTask(Model *model, const QModelIndex &mailbox, Parser *oldParser);
@@ -92,11 +95,10 @@ public:
     virtual OpenConnectionTask *createOpenConnectionTask(Model *model);
     virtual UpdateFlagsOfAllMessagesTask *createUpdateFlagsOfAllMessagesTask(Model *model, const QModelIndex &mailbox,
             const FlagsOperation flagOperation, const QString &flags);
-    virtual UpdateFlagsTask *createUpdateFlagsTask(Model *model, const QModelIndexList &messages, const FlagsOperation flagOperation,
-            const QString &flags);
-    virtual UpdateFlagsTask *createUpdateFlagsTask(Model *model, CopyMoveMessagesTask *copyTask,
-            const QList<QPersistentModelIndex> &messages, const FlagsOperation flagOperation,
-            const QString &flags);
+    virtual UpdateFlagsTask *createUpdateFlagsTask(Model *model, const QModelIndex &mailbox, const Imap::Uids &uids,
+            const FlagsOperation flagOperation, const QString &flags);
+    virtual UpdateFlagsTask *createUpdateFlagsTask(Model *model, CopyMoveMessagesTask *copyTask, const QModelIndex &mailbox,
+            const Imap::Uids &uids, const FlagsOperation flagOperation, const QString &flags);
     virtual ThreadTask *createThreadTask(Model *model, const QModelIndex &mailbox, const QByteArray &algorithm, const QStringList &searchCriteria);
     virtual ThreadTask *createIncrementalThreadTask(Model *model, const QModelIndex &mailbox, const QByteArray &algorithm, const QStringList &searchCriteria);
     virtual NoopTask *createNoopTask(Model *model, ImapTask *parentTask);
@@ -31,7 +31,7 @@
 #include "MsgListModel.h"
 
 namespace {
-    /** @short Preallocate a bit more space in the hashmaps for future new arrivals */
+    /** @short Preallocate a bit more space in the node arrays for future new arrivals */
     const int headroomForNewmessages = 1000;
 }
 
@@ -39,14 +39,14 @@ namespace {
 using Imap::Mailbox::ThreadNodeInfo;
 
 #if 0
-QByteArray dumpThreadNodeInfo(const QHash<uint,ThreadNodeInfo> &mapping, const uint nodeId, const uint offset)
+QByteArray dumpThreadNodeInfo(const QVector<ThreadNodeInfo> &mapping, const uint nodeId, const uint offset)
 {
     QByteArray res;
     QByteArray prefix(offset, ' ');
     QTextStream ss(&res);
-    Q_ASSERT(mapping.contains(nodeId));
+    Q_ASSERT(nodeId < static_cast<uint>(mapping.size()));
     const ThreadNodeInfo &node = mapping[nodeId];
-    ss << prefix << "ThreadNodeInfo intId " << node.internalId << " UID " << node.uid << " ptr " << node.ptr <<
+    ss << prefix << "ThreadNodeInfo intId " << node.internalId << " UID " << node.uid << " source row " << node.sourceRow <<
           " parentIntId " << node.parent << "\n";
     Q_FOREACH(const uint childId, node.children) {
         ss << dumpThreadNodeInfo(mapping, childId, offset + 1);
@@ -74,7 +74,7 @@ namespace Mailbox
 {
 
 ThreadingMsgListModel::ThreadingMsgListModel(QObject *parent):
-    QAbstractProxyModel(parent), threadingHelperLastId(0), modelResetInProgress(false), threadingInFlight(false),
+    QAbstractProxyModel(parent), modelResetInProgress(false), threadingInFlight(false),
     m_shallBeThreading(false), m_filteredBySearch(false), m_sortTask(0), m_sortReverse(false), m_currentSortingCriteria(SORT_NONE),
     m_searchValidity(RESULT_INVALIDATED)
 {
@@ -88,7 +88,7 @@ void ThreadingMsgListModel::setSourceModel(QAbstractItemModel *sourceModel)
 {
     beginResetModel();
     threading.clear();
-    ptrToInternal.clear();
+    sourceRowToInternal.clear();
     unknownUids.clear();
     threadedRootIds.clear();
     m_currentSortResult.clear();
@@ -131,39 +131,40 @@ QVariant ThreadingMsgListModel::headerData(int section, Qt::Orientation orientat
 
 void ThreadingMsgListModel::handleDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
 {
-    // We don't support updates which concern multiple rows at this time.
-    // Doing that would very likely require a completely different codepath due to threading...
     Q_ASSERT(topLeft.parent() == bottomRight.parent());
-    Q_ASSERT(topLeft.row() == bottomRight.row());
-    QModelIndex translated = mapFromSource(topLeft);
-
-    emit dataChanged(translated, translated.sibling(translated.row(), bottomRight.column()));
+    TreeItemMsgList *list = sourceMessageList();
+    if (!list)
+        return;
 
-    // We provide funny data like "does this thread contain unread messages?". Now the original signal might mean that flags of a
-    // nested message have changed. In order to always be consistent, we have to find the thread root and emit dataChanged() on that
-    // as well.
-    QModelIndex rootCandidate = translated;
-    while (rootCandidate.parent().isValid()) {
-        rootCandidate = rootCandidate.parent();
-    }
-    if (rootCandidate != translated) {
-        // We're really an embedded message
-        emit dataChanged(rootCandidate, rootCandidate.sibling(rootCandidate.row(), bottomRight.column()));
-    }
+    // The rows of a range can end up anywhere in the threads, so they have to be translated one by one. That is done through
+    // our own records rather than through the source model, so that a long range doesn't instantiate each and every message.
+    for (int row = topLeft.row(); row <= bottomRight.row() && row < sourceRowToInternal.size(); ++row) {
+        const uint internalId = sourceRowToInternal[row];
+        if (isAliveNode(internalId) && threading[internalId].sourceRow == row) {
+            const int offset = threading[internalId].offset;
+            emit dataChanged(createIndex(offset, topLeft.column(), internalId), createIndex(offset, bottomRight.column(), internalId));
+
+            // We provide funny data like "does this thread contain unread messages?". Now the original signal might mean that
+            // flags of a nested message have changed. In order to always be consistent, we have to find the thread root and
+            // emit dataChanged() on that as well.
+            uint rootId = internalId;
+            while (threading[rootId].parent)
+                rootId = threading[rootId].parent;
+            if (rootId != internalId) {
+                // We're really an embedded message
+                const int rootOffset = threading[rootId].offset;
+                emit dataChanged(createIndex(rootOffset, topLeft.column(), rootId), createIndex(rootOffset, bottomRight.column(), rootId));
+            }
+        }
 
-    auto message = dynamic_cast<TreeItemMessage*>(static_cast<TreeItemMessage*>(topLeft.internalPointer()));
-    Q_ASSERT(message);
-    if (message->uid() == 0) {
-        // UID is not yet known.
-        // This is a legal situation, for example when an unsolicited FETCH FLAGS arrives and there's no UID in there.
-        return;
-    }
+        if (row >= list->messageRowCount() || list->uidAt(row) == 0) {
+            // UID is not yet known.
+            // This is a legal situation, for example when an unsolicited FETCH FLAGS arrives and there's no UID in there.
+            continue;
+        }
 
-    QSet<TreeItem*>::iterator persistent = unknownUids.find(message);
-    if (persistent != unknownUids.end()) {
-        // The message wasn't fully synced before, and now it is
-        persistent = unknownUids.erase(persistent);
-        if (unknownUids.isEmpty()) {
+        if (unknownUids.remove(internalId) && unknownUids.isEmpty()) {
+            // The last message which wasn't fully synced before now is
             wantThreading();
         }
     }
@@ -188,13 +189,14 @@ QModelIndex ThreadingMsgListModel::index(int row, int column, const QModelIndex
 
     uint parentId = parent.isValid() ? parent.internalId() : 0;
 
-    QHash<uint,ThreadNodeInfo>::const_iterator it = threading.constFind(parentId);
-    Q_ASSERT(it != threading.constEnd());
+    if (!isAliveNode(parentId))
+        return QModelIndex();
 
-    if (it->children.size() <= row)
+    const ThreadNodeInfo &node = threading[parentId];
+    if (node.children.size() <= row)
         return QModelIndex();
 
-    return createIndex(row, column, it->children[row]);
+    return createIndex(row, column, node.children[row]);
 }
 
 QModelIndex ThreadingMsgListModel::parent(const QModelIndex &index) const
@@ -208,18 +210,17 @@ QModelIndex ThreadingMsgListModel::parent(const QModelIndex &index) const
     if (index.row() < 0 || index.column() < 0 || index.column() >= MsgListModel::COLUMN_COUNT)
         return QModelIndex();
 
-    QHash<uint,ThreadNodeInfo>::const_iterator node = threading.constFind(index.internalId());
-    if (node == threading.constEnd())
+    if (!isAliveNode(index.internalId()))
         return QModelIndex();
 
-    QHash<uint,ThreadNodeInfo>::const_iterator parentNode = threading.constFind(node->parent);
-    Q_ASSERT(parentNode != threading.constEnd());
-    Q_ASSERT(parentNode->internalId == node->parent);
-
-    if (parentNode->internalId == 0)
+    const ThreadNodeInfo &node = threading[index.internalId()];
+    if (node.parent == 0)
         return QModelIndex();
 
-    return createIndex(parentNode->offset, 0, parentNode->internalId);
+    const ThreadNodeInfo &parentNode = threading[node.parent];
+    Q_ASSERT(parentNode.internalId == node.parent);
+
+    return createIndex(parentNode.offset, 0, parentNode.internalId);
 }
 
 bool ThreadingMsgListModel::hasChildren(const QModelIndex &parent) const
@@ -227,7 +228,8 @@ bool ThreadingMsgListModel::hasChildren(const QModelIndex &parent) const
     if (parent.isValid() && parent.column() != 0)
         return false;
 
-    return ! threading.isEmpty() && ! threading.value(parent.internalId()).children.isEmpty();
+    const uint parentId = parent.isValid() ? parent.internalId() : 0;
+    return isAliveNode(parentId) && ! threading[parentId].children.isEmpty();
 }
 
 int ThreadingMsgListModel::rowCount(const QModelIndex &parent) const
@@ -238,7 +240,11 @@ int ThreadingMsgListModel::rowCount(const QModelIndex &parent) const
     if (parent.isValid() && parent.column() != 0)
         return 0;
 
-    return threading.value(parent.internalId()).children.size();
+    const uint parentId = parent.isValid() ? parent.internalId() : 0;
+    if (!isAliveNode(parentId))
+        return 0;
+
+    return threading[parentId].children.size();
 }
 
 int ThreadingMsgListModel::columnCount(const QModelIndex &parent) const
@@ -254,18 +260,15 @@ QModelIndex ThreadingMsgListModel::mapToSource(const QModelIndex &proxyIndex) co
     if (!proxyIndex.isValid() || !proxyIndex.internalId())
         return QModelIndex();
 
-    if (threading.isEmpty())
+    if (!isAliveNode(proxyIndex.internalId()))
         return QModelIndex();
 
     Imap::Mailbox::MsgListModel *msgList = qobject_cast<Imap::Mailbox::MsgListModel *>(sourceModel());
     Q_ASSERT(msgList);
 
-    QHash<uint,ThreadNodeInfo>::const_iterator node = threading.constFind(proxyIndex.internalId());
-    if (node == threading.constEnd())
-        return QModelIndex();
-
-    if (node->ptr) {
-        return msgList->createIndex(node->ptr->row(), proxyIndex.column(), node->ptr);
+    const ThreadNodeInfo &node = threading[proxyIndex.internalId()];
+    if (node.sourceRow >= 0) {
+        return msgList->index(node.sourceRow, proxyIndex.column());
     } else {
         // it's a fake message
         return QModelIndex();
@@ -279,20 +282,16 @@ QModelIndex ThreadingMsgListModel::mapFromSource(const QModelIndex &sourceIndex)
 
     Q_ASSERT(sourceIndex.model() == sourceModel());
 
-    QHash<void *,uint>::const_iterator it = ptrToInternal.constFind(sourceIndex.internalPointer());
-    if (it == ptrToInternal.constEnd())
+    if (sourceIndex.row() >= sourceRowToInternal.size())
         return QModelIndex();
 
-    const uint internalId = *it;
-
-    QHash<uint,ThreadNodeInfo>::const_iterator node = threading.constFind(internalId);
-    if (node == threading.constEnd()) {
+    const uint internalId = sourceRowToInternal[sourceIndex.row()];
+    if (!isAliveNode(internalId) || threading[internalId].sourceRow != sourceIndex.row()) {
         // The filtering criteria say that this index shall not be visible
         return QModelIndex();
     }
-    Q_ASSERT(node != threading.constEnd());
 
-    return createIndex(node->offset, sourceIndex.column(), internalId);
+    return createIndex(threading[internalId].offset, sourceIndex.column(), internalId);
 }
 
 QVariant ThreadingMsgListModel::data(const QModelIndex &proxyIndex, int role) const
@@ -300,10 +299,10 @@ QVariant ThreadingMsgListModel::data(const QModelIndex &proxyIndex, int role) co
     if (! proxyIndex.isValid() || proxyIndex.model() != this)
         return QVariant();
 
-    QHash<uint,ThreadNodeInfo>::const_iterator it = threading.constFind(proxyIndex.internalId());
-    Q_ASSERT(it != threading.constEnd());
+    Q_ASSERT(isAliveNode(proxyIndex.internalId()));
+    const ThreadNodeInfo &node = threading[proxyIndex.internalId()];
 
-    if (it->ptr) {
+    if (node.sourceRow >= 0) {
         // It's a real item which exists in the underlying model
         switch (role) {
         case RoleThreadRootWithUnreadMessages:
@@ -313,10 +312,18 @@ QVariant ThreadingMsgListModel::data(const QModelIndex &proxyIndex, int role) co
                 // a reasonable result instead of whinning about callers requesting useless stuff.
                 return false;
             } else {
-                return threadContainsUnreadMessages(it->internalId);
+                return threadContainsUnreadMessages(node.internalId);
             }
         case RoleThreadAggregatedFlags:
-            return threadAggregatedFlags(it->internalId);
+            return threadAggregatedFlags(node.internalId);
+        case RoleMessageWasUnread:
+        {
+            // This one is asked for each and every message when the read ones are hidden, so it shall not instantiate them
+            TreeItemMsgList *list = sourceMessageList();
+            if (list && node.sourceRow < list->messageRowCount())
+                return list->wasUnreadAt(node.sourceRow);
+            return QAbstractProxyModel::data(proxyIndex, role);
+        }
         default:
             return QAbstractProxyModel::data(proxyIndex, role);
         }
@@ -339,9 +346,9 @@ Qt::ItemFlags ThreadingMsgListModel::flags(const QModelIndex &index) const
     if (! index.isValid() || index.model() != this)
         return Qt::NoItemFlags;
 
-    QHash<uint,ThreadNodeInfo>::const_iterator it = threading.constFind(index.internalId());
-    Q_ASSERT(it != threading.constEnd());
-    if (it->ptr && it->uid)
+    Q_ASSERT(isAliveNode(index.internalId()));
+    const ThreadNodeInfo &node = threading[index.internalId()];
+    if (node.sourceRow >= 0 && node.uid)
         return Qt::ItemIsSelectable | Qt::ItemIsDragEnabled | Qt::ItemIsEnabled;
 
     return Qt::NoItemFlags;
@@ -352,31 +359,29 @@ void ThreadingMsgListModel::handleRowsAboutToBeRemoved(const QModelIndex &parent
 {
     Q_ASSERT(!parent.isValid());
 
-    for (int i = start; i <= end; ++i) {
-        QModelIndex index = sourceModel()->index(i, 0, parent);
-        Q_ASSERT(index.isValid());
-        QModelIndex translated = mapFromSource(index);
+    for (int i = start; i <= end && i < sourceRowToInternal.size(); ++i) {
+        const uint internalId = sourceRowToInternal[i];
 
-        unknownUids.remove(static_cast<TreeItem*>(index.internalPointer()));
+        unknownUids.remove(internalId);
 
-        if (!translated.isValid()) {
+        if (!isAliveNode(internalId) || threading[internalId].sourceRow != i) {
             // The index being removed wasn't visible in our mapping anyway
             continue;
         }
 
-        Q_ASSERT(translated.isValid());
-        QHash<uint,ThreadNodeInfo>::iterator it = threading.find(translated.internalId());
-        Q_ASSERT(it != threading.end());
-        it->uid = 0;
-        it->ptr = 0;
+        ThreadNodeInfo &node = threading[internalId];
+        node.uid = 0;
+        node.sourceRow = -1;
     }
 }
 
 void ThreadingMsgListModel::handleRowsRemoved(const QModelIndex &parent, int start, int end)
 {
     Q_ASSERT(!parent.isValid());
-    Q_UNUSED(start);
-    Q_UNUSED(end);
+    if (start < sourceRowToInternal.size()) {
+        sourceRowToInternal.remove(start, qMin(end, sourceRowToInternal.size() - 1) - start + 1);
+        updateSourceRows(start);
+    }
     if (!m_delayedPrune->isActive())
         m_delayedPrune->start();
 }
@@ -394,7 +399,7 @@ void ThreadingMsgListModel::handleRowsAboutToBeInserted(const QModelIndex &paren
 {
     Q_ASSERT(!parent.isValid());
 
-    int myStart = threading[0].children.size();
+    int myStart = threading.isEmpty() ? 0 : threading[0].children.size();
     int myEnd = myStart + (end - start);
     beginInsertRows(QModelIndex(), myStart, myEnd);
 }
@@ -403,23 +408,29 @@ void ThreadingMsgListModel::handleRowsInserted(const QModelIndex &parent, int st
 {
     Q_ASSERT(!parent.isValid());
 
+    if (threading.isEmpty()) {
+        // Default-construct the root node
+        threading.append(ThreadNodeInfo());
+    }
+
+    TreeItemMsgList *list = sourceMessageList();
+    Q_ASSERT(list);
     for (int i = start; i <= end; ++i) {
-        QModelIndex index = sourceModel()->index(i, 0);
-        uint uid = index.data(RoleMessageUid).toUInt();
         ThreadNodeInfo node;
-        node.internalId = ++threadingHelperLastId;
-        node.uid = uid;
-        node.ptr = static_cast<TreeItem *>(index.internalPointer());
+        node.internalId = threading.size();
+        node.uid = list->uidAt(i);
+        node.sourceRow = i;
         node.offset = threading[0].children.size();
-        threading[node.internalId] = node;
         threading[0].children << node.internalId;
-        ptrToInternal[node.ptr] = node.internalId;
+        threading.append(node);
+        sourceRowToInternal.insert(i, node.internalId);
         if (!node.uid) {
-            unknownUids << static_cast<TreeItem*>(index.internalPointer());
+            unknownUids << node.internalId;
         } else {
             threadedRootIds.append(node.internalId);
         }
     }
+    updateSourceRows(end + 1);
     endInsertRows();
 
     if (!m_sortTask || !m_sortTask->isPersistent()) {
@@ -441,7 +452,7 @@ void ThreadingMsgListModel::resetMe()
     beginResetModel();
     modelResetInProgress = true;
     threading.clear();
-    ptrToInternal.clear();
+    sourceRowToInternal.clear();
     unknownUids.clear();
     threadedRootIds.clear();
     m_currentSortResult.clear();
@@ -456,14 +467,12 @@ void ThreadingMsgListModel::resetMe()
 
 void ThreadingMsgListModel::updateNoThreading()
 {
-    threadingHelperLastId = 0;
-
     if (!sourceModel()) {
         // Maybe we got reset because the parent model is no longer here...
         if (! threading.isEmpty()) {
             beginRemoveRows(QModelIndex(), 0, rowCount() - 1);
             threading.clear();
-            ptrToInternal.clear();
+            sourceRowToInternal.clear();
             endRemoveRows();
         }
         unknownUids.clear();
@@ -473,55 +482,44 @@ void ThreadingMsgListModel::updateNoThreading()
     emit layoutAboutToBeChanged();
     updatePersistentIndexesPhase1();
     threading.clear();
-    ptrToInternal.clear();
+    sourceRowToInternal.clear();
     unknownUids.clear();
     threadedRootIds.clear();
 
     int upstreamMessages = sourceModel()->rowCount();
-    QList<uint> allIds;
-    QHash<uint,ThreadNodeInfo> newThreading;
-    QHash<void *,uint> newPtrToInternal;
 
     if (upstreamMessages) {
-        // Prefer the direct pointer access instead of going through the MVC API -- similar to how applyThreading() works.
-        // This improves the speed of the testSortingPerformance benchmark by 18%.
-        QModelIndex firstMessageIndex = sourceModel()->index(0, 0);
-        Q_ASSERT(firstMessageIndex.isValid());
-        const Model *realModel = 0;
-        TreeItem *firstMessagePtr = Model::realTreeItem(firstMessageIndex, &realModel);
-        Q_ASSERT(firstMessagePtr);
-        // If the next asserts fails, it means that the implementation of MsgListModel has changed and uses its own pointers
-        Q_ASSERT(firstMessagePtr == firstMessageIndex.internalPointer());
-        TreeItemMsgList *list = dynamic_cast<TreeItemMsgList *>(firstMessagePtr->parent());
+        // Prefer the direct access to the list of messages instead of going through the MVC API -- similar to how
+        // applyThreading() works. This improves the speed of the testSortingPerformance benchmark by 18%, and it doesn't
+        // instantiate any messages.
+        TreeItemMsgList *list = sourceMessageList();
         Q_ASSERT(list);
 
-        newThreading.reserve(upstreamMessages + headroomForNewmessages);
-        newPtrToInternal.reserve(upstreamMessages + headroomForNewmessages);
+        // The whole tree is built in one pass; the node of the message at source row i gets the internal ID i + 1
+        threading.reserve(upstreamMessages + 1 + headroomForNewmessages);
+        sourceRowToInternal.reserve(upstreamMessages + headroomForNewmessages);
+        QVector<uint> allIds;
+        allIds.reserve(upstreamMessages + headroomForNewmessages);
+
+        // Default-construct the root node
+        threading.append(ThreadNodeInfo());
 
         for (int i = 0; i < upstreamMessages; ++i) {
-            TreeItemMessage *ptr = static_cast<TreeItemMessage*>(list->m_children[i]);
-            Q_ASSERT(ptr);
             ThreadNodeInfo node;
             node.internalId = i + 1;
-            node.uid = ptr->uid();
-            node.ptr = ptr;
+            node.uid = list->uidAt(i);
+            node.sourceRow = i;
             node.offset = i;
-            newThreading[node.internalId] = node;
+            threading.append(node);
             allIds.append(node.internalId);
-            newPtrToInternal[node.ptr] = node.internalId;
+            sourceRowToInternal.append(node.internalId);
             if (!node.uid) {
-                unknownUids << ptr;
+                unknownUids << node.internalId;
             }
         }
-    }
 
-    if (newThreading.size()) {
-        threading = newThreading;
-        ptrToInternal = newPtrToInternal;
-        threading[ 0 ].children = allIds;
-        threading[ 0 ].ptr = 0;
-        threadingHelperLastId = newThreading.size();
-        threadedRootIds = threading[0].children;
+        threading[0].children = allIds;
+        threadedRootIds = allIds;
     }
     updatePersistentIndexesPhase2();
     emit layoutChanged();
@@ -603,11 +601,11 @@ void ThreadingMsgListModel::wantThreading(const SkipSortSearch skipSortSearch)
     } else {
         // There's apparently at least one known UID whose threading info we do not know; that means that we have to ask the
         // server here.
-        auto roughlyLastKnown = const_cast<Model*>(realModel)->findMessageOrNextOneByUid(list, highestUidInThreadingLowerBound);
-        if (list->m_children.end() - roughlyLastKnown >= 50 || roughlyLastKnown == list->m_children.begin()) {
+        const int roughlyLastKnown = realModel->findMessageOrNextOneByUid(list, highestUidInThreadingLowerBound);
+        if (list->messageRowCount() - roughlyLastKnown >= 50 || roughlyLastKnown == 0) {
             askForThreading();
         } else {
-            askForThreading(static_cast<TreeItemMessage*>(*roughlyLastKnown)->uid() + 1);
+            askForThreading(list->uidAt(roughlyLastKnown) + 1);
         }
     }
 }
@@ -616,11 +614,29 @@ uint ThreadingMsgListModel::findHighestUidInMailbox(TreeItemMsgList *list)
 {
     uint highestUidInMailbox = 0;
     for (int i = sourceModel()->rowCount() - 1; i > -1 && !highestUidInMailbox; --i) {
-        highestUidInMailbox = dynamic_cast<TreeItemMessage*>(list->m_children[i])->uid();
+        highestUidInMailbox = list->uidAt(i);
     }
     return highestUidInMailbox;
 }
 
+TreeItemMsgList *ThreadingMsgListModel::sourceMessageList() const
+{
+    MsgListModel *msgList = qobject_cast<MsgListModel *>(sourceModel());
+    if (!msgList)
+        return 0;
+    msgList->checkPersistentIndex();
+    return msgList->msgListPtr;
+}
+
+void ThreadingMsgListModel::updateSourceRows(const int from)
+{
+    for (int row = from; row < sourceRowToInternal.size(); ++row) {
+        const uint internalId = sourceRowToInternal[row];
+        if (isAliveNode(internalId) && threading[internalId].sourceRow >= 0)
+            threading[internalId].sourceRow = row;
+    }
+}
+
 uint ThreadingMsgListModel::findHighEnoughNumber(const QVector<Responses::ThreadingNode> &mapping, uint marker)
 {
     if (mapping.isEmpty())
@@ -705,60 +721,191 @@ static void gatherAllUidsFromThreadNode(Imap::Uids &uids, const QVector<Response
 void ThreadingMsgListModel::slotIncrementalThreadingAvailable(const Responses::ESearch::IncrementalThreadingData_t &data)
 {
     // Preparation: get through to the real model
-    const Imap::Mailbox::Model *realModel;
+    const Imap::Mailbox::Model *constModel;
     QModelIndex someMessage = sourceModel()->index(0,0);
     Q_ASSERT(someMessage.isValid());
     QModelIndex realIndex;
-    Imap::Mailbox::Model::realTreeItem(someMessage, &realModel, &realIndex);
-    QModelIndex mailboxIndex = realIndex.parent().parent();
-    Q_ASSERT(mailboxIndex.isValid());
+    Imap::Mailbox::Model::realTreeItem(someMessage, &constModel, &realIndex);
+    Model *realModel = const_cast<Model*>(constModel);
+    TreeItemMsgList *list = dynamic_cast<TreeItemMsgList*>(static_cast<TreeItem*>(realIndex.parent().internalPointer()));
+    Q_ASSERT(list);
+
+    // Only a few threads are affected by the incremental updates, so the whole tree is not rebuilt within a layoutChanged().
+    // The existing nodes are moved to their new places instead, which means that the views keep their scrolling position
+    // and all persistent indexes remain valid.
 
-    // First phase: remove all messages mentioned in the incremental responses from their original placement
+    // First phase: find all nodes of all threads which contain any message mentioned in the incremental responses
     Imap::Uids affectedUids;
     for (Responses::ESearch::IncrementalThreadingData_t::const_iterator it = data.constBegin(); it != data.constEnd(); ++it) {
         gatherAllUidsFromThreadNode(affectedUids, it->thread);
     }
-    qSort(affectedUids);
-    QList<TreeItemMessage*> affectedMessages = const_cast<Model*>(realModel)->
-            findMessagesByUids(static_cast<TreeItemMailbox*>(mailboxIndex.internalPointer()), affectedUids);
-    QHash<uint,void *> uidToPtrCache;
-
-
-    emit layoutAboutToBeChanged();
-    updatePersistentIndexesPhase1();
-    for (QList<TreeItemMessage*>::const_iterator it = affectedMessages.constBegin(); it != affectedMessages.constEnd(); ++it) {
-        QHash<void *,uint>::const_iterator ptrMappingIt = ptrToInternal.constFind(*it);
-        Q_ASSERT(ptrMappingIt != ptrToInternal.constEnd());
-        QHash<uint,ThreadNodeInfo>::iterator threadIt = threading.find(*ptrMappingIt);
-        Q_ASSERT(threadIt != threading.end());
-        uidToPtrCache[(*it)->uid()] = threadIt->ptr;
-        threadIt->ptr = 0;
+    std::vector<bool> isOldRoot(threading.size(), false);
+    std::vector<uint> oldNodes;
+    Q_FOREACH(const uint uid, affectedUids) {
+        uint internalId = uid ? findNodeByUid(realModel, list, uid) : 0;
+        if (!internalId)
+            continue;
+        while (threading[internalId].parent)
+            internalId = threading[internalId].parent;
+        if (!isOldRoot[internalId]) {
+            isOldRoot[internalId] = true;
+            oldNodes.push_back(internalId);
+        }
+    }
+    for (std::vector<uint>::size_type i = 0; i < oldNodes.size(); ++i) {
+        const QVector<uint> &children = threading[oldNodes[i]].children;
+        oldNodes.insert(oldNodes.end(), children.constBegin(), children.constEnd());
     }
-    pruneTree();
-    updatePersistentIndexesPhase2();
-    emit layoutChanged();
 
-    // Second phase: for each message whose UID is returned by the server, update the threading data
-    QSet<uint> usedNodes;
-    emit layoutAboutToBeChanged();
-    updatePersistentIndexesPhase1();
+    // Second phase: for each message whose UID is returned by the server, move it to its new place
+    std::vector<bool> placed(threading.size(), false);
     for (Responses::ESearch::IncrementalThreadingData_t::const_iterator it = data.constBegin(); it != data.constEnd(); ++it) {
-        registerThreading(it->thread, 0, uidToPtrCache, usedNodes);
-        int actualOffset = threading[0].children.size() - 1;
-        int expectedOffsetOfPrevious = threading[0].children.indexOf(it->previousThreadRoot);
-        if (actualOffset == expectedOffsetOfPrevious + 1) {
-            // it's on the correct position, yay!
+        int offset = 0;
+        uint previousId = it->previousThreadRoot ? findNodeByUid(realModel, list, it->previousThreadRoot) : 0;
+        if (previousId) {
+            while (threading[previousId].parent)
+                previousId = threading[previousId].parent;
+            offset = threading[previousId].offset + 1;
+        }
+        placeThreadNodes(it->thread, 0, offset, realModel, list, placed);
+    }
+
+    // Third phase: get rid of whatever remained from the original threads. The children are visited before their parents.
+    for (auto it = oldNodes.crbegin(); it != oldNodes.crend(); ++it) {
+        const uint internalId = *it;
+        if (placed[internalId] || !isAliveNode(internalId))
+            continue;
+        if (threading[internalId].sourceRow >= 0) {
+            // A message which was not mentioned by the server. It either stays in place along with its parent, or it becomes
+            // a standalone thread.
+            const uint parentId = threading[internalId].parent;
+            if (parentId && ((parentId < placed.size() && placed[parentId]) || threading[parentId].sourceRow < 0))
+                moveNode(internalId, 0, threading[0].children.size());
         } else {
-            // move the new subthread to a correct place
-            threading[0].children.insert(expectedOffsetOfPrevious + 1, threading[0].children.takeLast());
-            // push the rest (including the new arrival) forward
-            for (int i = expectedOffsetOfPrevious + 1; i < threading[0].children.size(); ++i) {
-                threading[threading[0].children[i]].offset = i;
+            // A fake node which is no longer needed
+            while (!threading[internalId].children.isEmpty())
+                moveNode(threading[internalId].children.first(), 0, threading[0].children.size());
+            removeLeafNode(internalId);
+        }
+    }
+}
+
+void ThreadingMsgListModel::placeThreadNodes(const QVector<Responses::ThreadingNode> &mapping, const uint parentId, int offset,
+                                             Model *realModel, TreeItemMsgList *list, std::vector<bool> &placed)
+{
+    Q_FOREACH(const Imap::Responses::ThreadingNode &node, mapping) {
+        uint nodeId = node.num ? findNodeByUid(realModel, list, node.num) : 0;
+        if (nodeId && (nodeId >= placed.size() || placed[nodeId])) {
+            // A single message cannot be shown at two places
+            nodeId = 0;
+        }
+
+        if (nodeId) {
+            if (threading[nodeId].parent == parentId && threading[nodeId].offset < offset) {
+                // The target offset was determined as if this node was not among the siblings yet
+                --offset;
             }
+            moveNode(nodeId, parentId, offset);
+            placed[nodeId] = true;
+        } else {
+            // Either this is an empty node, or the message is no longer in the mailbox
+            nodeId = insertFakeNode(parentId, offset);
         }
+        placeThreadNodes(node.children, nodeId, 0, realModel, list, placed);
+        ++offset;
     }
-    updatePersistentIndexesPhase2();
-    emit layoutChanged();
+}
+
+void ThreadingMsgListModel::moveNode(const uint internalId, const uint newParentId, const int newOffset)
+{
+    Q_ASSERT(isAliveNode(internalId));
+    Q_ASSERT(isAliveNode(newParentId));
+    const uint oldParentId = threading[internalId].parent;
+    const int oldOffset = threading[internalId].offset;
+    if (oldParentId == newParentId && oldOffset == newOffset)
+        return;
+
+    // Qt wants the destination row as it is prior to the move
+    const int destination = oldParentId == newParentId && newOffset > oldOffset ? newOffset + 1 : newOffset;
+    bool ok = beginMoveRows(indexForNode(oldParentId), oldOffset, oldOffset, indexForNode(newParentId), destination);
+    Q_ASSERT(ok);
+    Q_UNUSED(ok);
+
+    threading[oldParentId].children.remove(oldOffset);
+    threading[newParentId].children.insert(newOffset, internalId);
+    threading[internalId].parent = newParentId;
+    if (oldParentId == newParentId) {
+        renumberChildren(newParentId, qMin(oldOffset, newOffset));
+    } else {
+        renumberChildren(oldParentId, oldOffset);
+        renumberChildren(newParentId, newOffset);
+    }
+
+    if (oldParentId == 0)
+        threadedRootIds.removeOne(internalId);
+    if (newParentId == 0)
+        registerThreadRoot(internalId);
+    endMoveRows();
+}
+
+uint ThreadingMsgListModel::insertFakeNode(const uint parentId, const int offset)
+{
+    Q_ASSERT(isAliveNode(parentId));
+    beginInsertRows(indexForNode(parentId), offset, offset);
+    ThreadNodeInfo fake;
+    fake.internalId = threading.size();
+    fake.parent = parentId;
+    threading.append(fake);
+    threading[parentId].children.insert(offset, fake.internalId);
+    renumberChildren(parentId, offset);
+    if (parentId == 0)
+        registerThreadRoot(fake.internalId);
+    endInsertRows();
+    return fake.internalId;
+}
+
+void ThreadingMsgListModel::removeLeafNode(const uint internalId)
+{
+    Q_ASSERT(isAliveNode(internalId));
+    Q_ASSERT(threading[internalId].children.isEmpty());
+    const uint parentId = threading[internalId].parent;
+    const int offset = threading[internalId].offset;
+    beginRemoveRows(indexForNode(parentId), offset, offset);
+    threading[parentId].children.remove(offset);
+    threading[internalId] = ThreadNodeInfo();
+    renumberChildren(parentId, offset);
+    if (parentId == 0)
+        threadedRootIds.removeOne(internalId);
+    endRemoveRows();
+}
+
+void ThreadingMsgListModel::renumberChildren(const uint parentId, const int from)
+{
+    const QVector<uint> &children = threading[parentId].children;
+    for (int i = from; i < children.size(); ++i) {
+        Q_ASSERT(isAliveNode(children[i]));
+        threading[children[i]].offset = i;
+    }
+}
+
+void ThreadingMsgListModel::registerThreadRoot(const uint internalId)
+{
+    // Keep the same order as the one of the top-level nodes; a new root goes right after its preceding sibling
+    const int offset = threading[internalId].offset;
+    if (offset == 0) {
+        threadedRootIds.prepend(internalId);
+        return;
+    }
+    const int previous = threadedRootIds.indexOf(threading[0].children[offset - 1]);
+    threadedRootIds.insert(previous == -1 ? threadedRootIds.size() : previous + 1, internalId);
+}
+
+QModelIndex ThreadingMsgListModel::indexForNode(const uint internalId) const
+{
+    if (!internalId)
+        return QModelIndex();
+    Q_ASSERT(isAliveNode(internalId));
+    return createIndex(threading[internalId].offset, 0, internalId);
 }
 
 void ThreadingMsgListModel::slotIncrementalThreadingFailed()
@@ -914,11 +1061,10 @@ void ThreadingMsgListModel::calculateNullSort()
     m_currentSortResult.clear();
     m_currentSortResult.reserve(threadedRootIds.size() + headroomForNewmessages);
     Q_FOREACH(const uint internalId, threadedRootIds) {
-        QHash<uint,ThreadNodeInfo>::const_iterator it = threading.constFind(internalId);
-        if (it == threading.constEnd())
+        if (!isAliveNode(internalId))
             continue;
-        if (it->uid)
-            m_currentSortResult.append(it->uid);
+        if (threading[internalId].uid)
+            m_currentSortResult.append(threading[internalId].uid);
     }
     m_searchValidity = RESULT_FRESH;
 }
@@ -936,66 +1082,52 @@ void ThreadingMsgListModel::applyThreading(const QVector<Imap::Responses::Thread
     updatePersistentIndexesPhase1();
 
     threading.clear();
-    ptrToInternal.clear();
-    // Default-construct the root node
-    threading[ 0 ].ptr = 0;
+    sourceRowToInternal.clear();
 
     // At first, initialize threading nodes for all messages which are right now available in the mailbox.
-    // We risk that we will have to delete some of them later on, but this is likely better than doing a lookup
-    // for each UID individually (remember, the THREAD response might contain UIDs in crazy order).
+    // We risk that we will have to forget some of them later on, but the node of each message can then be found through
+    // its row in the source model, which is cheap to obtain from its UID (remember, the THREAD response might contain UIDs
+    // in crazy order).
     int upstreamMessages = sourceModel()->rowCount();
-    QHash<uint,void *> uidToPtrCache;
-    QSet<uint> usedNodes;
-    uidToPtrCache.reserve(upstreamMessages + headroomForNewmessages);
-    threading.reserve(upstreamMessages + headroomForNewmessages);
-    ptrToInternal.reserve(upstreamMessages + headroomForNewmessages);
+    threading.reserve(upstreamMessages + 1 + headroomForNewmessages);
+    sourceRowToInternal.reserve(upstreamMessages + headroomForNewmessages);
 
+    // Default-construct the root node
+    threading.append(ThreadNodeInfo());
+
+    Model *realModel = 0;
+    TreeItemMsgList *list = 0;
     if (upstreamMessages) {
-        // Work with pointers instead going through the MVC API for performance.
+        // Work with the list of messages directly instead going through the MVC API for performance.
         // This matters (at least that's what by benchmarks said).
-        QModelIndex firstMessageIndex = sourceModel()->index(0, 0);
-        Q_ASSERT(firstMessageIndex.isValid());
-        const Model *realModel = 0;
-        TreeItem *firstMessagePtr = Model::realTreeItem(firstMessageIndex, &realModel);
-        Q_ASSERT(firstMessagePtr);
-        // If the next asserts fails, it means that the implementation of MsgListModel has changed and uses its own pointers
-        Q_ASSERT(firstMessagePtr == firstMessageIndex.internalPointer());
-        TreeItemMsgList *list = dynamic_cast<TreeItemMsgList *>(firstMessagePtr->parent());
+        realModel = qobject_cast<Model *>(qobject_cast<MsgListModel *>(sourceModel())->sourceModel());
+        Q_ASSERT(realModel);
+        list = sourceMessageList();
         Q_ASSERT(list);
         for (int i = 0; i < upstreamMessages; ++i) {
             ThreadNodeInfo node;
-            node.uid = dynamic_cast<TreeItemMessage *>(list->m_children[i])->uid();
+            node.uid = list->uidAt(i);
             if (! node.uid) {
                 throw UnknownMessageIndex("Encountered a message with zero UID when threading. This is a bug in Trojita, sorry.");
             }
 
             node.internalId = i + 1;
-            node.ptr = list->m_children[i];
-            uidToPtrCache[node.uid] = node.ptr;
-            threadingHelperLastId = node.internalId;
-            // We're creating a new node here
-            Q_ASSERT(!threading.contains(node.internalId));
-            threading[ node.internalId ] = node;
-            ptrToInternal[ node.ptr ] = node.internalId;
+            node.sourceRow = i;
+            // Not placed into the tree yet
+            node.offset = -1;
+            threading.append(node);
+            sourceRowToInternal.append(node.internalId);
         }
     }
 
-    // Mark the root node as always present
-    usedNodes.insert(0);
-
-    // Set up parents and find the list of all used nodes
-    registerThreading(mapping, 0, uidToPtrCache, usedNodes);
+    // Set up parents and place all used nodes into the tree
+    registerThreading(mapping, 0, realModel, list);
 
-    // Now remove all messages which were not referenced in the THREAD response from our mapping
-    QHash<uint,ThreadNodeInfo>::iterator it = threading.begin();
-    while (it != threading.end()) {
-        if (usedNodes.contains(it.key())) {
-            // this message should be shown
-            ++it;
-        } else {
+    // Now forget all messages which were not referenced in the THREAD response
+    for (int i = 1; i <= upstreamMessages; ++i) {
+        if (threading[i].offset == -1) {
             // this message is not included in the list of messages actually to be shown
-            ptrToInternal.remove(it->ptr);
-            it = threading.erase(it);
+            threading[i] = ThreadNodeInfo();
         }
     }
     pruneTree();
@@ -1008,201 +1140,194 @@ void ThreadingMsgListModel::applyThreading(const QVector<Imap::Responses::Thread
     searchSortPreferenceImplementation(m_currentSearchConditions, m_currentSortingCriteria, m_sortReverse ? Qt::DescendingOrder : Qt::AscendingOrder);
 }
 
-void ThreadingMsgListModel::registerThreading(const QVector<Imap::Responses::ThreadingNode> &mapping, uint parentId, const QHash<uint,void *> &uidToPtr, QSet<uint> &usedNodes)
+void ThreadingMsgListModel::registerThreading(const QVector<Imap::Responses::ThreadingNode> &mapping, uint parentId,
+                                              Model *realModel, TreeItemMsgList *list)
 {
     Q_FOREACH(const Imap::Responses::ThreadingNode &node, mapping) {
-        uint nodeId;
-        QHash<uint,void *>::const_iterator ptrIt;
-        if (node.num == 0 ||
-                (ptrIt = uidToPtr.find(node.num)) == uidToPtr.constEnd()) {
+        uint nodeId = node.num && list ? findNodeByUid(realModel, list, node.num) : 0;
+        if (nodeId && threading[nodeId].offset != -1) {
+            // Only the nodes which were prepared for this round and which were not placed into the tree yet are eligible;
+            // anything else would mean that a single message is referenced from two places.
+            nodeId = 0;
+        }
+
+        if (!nodeId) {
             // Either this is an empty node, or the THREAD response references a UID which is no longer in the mailbox.
             // This is a valid scenario; it can happen e.g. when reusing data from cache, or when a message got
             // expunged after the untagged THREAD was received, but before the tagged OK.
             // We cannot just ignore this node, though, because it might have some children which we would otherwise
             // simply hide.
-            // The ptrIt which is initialized by the condition is used in the else branch.
             ThreadNodeInfo fake;
-            fake.internalId = ++threadingHelperLastId;
-            fake.parent = parentId;
-            Q_ASSERT(threading.contains(parentId));
-            // The child will be registered to the list of parent's children after the if/else branch
-            threading[ fake.internalId ] = fake;
+            fake.internalId = threading.size();
+            Q_ASSERT(isAliveNode(parentId));
+            // The child will be registered to the list of parent's children below
+            threading.append(fake);
             nodeId = fake.internalId;
-        } else {
-            QHash<void *,uint>::const_iterator nodeIt = ptrToInternal.constFind(*ptrIt);
-            // The following assert would fail if there was a node with a valid UID, but not in our ptrToInternal mapping.
-            // That is however non-issue, as we pre-create nodes for all messages beforehand.
-            Q_ASSERT(nodeIt != ptrToInternal.constEnd());
-            nodeId = *nodeIt;
-            // This is needed for the incremental stuff
-            threading[nodeId].ptr = static_cast<TreeItem*>(*ptrIt);
         }
         threading[nodeId].offset = threading[parentId].children.size();
-        threading[ parentId ].children.append(nodeId);
-        threading[ nodeId ].parent = parentId;
-        usedNodes.insert(nodeId);
-        registerThreading(node.children, nodeId, uidToPtr, usedNodes);
+        threading[parentId].children.append(nodeId);
+        threading[nodeId].parent = parentId;
+        registerThreading(node.children, nodeId, realModel, list);
     }
 }
 
+bool ThreadingMsgListModel::isAliveNode(const uint internalId) const
+{
+    return internalId < static_cast<uint>(threading.size()) && threading[internalId].internalId == internalId;
+}
+
+uint ThreadingMsgListModel::findNodeByUid(Model *realModel, TreeItemMsgList *list, const uint uid) const
+{
+    // The list of messages is sorted by UID, so the message (and therefore its source row and our node) can be found through
+    // a binary search
+    const int row = realModel->findMessageOrNextOneByUid(list, uid);
+    if (row >= list->messageRowCount() || list->uidAt(row) != uid)
+        return 0;
+    if (row >= sourceRowToInternal.size())
+        return 0;
+    const uint internalId = sourceRowToInternal[row];
+    return isAliveNode(internalId) && threading[internalId].sourceRow >= 0 ? internalId : 0;
+}
+
 /** @short Gather a list of persistent indexes which we have to transform after out layout change */
 void ThreadingMsgListModel::updatePersistentIndexesPhase1()
 {
     oldPersistentIndexes = persistentIndexList();
-    oldPtrs.clear();
+    oldSourceRows.clear();
+    oldSourceRows.reserve(oldPersistentIndexes.size());
     Q_FOREACH(const QModelIndex &idx, oldPersistentIndexes) {
         // the index could get invalidated by the pruneTree() or something else manipulating our threading
-        bool isOk = idx.isValid() && threading.contains(idx.internalId());
+        bool isOk = idx.isValid() && isAliveNode(idx.internalId());
         if (!isOk) {
-            oldPtrs << 0;
+            oldSourceRows << -1;
             continue;
         }
         QModelIndex translated = mapToSource(idx);
         if (!translated.isValid()) {
             // another stale item
-            oldPtrs << 0;
+            oldSourceRows << -1;
             continue;
         }
-        oldPtrs << translated.internalPointer();
+        oldSourceRows << translated.row();
     }
 }
 
 /** @short Update the gathered persistent indexes after our change in the layout */
 void ThreadingMsgListModel::updatePersistentIndexesPhase2()
 {
-    Q_ASSERT(oldPersistentIndexes.size() == oldPtrs.size());
+    Q_ASSERT(oldPersistentIndexes.size() == oldSourceRows.size());
     QList<QModelIndex> updatedIndexes;
     for (int i = 0; i < oldPersistentIndexes.size(); ++i) {
-        QHash<void *,uint>::const_iterator ptrIt = ptrToInternal.constFind(oldPtrs[i]);
-        if (ptrIt == ptrToInternal.constEnd()) {
+        const int row = oldSourceRows[i];
+        if (row < 0 || row >= sourceRowToInternal.size()) {
             // That message is no longer there
             updatedIndexes.append(QModelIndex());
             continue;
         }
-        QHash<uint,ThreadNodeInfo>::const_iterator it = threading.constFind(*ptrIt);
-        if (it == threading.constEnd()) {
+        const uint internalId = sourceRowToInternal[row];
+        if (!isAliveNode(internalId) || threading[internalId].sourceRow < 0) {
             // Filtering doesn't accept this index, let's declare it dead
             updatedIndexes.append(QModelIndex());
         } else {
-            updatedIndexes.append(createIndex(it->offset, oldPersistentIndexes[i].column(), it->internalId));
+            updatedIndexes.append(createIndex(threading[internalId].offset, oldPersistentIndexes[i].column(), internalId));
         }
     }
     Q_ASSERT(oldPersistentIndexes.size() == updatedIndexes.size());
     changePersistentIndexList(oldPersistentIndexes, updatedIndexes);
     oldPersistentIndexes.clear();
-    oldPtrs.clear();
+    oldSourceRows.clear();
 }
 
 void ThreadingMsgListModel::pruneTree()
 {
-    // Our mapping (threading) is completely unsorted, which means that we simply don't have any way of walking the tree from
-    // the top. Instead, we got to work with a random walk, processing nodes in an unspecified order.  If we iterated on the QHash
-    // directly, we'd hit an issue with iterator ordering (basically, we want to be able to say "hey, I don't care at which point
-    // of the iteration I'm right now, the next node to process should be that one, and then we should resume with the rest").
-    QList<uint> pending = threading.keys();
+    // The nodes are visited in the order of their internal IDs, which is unrelated to the shape of the tree. That is fine,
+    // though, because the removal of a fake node never turns any other node into a fake one.
 
     // These are the parents whose children will have to be renumbered later on
-    QSet<uint> parentsForRenumbering;
-
-    for (QList<uint>::iterator id = pending.begin(); id != pending.end(); /* nothing */) {
-        // Convert to the hashmap
-        // The "it" iterator point to the current node in the threading mapping
-        QHash<uint, ThreadNodeInfo>::iterator it = threading.find(*id);
-        if (it == threading.end()) {
-            // We've already seen this node, that's due to promoting
+    std::vector<bool> needsRenumbering(threading.size(), false);
+
+    for (uint id = 1; id < static_cast<uint>(threading.size()); /* nothing */) {
+        if (!isAliveNode(id)) {
+            // This one is already gone
             ++id;
             continue;
         }
 
-        if (it->internalId == 0) {
-            // A special root item; we should not delete that one :)
+        ThreadNodeInfo &node = threading[id];
+        if (node.sourceRow >= 0) {
+            // regular and valid message -> skip
             ++id;
             continue;
         }
-        if (it->ptr) {
-            // regular and valid message -> skip
-            ++id;
-        } else {
-            // a fake one
-
-            // each node has a parent
-            QHash<uint, ThreadNodeInfo>::iterator parent = threading.find(it->parent);
-            Q_ASSERT(parent != threading.end());
-
-            // and the node itself has to be found in its parent's children
-            QList<uint>::iterator childIt = qFind(parent->children.begin(), parent->children.end(), it->internalId);
-            Q_ASSERT(childIt != parent->children.end());
-            // The offset of this child might no longer be correct, though -- we're postponing the actual deletion until later
-
-            if (it->children.isEmpty()) {
-                // This is a leaf node, so we can just remove it
-                childIt = parent->children.erase(childIt);
-                // We do not perform the renumbering immediately, that would lead to an O(n^2) performance when deleting nodes.
-                parentsForRenumbering.insert(it->parent);
-                parentsForRenumbering.remove(it->internalId);
-
-                if (it->parent == 0) {
-                    threadedRootIds.removeOne(it->internalId);
-                }
-                threading.erase(it);
-                ++id;
 
-            } else {
-                // This node has some children, so we can't just delete it. Instead of that, we promote its first child
-                // to replace this node.
-                QHash<uint, ThreadNodeInfo>::iterator replaceWith = threading.find(it->children.first());
-                Q_ASSERT(replaceWith != threading.end());
-
-                // The offsets will, again, be updated later on
-                parentsForRenumbering.insert(it->parent);
-                parentsForRenumbering.insert(replaceWith.key());
-                parentsForRenumbering.remove(it->internalId);
-
-                // Replace the node
-                *childIt = it->children.first();
-                replaceWith->parent = parent->internalId;
-
-                // Now merge the lists of children
-                it->children.removeFirst();
-                replaceWith->children = replaceWith->children + it->children;
-
-                // Fix parent information of all children of the replacement node
-                for (int i = 0; i < replaceWith->children.size(); ++i) {
-                    QHash<uint, ThreadNodeInfo>::iterator sibling = threading.find(replaceWith->children[i]);
-                    Q_ASSERT(sibling != threading.end());
-                    sibling->parent = replaceWith.key();
-                }
+        // a fake one
 
-                if (parent->internalId == 0) {
-                    // Update the list of all thread roots
-                    QList<uint>::iterator rootIt = qFind(threadedRootIds.begin(), threadedRootIds.end(), it->internalId);
-                    if (rootIt != threadedRootIds.end())
-                        *rootIt = replaceWith->internalId;
-                }
+        // each node has a parent
+        const uint parentId = node.parent;
+        Q_ASSERT(isAliveNode(parentId));
+        ThreadNodeInfo &parent = threading[parentId];
 
-                // Now that all references are gone, remove the original node
-                threading.erase(it);
+        // and the node itself has to be found in its parent's children
+        QVector<uint>::iterator childIt = std::find(parent.children.begin(), parent.children.end(), id);
+        Q_ASSERT(childIt != parent.children.end());
+        // The offset of this child might no longer be correct, though -- we're postponing the actual deletion until later
 
-                if (!replaceWith->ptr) {
-                    // If the just-promoted item is also a fake one, we'll have to visit it as well. This assignment is safe,
-                    // because we've already processed the current item and are completely done with it. The worst which can
-                    // happen is that we'll visit the same node twice, which is reasonably acceptable.
-                    *id = replaceWith.key();
-                }
+        if (node.children.isEmpty()) {
+            // This is a leaf node, so we can just remove it
+            parent.children.erase(childIt);
+            // We do not perform the renumbering immediately, that would lead to an O(n^2) performance when deleting nodes.
+            needsRenumbering[parentId] = true;
+
+            if (parentId == 0) {
+                threadedRootIds.removeOne(id);
+            }
+            threading[id] = ThreadNodeInfo();
+            ++id;
+
+        } else {
+            // This node has some children, so we can't just delete it. Instead of that, we promote its first child
+            // to replace this node.
+            const uint replacementId = node.children.first();
+            Q_ASSERT(isAliveNode(replacementId));
+            ThreadNodeInfo &replaceWith = threading[replacementId];
+
+            // The offsets will, again, be updated later on
+            needsRenumbering[parentId] = true;
+            needsRenumbering[replacementId] = true;
+
+            // Replace the node
+            *childIt = replacementId;
+            replaceWith.parent = parentId;
+
+            // Now merge the lists of children
+            node.children.removeFirst();
+            replaceWith.children += node.children;
+
+            // Fix parent information of all children of the replacement node
+            Q_FOREACH(const uint sibling, replaceWith.children) {
+                threading[sibling].parent = replacementId;
             }
+
+            if (parentId == 0) {
+                // Update the list of all thread roots
+                QVector<uint>::iterator rootIt = std::find(threadedRootIds.begin(), threadedRootIds.end(), id);
+                if (rootIt != threadedRootIds.end())
+                    *rootIt = replacementId;
+            }
+
+            // Now that all references are gone, remove the original node
+            threading[id] = ThreadNodeInfo();
+
+            // If the just-promoted item is also a fake one, we'll have to visit it as well. All fake nodes with lower IDs
+            // than the current one are gone already, so it is going to be reached in due course.
+            ++id;
         }
     }
 
     // Now fix the sequential numbering of all siblings of deleted children
-    Q_FOREACH(const auto parentId, parentsForRenumbering) {
-        auto parentIt = threading.constFind(parentId);
-        Q_ASSERT(parentIt != threading.constEnd());
-        int offset = 0;
-        for (auto childNumber = parentIt->children.constBegin(); childNumber != parentIt->children.constEnd(); ++childNumber, ++offset) {
-            auto childIt = threading.find(*childNumber);
-            Q_ASSERT(childIt != threading.end());
-            childIt->offset = offset;
-        }
+    for (uint parentId = 0; parentId < needsRenumbering.size(); ++parentId) {
+        if (needsRenumbering[parentId] && isAliveNode(parentId))
+            renumberChildren(parentId, 0);
     }
 }
 
@@ -1229,15 +1354,15 @@ QMimeData *ThreadingMsgListModel::mimeData(const QModelIndexList &indexes) const
 }
 
 template<typename T>
-bool threadForeachCallback(std::function<T(const TreeItemMessage &)> callback, const TreeItemMessage &message)
+bool threadForeachCallback(std::function<T(const int)> callback, const int sourceRow)
 {
-    callback(message);
+    callback(sourceRow);
     return false;
 }
 template<>
-bool threadForeachCallback<const bool>(std::function<const bool(const TreeItemMessage &)> callback, const TreeItemMessage &message)
+bool threadForeachCallback<const bool>(std::function<const bool(const int)> callback, const int sourceRow)
 {
-    return callback(message);
+    return callback(sourceRow);
 }
 
 /** @short Execute the provided function once for each message
@@ -1245,31 +1370,31 @@ bool threadForeachCallback<const bool>(std::function<const bool(const TreeItemMe
 Returns immediately if the provided function returns `true`.
 */
 template<typename T>
-void ThreadingMsgListModel::threadForeach(const uint &root, std::function<T(const TreeItemMessage &)> callback) const
+void ThreadingMsgListModel::threadForeach(const uint &root, std::function<T(const int)> callback) const
 {
-    QList<uint> queue;
+    QVector<uint> queue;
     queue.append(root);
-    while (! queue.isEmpty()) {
-        uint current = queue.takeFirst();
-        QHash<uint,ThreadNodeInfo>::const_iterator it = threading.constFind(current);
-        Q_ASSERT(it != threading.constEnd());
-        if (it->ptr) {
-            // Because of the delayed delete via pruneTree, we can hit a null pointer here
-            TreeItemMessage *message = dynamic_cast<TreeItemMessage *>(it->ptr);
-            Q_ASSERT(message);
-            if (threadForeachCallback(callback, *message))
+    for (int i = 0; i < queue.size(); ++i) {
+        Q_ASSERT(isAliveNode(queue[i]));
+        const ThreadNodeInfo &node = threading[queue[i]];
+        if (node.sourceRow >= 0) {
+            // Because of the delayed delete via pruneTree, we can hit a fake node here
+            if (threadForeachCallback(callback, node.sourceRow))
                 return;
         }
-        queue.append(it->children);
+        queue += node.children;
     }
 }
 
 bool ThreadingMsgListModel::threadContainsUnreadMessages(const uint root) const
 {
     // FIXME: cache the value somewhere...
+    TreeItemMsgList *list = sourceMessageList();
+    if (!list)
+        return false;
     bool containsUnreadMessages = false;
-    threadForeach<bool>(root, [&containsUnreadMessages](const TreeItemMessage &message) -> bool {
-        return containsUnreadMessages = ! message.isMarkedAsRead();
+    threadForeach<bool>(root, [list, &containsUnreadMessages](const int row) -> bool {
+        return containsUnreadMessages = ! list->isMarkedAsReadAt(row);
     });
     return containsUnreadMessages;
 }
@@ -1277,9 +1402,12 @@ bool ThreadingMsgListModel::threadContainsUnreadMessages(const uint root) const
 QStringList ThreadingMsgListModel::threadAggregatedFlags(const uint root) const
 {
     // FIXME: cache the value somewhere...
+    TreeItemMsgList *list = sourceMessageList();
+    if (!list)
+        return QStringList();
     QStringList aggregatedFlags;
-    threadForeach<void>(root, [&aggregatedFlags](const TreeItemMessage &message) {
-        aggregatedFlags += message.m_flags;
+    threadForeach<void>(root, [list, &aggregatedFlags](const int row) {
+        aggregatedFlags += list->flagsAt(row);
     });
     aggregatedFlags.removeDuplicates();
     return aggregatedFlags;
@@ -1462,49 +1590,57 @@ void ThreadingMsgListModel::applySort()
     QModelIndex someMessage = sourceModel()->index(0,0);
     QModelIndex realIndex;
     Model::realTreeItem(someMessage, &realModel, &realIndex);
-    TreeItemMailbox *mailbox = dynamic_cast<TreeItemMailbox*>(static_cast<TreeItem*>(realIndex.parent().parent().internalPointer()));
-    Q_ASSERT(mailbox);
+    TreeItemMsgList *list = dynamic_cast<TreeItemMsgList*>(static_cast<TreeItem*>(realIndex.parent().internalPointer()));
+    Q_ASSERT(list);
 
     emit layoutAboutToBeChanged();
     updatePersistentIndexesPhase1();
-    QSet<uint> newlyUnreachable(threading[0].children.toSet());
+    QVector<uint> oldRoots = threading[0].children;
     threading[0].children.clear();
     threading[0].children.reserve(m_currentSortResult.size() + headroomForNewmessages);
 
-    QSet<uint> allRootIds(threadedRootIds.toSet());
+    std::vector<bool> isThreadRoot(threading.size(), false);
+    Q_FOREACH(const uint internalId, threadedRootIds) {
+        if (isAliveNode(internalId))
+            isThreadRoot[internalId] = true;
+    }
+    std::vector<bool> isShown(threading.size(), false);
 
     for (int i = 0; i < m_currentSortResult.size(); ++i) {
         int offset = m_sortReverse ? m_currentSortResult.size() - 1 - i : i;
-        QList<TreeItemMessage *> messages = const_cast<Model*>(realModel)
-                ->findMessagesByUids(mailbox, Imap::Uids() << m_currentSortResult[offset]);
-        if (messages.isEmpty()) {
+        const uint uid = m_currentSortResult[offset];
+        const int row = realModel->findMessageOrNextOneByUid(list, uid);
+        if (row >= list->messageRowCount() || list->uidAt(row) != uid) {
             // wrong UID, weird
             continue;
         }
-        Q_ASSERT(messages.size() == 1);
-        QHash<void *,uint>::const_iterator it = ptrToInternal.constFind(messages.front());
         // else applyThreading() taking care of it
         if (!threadingInFlight)
-            Q_ASSERT(it != ptrToInternal.constEnd());
-        if (!allRootIds.contains(*it)) {
+            Q_ASSERT(row < sourceRowToInternal.size());
+        if (row >= sourceRowToInternal.size())
+            continue;
+        const uint internalId = sourceRowToInternal[row];
+        if (!isAliveNode(internalId) || !isThreadRoot[internalId] || isShown[internalId]) {
             // not a thread root, so don't show it
             continue;
         }
-        threading[*it].offset = threading[0].children.size();
-        threading[0].children.append(*it);
+        isShown[internalId] = true;
+        threading[internalId].offset = threading[0].children.size();
+        threading[0].children.append(internalId);
     }
 
     // Now remove everything which is no longer reachable from the root of the thread mapping
     // Start working on the top-level orphans
-    Q_FOREACH(const uint uid, threading[0].children) {
-        newlyUnreachable.remove(uid);
+    std::vector<uint> queue;
+    Q_FOREACH(const uint internalId, oldRoots) {
+        if (!isShown[internalId])
+            queue.push_back(internalId);
     }
-    std::vector<uint> queue(newlyUnreachable.constBegin(), newlyUnreachable.constEnd());
     for (std::vector<uint>::size_type i = 0; i < queue.size(); ++i) {
-        QHash<uint,ThreadNodeInfo>::iterator threadingIt = threading.find(queue[i]);
-        Q_ASSERT(threadingIt != threading.end());
-        queue.insert(queue.end(), threadingIt->children.constBegin(), threadingIt->children.constEnd());
-        threading.erase(threadingIt);
+        Q_ASSERT(isAliveNode(queue[i]));
+        const ThreadNodeInfo &node = threading[queue[i]];
+        queue.insert(queue.end(), node.children.constBegin(), node.children.constEnd());
+        threading[queue[i]] = ThreadNodeInfo();
     }
 
     updatePersistentIndexesPhase2();
@@ -24,9 +24,11 @@
 #define IMAP_THREADINGMSGLISTMODEL_H
 
 #include <functional>
+#include <vector>
 #include <QAbstractProxyModel>
 #include <QPointer>
 #include <QSet>
+#include <QVector>
 #include "MailboxTree.h"
 #include "Imap/Parser/Response.h"
 
@@ -45,7 +47,12 @@ class SortTask;
 class TreeItem;
 class TreeItemMsgList;
 
-/** @short A node in tree structure used for threading representation */
+/** @short A node in tree structure used for threading representation
+
+The nodes are stored in a flat array and refer to each other through their position in that array, which is also their
+internal ID. A node which is no longer part of the tree is replaced by a default-constructed one; as its internalId no longer
+matches its position, it is considered dead.
+*/
 struct ThreadNodeInfo {
     /** @short Internal unique identifier used for model indexes */
     uint internalId;
@@ -54,16 +61,26 @@ struct ThreadNodeInfo {
     /** @short internalId of a parent of this message */
     uint parent;
     /** @short List of children of current node */
-    QList<uint> children;
-    /** @short Pointer to the TreeItemMessage* of the corresponding message */
-    TreeItem *ptr;
+    QVector<uint> children;
+    /** @short Row of the corresponding message in the source model, or -1 for a fake node */
+    int sourceRow;
     /** @short Position among our parent's children */
     int offset;
-    ThreadNodeInfo(): internalId(0), uid(0), parent(0), ptr(0), offset(0) {}
+    ThreadNodeInfo(): internalId(0), uid(0), parent(0), sourceRow(-1), offset(0) {}
 };
 
 QDebug operator<<(QDebug debug, const ThreadNodeInfo &node);
 
+}
+}
+
+Q_DECLARE_TYPEINFO(Imap::Mailbox::ThreadNodeInfo, Q_MOVABLE_TYPE);
+
+namespace Imap
+{
+namespace Mailbox
+{
+
 /** @short A model implementing view of the whole IMAP server
 
 The problem with threading is that due to the extremely asynchronous nature of the IMAP Model, we often get informed about indexes
@@ -216,7 +233,35 @@ private:
 
     /** @short Convert the threading from a THREAD response and apply that threading to this model */
     void registerThreading(const QVector<Imap::Responses::ThreadingNode> &mapping, uint parentId,
-                           const QHash<uint,void *> &uidToPtr, QSet<uint> &usedNodes);
+                           Model *realModel, TreeItemMsgList *list);
+
+    /** @short Is the node with this internal ID still a part of the thread tree? */
+    bool isAliveNode(const uint internalId) const;
+
+    /** @short Find the node of a message with the given UID, or return 0 if there's no such node */
+    uint findNodeByUid(Model *realModel, TreeItemMsgList *list, const uint uid) const;
+
+    /** @short Return an index pointing to the specified node, or an invalid one for the root */
+    QModelIndex indexForNode(const uint internalId) const;
+
+    /** @short Place the nodes of a subthread under the given parent, moving the existing ones around */
+    void placeThreadNodes(const QVector<Imap::Responses::ThreadingNode> &mapping, const uint parentId, int offset,
+                          Model *realModel, TreeItemMsgList *list, std::vector<bool> &placed);
+
+    /** @short Move a node (along with its children) to a new place, notifying the views about that */
+    void moveNode(const uint internalId, const uint newParentId, const int newOffset);
+
+    /** @short Insert a new fake node, notifying the views about that */
+    uint insertFakeNode(const uint parentId, const int offset);
+
+    /** @short Remove a node without any children, notifying the views about that */
+    void removeLeafNode(const uint internalId);
+
+    /** @short Update the offsets of the children of a node, starting at the specified position */
+    void renumberChildren(const uint parentId, const int from);
+
+    /** @short Put a node which has just become a top-level one into the list of thread roots */
+    void registerThreadRoot(const uint internalId);
 
     bool searchSortPreferenceImplementation(const QStringList &searchConditions, const SortCriterium criterium,
                                             const Qt::SortOrder order = Qt::AscendingOrder);
@@ -224,8 +269,8 @@ private:
     /** @short Remove fake messages from the threading tree */
     void pruneTree();
 
-    /** @short Execute the provided function once for each message */
-    template<typename T> void threadForeach(const uint &root, std::function<T(const TreeItemMessage &)> callback) const;
+    /** @short Execute the provided function once for each message, passing the message's row in the source model */
+    template<typename T> void threadForeach(const uint &root, std::function<T(const int)> callback) const;
 
     /** @short Check current thread for "unread messages" */
     bool threadContainsUnreadMessages(const uint root) const;
@@ -244,26 +289,30 @@ private:
 
     uint findHighestUidInMailbox(TreeItemMsgList *list);
 
+    /** @short The list of messages which our source model shows, or nullptr if there's none */
+    TreeItemMsgList *sourceMessageList() const;
+
+    /** @short Let the nodes of the messages at and after the given source row know about their current row */
+    void updateSourceRows(const int from);
+
     void logTrace(const QString &message);
 
 
     ThreadingMsgListModel &operator=(const ThreadingMsgListModel &);  // don't implement
     ThreadingMsgListModel(const ThreadingMsgListModel &);  // don't implement
 
-    /** @short Mapping from the upstream model's internalId to ThreadingMsgListModel's internal IDs */
-    QHash<void *,uint> ptrToInternal;
-
     /** @short Tree for the threading
 
-    This tree is indexed by our internal ID.
+    This is a contiguous array indexed by our internal ID, with the root node at index zero. The IDs of the nodes
+    which get removed are not reused until the whole tree is rebuilt, so that the existing model indexes remain valid.
     */
-    QHash<uint,ThreadNodeInfo> threading;
+    QVector<ThreadNodeInfo> threading;
 
-    /** @short Last assigned internal ID */
-    uint threadingHelperLastId;
+    /** @short Mapping from the upstream model's rows to ThreadingMsgListModel's internal IDs */
+    QVector<uint> sourceRowToInternal;
 
-    /** @short Messages with unknown UIDs */
-    QSet<TreeItem*> unknownUids;
+    /** @short Internal IDs of the nodes of messages with unknown UIDs */
+    QSet<uint> unknownUids;
 
     /** @short Threading algorithm we're using for this request */
     QByteArray requestedAlgorithm;
@@ -277,7 +326,7 @@ private:
     bool modelResetInProgress;
 
     QModelIndexList oldPersistentIndexes;
-    QList<void *> oldPtrs;
+    QVector<int> oldSourceRows;
 
     /** @short There's a pending THREAD command for which we haven't received data yet */
     bool threadingInFlight;
@@ -295,7 +344,7 @@ private:
     bool m_sortReverse;
 
     /** @short IDs of all thread roots when no sorting or filtering is applied */
-    QList<uint> threadedRootIds;
+    QVector<uint> threadedRootIds;
 
     /** @short Sorting criteria of the current copy of the sort result */
     SortCriterium m_currentSortingCriteria;
@@ -27,6 +27,7 @@
 #include <QGuiApplication>
 #include <QLocale>
 #include <QProcess>
+#include <QRegularExpression>
 #include <QSettings>
 #include <QSslCertificate>
 #include <QSslKey>
@@ -47,10 +48,10 @@ QString persistentLogFileName()
 {
     QString logFileName = Common::writablePath(Common::LOCATION_CACHE);
     if (logFileName.isEmpty()) {
-        logFileName = QDir::homePath() + QLatin1String("/.trojita-connection-log");
+        logFileName = QDir::homePath() + QLatin1String("/.trojita-connection-log.bin");
     } else {
         QDir().mkpath(logFileName);
-        logFileName += QLatin1String("/trojita-connection-log");
+        logFileName += QLatin1String("/trojita-connection-log.bin");
     }
     return logFileName;
 }
@@ -463,4 +464,48 @@ bool removeRecursively(const QString &dirName)
     return result;
 }
 
+/** @short Extract the "base subject" as defined by RFC 5256, section 2.1
+
+The base subject is what remains after stripping all the "Re:" and "Fwd:" prefixes, mailing list tags and other
+decorations which get added as the message is being passed around. Messages with the same base subject are likely to
+belong to the same conversation, which makes it useful for client-side threading and for grouping of messages.
+*/
+QString baseSubject(const QString &subject)
+{
+    // A sequence of optional [blobs] followed by Re: or Fwd:, possibly with another [blob] before the colon
+    static const QRegularExpression leader(QLatin1String(
+            "^(?:(?:\\[[^\\[\\]]*\\]\\s*)*(?:re|fwd?)\\s*(?:\\[[^\\[\\]]*\\]\\s*)?:\\s*)+"),
+            QRegularExpression::CaseInsensitiveOption);
+    static const QRegularExpression blob(QLatin1String("^\\[[^\\[\\]]*\\]\\s*"));
+
+    QString res = subject.simplified();
+    Q_FOREVER {
+        while (res.endsWith(QLatin1String("(fwd)"), Qt::CaseInsensitive)) {
+            res = res.left(res.size() - 5).trimmed();
+        }
+
+        bool changed;
+        do {
+            changed = false;
+            QRegularExpressionMatch match = leader.match(res);
+            if (match.hasMatch()) {
+                res = res.mid(match.capturedLength());
+                changed = true;
+            }
+            // A lone leading blob goes away as well, unless it's all what's left
+            match = blob.match(res);
+            if (match.hasMatch() && match.capturedLength() < res.size()) {
+                res = res.mid(match.capturedLength());
+                changed = true;
+            }
+        } while (changed);
+
+        if (res.startsWith(QLatin1String("[fwd:"), Qt::CaseInsensitive) && res.endsWith(QLatin1Char(']'))) {
+            res = res.mid(5, res.size() - 6).trimmed();
+            continue;
+        }
+        return res;
+    }
+}
+
 }
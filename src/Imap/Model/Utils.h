@@ -33,7 +33,7 @@ class QSslError;
 namespace Imap {
 namespace Mailbox {
 
-/** @short Return the name of a log file for logging IMAP communication */
+/** @short Return the name of a binary log file for logging IMAP communication, readable through trojita-log-viewer */
 QString persistentLogFileName();
 
 /** @short Return a system/platform version */
@@ -51,6 +51,8 @@ QModelIndex deproxifiedIndex(const QModelIndex& index);
 
 bool removeRecursively(const QString &dirName);
 
+QString baseSubject(const QString &subject);
+
 }
 
 
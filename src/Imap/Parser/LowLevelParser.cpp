@@ -22,6 +22,7 @@
 */
 
 #include <limits>
+#include <utility>
 #include <QDebug>
 #include <QMap>
 #include <QPair>
@@ -373,8 +374,8 @@ QVariant getAnything(const QByteArray &line, int &start)
 Imap::Uids getSequence(const QByteArray &line, int &start)
 {
     uint num = LowLevelParser::getUInt(line, start);
-    if (start >= line.size() - 2) {
-        // It's definitely just a number because there's no more data in here
+    if (start >= line.size() || (line[start] != ':' && line[start] != ',')) {
+        // It's definitely just a number because there's no sequence set continuing in here
         return Imap::Uids() << num;
     } else {
         Imap::Uids numbers;
@@ -382,8 +383,9 @@ Imap::Uids getSequence(const QByteArray &line, int &start)
 
         enum {COMMA, RANGE} currentType = COMMA;
 
-        // Try to find further items in the sequence set
-        while (line[start] == ':' || line[start] == ',') {
+        // Try to find further items in the sequence set. The data might come from a standalone token (like the arguments
+        // of a response code), so we cannot rely on the CRLF being present.
+        while (start < line.size() && (line[start] == ':' || line[start] == ',')) {
             // it's a sequence set
 
             if (line[start] == ':') {
@@ -397,20 +399,22 @@ Imap::Uids getSequence(const QByteArray &line, int &start)
             }
 
             ++start;
-            if (start >= line.size() - 2) throw NoData("Truncated sequence set", line, start);
+            if (start >= line.size()) throw NoData("Truncated sequence set", line, start);
 
             uint num = LowLevelParser::getUInt(line, start);
             if (currentType == COMMA) {
                 // just adding one more to the set
                 numbers << num;
             } else {
-                // working with a range
-                if (numbers.last() >= num)
-                    throw UnexpectedHere("Sequence set contains an invalid range. "
-                                         "First item of a range must always be smaller than the second item.", line, start);
-
-                for (uint i = numbers.last() + 1; i <= num; ++i)
+                // working with a range; RFC 3501 says that "4:2" is the same as "2:4", and RFC 4315 servers do send these
+                uint first = numbers.takeLast();
+                if (first > num)
+                    std::swap(first, num);
+                for (uint i = first; ; ++i) {
                     numbers << i;
+                    if (i == num)
+                        break;
+                }
             }
         }
         return numbers;
@@ -506,5 +510,41 @@ void eatSpaces(const QByteArray &line, int &start)
         ++start;
 }
 
+QByteArray extractListId(const QByteArray &rawHeaders)
+{
+    static const QByteArray fieldName("list-id");
+    int pos = 0;
+    while (pos < rawHeaders.size()) {
+        int eol = rawHeaders.indexOf('\n', pos);
+        if (eol == -1)
+            eol = rawHeaders.size();
+
+        if (rawHeaders.mid(pos, fieldName.size()).toLower() == fieldName) {
+            int colon = pos + fieldName.size();
+            while (colon < eol && (rawHeaders[colon] == ' ' || rawHeaders[colon] == '\t'))
+                ++colon;
+            if (colon < eol && rawHeaders[colon] == ':') {
+                QByteArray value = rawHeaders.mid(colon + 1, eol - colon - 1);
+                // unfold the continuation lines
+                while (eol + 1 < rawHeaders.size() && (rawHeaders[eol + 1] == ' ' || rawHeaders[eol + 1] == '\t')) {
+                    int next = rawHeaders.indexOf('\n', eol + 1);
+                    if (next == -1)
+                        next = rawHeaders.size();
+                    value += rawHeaders.mid(eol + 1, next - eol - 1);
+                    eol = next;
+                }
+                // The phrase could contain a quoted "<", so let's look for the last one
+                const int start = value.lastIndexOf('<');
+                const int end = start == -1 ? -1 : value.indexOf('>', start);
+                if (end > start + 1)
+                    return value.mid(start + 1, end - start - 1).trimmed();
+                return QByteArray();
+            }
+        }
+        pos = eol + 1;
+    }
+    return QByteArray();
+}
+
 }
 }
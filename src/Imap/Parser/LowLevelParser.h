@@ -106,6 +106,13 @@ QDateTime parseRFC2822DateTime(const QByteArray &input);
 
 /** @short Eat spaces as long as we can */
 void eatSpaces(const QByteArray &line, int &start);
+
+/** @short Extract the list identifier from the List-Id header (RFC 2919) found in a block of raw RFC 5322 headers
+ *
+ * Only the list-id itself, i.e. the part enclosed in angle brackets, is returned; the optional descriptive phrase is
+ * ignored. A null QByteArray is returned when there's no such header.
+ * */
+QByteArray extractListId(const QByteArray &rawHeaders);
 }
 }
 
@@ -28,6 +28,7 @@
 #include <QTime>
 #include <QTimer>
 #include "Parser.h"
+#include "Common/PerformanceTrace.h"
 #include "Imap/Encoders.h"
 #include "LowLevelParser.h"
 #include "../../Streams/IODeviceSocket.h"
@@ -470,12 +471,18 @@ CommandHandle Parser::uidFetch(const Sequence &seq, const QList<QByteArray> &ite
                         Commands::PartOfCommand(Commands::ATOM, buf));
 }
 
-CommandHandle Parser::uidStore(const Sequence &seq, const QString &item, const QString &value)
+CommandHandle Parser::uidStore(const Sequence &seq, const QString &item, const QString &value, const quint64 unchangedSince)
 {
-    return queueCommand(Commands::Command("UID STORE") <<
-                        Commands::PartOfCommand(Commands::ATOM, seq.toByteArray()) <<
-                        Commands::PartOfCommand(Commands::ATOM, item.toUtf8()) <<
-                        Commands::PartOfCommand(Commands::ATOM, value.toUtf8()));
+    Commands::Command cmd = Commands::Command("UID STORE") <<
+                        Commands::PartOfCommand(Commands::ATOM, seq.toByteArray());
+    if (unchangedSince) {
+        cmd << Commands::PartOfCommand(Commands::ATOM_NO_SPACE_AROUND, " (UNCHANGEDSINCE ") <<
+               Commands::PartOfCommand(Commands::ATOM, QByteArray::number(unchangedSince)) <<
+               Commands::PartOfCommand(Commands::ATOM_NO_SPACE_AROUND, ") ");
+    }
+    cmd << Commands::PartOfCommand(Commands::ATOM, item.toUtf8()) <<
+           Commands::PartOfCommand(Commands::ATOM, value.toUtf8());
+    return queueCommand(cmd);
 }
 
 CommandHandle Parser::uidCopy(const Sequence &seq, const QString &mailbox)
@@ -809,7 +816,7 @@ void Parser::executeACommand()
 #ifdef PRINT_TRAFFIC_TX
         qDebug() << m_parserId << ">>>" << buf.left(PRINT_TRAFFIC_TX).trimmed();
 #endif
-        socket->write(buf);
+        writeToSocket(buf);
         idling = false;
         cmdQueue.pop_front();
         emit lineSent(this, buf);
@@ -819,6 +826,15 @@ void Parser::executeACommand()
 
     Q_ASSERT(! idling);
 
+    if (cmd.currentPart == 0 && cmd.cmds.size() > 1 && cmd.cmds[1].kind != Commands::IDLE) {
+        // Remember when this command went out; the round-trip time gets recorded once its tagged response arrives.
+        // IDLE is special because its completion is triggered by us, not by the server.
+        QByteArray name = cmd.cmds[1].text;
+        if (name == "UID" && cmd.cmds.size() > 2)
+            name += ' ' + cmd.cmds[2].text;
+        m_pendingCommands.insert(cmd.cmds.first().text, qMakePair(name, Common::PerformanceTrace::instance()->timestamp()));
+    }
+
     while (1) {
         Commands::PartOfCommand &part = cmd.cmds[ cmd.currentPart ];
         switch (part.kind) {
@@ -853,7 +869,7 @@ void Parser::executeACommand()
                 else
                     qDebug() << m_parserId << ">>> [sensitive command] -- added literal";
 #endif
-                socket->write(buf);
+                writeToSocket(buf);
                 part.numberSent = true;
                 waitingForContinuation = true;
                 Q_ASSERT(literalCommandTag.isEmpty());
@@ -871,7 +887,7 @@ void Parser::executeACommand()
 #ifdef PRINT_TRAFFIC_TX
             qDebug() << m_parserId << ">>>" << buf.left(PRINT_TRAFFIC_TX).trimmed();
 #endif
-            socket->write(buf);
+            writeToSocket(buf);
             idling = true;
             waitForInitialIdle = true;
             cmdQueue.pop_front();
@@ -884,7 +900,7 @@ void Parser::executeACommand()
 #ifdef PRINT_TRAFFIC_TX
             qDebug() << m_parserId << ">>>" << buf.left(PRINT_TRAFFIC_TX).trimmed();
 #endif
-            socket->write(buf);
+            writeToSocket(buf);
             startTlsInProgress = true;
             emit lineSent(this, buf);
             return;
@@ -895,7 +911,7 @@ void Parser::executeACommand()
 #ifdef PRINT_TRAFFIC_TX
             qDebug() << m_parserId << ">>>" << buf.left(PRINT_TRAFFIC_TX).trimmed();
 #endif
-            socket->write(buf);
+            writeToSocket(buf);
             compressDeflateInProgress = true;
             cmdQueue.pop_front();
             emit lineSent(this, buf);
@@ -911,7 +927,7 @@ void Parser::executeACommand()
             else
                 qDebug() << m_parserId << ">>> [sensitive command]";
 #endif
-            socket->write(buf);
+            writeToSocket(buf);
             cmdQueue.pop_front();
             emit lineSent(this, sensitiveCommand ? privateMessage : buf);
             break;
@@ -926,6 +942,12 @@ void Parser::executeACommand()
     }
 }
 
+void Parser::writeToSocket(const QByteArray &buf)
+{
+    socket->write(buf);
+    Common::PerformanceTrace::instance()->recordTraffic(m_parserId, 0, buf.size());
+}
+
 /** @short Process a line from IMAP server */
 void Parser::processLine(QByteArray line)
 {
@@ -937,6 +959,7 @@ void Parser::processLine(QByteArray line)
         qDebug() << m_parserId << "<<<" << debugLine;
 #endif
     emit lineReceived(this, line);
+    Common::PerformanceTrace::instance()->recordTraffic(m_parserId, line.size(), 0);
     if (m_expectsInitialGreeting && !line.startsWith("* ")) {
         throw NotAnImapServerError(std::string(), line, -1);
     } else if (line.startsWith("* ")) {
@@ -954,6 +977,12 @@ void Parser::processLine(QByteArray line)
             throw ContinuationRequest(line.constData());
         }
     } else {
+        auto pending = m_pendingCommands.find(line.left(line.indexOf(' ')));
+        if (pending != m_pendingCommands.end()) {
+            Common::PerformanceTrace::instance()->recordSpan("imap", QString::fromUtf8(pending->first), QString::fromUtf8(pending.key()),
+                                                             m_parserId, pending->second);
+            m_pendingCommands.erase(pending);
+        }
         queueResponse(parseTagged(line));
     }
 }
@@ -21,6 +21,7 @@
 */
 #ifndef IMAP_PARSER_H
 #define IMAP_PARSER_H
+#include <QHash>
 #include <QLinkedList>
 #include <QSharedPointer>
 #include "Command.h"
@@ -182,8 +183,11 @@ public slots:
     /** @short UID command (FETCH), RFC3501 sect 6.4.8 */
     CommandHandle uidFetch(const Sequence &seq, const QList<QByteArray> &items);
 
-    /** @short UID command (STORE), RFC3501 sect 6.4.8 */
-    CommandHandle uidStore(const Sequence &seq, const QString &item, const QString &value);
+    /** @short UID command (STORE), RFC3501 sect 6.4.8
+
+    A non-zero @arg unchangedSince adds the UNCHANGEDSINCE modifier from RFC 7162.
+    */
+    CommandHandle uidStore(const Sequence &seq, const QString &item, const QString &value, const quint64 unchangedSince = 0);
 
     /** @short UID command (COPY), RFC3501 sect 6.4.8 */
     CommandHandle uidCopy(const Sequence &seq, const QString &mailbox);
@@ -351,6 +355,9 @@ private:
 
     void processLine(QByteArray line);
 
+    /** @short Send data to the server and account for them in the traffic statistics */
+    void writeToSocket(const QByteArray &buf);
+
     /** @short Parse line for untagged reply */
     QSharedPointer<Responses::AbstractResponse> parseUntagged(const QByteArray &line);
 
@@ -401,6 +408,9 @@ private:
     QByteArray compressDeflateCommand;
     QByteArray literalCommandTag;
 
+    /** @short Name and start timestamp of the commands which were sent, but whose tagged response hasn't arrived yet */
+    QHash<QByteArray, QPair<QByteArray, qint64> > m_pendingCommands;
+
     /** @short Unique-id for debugging purposes */
     uint m_parserId;
 };
@@ -339,7 +339,7 @@ State::State(const QByteArray &tag, const Kind kind, const QByteArray &line, int
         CASE(BADURL)
         CASE(HIGHESTMODSEQ)
         CASE(NOMODSEQ)
-        // FIXME: not implemented CASE(MODIFIED)
+        CASE(MODIFIED)
         CASE(COMPRESSIONACTIVE)
         CASE(CLOSED)
         CASE(NOTSAVED)
@@ -510,10 +510,25 @@ State::State(const QByteArray &tag, const Kind kind, const QByteArray &line, int
             respCodeData = QSharedPointer<AbstractData>(new RespData<QPair<uint,Sequence> >(qMakePair(uidValidity, seq)));
             break;
         }
-        case Responses::COPYUID:
+        case Responses::MODIFIED:
         {
-            // FIXME: don't return anything, this is broken with multiple messages, unfortunately
+            // RFC 7162 clarified that this is a sequence-set which lists UIDs when replying to an UID STORE
+            if (originalList.size() != 2)
+                throw InvalidResponseCode("Malformed MODIFIED: wrong number of arguments", line, start);
+            int pos = 0;
+            QByteArray s1 = originalList[1].toByteArray();
+            Sequence seq = Sequence::fromVector(LowLevelParser::getSequence(s1, pos));
+            if (!seq.isValid())
+                throw InvalidResponseCode("Malformed MODIFIED: cannot extract the list of UIDs", line, start);
+            if (pos != s1.size())
+                throw InvalidResponseCode("Malformed MODIFIED: garbage found after the list of UIDs", line, start);
+            respCodeData = QSharedPointer<AbstractData>(new RespData<Sequence>(seq));
             break;
+        }
+        case Responses::COPYUID:
+        {
+            // The order of UIDs matters here because the n-th UID in the source set corresponds to the n-th UID
+            // in the destination set. That's why we cannot use the Sequence which would sort the items.
             if (originalList.size() != 4)
                 throw InvalidResponseCode("Malformed COPYUID: wrong number of arguments", line, start);
             bool ok;
@@ -522,30 +537,24 @@ State::State(const QByteArray &tag, const Kind kind, const QByteArray &line, int
                 throw InvalidResponseCode("Malformed COPYUID: cannot extract UIDVALIDITY", line, start);
             int pos = 0;
             QByteArray s1 = originalList[2].toByteArray();
-            Sequence seq1 = Sequence::fromVector(LowLevelParser::getSequence(s1, pos));
-            if (!seq1.isValid())
-                throw InvalidResponseCode("Malformed COPYUID: cannot extract the first sequence", line, start);
+            Uids uids1 = LowLevelParser::getSequence(s1, pos);
             if (pos != s1.size())
                 throw InvalidResponseCode("Malformed COPYUID: garbage found after the first sequence", line, start);
             pos = 0;
             QByteArray s2 = originalList[3].toByteArray();
-            Sequence seq2 = Sequence::fromVector(LowLevelParser::getSequence(s2, pos));
-            if (!seq2.isValid())
-                throw InvalidResponseCode("Malformed COPYUID: cannot extract the second sequence", line, start);
+            Uids uids2 = LowLevelParser::getSequence(s2, pos);
             if (pos != s2.size())
                 throw InvalidResponseCode("Malformed COPYUID: garbage found after the second sequence", line, start);
-            respCodeData = QSharedPointer<AbstractData>(new RespData<QPair<uint,QPair<Sequence, Sequence> > >(
-                                                            qMakePair(uidValidity, qMakePair<Sequence, Sequence>(seq1, seq2))));
+            if (uids1.size() != uids2.size())
+                throw InvalidResponseCode("Malformed COPYUID: the number of source and destination UIDs differs", line, start);
+            respCodeData = QSharedPointer<AbstractData>(new RespData<QPair<uint,QPair<Uids, Uids> > >(
+                                                            qMakePair(uidValidity, qMakePair(uids1, uids2))));
             break;
         }
         case Responses::URLMECH:
             // FIXME: implement me
             Q_ASSERT(false);
             break;
-        case Responses::MODIFIED:
-            // FIXME: clarify what "set" in the RFC 4551 means and implement it
-            Q_ASSERT(false);
-            break;
         case Responses::ANNOTATE:
         {
             if (list.count() != 1)
@@ -879,6 +888,15 @@ Fetch::Fetch(const uint number, const QByteArray &line, int &start): number(numb
                 throw UnexpectedHere("FETCH identifier contains \"[\", but no matching \"]\" was found", line, posBeforeIdentifier);
             identifier = line.mid(posBeforeIdentifier, pos - posBeforeIdentifier + 1).toUpper();
             start = pos + 1;
+            if (start < line.size() && line[start] == '<') {
+                // A partial fetch, the "<origin>" becomes a part of the identifier
+                int posOrigin = start + 1;
+                LowLevelParser::getUInt64(line, posOrigin);
+                if (posOrigin >= line.size() || line[posOrigin] != '>')
+                    throw UnexpectedHere("FETCH identifier contains an unterminated <origin>", line, start);
+                identifier += line.mid(start, posOrigin - start + 1);
+                start = posOrigin + 1;
+            }
         }
 
         if (data.contains(identifier))
@@ -1349,9 +1367,17 @@ template<> QTextStream &RespData<QPair<uint,Sequence> >::dump(QTextStream &strea
     return stream << "UIDVALIDITY " << data.first << " UIDs" << data.second;
 }
 
-template<> QTextStream &RespData<QPair<uint,QPair<Sequence, Sequence> > >::dump(QTextStream &stream) const
+template<> QTextStream &RespData<QPair<uint,QPair<Uids, Uids> > >::dump(QTextStream &stream) const
 {
-    return stream << "UIDVALIDITY " << data.first << " UIDs-1" << data.second.first << " UIDs-2" << data.second.second;
+    stream << "UIDVALIDITY " << data.first << " UIDs-1";
+    Q_FOREACH(const uint uid, data.second.first) {
+        stream << " " << uid;
+    }
+    stream << " UIDs-2";
+    Q_FOREACH(const uint uid, data.second.second) {
+        stream << " " << uid;
+    }
+    return stream;
 }
 
 bool RespData<void>::eq(const AbstractData &other) const
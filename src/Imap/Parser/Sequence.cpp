@@ -20,9 +20,9 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include "Sequence.h"
-#include <QStringList>
+#include <algorithm>
 #include <QTextStream>
+#include "Sequence.h"
 
 namespace Imap
 {
@@ -47,22 +47,24 @@ QByteArray Sequence::toByteArray() const
     {
         Q_ASSERT(! numbers.isEmpty());
 
-        QStringList res;
+        // Building the result directly in a QByteArray matters when marking tens of thousands of messages at once
+        QByteArray res;
         int i = 0;
         while (i < numbers.size()) {
             int old = i;
             while (i < numbers.size() - 1 &&
                    numbers[i] == numbers[ i + 1 ] - 1)
                 ++i;
+            if (!res.isEmpty())
+                res += ',';
+            res += QByteArray::number(numbers[old]);
             if (old != i) {
                 // we've found a sequence
-                res << QString::number(numbers[old]) + QLatin1Char(':') + QString::number(numbers[i]);
-            } else {
-                res << QString::number(numbers[i]);
+                res += ':' + QByteArray::number(numbers[i]);
             }
             ++i;
         }
-        return res.join(QStringLiteral(",")).toLocal8Bit();
+        return res;
     }
     case RANGE:
         Q_ASSERT(lo <= hi);
@@ -115,13 +117,44 @@ Sequence Sequence::fromVector(Imap::Uids numbers)
 {
     Q_ASSERT(!numbers.isEmpty());
     qSort(numbers);
-    Sequence seq(numbers.first());
-    for (int i = 1; i < numbers.size(); ++i) {
-        seq.add(numbers[i]);
-    }
+    numbers.erase(std::unique(numbers.begin(), numbers.end()), numbers.end());
+    Sequence seq;
+    seq.numbers = numbers;
     return seq;
 }
 
+QList<Sequence> Sequence::split(const int maxLength) const
+{
+    if (kind != DISTINCT)
+        return QList<Sequence>() << *this;
+
+    Q_ASSERT(!numbers.isEmpty());
+    QList<Sequence> res;
+    Sequence current;
+    int currentLength = 0;
+    int i = 0;
+    while (i < numbers.size()) {
+        int old = i;
+        while (i < numbers.size() - 1 &&
+               numbers[i] == numbers[ i + 1 ] - 1)
+            ++i;
+        int partLength = QByteArray::number(numbers[old]).size();
+        if (old != i)
+            partLength += 1 + QByteArray::number(numbers[i]).size();
+        if (currentLength && currentLength + 1 + partLength > maxLength) {
+            res << current;
+            current = Sequence();
+            currentLength = 0;
+        }
+        currentLength += (currentLength ? 1 : 0) + partLength;
+        for (int j = old; j <= i; ++j)
+            current.numbers << numbers[j];
+        ++i;
+    }
+    res << current;
+    return res;
+}
+
 bool Sequence::isValid() const
 {
     if (kind == DISTINCT && numbers.isEmpty())
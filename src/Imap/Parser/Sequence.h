@@ -23,6 +23,7 @@
 #ifndef IMAP_PARSER_SEQUENCE_H
 #define IMAP_PARSER_SEQUENCE_H
 
+#include <QList>
 #include <QString>
 #include "Imap/Parser/Uids.h"
 
@@ -84,6 +85,13 @@ public:
     /** @short Create a sequence from a list of numbers */
     static Sequence fromVector(Imap::Uids numbers);
 
+    /** @short Split the sequence into several sequences whose textual form is at most @arg maxLength bytes long
+
+      Consecutive ranges are never broken apart, so a single range might still exceed the limit. Sequences which
+      are not made of distinct numbers are returned as-is.
+    */
+    QList<Sequence> split(const int maxLength) const;
+
     /** @short Return true if the sequence contains at least some items */
     bool isValid() const;
 
@@ -21,7 +21,9 @@
 */
 
 
+#include <QSet>
 #include "CopyMoveMessagesTask.h"
+#include "Imap/Model/Cache.h"
 #include "Imap/Model/ItemRoles.h"
 #include "Imap/Model/Model.h"
 #include "Imap/Model/MailboxTree.h"
@@ -37,7 +39,7 @@ namespace Mailbox
 
 CopyMoveMessagesTask::CopyMoveMessagesTask(Model *model, const QModelIndexList &messages_, const QString &targetMailbox,
                                            const CopyMoveOperation op):
-    ImapTask(model), targetMailbox(targetMailbox), shouldDelete(op == MOVE)
+    ImapTask(model), targetMailbox(targetMailbox), shouldDelete(op == MOVE), cacheMigrated(false)
 {
     if (messages_.isEmpty()) {
         throw CantHappen("CopyMoveMessagesTask called with empty message set");
@@ -46,6 +48,9 @@ CopyMoveMessagesTask::CopyMoveMessagesTask(Model *model, const QModelIndexList &
         messages << index;
     }
     QModelIndex mailboxIndex = model->findMailboxForItems(messages_);
+    TreeItemMailbox *mailbox = Model::mailboxForSomeItem(mailboxIndex);
+    Q_ASSERT(mailbox);
+    sourceMailbox = mailbox->mailbox();
     conn = model->findTaskResponsibleFor(mailboxIndex);
     conn->addDependentTask(this);
 }
@@ -69,6 +74,7 @@ void CopyMoveMessagesTask::perform()
             Q_ASSERT(item);
             TreeItemMessage *message = dynamic_cast<TreeItemMessage *>(item);
             Q_ASSERT(message);
+            uids << message->uid();
             if (first) {
                 seq = Sequence(message->uid());
                 first = false;
@@ -93,11 +99,20 @@ void CopyMoveMessagesTask::perform()
 
 bool CopyMoveMessagesTask::handleStateHelper(const Imap::Responses::State *const resp)
 {
-    if (resp->tag.isEmpty())
+    if (resp->tag.isEmpty()) {
+        // The UID MOVE reports the COPYUID via an untagged OK which comes before the EXPUNGEs (RFC 6851).
+        // We have to act on it right now because the EXPUNGEs are going to remove the source data from the cache.
+        if (!moveTag.isEmpty() && resp->kind == Responses::OK && resp->respCode == Responses::COPYUID) {
+            return migrateCachedData(resp);
+        }
         return false;
+    }
 
     if (resp->tag == copyTag) {
         if (resp->kind == Responses::OK) {
+            if (resp->respCode == Responses::COPYUID) {
+                migrateCachedData(resp);
+            }
             if (shouldDelete) {
                 if (_dead) {
                     // Yeah, that's bad -- the COPY has succeeded, yet we cannot update the flags :(
@@ -106,7 +121,14 @@ bool CopyMoveMessagesTask::handleStateHelper(const Imap::Responses::State *const
                     return true;
                 }
                 // We ignore the _aborted status here, though -- we just want to finish in an "atomic" manner
-                ImapTask *flagTask = new UpdateFlagsTask(model, this, messages, FLAG_ADD_SILENT, QStringLiteral("\\Deleted"));
+                TreeItemMailbox *mailbox = model->findMailboxByName(sourceMailbox);
+                if (!mailbox) {
+                    log(QStringLiteral("COPY succeeded, but the source mailbox is gone, so it cannot be marked as deleted"));
+                    _failed(tr("The source mailbox has disappeared"));
+                    return true;
+                }
+                ImapTask *flagTask = new UpdateFlagsTask(model, this, mailbox->toIndex(model), uids, FLAG_ADD_SILENT,
+                                                         QStringLiteral("\\Deleted"));
                 if (model->accessParser(parser).capabilities.contains(QStringLiteral("UIDPLUS"))) {
                     new ExpungeMessagesTask(model, flagTask, messages);
                 }
@@ -118,6 +140,9 @@ bool CopyMoveMessagesTask::handleStateHelper(const Imap::Responses::State *const
         return true;
     } else if (resp->tag == moveTag) {
         if (resp->kind == Responses::OK) {
+            if (resp->respCode == Responses::COPYUID) {
+                migrateCachedData(resp);
+            }
             _completed();
         } else {
             _failed(tr("The UID MOVE operation has failed: %1").arg(resp->message));
@@ -128,6 +153,61 @@ bool CopyMoveMessagesTask::handleStateHelper(const Imap::Responses::State *const
     }
 }
 
+/** @short Make the data about the source messages which we already have available under their new UIDs, too
+
+This way, there's no need to download the same data again when the user opens the target mailbox. The data are only
+copied when the COPYUID refers to the same UIDVALIDITY as what we have cached for the target mailbox, and when all of the
+source UIDs are the ones we have actually asked for.
+
+Returns true if the response was recognized as related to this task.
+*/
+bool CopyMoveMessagesTask::migrateCachedData(const Imap::Responses::State *const resp)
+{
+    if (cacheMigrated)
+        return false;
+
+    const Responses::RespData<QPair<uint, QPair<Uids, Uids> > > *const respData =
+            dynamic_cast<const Responses::RespData<QPair<uint, QPair<Uids, Uids> > >* const>(resp->respCodeData.data());
+    Q_ASSERT(respData);
+    const uint uidValidity = respData->data.first;
+    const Uids &srcUids = respData->data.second.first;
+    const Uids &dstUids = respData->data.second.second;
+    Q_ASSERT(srcUids.size() == dstUids.size());
+
+    QSet<uint> requestedUids;
+    requestedUids.reserve(uids.size());
+    Q_FOREACH(const uint uid, uids) {
+        requestedUids.insert(uid);
+    }
+    Q_FOREACH(const uint uid, srcUids) {
+        if (!requestedUids.contains(uid)) {
+            // This is probably a response to some other command which is running at the same time
+            return false;
+        }
+    }
+    cacheMigrated = true;
+
+    auto cache = model->cache();
+    if (cache->mailboxSyncState(targetMailbox).uidValidity() != uidValidity) {
+        log(QStringLiteral("COPYUID: UIDVALIDITY of %1 is not cached or does not match, not migrating cached data").arg(targetMailbox));
+        return true;
+    }
+
+    for (int i = 0; i < srcUids.size(); ++i) {
+        auto metadata = cache->messageMetadata(sourceMailbox, srcUids[i]);
+        if (metadata.uid) {
+            metadata.uid = dstUids[i];
+            cache->setMessageMetadata(targetMailbox, dstUids[i], metadata);
+        }
+        auto flags = cache->msgFlags(sourceMailbox, srcUids[i]);
+        if (!flags.isEmpty()) {
+            cache->setMsgFlags(targetMailbox, dstUids[i], flags);
+        }
+        cache->copyMessageParts(sourceMailbox, srcUids[i], targetMailbox, dstUids[i]);
+    }
+    return true;
+}
+
 QVariant CopyMoveMessagesTask::taskData(const int role) const
 {
     return role == RoleTaskCompactName ? QVariant(tr("Copying messages")) : QVariant();
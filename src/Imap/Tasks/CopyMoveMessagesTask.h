@@ -44,12 +44,18 @@ public:
     virtual QVariant taskData(const int role) const;
     virtual bool needsMailbox() const {return true;}
 private:
+    bool migrateCachedData(const Imap::Responses::State *const resp);
+
     CommandHandle copyTag;
     CommandHandle moveTag;
     ImapTask *conn;
     QList<QPersistentModelIndex> messages;
+    Imap::Uids uids;
+    QString sourceMailbox;
     QString targetMailbox;
     bool shouldDelete;
+    /** @short Have we already processed the COPYUID response? */
+    bool cacheMigrated;
 };
 
 }
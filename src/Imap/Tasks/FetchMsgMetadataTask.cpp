@@ -50,8 +50,13 @@ void FetchMsgMetadataTask::perform()
     Sequence seq = Sequence::fromVector(uids);
 
     // we do not want to use _onlineMessageFetch because it contains UID and FLAGS
-    tag = parser->uidFetch(seq, QList<QByteArray>() << "ENVELOPE" << "INTERNALDATE" <<
-                           "BODYSTRUCTURE" << "RFC822.SIZE" << "BODY.PEEK[HEADER.FIELDS (References List-Post)]");
+    QList<QByteArray> items = QList<QByteArray>() << "ENVELOPE" << "INTERNALDATE" <<
+                           "BODYSTRUCTURE" << "RFC822.SIZE" << "BODY.PEEK[HEADER.FIELDS (References List-Post List-Id)]";
+    if (model->accessParser(parser).capabilities.contains(QStringLiteral("PREVIEW"))) {
+        // RFC 8970: the previews come for free along with the rest of the metadata, without any extra round trips
+        items << "PREVIEW";
+    }
+    tag = parser->uidFetch(seq, items);
 }
 
 bool FetchMsgMetadataTask::handleFetch(const Imap::Responses::Fetch *const resp)
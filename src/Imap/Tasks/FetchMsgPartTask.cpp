@@ -132,6 +132,10 @@ void FetchMsgPartTask::doForAllParts(const std::function<void(TreeItemPart *, co
     const auto messages = model->findMessagesByUids(mailbox, uids);
     for(auto message: messages) {
         for (const auto &partId: parts) {
+            if (partId == "PREVIEW") {
+                // The RFC 8970 preview belongs to the whole message, not to any of its parts
+                continue;
+            }
             auto part = mailbox->partIdToPtr(model, static_cast<TreeItemMessage *>(message), partId);
             f(part, partId, message->uid());
         }
@@ -147,7 +151,17 @@ void FetchMsgPartTask::markPendingItemsUnavailable()
                 .arg(QString::fromUtf8(partId), QString::number(uid)), Common::LOG_MESSAGES);
             return;
         }
-        if (part->loading()) {
+        if (partId.endsWith('>')) {
+            // A partial fetch; the part itself is not affected when the chunk did not arrive, it can be asked for again.
+            // Make sure not to touch a request for some other chunk which might have been made in the meanwhile.
+            const int originPos = partId.lastIndexOf('<');
+            const quint64 offset = partId.mid(originPos + 1, partId.indexOf('.', originPos) - originPos - 1).toULongLong();
+            if (part->m_partialChunkRequested && offset == static_cast<quint64>(part->m_partialData.size())) {
+                log(QStringLiteral("Received no data for chunk %1 UID %2").arg(QString::fromUtf8(partId), QString::number(uid)),
+                    Common::LOG_MESSAGES);
+                part->m_partialChunkRequested = 0;
+            }
+        } else if (part->loading()) {
             log(QStringLiteral("Received no data for part %1 UID %2").arg(QString::fromUtf8(partId), QString::number(uid)),
                 Common::LOG_MESSAGES);
             markPartUnavailable(part);
@@ -57,6 +57,8 @@ private:
     Imap::Uids uids;
     QList<QByteArray> parts;
     QPersistentModelIndex mailboxIndex;
+
+    friend class KeepMailboxOpenTask; // needs access to uids and parts for raising the priority
 };
 
 }
@@ -22,6 +22,7 @@
 
 #include "ImapTask.h"
 #include "Common/InvokeMethod.h"
+#include "Common/PerformanceTrace.h"
 #include "Imap/Model/Model.h"
 #include "Imap/Model/TaskPresentationModel.h"
 #include "KeepMailboxOpenTask.h"
@@ -32,7 +33,8 @@ namespace Mailbox
 {
 
 ImapTask::ImapTask(Model *model) :
-    QObject(model), parser(0), parentTask(0), model(model), _finished(false), _dead(false), _aborted(false)
+    QObject(model), parser(0), parentTask(0), model(model), _finished(false), _dead(false), _aborted(false),
+    m_priority(TaskPriority::INTERACTIVE), m_traceStart(Common::PerformanceTrace::instance()->timestamp())
 {
     connect(this, &QObject::destroyed, model, &Model::slotTaskDying);
     CHECK_TASK_TREE;
@@ -224,6 +226,7 @@ bool ImapTask::handleParseErrorResponse(const Imap::Responses::ParseErrorRespons
 void ImapTask::_completed()
 {
     _finished = true;
+    recordDuration();
     log(QStringLiteral("Completed"));
     Q_FOREACH(ImapTask* task, dependentTasks) {
         if (!task->isFinished())
@@ -235,6 +238,7 @@ void ImapTask::_completed()
 void ImapTask::_failed(const QString &errorMessage)
 {
     _finished = true;
+    recordDuration();
     killAllPendingTasks(errorMessage);
     log(QStringLiteral("Failed: %1").arg(errorMessage));
     emit failed(errorMessage);
@@ -273,6 +277,15 @@ void ImapTask::handleResponseCode(const Imap::Responses::State *const resp)
     }
 }
 
+void ImapTask::recordDuration()
+{
+    if (m_traceStart < 0)
+        return;
+    Common::PerformanceTrace::instance()->recordSpan("task", QString::fromUtf8(metaObject()->className()), debugIdentification(),
+                                                     parser ? parser->parserId() : 0, m_traceStart);
+    m_traceStart = -1;
+}
+
 bool ImapTask::isReadyToRun() const
 {
     return false;
@@ -30,6 +30,7 @@
 #include "Common/Logging.h"
 #include "../Parser/Parser.h"
 #include "../Model/FlagsOperation.h"
+#include "../Model/TaskPriority.h"
 
 namespace Imap
 {
@@ -136,6 +137,10 @@ public:
     /** @short Implemente fetching of data for TaskPresentationModel */
     virtual QVariant taskData(const int role) const = 0;
 
+    /** @short How urgent is this task? Tasks with a higher priority get started first. */
+    TaskPriority priority() const { return m_priority; }
+    void setPriority(const TaskPriority priority) { m_priority = priority; }
+
 protected:
     void _completed();
 
@@ -162,6 +167,9 @@ protected:
 private:
     void handleResponseCode(const Imap::Responses::State *const resp);
 
+    /** @short Report the wall time between the creation of this task and its completion or failure */
+    void recordDuration();
+
 signals:
     /** @short This signal is emitted if the job failed in some way */
     void failed(QString errorMessage);
@@ -178,6 +186,9 @@ protected:
     bool _finished;
     bool _dead;
     bool _aborted;
+    TaskPriority m_priority;
+    /** @short When was this task created, as per Common::PerformanceTrace::timestamp(); negative once reported */
+    qint64 m_traceStart;
 
     friend class TaskPresentationModel; // needs access to the TaskPresentationModel
     friend class KeepMailboxOpenTask; // needs access to dependentTasks for removing stuff
@@ -20,6 +20,7 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <sstream>
 #include "KeepMailboxOpenTask.h"
 #include "Common/InvokeMethod.h"
@@ -46,7 +47,7 @@ namespace Mailbox
 
 KeepMailboxOpenTask::KeepMailboxOpenTask(Model *model, const QModelIndex &mailboxIndex, Parser *oldParser) :
     ImapTask(model), mailboxIndex(mailboxIndex), synchronizeConn(0), shouldExit(false), isRunning(Running::NOT_YET),
-    shouldRunNoop(false), shouldRunIdle(false), idleLauncher(0), unSelectTask(0),
+    shouldRunNoop(false), shouldRunIdle(false), idleLauncher(0), m_envelopesFollowViewport(false), unSelectTask(0),
     m_skippedStateSynces(0), m_performedStateSynces(0), m_syncingTimer(nullptr)
 {
     Q_ASSERT(mailboxIndex.isValid());
@@ -147,6 +148,20 @@ KeepMailboxOpenTask::KeepMailboxOpenTask(Model *model, const QModelIndex &mailbo
     if (! ok)
         limitParallelFetchTasks = 10;
 
+    limitParallelEnvelopeTasks = model->property("trojita-imap-limit-parallel-envelope-tasks").toInt(&ok);
+    if (! ok)
+        limitParallelEnvelopeTasks = 1;
+
+    limitParallelBackgroundTasks = model->property("trojita-imap-limit-parallel-background-tasks").toInt(&ok);
+    if (! ok)
+        limitParallelBackgroundTasks = 1;
+
+    limitReservedInteractiveTasks = model->property("trojita-imap-limit-reserved-interactive-tasks").toInt(&ok);
+    if (! ok)
+        limitReservedInteractiveTasks = 2;
+    // There has to be some room left for the less urgent requests
+    limitReservedInteractiveTasks = qBound(0, limitReservedInteractiveTasks, limitParallelFetchTasks - 1);
+
     limitActiveTasks = model->property("trojita-imap-limit-active-tasks").toInt(&ok);
     if (! ok)
         limitActiveTasks = 100;
@@ -275,8 +290,14 @@ void KeepMailboxOpenTask::slotTaskDeleted(QObject *object)
         dependingTasksForThisMailbox.removeOne(reinterpret_cast<ImapTask *>(object));
         dependingTasksNoMailbox.removeOne(reinterpret_cast<ImapTask *>(object));
         runningTasksForThisMailbox.removeOne(reinterpret_cast<ImapTask *>(object));
-        fetchPartTasks.removeOne(reinterpret_cast<FetchMsgPartTask *>(object));
-        fetchMetadataTasks.removeOne(reinterpret_cast<FetchMsgMetadataTask *>(object));
+        if (fetchPartTasks.removeOne(reinterpret_cast<FetchMsgPartTask *>(object)) && !requestedParts.isEmpty()) {
+            // Some of the less urgent requests might have been waiting for this one to finish
+            fetchPartTimer->start();
+        }
+        if (fetchMetadataTasks.removeOne(reinterpret_cast<FetchMsgMetadataTask *>(object)) && !requestedEnvelopes.isEmpty()) {
+            // There's a room for the envelopes which didn't fit into the previous batches
+            fetchEnvelopeTimer->start();
+        }
         abortableTasks.removeOne(reinterpret_cast<FetchMsgMetadataTask *>(object));
     }
 
@@ -445,7 +466,7 @@ bool KeepMailboxOpenTask::handleNumberResponse(const Imap::Responses::NumberResp
         return true;
     } else if (resp->kind == Imap::Responses::EXISTS) {
 
-        if (resp->number == static_cast<uint>(list->m_children.size())) {
+        if (resp->number == static_cast<uint>(list->m_rows.size())) {
             // no changes
             return true;
         }
@@ -454,10 +475,10 @@ bool KeepMailboxOpenTask::handleNumberResponse(const Imap::Responses::NumberResp
 
         breakOrCancelPossibleIdle();
 
-        Q_ASSERT(list->m_children.size());
+        Q_ASSERT(list->m_rows.size());
         uint highestKnownUid = 0;
-        for (int i = list->m_children.size() - 1; ! highestKnownUid && i >= 0; --i) {
-            highestKnownUid = static_cast<const TreeItemMessage *>(list->m_children[i])->uid();
+        for (int i = list->m_rows.size() - 1; ! highestKnownUid && i >= 0; --i) {
+            highestKnownUid = list->uidAt(i);
             //qDebug() << "UID disco: trying seq" << i << highestKnownUid;
         }
         breakOrCancelPossibleIdle();
@@ -755,7 +776,11 @@ void KeepMailboxOpenTask::activateTasks()
 
     while (!dependingTasksForThisMailbox.isEmpty() && model->accessParser(parser).activeTasks.size() < limitActiveTasks) {
         breakOrCancelPossibleIdle();
-        ImapTask *task = dependingTasksForThisMailbox.takeFirst();
+        // The most urgent task goes first; among those with the same priority, the oldest one wins
+        auto it = std::max_element(dependingTasksForThisMailbox.begin(), dependingTasksForThisMailbox.end(),
+                                   [](const ImapTask *a, const ImapTask *b) { return a->priority() < b->priority(); });
+        ImapTask *task = *it;
+        dependingTasksForThisMailbox.erase(it);
         runningTasksForThisMailbox.append(task);
         dependentTasks.removeOne(task);
         task->perform();
@@ -771,23 +796,100 @@ void KeepMailboxOpenTask::activateTasks()
         idleLauncher->enterIdleLater();
 }
 
-void KeepMailboxOpenTask::requestPartDownload(const uint uid, const QByteArray &partId, const uint estimatedSize)
+void KeepMailboxOpenTask::requestPartDownload(const uint uid, const QByteArray &partId, const uint estimatedSize,
+                                              const TaskPriority priority)
 {
-    requestedParts[uid].insert(partId);
-    requestedPartSizes[uid] += estimatedSize;
+    groupRequestedParts(uid, false);
+    auto &parts = requestedParts[uid];
+    auto it = parts.find(partId);
+    if (it == parts.end()) {
+        RequestedPart request;
+        request.estimatedSize = estimatedSize;
+        request.priority = priority;
+        parts.insert(partId, request);
+    } else if (it->priority < priority) {
+        it->priority = priority;
+    }
+    groupRequestedParts(uid, true);
     if (!fetchPartTimer->isActive()) {
         fetchPartTimer->start();
     }
 }
 
-void KeepMailboxOpenTask::requestEnvelopeDownload(const uint uid)
+void KeepMailboxOpenTask::raisePartPriority(const uint uid, const QList<QByteArray> &partIds)
+{
+    auto parts = requestedParts.find(uid);
+    bool raised = false;
+    if (parts != requestedParts.end()) {
+        groupRequestedParts(uid, false);
+        Q_FOREACH(const QByteArray &partId, partIds) {
+            auto it = parts->find(partId);
+            if (it != parts->end()) {
+                it->priority = TaskPriority::INTERACTIVE;
+                raised = true;
+            }
+        }
+        groupRequestedParts(uid, true);
+    }
+    if (raised) {
+        // Whatever was holding this request back does not apply anymore
+        fetchPartTimer->start();
+        return;
+    }
+
+    // The request might have been already turned into a task which did not get a chance to send its command yet
+    Q_FOREACH(ImapTask *task, dependingTasksForThisMailbox) {
+        FetchMsgPartTask *fetchTask = qobject_cast<FetchMsgPartTask *>(task);
+        if (!fetchTask || fetchTask->priority() == TaskPriority::INTERACTIVE || !fetchTask->uids.contains(uid))
+            continue;
+        Q_FOREACH(const QByteArray &partId, partIds) {
+            if (fetchTask->parts.contains(partId)) {
+                fetchTask->setPriority(TaskPriority::INTERACTIVE);
+                break;
+            }
+        }
+    }
+}
+
+void KeepMailboxOpenTask::requestEnvelopeDownload(const uint uid, const TaskPriority priority)
 {
     requestedEnvelopes.append(uid);
+    auto it = requestedEnvelopePriorities.find(uid);
+    if (it == requestedEnvelopePriorities.end()) {
+        requestedEnvelopePriorities.insert(uid, priority);
+    } else if (*it < priority) {
+        *it = priority;
+    }
     if (!fetchEnvelopeTimer->isActive()) {
         fetchEnvelopeTimer->start();
     }
 }
 
+Imap::Uids KeepMailboxOpenTask::abandonEnvelopeRequests(const QSet<uint> &wanted)
+{
+    m_envelopesFollowViewport = true;
+    Imap::Uids abandoned;
+    auto it = std::remove_if(requestedEnvelopes.begin(), requestedEnvelopes.end(), [this, &wanted, &abandoned](const uint uid) {
+        if (wanted.contains(uid))
+            return false;
+        abandoned << uid;
+        requestedEnvelopePriorities.remove(uid);
+        return true;
+    });
+    requestedEnvelopes.erase(it, requestedEnvelopes.end());
+    return abandoned;
+}
+
+void KeepMailboxOpenTask::stopFollowingViewport()
+{
+    if (!m_envelopesFollowViewport)
+        return;
+    m_envelopesFollowViewport = false;
+    if (!requestedEnvelopes.isEmpty() && !fetchEnvelopeTimer->isActive()) {
+        fetchEnvelopeTimer->start();
+    }
+}
+
 void KeepMailboxOpenTask::slotFetchRequestedParts()
 {
     // FIXME: abort/die
@@ -797,26 +899,104 @@ void KeepMailboxOpenTask::slotFetchRequestedParts()
 
     breakOrCancelPossibleIdle();
 
-    auto it = requestedParts.begin();
-    auto parts = *it;
+    while (!requestedPartGroups.isEmpty()) {
+        // The most urgent requests go first
+        const TaskPriority priority = requestedPartGroups.lastKey();
+        const auto &byPriority = requestedPartGroups.last();
+
+        // When asked to exit, do as much as possible and die
+        if (!shouldExit && !canStartPartFetch(priority))
+            return;
 
-    // When asked to exit, do as much as possible and die
-    while (shouldExit || fetchPartTasks.size() < limitParallelFetchTasks) {
+        // Messages which ask for the same parts are fetched together even when their UIDs are not adjacent. This is what
+        // keeps e.g. the previews of a screenful of messages at a single round trip. Only the parts with the same priority
+        // go into one command, so that a preload cannot delay what the user is waiting for.
+        auto group = std::min_element(byPriority.constBegin(), byPriority.constEnd(),
+                                      [](const QMap<uint, uint> &a, const QMap<uint, uint> &b) {
+            return a.firstKey() < b.firstKey();
+        });
+        const QList<QByteArray> parts = group.key().split('\n');
         Imap::Uids uids;
         uint totalSize = 0;
-        while (uids.size() < limitMessagesAtOnce && it != requestedParts.end() && totalSize < limitBytesAtOnce) {
-            if (parts != *it)
-                break;
-            parts = *it;
+        for (auto it = group->constBegin();
+             uids.size() < limitMessagesAtOnce && it != group->constEnd() && totalSize < limitBytesAtOnce; ++it) {
             uids << it.key();
-            totalSize += requestedPartSizes.take(it.key());
-            it = requestedParts.erase(it);
+            totalSize += *it;
         }
-        if (uids.isEmpty())
-            return;
 
-        fetchPartTasks << model->m_taskFactory->createFetchMsgPartTask(model, mailboxIndex, uids, parts.toList());
+        Q_FOREACH(const uint uid, uids) {
+            groupRequestedParts(uid, false);
+            auto requests = requestedParts.find(uid);
+            Q_FOREACH(const QByteArray &partId, parts) {
+                requests->remove(partId);
+            }
+            if (requests->isEmpty()) {
+                requestedParts.erase(requests);
+            } else {
+                groupRequestedParts(uid, true);
+            }
+        }
+
+        fetchPartTasks << model->m_taskFactory->createFetchMsgPartTask(model, mailboxIndex, uids, parts, priority);
+    }
+}
+
+/** @short Add the message @arg uid to the requestedPartGroups, or remove it from there if @arg add is false
+
+This has to be called before and after each modification of the requestedParts of that message.
+*/
+void KeepMailboxOpenTask::groupRequestedParts(const uint uid, const bool add)
+{
+    auto requests = requestedParts.constFind(uid);
+    if (requests == requestedParts.constEnd())
+        return;
+
+    // The part IDs are iterated in a stable order, so the same set of parts always makes the same key
+    QMap<TaskPriority, QPair<QByteArray, uint> > groups;
+    for (auto it = requests->constBegin(); it != requests->constEnd(); ++it) {
+        auto &group = groups[it->priority];
+        if (!group.first.isEmpty())
+            group.first += '\n';
+        group.first += it.key();
+        group.second += it->estimatedSize;
+    }
+
+    for (auto it = groups.constBegin(); it != groups.constEnd(); ++it) {
+        if (add) {
+            requestedPartGroups[it.key()][it->first].insert(uid, it->second);
+            continue;
+        }
+        auto byPriority = requestedPartGroups.find(it.key());
+        Q_ASSERT(byPriority != requestedPartGroups.end());
+        auto group = byPriority->find(it->first);
+        Q_ASSERT(group != byPriority->end());
+        group->remove(uid);
+        if (group->isEmpty())
+            byPriority->erase(group);
+        if (byPriority->isEmpty())
+            requestedPartGroups.erase(byPriority);
+    }
+}
+
+/** @short Is there a room for another part fetch with the given @arg priority?
+
+No more than limitParallelFetchTasks fetches are in flight at once. A few of these slots are reserved for what the user is
+waiting for, so that the less urgent requests cannot clog the connection in front of the ones which might come later.
+*/
+bool KeepMailboxOpenTask::canStartPartFetch(const TaskPriority priority) const
+{
+    switch (priority) {
+    case TaskPriority::INTERACTIVE:
+        return fetchPartTasks.size() < limitParallelFetchTasks;
+    case TaskPriority::PRELOAD:
+        return fetchPartTasks.size() < limitParallelFetchTasks - limitReservedInteractiveTasks;
+    case TaskPriority::BACKGROUND:
+        return fetchPartTasks.size() < limitParallelFetchTasks - limitReservedInteractiveTasks &&
+                std::count_if(fetchPartTasks.begin(), fetchPartTasks.end(), [](const FetchMsgPartTask *task) {
+                    return task->priority() == TaskPriority::BACKGROUND;
+                }) < limitParallelBackgroundTasks;
     }
+    Q_UNREACHABLE();
 }
 
 void KeepMailboxOpenTask::slotFetchRequestedEnvelopes()
@@ -828,6 +1008,16 @@ void KeepMailboxOpenTask::slotFetchRequestedEnvelopes()
 
     breakOrCancelPossibleIdle();
 
+    // When the requests follow what a view shows, keep them queued while a previous batch is still being fetched. Whatever
+    // scrolls away in the meanwhile gets dropped through abandonEnvelopeRequests(), and the rest goes out as a single command.
+    if (!shouldExit && m_envelopesFollowViewport && fetchMetadataTasks.size() >= limitParallelEnvelopeTasks)
+        return;
+
+    // The messages which the user is waiting for go first, the preloading comes afterwards
+    std::stable_partition(requestedEnvelopes.begin(), requestedEnvelopes.end(), [this](const uint uid) {
+        return requestedEnvelopePriorities.value(uid, TaskPriority::INTERACTIVE) == TaskPriority::INTERACTIVE;
+    });
+
     Imap::Uids fetchNow;
     if (shouldExit) {
         fetchNow = requestedEnvelopes;
@@ -837,7 +1027,14 @@ void KeepMailboxOpenTask::slotFetchRequestedEnvelopes()
         fetchNow = requestedEnvelopes.mid(0, amount);
         requestedEnvelopes.erase(requestedEnvelopes.begin(), requestedEnvelopes.begin() + amount);
     }
-    fetchMetadataTasks << model->m_taskFactory->createFetchMsgMetadataTask(model, mailboxIndex, fetchNow);
+    TaskPriority priority = TaskPriority::BACKGROUND;
+    Q_FOREACH(const uint uid, fetchNow) {
+        priority = qMax(priority, requestedEnvelopePriorities.take(uid));
+    }
+    // Sorted UIDs without duplicates make for the shortest sequence of ranges in the FETCH command
+    qSort(fetchNow);
+    fetchNow.erase(std::unique(fetchNow.begin(), fetchNow.end()), fetchNow.end());
+    fetchMetadataTasks << model->m_taskFactory->createFetchMsgMetadataTask(model, mailboxIndex, fetchNow, priority);
 }
 
 void KeepMailboxOpenTask::breakOrCancelPossibleIdle()
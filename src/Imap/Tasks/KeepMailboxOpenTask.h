@@ -145,9 +145,16 @@ public:
 
     QString debugIdentification() const;
 
-    void requestPartDownload(const uint uid, const QByteArray &partId, const uint estimatedSize);
+    void requestPartDownload(const uint uid, const QByteArray &partId, const uint estimatedSize,
+                             const TaskPriority priority = TaskPriority::INTERACTIVE);
+    /** @short The user is waiting for the @arg partIds of the message @arg uid which might have been requested with a lower priority */
+    void raisePartPriority(const uint uid, const QList<QByteArray> &partIds);
     /** @short Request a delayed loading of a message envelope */
-    void requestEnvelopeDownload(const uint uid);
+    void requestEnvelopeDownload(const uint uid, const TaskPriority priority = TaskPriority::INTERACTIVE);
+    /** @short Drop the queued envelope requests for messages which are not in @arg wanted, return their UIDs */
+    Imap::Uids abandonEnvelopeRequests(const QSet<uint> &wanted);
+    /** @short No view shows this mailbox anymore, so the queued envelope requests should not wait for viewport updates */
+    void stopFollowingViewport();
 
     virtual QVariant taskData(const int role) const;
 
@@ -159,6 +166,9 @@ public:
 
     bool hasItsOwnActivity() const;
 
+    bool canStartPartFetch(const TaskPriority priority) const;
+    void groupRequestedParts(const uint uid, const bool add);
+
 private slots:
     void slotTaskDeleted(QObject *object);
 
@@ -288,18 +298,39 @@ protected:
     friend class ::ImapModelIdleTest;
     friend class ::LibMailboxSync;
 
-    QMap<uint, QSet<QByteArray> > requestedParts;
-    QMap<uint, uint> requestedPartSizes;
+    /** @short A queued request for fetching a single message part */
+    struct RequestedPart {
+        uint estimatedSize;
+        TaskPriority priority;
+    };
+    /** @short Parts which are waiting to be fetched, indexed by the UID of their message and by the fetch item */
+    QMap<uint, QMap<QByteArray, RequestedPart> > requestedParts;
+    /** @short The requestedParts grouped by priority and by the parts which a message asks for with that priority
+
+    The inner key is made of the part IDs, the innermost map goes from the UID to the estimated size of these parts. See
+    groupRequestedParts().
+    */
+    QMap<TaskPriority, QMap<QByteArray, QMap<uint, uint> > > requestedPartGroups;
     /** @short UIDs of messages with pending FetchMsgMetadataTask request
 
     QList is used in preference to the QSet in an attempt to maintain the order of requests. Simply ordering via UID is
     not enough because of output sorting, threads etc etc.
     */
     Imap::Uids requestedEnvelopes;
+    /** @short How urgently is each of the requestedEnvelopes needed */
+    QHash<uint, TaskPriority> requestedEnvelopePriorities;
+    /** @short Is a view telling us which envelopes are still interesting? See abandonEnvelopeRequests(). */
+    bool m_envelopesFollowViewport;
 
     uint limitBytesAtOnce;
     int limitMessagesAtOnce;
     int limitParallelFetchTasks;
+    /** @short How many envelope fetches to keep in flight while the requests are driven by a view */
+    int limitParallelEnvelopeTasks;
+    /** @short How many part fetches with the TaskPriority::BACKGROUND priority can be in flight at once */
+    int limitParallelBackgroundTasks;
+    /** @short How many of the limitParallelFetchTasks slots are only available to the TaskPriority::INTERACTIVE fetches */
+    int limitReservedInteractiveTasks;
     int limitActiveTasks;
 
     /** @short An UNSELECT task, if active */
@@ -39,7 +39,7 @@ namespace Mailbox
 ObtainSynchronizedMailboxTask::ObtainSynchronizedMailboxTask(Model *model, const QModelIndex &mailboxIndex, ImapTask *parentTask,
         KeepMailboxOpenTask *keepTask):
     ImapTask(model), conn(parentTask), mailboxIndex(mailboxIndex), status(STATE_WAIT_FOR_CONN), uidSyncingMode(UID_SYNC_ALL),
-    firstUnknownUidOffset(0), m_usingQresync(false), unSelectTask(0), keepTaskChild(keepTask)
+    firstUnknownUidOffset(0), m_usingQresync(false), m_flagsChangedSilently(false), unSelectTask(0), keepTaskChild(keepTask)
 {
     // The Parser* is not provided by our parent task, but instead through the keepTaskChild.  The reason is simple, the parent
     // task might not even exist, but there's always an KeepMailboxOpenTask in the game.
@@ -288,10 +288,10 @@ void ObtainSynchronizedMailboxTask::finalizeSelect()
                             model->cache()->clearAllMessages(mailbox->mailbox());
                             m_usingQresync = false;
                             fullMboxSync(mailbox, list);
-                        } else if (syncState.exists() != static_cast<uint>(list->m_children.size())) {
+                        } else if (syncState.exists() != static_cast<uint>(list->m_rows.size())) {
                             log(QString::fromUtf8("Sync error: constant HIGHESTMODSEQ, EXISTS says %1 messages but in fact "
                                                    "there are %2 when finalizing SELECT")
-                                .arg(QString::number(mailbox->syncState.exists()), QString::number(list->m_children.size())),
+                                .arg(QString::number(mailbox->syncState.exists()), QString::number(list->m_rows.size())),
                                 Common::LOG_MAILBOX_SYNC);
                             mailbox->syncState.setHighestModSeq(0);
                             model->cache()->clearAllMessages(mailbox->mailbox());
@@ -308,9 +308,9 @@ void ObtainSynchronizedMailboxTask::finalizeSelect()
                         return;
                     }
 
-                    if (static_cast<uint>(list->m_children.size()) != mailbox->syncState.exists()) {
+                    if (static_cast<uint>(list->m_rows.size()) != mailbox->syncState.exists()) {
                         log(QStringLiteral("Sync error: EXISTS says %1 messages, msgList has %2")
-                            .arg(QString::number(mailbox->syncState.exists()), QString::number(list->m_children.size())));
+                            .arg(QString::number(mailbox->syncState.exists()), QString::number(list->m_rows.size())));
                         mailbox->syncState.setHighestModSeq(0);
                         model->cache()->clearAllMessages(mailbox->mailbox());
                         m_usingQresync = false;
@@ -322,9 +322,8 @@ void ObtainSynchronizedMailboxTask::finalizeSelect()
                     if (oldSyncState.uidNext() < syncState.uidNext()) {
                         list->setFetchStatus(TreeItem::DONE);
                         int seqWithLowestUnknownUid = -1;
-                        for (int i = 0; i < list->m_children.size(); ++i) {
-                            TreeItemMessage *msg = static_cast<TreeItemMessage*>(list->m_children[i]);
-                            if (!msg->uid()) {
+                        for (int i = 0; i < list->m_rows.size(); ++i) {
+                            if (!list->uidAt(i)) {
                                 seqWithLowestUnknownUid = i;
                                 break;
                             }
@@ -409,21 +408,17 @@ void ObtainSynchronizedMailboxTask::fullMboxSync(TreeItemMailbox *mailbox, TreeI
     log(QStringLiteral("Full synchronization"), Common::LOG_MAILBOX_SYNC);
 
     QModelIndex parent = list->toIndex(model);
-    if (! list->m_children.isEmpty()) {
-        model->beginRemoveRows(parent, 0, list->m_children.size() - 1);
-        auto oldItems = list->m_children;
-        list->m_children.clear();
+    if (! list->m_rows.isEmpty()) {
+        model->beginRemoveRows(parent, 0, list->m_rows.size() - 1);
+        auto oldRows = list->takeRows(0, list->m_rows.size());
         model->endRemoveRows();
-        qDeleteAll(oldItems);
+        for (auto it = oldRows.constBegin(); it != oldRows.constEnd(); ++it) {
+            delete it->item;
+        }
     }
     if (mailbox->syncState.exists()) {
-        list->m_children.reserve(mailbox->syncState.exists());
         model->beginInsertRows(parent, 0, mailbox->syncState.exists() - 1);
-        for (uint i = 0; i < mailbox->syncState.exists(); ++i) {
-            TreeItemMessage *msg = new TreeItemMessage(list);
-            msg->m_offset = i;
-            list->m_children << msg;
-        }
+        list->appendRows(mailbox->syncState.exists());
         model->endInsertRows();
 
         syncUids(mailbox);
@@ -460,9 +455,9 @@ void ObtainSynchronizedMailboxTask::syncNoNewNoDeletions(TreeItemMailbox *mailbo
     if (mailbox->syncState.exists()) {
         // Verify that we indeed have all UIDs and not need them anymore
 #ifndef QT_NO_DEBUG
-        for (int i = 0; i < list->m_children.size(); ++i) {
+        for (int i = 0; i < list->m_rows.size(); ++i) {
             // FIXME: This assert can fail if the mailbox contained messages with missing UIDs even before we opened it now.
-            Q_ASSERT(static_cast<TreeItemMessage *>(list->m_children[i])->uid());
+            Q_ASSERT(list->uidAt(i));
         }
 #endif
     } else {
@@ -471,19 +466,14 @@ void ObtainSynchronizedMailboxTask::syncNoNewNoDeletions(TreeItemMailbox *mailbo
         list->m_numberFetchingStatus = TreeItem::DONE;
     }
 
-    if (list->m_children.isEmpty()) {
-        TreeItemChildrenList messages;
-        list->m_children.reserve(mailbox->syncState.exists());
+    if (list->m_rows.isEmpty()) {
+        list->m_rows.resize(mailbox->syncState.exists());
         for (uint i = 0; i < mailbox->syncState.exists(); ++i) {
-            TreeItemMessage *msg = new TreeItemMessage(list);
-            msg->m_offset = i;
-            msg->m_uid = uidMap[ i ];
-            messages << msg;
+            list->m_rows[i].uid = uidMap[i];
         }
-        list->setChildren(messages);
 
     } else {
-        if (mailbox->syncState.exists() != static_cast<uint>(list->m_children.size())) {
+        if (mailbox->syncState.exists() != static_cast<uint>(list->m_rows.size())) {
             throw CantHappen("TreeItemMsgList has wrong number of "
                              "children, even though no change of "
                              "message count occurred");
@@ -681,8 +671,8 @@ bool ObtainSynchronizedMailboxTask::handleResponseCodeInsideState(const Imap::Re
 void ObtainSynchronizedMailboxTask::updateHighestKnownUid(TreeItemMailbox *mailbox, const TreeItemMsgList *list) const
 {
     uint highestKnownUid = 0;
-    for (int i = list->m_children.size() - 1; ! highestKnownUid && i >= 0; --i) {
-        highestKnownUid = static_cast<const TreeItemMessage *>(list->m_children[i])->uid();
+    for (int i = list->m_rows.size() - 1; ! highestKnownUid && i >= 0; --i) {
+        highestKnownUid = list->uidAt(i);
     }
     if (highestKnownUid) {
         // If the UID walk return a usable number, remember that and use it for updating our idea of the UIDNEXT
@@ -711,19 +701,14 @@ bool ObtainSynchronizedMailboxTask::handleNumberResponse(const Imap::Responses::
                 // Because QRESYNC won't tell us anything about the new UIDs, we have to resort to this kludgy way of working.
                 // I really, really wonder why there's no such thing like the ARRIVED to accompany VANISHED. Oh well.
                 mailbox->syncState.setExists(resp->number);
-                int newArrivals = resp->number - list->m_children.size();
+                int newArrivals = resp->number - list->m_rows.size();
                 if (newArrivals > 0) {
                     // We have to add empty messages here
                     QModelIndex parent = list->toIndex(model);
-                    int offset = list->m_children.size();
-                    list->m_children.reserve(resp->number);
+                    int offset = list->m_rows.size();
                     model->beginInsertRows(parent, offset, resp->number - 1);
-                    for (int i = 0; i < newArrivals; ++i) {
-                        TreeItemMessage *msg = new TreeItemMessage(list);
-                        msg->m_offset = i + offset;
-                        list->m_children << msg;
-                        // yes, we really have to add this message with UID 0 :(
-                    }
+                    // yes, we really have to add these messages with UID 0 :(
+                    list->appendRows(newArrivals);
                     model->endInsertRows();
                     list->m_totalMessageCount = resp->number;
                 }
@@ -741,12 +726,12 @@ bool ObtainSynchronizedMailboxTask::handleNumberResponse(const Imap::Responses::
 
         case STATE_SYNCING_FLAGS:
         case STATE_DONE:
-            if (resp->number == static_cast<uint>(list->m_children.size())) {
+            if (resp->number == static_cast<uint>(list->m_rows.size())) {
                 // no changes
                 return true;
             }
             mailbox->handleExists(model, *resp);
-            Q_ASSERT(list->m_children.size());
+            Q_ASSERT(list->m_rows.size());
             updateHighestKnownUid(mailbox, list);
             CommandHandle fetchCmd = parser->uidFetch(Sequence::startingAt(
                                                     // prevent a possible invalid 0:*
@@ -991,6 +976,15 @@ bool ObtainSynchronizedMailboxTask::handleFetch(const Imap::Responses::Fetch *co
 
     TreeItemMailbox *mailbox = Model::mailboxForSomeItem(mailboxIndex);
     Q_ASSERT(mailbox);
+    TreeItemMsgList *list = dynamic_cast<TreeItemMsgList *>(mailbox->m_children[0]);
+    Q_ASSERT(list);
+    const int number = static_cast<int>(resp->number) - 1;
+    if (number >= 0 && number < list->m_rows.size() && !list->existingMessageAt(number) && !list->m_rows[number].flagsHandled
+            && resp->data.contains("FLAGS")) {
+        // The first FLAGS of a message which nobody has looked at yet are stored without any notification,
+        // see notifyInterestingMessages()
+        m_flagsChangedSilently = true;
+    }
     QList<TreeItemPart *> changedParts;
     TreeItemMessage *changedMessage = 0;
     mailbox->handleFetchResponse(model, *resp, changedParts, changedMessage, m_usingQresync);
@@ -1020,48 +1014,50 @@ void ObtainSynchronizedMailboxTask::applyUids(TreeItemMailbox *mailbox)
     TreeItemMsgList *list = dynamic_cast<TreeItemMsgList *>(mailbox->m_children[0]);
     Q_ASSERT(list);
     QModelIndex parent = list->toIndex(model);
-    list->m_children.reserve(mailbox->syncState.exists());
+    list->m_rows.reserve(mailbox->syncState.exists());
+
+    // The messages whose UIDs got filled in are announced in one go at the end; there could be quite a lot of them.
+    // All of them precede the current position, so they are not affected by any removals.
+    int firstFilledIn = -1;
+    int lastFilledIn = -1;
 
     int i = firstUnknownUidOffset;
     while (i < uidMap.size() + static_cast<int>(firstUnknownUidOffset)) {
-        // Index inside the uidMap in which the UID of a message at offset i in the list->m_children can be found
+        // Index inside the uidMap in which the UID of a message at offset i in the list->m_rows can be found
         int uidOffset = i - firstUnknownUidOffset;
         Q_ASSERT(uidOffset >= 0);
         Q_ASSERT(uidOffset < uidMap.size());
 
         // For each UID which is really supposed to be there...
 
-        Q_ASSERT(i <= list->m_children.size());
-        if (i == list->m_children.size()) {
+        Q_ASSERT(i <= list->m_rows.size());
+        if (i == list->m_rows.size()) {
             // now we're just adding new messages to the end of the list
             const int futureTotalMessages = mailbox->syncState.exists();
             model->beginInsertRows(parent, i, futureTotalMessages - 1);
+            // Add all messages in one go
+            list->appendRows(futureTotalMessages - i);
             for (/*nothing*/; i < futureTotalMessages; ++i) {
-                // Add all messages in one go
-                TreeItemMessage *msg = new TreeItemMessage(list);
-                msg->m_offset = i;
                 // We're iterating with i, so we got to update the uidOffset
                 uidOffset = i - firstUnknownUidOffset;
                 Q_ASSERT(uidOffset >= 0);
                 Q_ASSERT(uidOffset < uidMap.size());
-                msg->m_uid = uidMap[uidOffset];
-                list->m_children << msg;
+                list->m_rows[i].uid = uidMap[uidOffset];
             }
             model->endInsertRows();
-            Q_ASSERT(i == list->m_children.size());
+            Q_ASSERT(i == list->m_rows.size());
             Q_ASSERT(i == futureTotalMessages);
-        } else if (static_cast<TreeItemMessage *>(list->m_children[i])->m_uid == uidMap[uidOffset]) {
+        } else if (list->uidAt(i) == uidMap[uidOffset]) {
             // If the UID of the "current message" matches, we're okay
-            static_cast<TreeItemMessage *>(list->m_children[i])->m_offset = i;
             ++i;
-        } else if (static_cast<TreeItemMessage *>(list->m_children[i])->m_uid == 0) {
+        } else if (list->uidAt(i) == 0) {
             // If the UID of the "current message" is zero, replace that with this message
-            TreeItemMessage *msg = static_cast<TreeItemMessage*>(list->m_children[i]);
-            msg->m_uid = uidMap[uidOffset];
-            msg->m_offset = i;
-            QModelIndex idx = model->createIndex(i, 0, msg);
-            emit model->dataChanged(idx, idx);
-            if (msg->accessFetchStatus() == TreeItem::LOADING) {
+            list->m_rows[i].uid = uidMap[uidOffset];
+            if (firstFilledIn == -1)
+                firstFilledIn = i;
+            lastFilledIn = i;
+            TreeItemMessage *msg = list->existingMessageAt(i);
+            if (msg && msg->accessFetchStatus() == TreeItem::LOADING) {
                 // We've got to ask for the message metadata once again; the first attempt happened when the UID was still zero,
                 // so this is our chance
                 model->askForMsgMetadata(msg, Model::PRELOAD_PER_POLICY);
@@ -1070,15 +1066,15 @@ void ObtainSynchronizedMailboxTask::applyUids(TreeItemMailbox *mailbox)
         } else {
             // We've got an UID mismatch
             int pos = i;
-            while (pos < list->m_children.size()) {
+            while (pos < list->m_rows.size()) {
                 // Remove any messages which have non-zero UID which is at the same time different than the UID we want to add
                 // The key idea here is that IMAP guarantees that each and every new message will have greater UID than any
                 // other message already in the mailbox. Just for the sake of completeness, should an evil server send us a
                 // malformed response, we wouldn't care (or notice at this point), we'd just "needlessly" delete many "innocent"
                 // messages due to that one out-of-place arrival -- but we'd still remain correct and not crash.
-                TreeItemMessage *otherMessage = static_cast<TreeItemMessage*>(list->m_children[pos]);
-                if (otherMessage->m_uid != 0 && otherMessage->m_uid != uidMap[uidOffset]) {
-                    model->cache()->clearMessage(mailbox->mailbox(), otherMessage->uid());
+                const uint otherUid = list->uidAt(pos);
+                if (otherUid != 0 && otherUid != uidMap[uidOffset]) {
+                    model->cache()->clearMessage(mailbox->mailbox(), otherUid);
                     ++pos;
                 } else {
                     break;
@@ -1086,34 +1082,39 @@ void ObtainSynchronizedMailboxTask::applyUids(TreeItemMailbox *mailbox)
             }
             Q_ASSERT(pos > i);
             model->beginRemoveRows(parent, i, pos - 1);
-            TreeItemChildrenList removedItems = list->m_children.mid(i, pos - i);
-            list->m_children.erase(list->m_children.begin() + i, list->m_children.begin() + pos);
+            auto removedRows = list->takeRows(i, pos - i);
             model->endRemoveRows();
-            // the m_offset of all subsequent messages will be updated later, at the time *they* are processed
-            qDeleteAll(removedItems);
-            if (i == list->m_children.size()) {
+            for (auto it = removedRows.constBegin(); it != removedRows.constEnd(); ++it) {
+                delete it->item;
+            }
+            if (i == list->m_rows.size()) {
                 // We're asked to add messages to the end of the list. That's something that's already implemented above,
                 // so let's reuse that code. That's why we do *not* want to increment the counter here.
             } else {
-                Q_ASSERT(i < list->m_children.size());
+                Q_ASSERT(i < list->m_rows.size());
                 // But this case is also already implemented above, so we won't touch the counter from here, either,
                 // and let the existing code do its job
             }
         }
     }
 
-    if (i != list->m_children.size()) {
+    if (i != list->m_rows.size()) {
         // remove items at the end
-        model->beginRemoveRows(parent, i, list->m_children.size() - 1);
-        TreeItemChildrenList removedItems = list->m_children.mid(i);
-        list->m_children.erase(list->m_children.begin() + i, list->m_children.end());
+        model->beginRemoveRows(parent, i, list->m_rows.size() - 1);
+        auto removedRows = list->takeRows(i, list->m_rows.size() - i);
         model->endRemoveRows();
-        qDeleteAll(removedItems);
+        for (auto it = removedRows.constBegin(); it != removedRows.constEnd(); ++it) {
+            delete it->item;
+        }
+    }
+
+    if (firstFilledIn != -1) {
+        emit model->dataChanged(list->messageAt(firstFilledIn)->toIndex(model), list->messageAt(lastFilledIn)->toIndex(model));
     }
 
     uidMap.clear();
 
-    list->m_totalMessageCount = list->m_children.size();
+    list->m_totalMessageCount = list->m_rows.size();
     list->setFetchStatus(TreeItem::DONE);
 
     model->emitMessageCountChanged(mailbox);
@@ -1155,6 +1156,11 @@ void ObtainSynchronizedMailboxTask::notifyInterestingMessages(TreeItemMailbox *m
     TreeItemMsgList *list = dynamic_cast<Imap::Mailbox::TreeItemMsgList *>(mailbox->m_children[0]);
     Q_ASSERT(list);
     list->recalcVariousMessageCounts(model);
+    if (m_flagsChangedSilently && !list->m_rows.isEmpty()) {
+        // Some rows got their flags without the views being told about it; let them catch up with all of that at once
+        m_flagsChangedSilently = false;
+        emit model->dataChanged(list->messageAt(0)->toIndex(model), list->messageAt(list->m_rows.size() - 1)->toIndex(model));
+    }
     QModelIndex listIndex = list->toIndex(model);
     Q_ASSERT(listIndex.isValid());
     QModelIndex firstInterestingMessage = model->index(
@@ -113,6 +113,8 @@ private:
     uint firstUnknownUidOffset;
     SyncState oldSyncState;
     bool m_usingQresync;
+    /** @short Have some messages received their first FLAGS without a dataChanged() being emitted for them? */
+    bool m_flagsChangedSilently;
 
     /** @short An UNSELECT task, if active */
     UnSelectTask *unSelectTask;
@@ -72,28 +72,30 @@ bool UpdateFlagsOfAllMessagesTask::handleStateHelper(const Imap::Responses::Stat
             TreeItemMsgList *list = dynamic_cast<TreeItemMsgList*>(mailbox->m_children [0]);
             Q_ASSERT(list);
 
-            Q_FOREACH (TreeItem *item, list->m_children) {
-                TreeItemMessage *message = dynamic_cast<TreeItemMessage *>(item);
-                Q_ASSERT(message);
-
-                if (message->uid() == 0) {
+            int firstChanged = -1;
+            int lastChanged = -1;
+            for (int row = 0; row < list->m_rows.size(); ++row) {
+                const uint uid = list->uidAt(row);
+                if (uid == 0) {
                     // UID not determined yet, so we cannot really modify its flags
                     continue;
                 }
 
                 Q_ASSERT(flagOperation == Imap::Mailbox::FLAG_ADD || flagOperation == Imap::Mailbox::FLAG_ADD_SILENT);
-                QStringList newFlags = message->m_flags;
+                QStringList newFlags = list->flagsAt(row);
                 if (!newFlags.contains(flags)) {
                     newFlags << flags;
-                    message->setFlags(list, model->normalizeFlags(newFlags));
-                    model->cache()->setMsgFlags(mailbox->mailbox(), message->uid(), newFlags);
-                    QModelIndex messageIndex = model->createIndex(message->m_offset, 0, message);
-
-                    // emitting dataChanged() separately for each message in the mailbox:
-                    // Trojita model assmues that dataChanged is emitted individually
-                    model->dataChanged(messageIndex, messageIndex);
+                    list->setFlagsAt(row, model->normalizeFlags(newFlags));
+                    model->cache()->setMsgFlags(mailbox->mailbox(), uid, newFlags);
+                    if (firstChanged == -1)
+                        firstChanged = row;
+                    lastChanged = row;
                 }
             }
+            if (firstChanged != -1) {
+                // A single range is enough; there's no need to instantiate each and every message just to announce its change
+                emit model->dataChanged(list->messageAt(firstChanged)->toIndex(model), list->messageAt(lastChanged)->toIndex(model));
+            }
             model->emitMessageCountChanged(mailbox);
             list->fetchNumbers(model);
             _completed();
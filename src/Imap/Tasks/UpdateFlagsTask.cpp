@@ -21,6 +21,8 @@
 */
 
 
+#include <algorithm>
+#include <iterator>
 #include "UpdateFlagsTask.h"
 #include "Imap/Model/ItemRoles.h"
 #include "Imap/Model/MailboxTree.h"
@@ -33,27 +35,42 @@ namespace Imap
 namespace Mailbox
 {
 
-UpdateFlagsTask::UpdateFlagsTask(Model *model, const QModelIndexList &messages_, const FlagsOperation flagOperation, const QString &flags):
-    ImapTask(model), copyMove(0), flagOperation(flagOperation), flags(flags)
+/** @short Maximal length of the sequence-set in one UID STORE
+
+RFC 7162 recommends that clients limit their command lines to 8192 octets; this leaves enough room for the rest of the command.
+*/
+const int maxStoreSequenceLength = 7000;
+
+UpdateFlagsTask::UpdateFlagsTask(Model *model, const QModelIndex &mailbox, const Imap::Uids &uids_,
+                                 const FlagsOperation flagOperation, const QString &flags):
+    ImapTask(model), copyMove(0), mailboxIndex(mailbox), flagOperation(flagOperation), flags(flags), someStoreFailed(false)
 {
-    if (messages_.isEmpty()) {
-        throw CantHappen("UpdateFlagsTask called with empty message set");
-    }
-    Q_FOREACH(const QModelIndex& index, messages_) {
-        messages << index;
-    }
-    QModelIndex mailboxIndex = model->findMailboxForItems(messages_);
-    conn = model->findTaskResponsibleFor(mailboxIndex);
+    setUids(uids_);
+    conn = model->findTaskResponsibleFor(mailbox);
     conn->addDependentTask(this);
 }
 
-UpdateFlagsTask::UpdateFlagsTask(Model *model, CopyMoveMessagesTask *copyTask, const QList<QPersistentModelIndex> &messages,
+UpdateFlagsTask::UpdateFlagsTask(Model *model, CopyMoveMessagesTask *copyTask, const QModelIndex &mailbox, const Imap::Uids &uids_,
                                  const FlagsOperation flagOperation, const QString &flags):
-    ImapTask(model), conn(0), copyMove(copyTask), messages(messages), flagOperation(flagOperation), flags(flags)
+    ImapTask(model), conn(0), copyMove(copyTask), mailboxIndex(mailbox), flagOperation(flagOperation), flags(flags),
+    someStoreFailed(false)
 {
+    setUids(uids_);
     copyTask->addDependentTask(this);
 }
 
+/** @short Remember the UIDs in a sorted order and without duplicates */
+void UpdateFlagsTask::setUids(const Imap::Uids &uids_)
+{
+    uids = uids_;
+    qSort(uids);
+    uids.erase(std::unique(uids.begin(), uids.end()), uids.end());
+    uids.removeAll(0);
+    if (uids.isEmpty()) {
+        throw CantHappen("UpdateFlagsTask called with empty message set");
+    }
+}
+
 void UpdateFlagsTask::perform()
 {
     Q_ASSERT(conn || copyMove);
@@ -65,63 +82,138 @@ void UpdateFlagsTask::perform()
 
     IMAP_TASK_CHECK_ABORT_DIE;
 
-    Sequence seq;
-    bool first = true;
+    TreeItemMailbox *mailbox = mailboxIndex.isValid() ? Model::mailboxForSomeItem(mailboxIndex) : 0;
+    if (!mailbox) {
+        _failed(tr("Mailbox disappeared before we could've updated the flags"));
+        return;
+    }
+    TreeItemMsgList *list = dynamic_cast<TreeItemMsgList*>(mailbox->m_children[0]);
+    Q_ASSERT(list);
 
-    Q_FOREACH(const QPersistentModelIndex& index, messages) {
-        if (!index.isValid()) {
-            log(QStringLiteral("Some message got removed before we could update its flags"), Common::LOG_MESSAGES);
-        } else {
-            TreeItem *item = static_cast<TreeItem *>(index.internalPointer());
-            Q_ASSERT(item);
-            TreeItemMessage *message = dynamic_cast<TreeItemMessage *>(item);
-            Q_ASSERT(message);
-            if (first) {
-                seq = Sequence(message->uid());
-                first = false;
-            } else {
-                seq.add(message->uid());
-            }
-            switch (flagOperation) {
-            case FLAG_ADD:
-            case FLAG_REMOVE:
-            case FLAG_USE_THESE:
-                // we aren't supposed to update them ourselves; the IMAP server will tell us
-                break;
-            case FLAG_REMOVE_SILENT:
-            {
-                TreeItemMsgList *list = dynamic_cast<TreeItemMsgList*>(message->parent());
-                Q_ASSERT(list);
-                QStringList newFlags = message->m_flags;
-                newFlags.removeOne(flags);
-                message->setFlags(list, newFlags);
-                // we don't have to either re-sort or call Model::normalizeFlags again from this context;
-                // this will change when the model starts de-duplicating whole lists
-                model->cache()->setMsgFlags(static_cast<TreeItemMailbox*>(list->parent())->mailbox(), message->uid(), newFlags);
-                break;
-            }
-            case FLAG_ADD_SILENT:
-            {
-                TreeItemMsgList *list = dynamic_cast<TreeItemMsgList*>(message->parent());
-                Q_ASSERT(list);
-                QStringList newFlags = message->m_flags;
-                if (!newFlags.contains(flags)) {
-                    newFlags << flags;
-                    message->setFlags(list, model->normalizeFlags(newFlags));
-                    model->cache()->setMsgFlags(static_cast<TreeItemMailbox*>(list->parent())->mailbox(), message->uid(), newFlags);
-                }
-                break;
-            }
-            }
+    QString flagString = flags;
+    if (flagString.startsWith(QLatin1Char('(')) && flagString.endsWith(QLatin1Char(')')))
+        flagString = flagString.mid(1, flagString.size() - 2);
+    const QStringList change = flagString.split(QLatin1Char(' '), QString::SkipEmptyParts);
+
+    Imap::Uids presentUids;
+    presentUids.reserve(uids.size());
+    QVector<int> changedRows;
+
+    // Apply the change optimistically; the server will either confirm it, or we will revert it
+    Q_FOREACH(const int row, model->findMessageRowsByUids(mailbox, uids)) {
+        const uint uid = list->uidAt(row);
+        presentUids << uid;
+        previousFlags[uid] = list->flagsAt(row);
+
+        QStringList newFlags = model->normalizeFlags(updatedFlags(list->flagsAt(row), change));
+        if (newFlags != list->flagsAt(row)) {
+            list->setFlagsAt(row, newFlags);
+            changedRows << row;
         }
     }
 
-    if (first) {
+    if (presentUids.isEmpty()) {
         // No valid messages
         _failed(tr("All messages got removed before we could've updated their flags"));
         return;
     }
-    tag = parser->uidStore(seq, toImapString(flagOperation), flags);
+    if (presentUids.size() != uids.size()) {
+        log(QStringLiteral("%1 messages got removed before we could update their flags").arg(uids.size() - presentUids.size()),
+            Common::LOG_MESSAGES);
+    }
+    uids = presentUids;
+    emitDataChanged(list, changedRows);
+    model->emitMessageCountChanged(mailbox);
+
+    // Replacing the whole set of flags could silently revert changes made by other clients which we haven't heard about yet.
+    // The CONDSTORE extension lets the server refuse to touch those messages. For +FLAGS and -FLAGS, such a conflict does
+    // not matter because these changes are not affected by the state of the other flags.
+    quint64 unchangedSince = 0;
+    if (flagOperation == FLAG_USE_THESE && mailbox->syncState.isUsableForCondstore() &&
+            (model->accessParser(parser).capabilities.contains(QStringLiteral("CONDSTORE")) ||
+             model->accessParser(parser).capabilities.contains(QStringLiteral("QRESYNC")))) {
+        unchangedSince = mailbox->syncState.highestModSeq();
+    }
+
+    Q_FOREACH(const Sequence &seq, Sequence::fromVector(uids).split(maxStoreSequenceLength)) {
+        pendingStores[parser->uidStore(seq, toImapString(flagOperation), flags, unchangedSince)] = seq.toVector();
+    }
+}
+
+/** @short Notify about changed messages, one signal per a contiguous range of rows */
+void UpdateFlagsTask::emitDataChanged(TreeItemMsgList *list, QVector<int> rows)
+{
+    if (rows.isEmpty())
+        return;
+    qSort(rows);
+    int first = rows.front();
+    for (int i = 1; i <= rows.size(); ++i) {
+        if (i < rows.size() && rows[i] == rows[i - 1] + 1)
+            continue;
+        const int last = rows[i - 1];
+        emit model->dataChanged(list->messageAt(first)->toIndex(model), list->messageAt(last)->toIndex(model));
+        if (i < rows.size())
+            first = rows[i];
+    }
+}
+
+/** @short Return the flags which result from applying our operation on the @arg oldFlags */
+QStringList UpdateFlagsTask::updatedFlags(const QStringList &oldFlags, const QStringList &change) const
+{
+    QStringList res = oldFlags;
+    switch (flagOperation) {
+    case FLAG_ADD:
+    case FLAG_ADD_SILENT:
+        Q_FOREACH(const QString &flag, change) {
+            if (!res.contains(flag))
+                res << flag;
+        }
+        break;
+    case FLAG_REMOVE:
+    case FLAG_REMOVE_SILENT:
+        Q_FOREACH(const QString &flag, change) {
+            res.removeAll(flag);
+        }
+        break;
+    case FLAG_USE_THESE:
+        res = change;
+        break;
+    }
+    return res;
+}
+
+/** @short Restore the flags which the listed messages had before this task has changed them */
+void UpdateFlagsTask::rollback(Imap::Uids uids)
+{
+    qSort(uids);
+    TreeItemMailbox *mailbox = mailboxIndex.isValid() ? Model::mailboxForSomeItem(mailboxIndex) : 0;
+    if (!mailbox)
+        return;
+    TreeItemMsgList *list = static_cast<TreeItemMsgList *>(mailbox->m_children[0]);
+    QVector<int> changedRows;
+    Q_FOREACH(const int row, model->findMessageRowsByUids(mailbox, uids)) {
+        auto it = previousFlags.constFind(list->uidAt(row));
+        if (it == previousFlags.constEnd())
+            continue;
+        if (list->flagsAt(row) != *it) {
+            list->setFlagsAt(row, *it);
+            changedRows << row;
+        }
+    }
+    emitDataChanged(list, changedRows);
+    model->emitMessageCountChanged(mailbox);
+}
+
+/** @short Persist the current flags of messages whose update got confirmed by the server */
+void UpdateFlagsTask::saveToCache(const Imap::Uids &uids)
+{
+    TreeItemMailbox *mailbox = mailboxIndex.isValid() ? Model::mailboxForSomeItem(mailboxIndex) : 0;
+    if (!mailbox)
+        return;
+    TreeItemMsgList *list = static_cast<TreeItemMsgList *>(mailbox->m_children[0]);
+    Q_FOREACH(const int row, model->findMessageRowsByUids(mailbox, uids)) {
+        model->cache()->setMsgFlags(mailbox->mailbox(), list->uidAt(row), list->flagsAt(row));
+    }
 }
 
 bool UpdateFlagsTask::handleStateHelper(const Imap::Responses::State *const resp)
@@ -129,18 +221,49 @@ bool UpdateFlagsTask::handleStateHelper(const Imap::Responses::State *const resp
     if (resp->tag.isEmpty())
         return false;
 
-    if (resp->tag == tag) {
+    if (pendingFlagFetches.removeOne(resp->tag)) {
+        // The FETCH responses have already updated the model and the cache
+        if (resp->kind != Responses::OK) {
+            log(QStringLiteral("Failed to refresh flags of messages which were modified on the server"), Common::LOG_MESSAGES);
+        }
+    } else {
+        auto it = pendingStores.find(resp->tag);
+        if (it == pendingStores.end())
+            return false;
+
+        Imap::Uids uids = *it;
+        pendingStores.erase(it);
 
         if (resp->kind == Responses::OK) {
-            // nothing should be needed here
-            _completed();
+            if (resp->respCode == Responses::MODIFIED) {
+                // These messages were changed by someone else in the meantime and the server has therefore left them alone.
+                // The flags which we have remembered for them are stale, so let's ask the server for the real ones.
+                Imap::Uids modified = static_cast<const Responses::RespData<Sequence>&>(*(resp->respCodeData)).data.toVector();
+                qSort(modified);
+                log(QStringLiteral("Not updating flags of %1 messages which were modified on the server").arg(modified.size()),
+                    Common::LOG_MESSAGES);
+                rollback(modified);
+                pendingFlagFetches << parser->uidFetch(Sequence::fromVector(modified), QList<QByteArray>() << "FLAGS");
+                Imap::Uids confirmed;
+                std::set_difference(uids.constBegin(), uids.constEnd(), modified.constBegin(), modified.constEnd(),
+                                    std::back_inserter(confirmed));
+                uids = confirmed;
+            }
+            saveToCache(uids);
         } else {
+            rollback(uids);
+            someStoreFailed = true;
+        }
+    }
+
+    if (pendingStores.isEmpty() && pendingFlagFetches.isEmpty()) {
+        if (someStoreFailed) {
             _failed(tr("Failed to update FLAGS"));
-            // FIXME: error handling
+        } else {
+            _completed();
         }
-        return true;
     }
-    return false;
+    return true;
 }
 
 QVariant UpdateFlagsTask::taskData(const int role) const
@@ -23,6 +23,8 @@
 #ifndef IMAP_UPDATEFLAGS_TASK_H
 #define IMAP_UPDATEFLAGS_TASK_H
 
+#include <QHash>
+#include <QMap>
 #include <QPersistentModelIndex>
 #include "Imap/Model/FlagsOperation.h"
 #include "ImapTask.h"
@@ -33,11 +35,18 @@ namespace Mailbox
 {
 
 class CopyMoveMessagesTask;
+class TreeItemMsgList;
 
 /** @short Update message flags for a particular message set
 
 The purpose of this task is to make sure the IMAP flags for a set of messages from
 a given mailbox are changed.
+
+The messages are identified by their UIDs within a single mailbox, so that huge selections do not
+have to be tracked through persistent indexes. The change is applied to the model right away so that
+the GUI reacts immediately; it is reverted if the server refuses it. The UIDs are compressed into
+ranges and huge message sets are split into several UID STORE commands in order to keep the command
+lines at a reasonable length.
 */
 class UpdateFlagsTask : public ImapTask
 {
@@ -45,14 +54,15 @@ class UpdateFlagsTask : public ImapTask
 public:
     /** @short Change flags for a message set
 
-    IMAP flags for the @arg messages message set are changed -- the @arg flagOperation
+    IMAP flags for messages with the @arg uids UIDs in the @arg mailbox are changed -- the @arg flagOperation
     should be FLAGS, +FLAGS or -FLAGS (all of them optionally with the ".silent" modifier),
     and the desired change (actual flags) is passed in the @arg flags argument.
     */
-    UpdateFlagsTask(Model *model, const QModelIndexList &messages, const FlagsOperation flagOperation, const QString &flags);
+    UpdateFlagsTask(Model *model, const QModelIndex &mailbox, const Imap::Uids &uids, const FlagsOperation flagOperation,
+                    const QString &flags);
 
     /** @short Marking moved messages as deleted */
-    UpdateFlagsTask(Model *model, CopyMoveMessagesTask *copyTask, const QList<QPersistentModelIndex> &messages,
+    UpdateFlagsTask(Model *model, CopyMoveMessagesTask *copyTask, const QModelIndex &mailbox, const Imap::Uids &uids,
                     const FlagsOperation flagOperation, const QString &flags);
     virtual void perform();
 
@@ -60,12 +70,26 @@ public:
     virtual QVariant taskData(const int role) const;
     virtual bool needsMailbox() const {return true;}
 private:
-    CommandHandle tag;
+    void setUids(const Imap::Uids &uids);
+    QStringList updatedFlags(const QStringList &oldFlags, const QStringList &change) const;
+    void emitDataChanged(TreeItemMsgList *list, QVector<int> rows);
+    void rollback(Imap::Uids uids);
+    void saveToCache(const Imap::Uids &uids);
+
+    /** @short UIDs covered by each of the UID STORE commands which are still in flight */
+    QMap<CommandHandle, Imap::Uids> pendingStores;
+    /** @short The UID FETCH (FLAGS) commands for messages which the server refused to update because of a conflict */
+    QList<CommandHandle> pendingFlagFetches;
     ImapTask *conn;
     CopyMoveMessagesTask *copyMove;
-    QList<QPersistentModelIndex> messages;
+    QPersistentModelIndex mailboxIndex;
+    /** @short Sorted UIDs of the affected messages */
+    Imap::Uids uids;
     FlagsOperation flagOperation;
     QString flags;
+    /** @short Message flags as they were before we have changed them, indexed by UID */
+    QHash<uint, QStringList> previousFlags;
+    bool someStoreFailed;
 };
 
 }
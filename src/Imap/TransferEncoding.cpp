@@ -0,0 +1,642 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include "TransferEncoding.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define TROJITA_TRANSFER_ENCODING_SSSE3 1
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#define TROJITA_TARGET_SSSE3 __attribute__((target("ssse3")))
+#else
+#define TROJITA_TRANSFER_ENCODING_SSSE3 0
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__SSE2__)
+#define TROJITA_TRANSFER_ENCODING_SSE2 1
+#else
+#define TROJITA_TRANSFER_ENCODING_SSE2 0
+#endif
+
+namespace {
+
+/** @short Base64 output shall have no more than 76 characters per line, not counting the CRLF pair (RFC 2045) */
+const int base64LineLength = 76;
+/** @short Quoted-printable lines are broken once they get longer than this */
+const int qpLineLength = 76;
+
+const char base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+const char hexDigits[] = "0123456789ABCDEF";
+
+bool simdAllowed = true;
+
+struct DecodingTables {
+    signed char base64[256];
+    signed char hex[256];
+
+    DecodingTables()
+    {
+        memset(base64, -1, sizeof(base64));
+        for (int i = 0; i < 64; ++i) {
+            base64[static_cast<uchar>(base64Alphabet[i])] = i;
+        }
+        memset(hex, -1, sizeof(hex));
+        for (int i = 0; i < 16; ++i) {
+            hex[static_cast<uchar>(hexDigits[i])] = i;
+        }
+        for (int i = 10; i < 16; ++i) {
+            hex['a' + i - 10] = i;
+        }
+    }
+};
+
+const DecodingTables &decodingTables()
+{
+    static const DecodingTables tables;
+    return tables;
+}
+
+bool useSsse3()
+{
+#if TROJITA_TRANSFER_ENCODING_SSSE3
+    static const bool supported = __builtin_cpu_supports("ssse3");
+    return simdAllowed && supported;
+#else
+    return false;
+#endif
+}
+
+bool useSse2()
+{
+    return simdAllowed && TROJITA_TRANSFER_ENCODING_SSE2;
+}
+
+inline char *encodeBase64Triplet(const uchar *src, char *dst)
+{
+    const uint value = (src[0] << 16) | (src[1] << 8) | src[2];
+    *dst++ = base64Alphabet[value >> 18];
+    *dst++ = base64Alphabet[(value >> 12) & 0x3f];
+    *dst++ = base64Alphabet[(value >> 6) & 0x3f];
+    *dst++ = base64Alphabet[value & 0x3f];
+    return dst;
+}
+
+inline bool isQpLiteral(const uchar c)
+{
+    return c >= 33 && c <= 126 && c != '=';
+}
+
+#if TROJITA_TRANSFER_ENCODING_SSSE3
+/** @short Encode twelve bytes into sixteen base64 characters
+
+The input has to have at least sixteen bytes available. The approach is described at http://0x80.pl/notesen/2016-01-12-sse-base64-encoding.html .
+*/
+TROJITA_TARGET_SSSE3
+void encodeBase64BlockSsse3(const uchar *src, char *dst)
+{
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+    // Every 32bit lane gets three input bytes, in an order suitable for extracting the four 6bit indexes
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    const __m128i indexes = _mm_or_si128(t1, t3);
+
+    // Map the indexes to the alphabet by adding an offset which depends on the range the index is in
+    const __m128i offsets = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+    __m128i ranges = _mm_subs_epu8(indexes, _mm_set1_epi8(51));
+    ranges = _mm_sub_epi8(ranges, _mm_cmpgt_epi8(indexes, _mm_set1_epi8(25)));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_add_epi8(indexes, _mm_shuffle_epi8(offsets, ranges)));
+}
+
+/** @short Decode as many blocks of sixteen base64 characters as possible
+
+Decoding stops at the first block which contains anything but the base64 alphabet. Returns the number of consumed
+characters; each block produces twelve bytes of output, but sixteen bytes get written. The approach is described at
+http://0x80.pl/notesen/2016-01-17-sse-base64-decoding.html .
+*/
+TROJITA_TARGET_SSSE3
+int decodeBase64BlocksSsse3(const uchar *src, const int size, uchar *dst)
+{
+    const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                        0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask2F = _mm_set1_epi8(0x2f);
+    const __m128i packing = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    int i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        const __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask2F);
+        const __m128i loNibbles = _mm_and_si128(in, mask2F);
+        const __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+        const __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+        if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128()))) {
+            break;
+        }
+        const __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(_mm_cmpeq_epi8(in, mask2F), hiNibbles));
+        in = _mm_add_epi8(in, roll);
+
+        // Merge the 6bit values into 24bit groups and store them in the big-endian order
+        const __m128i pairs = _mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140));
+        const __m128i groups = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_shuffle_epi8(groups, packing));
+        dst += 12;
+    }
+    return i;
+}
+#endif
+
+/** @short Return the length of the leading run of characters which quoted-printable passes through as-is */
+int qpLiteralRun(const uchar *data, const int maxLength)
+{
+    int n = 0;
+#if TROJITA_TRANSFER_ENCODING_SSE2
+    const __m128i aboveSpace = _mm_set1_epi8(32);
+    const __m128i del = _mm_set1_epi8(127);
+    const __m128i equals = _mm_set1_epi8('=');
+    for (; n + 16 <= maxLength; n += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + n));
+        // The signed comparison takes care of the 8bit characters as well
+        const __m128i literal = _mm_andnot_si128(_mm_cmpeq_epi8(chunk, equals),
+                                                 _mm_and_si128(_mm_cmpgt_epi8(chunk, aboveSpace), _mm_cmplt_epi8(chunk, del)));
+        const int mask = _mm_movemask_epi8(literal);
+        if (mask != 0xffff) {
+            return n + __builtin_ctz(~mask);
+        }
+    }
+#endif
+    while (n < maxLength && isQpLiteral(data[n])) {
+        ++n;
+    }
+    return n;
+}
+
+}
+
+namespace Imap {
+namespace TransferEncoding {
+
+bool simdEnabled()
+{
+    return useSsse3() || useSse2();
+}
+
+void setSimdEnabled(const bool enabled)
+{
+    simdAllowed = enabled;
+}
+
+Base64Encoder::Base64Encoder(): m_pendingSize(0), m_column(0)
+{
+}
+
+void Base64Encoder::encode(const char *data, const int size, QByteArray *out)
+{
+    if (size <= 0) {
+        return;
+    }
+
+    const int start = out->size();
+    const int chars = (m_pendingSize + size) / 3 * 4;
+    // The vectorized code writes a few bytes past its output
+    out->resize(start + chars + (chars / base64LineLength + 1) * 2 + 16);
+    char *dst = out->data() + start;
+    const uchar *src = reinterpret_cast<const uchar *>(data);
+    const uchar *end = src + size;
+
+    if (m_pendingSize) {
+        // Complete the group which got split across the chunk boundary
+        uchar group[3];
+        memcpy(group, m_pending, m_pendingSize);
+        while (m_pendingSize < 3 && src < end) {
+            group[m_pendingSize++] = *src++;
+        }
+        if (m_pendingSize < 3) {
+            memcpy(m_pending, group, m_pendingSize);
+            out->resize(start);
+            return;
+        }
+        dst = encodeBase64Triplet(group, dst);
+        m_pendingSize = 0;
+        m_column += 4;
+        if (m_column == base64LineLength) {
+            *dst++ = '\r';
+            *dst++ = '\n';
+            m_column = 0;
+        }
+    }
+
+#if TROJITA_TRANSFER_ENCODING_SSSE3
+    const bool vectorized = useSsse3();
+#endif
+    while (end - src >= 3) {
+        const int lineBytes = qMin<qint64>((base64LineLength - m_column) / 4 * 3, (end - src) / 3 * 3);
+        const uchar *lineEnd = src + lineBytes;
+#if TROJITA_TRANSFER_ENCODING_SSSE3
+        if (vectorized) {
+            while (lineEnd - src >= 12 && end - src >= 16) {
+                encodeBase64BlockSsse3(src, dst);
+                src += 12;
+                dst += 16;
+            }
+        }
+#endif
+        for (; src < lineEnd; src += 3) {
+            dst = encodeBase64Triplet(src, dst);
+        }
+        m_column += lineBytes / 3 * 4;
+        if (m_column == base64LineLength) {
+            *dst++ = '\r';
+            *dst++ = '\n';
+            m_column = 0;
+        }
+    }
+
+    while (src < end) {
+        m_pending[m_pendingSize++] = *src++;
+    }
+    out->resize(dst - out->constData());
+}
+
+void Base64Encoder::encode(const QByteArray &data, QByteArray *out)
+{
+    encode(data.constData(), data.size(), out);
+}
+
+/** @short Flush the remaining data along with the padding and terminate the last line */
+void Base64Encoder::finish(QByteArray *out)
+{
+    if (m_pendingSize) {
+        uint value = m_pending[0] << 16;
+        if (m_pendingSize == 2) {
+            value |= m_pending[1] << 8;
+        }
+        const char tail[4] = {
+            base64Alphabet[value >> 18],
+            base64Alphabet[(value >> 12) & 0x3f],
+            m_pendingSize == 2 ? base64Alphabet[(value >> 6) & 0x3f] : '=',
+            '=',
+        };
+        out->append(tail, sizeof(tail));
+        m_column += 4;
+    }
+    if (m_column) {
+        out->append("\r\n", 2);
+    }
+    m_pendingSize = 0;
+    m_column = 0;
+}
+
+QByteArray Base64Encoder::encode(const QByteArray &data)
+{
+    Base64Encoder encoder;
+    QByteArray res;
+    encoder.encode(data, &res);
+    encoder.finish(&res);
+    return res;
+}
+
+Base64Decoder::Base64Decoder(): m_bits(0), m_bitCount(0)
+{
+}
+
+void Base64Decoder::decode(const char *data, const int size, QByteArray *out)
+{
+    if (size <= 0) {
+        return;
+    }
+
+    const signed char *table = decodingTables().base64;
+    const int start = out->size();
+    // Four characters make three bytes at most, and the vectorized code writes a few bytes past its output
+    out->resize(start + size / 4 * 3 + 3 + 16);
+    uchar *dst = reinterpret_cast<uchar *>(out->data()) + start;
+    const uchar *src = reinterpret_cast<const uchar *>(data);
+    const uchar *end = src + size;
+    uint bits = m_bits;
+    int bitCount = m_bitCount;
+
+#if TROJITA_TRANSFER_ENCODING_SSSE3
+    const bool vectorized = useSsse3();
+#endif
+    while (src < end) {
+#if TROJITA_TRANSFER_ENCODING_SSSE3
+        // The vectorized decoder can only start at a boundary of a group of four characters
+        if (vectorized && bitCount == 0 && end - src >= 16) {
+            const int consumed = decodeBase64BlocksSsse3(src, end - src, dst);
+            src += consumed;
+            dst += consumed / 16 * 12;
+            if (src == end) {
+                break;
+            }
+        }
+#endif
+        const int value = table[*src++];
+        if (value < 0) {
+            continue;
+        }
+        bits = (bits << 6) | value;
+        bitCount += 6;
+        if (bitCount >= 8) {
+            bitCount -= 8;
+            *dst++ = bits >> bitCount;
+            bits &= (1 << bitCount) - 1;
+        }
+    }
+
+    m_bits = bits;
+    m_bitCount = bitCount;
+    out->resize(reinterpret_cast<char *>(dst) - out->constData());
+}
+
+void Base64Decoder::decode(const QByteArray &data, QByteArray *out)
+{
+    decode(data.constData(), data.size(), out);
+}
+
+QByteArray Base64Decoder::decode(const QByteArray &data)
+{
+    Base64Decoder decoder;
+    QByteArray res;
+    decoder.decode(data, &res);
+    return res;
+}
+
+QuotedPrintableEncoder::QuotedPrintableEncoder(): m_pendingSize(0), m_lineLength(0), m_softBreakPending(false)
+{
+}
+
+/** @short Encode the data up to @arg stopAt, looking up to two bytes ahead
+
+Returns the number of bytes which got consumed. That can be less than @arg stopAt if the lookahead is needed and not
+available yet, unless we are @arg atEnd of the stream, or more when a CRLF starts right at the @arg stopAt boundary.
+*/
+int QuotedPrintableEncoder::encodeRange(const uchar *data, const int size, const int stopAt, const bool atEnd, char *&dst)
+{
+    const bool vectorized = useSse2();
+    int lineLength = m_lineLength;
+    bool softBreakPending = m_softBreakPending;
+    int i = 0;
+    while (i < stopAt) {
+        const uchar c = data[i];
+        // Whitespace at the end of a line has to be encoded, and CR is only let through as a part of a CRLF pair
+        if (!atEnd && ((c == ' ' && (i + 1 >= size || (data[i + 1] == '\r' && i + 2 >= size)))
+                       || (c == '\r' && i + 1 >= size))) {
+            break;
+        }
+
+        // Soft line breaks are only added when there's something to follow them
+        if (softBreakPending) {
+            *dst++ = '=';
+            *dst++ = '\r';
+            *dst++ = '\n';
+            lineLength = 0;
+            softBreakPending = false;
+        }
+
+        if (vectorized && isQpLiteral(c)) {
+            const int run = qpLiteralRun(data + i, qMin(stopAt - i, qpLineLength + 1 - lineLength));
+            memcpy(dst, data + i, run);
+            dst += run;
+            i += run;
+            lineLength += run;
+        } else if (isQpLiteral(c)) {
+            *dst++ = c;
+            ++lineLength;
+            ++i;
+        } else if (c == ' ') {
+            if (i + 2 < size && data[i + 1] == '\r' && data[i + 2] == '\n') {
+                *dst++ = '=';
+                *dst++ = '2';
+                *dst++ = '0';
+                lineLength += 3;
+            } else {
+                *dst++ = ' ';
+                ++lineLength;
+            }
+            ++i;
+        } else if (c == '\r' && i + 1 < size && data[i + 1] == '\n') {
+            *dst++ = '\r';
+            *dst++ = '\n';
+            lineLength = 0;
+            i += 2;
+        } else {
+            *dst++ = '=';
+            *dst++ = hexDigits[c >> 4];
+            *dst++ = hexDigits[c & 0x0f];
+            lineLength += 3;
+            ++i;
+        }
+
+        if (lineLength > qpLineLength) {
+            softBreakPending = true;
+        }
+    }
+    m_lineLength = lineLength;
+    m_softBreakPending = softBreakPending;
+    return i;
+}
+
+void QuotedPrintableEncoder::encode(const char *data, const int size, QByteArray *out)
+{
+    if (size <= 0) {
+        return;
+    }
+
+    const int start = out->size();
+    // Each byte makes three characters at most, and there's a soft line break at least once per 25 bytes
+    out->resize(start + (m_pendingSize + size) * 4 + 16);
+    char *dst = out->data() + start;
+    const uchar *src = reinterpret_cast<const uchar *>(data);
+    int offset = 0;
+
+    if (m_pendingSize) {
+        // Resolve the bytes which were waiting for their lookahead
+        uchar head[sizeof(m_pending)];
+        const int pending = m_pendingSize;
+        const int extra = qMin<int>(size, sizeof(head) - pending);
+        memcpy(head, m_pending, pending);
+        memcpy(head + pending, src, extra);
+        const int consumed = encodeRange(head, pending + extra, pending, false, dst);
+        if (consumed < pending) {
+            m_pendingSize = pending + extra - consumed;
+            memmove(m_pending, head + consumed, m_pendingSize);
+            out->resize(dst - out->constData());
+            return;
+        }
+        offset = consumed - pending;
+        m_pendingSize = 0;
+    }
+
+    const int consumed = offset + encodeRange(src + offset, size - offset, size - offset, false, dst);
+    m_pendingSize = size - consumed;
+    Q_ASSERT(m_pendingSize <= 2);
+    memcpy(m_pending, src + consumed, m_pendingSize);
+    out->resize(dst - out->constData());
+}
+
+void QuotedPrintableEncoder::encode(const QByteArray &data, QByteArray *out)
+{
+    encode(data.constData(), data.size(), out);
+}
+
+void QuotedPrintableEncoder::finish(QByteArray *out)
+{
+    if (m_pendingSize) {
+        const int start = out->size();
+        out->resize(start + m_pendingSize * 3 + 3);
+        char *dst = out->data() + start;
+        encodeRange(m_pending, m_pendingSize, m_pendingSize, true, dst);
+        out->resize(dst - out->constData());
+    }
+    m_pendingSize = 0;
+    m_lineLength = 0;
+    m_softBreakPending = false;
+}
+
+QByteArray QuotedPrintableEncoder::encode(const QByteArray &data)
+{
+    QuotedPrintableEncoder encoder;
+    QByteArray res;
+    encoder.encode(data, &res);
+    encoder.finish(&res);
+    return res;
+}
+
+QuotedPrintableDecoder::QuotedPrintableDecoder(): m_pendingSize(0)
+{
+}
+
+/** @short Decode the data up to @arg stopAt, looking up to two bytes ahead
+
+The semantics of the return value and of the arguments match QuotedPrintableEncoder::encodeRange.
+*/
+int QuotedPrintableDecoder::decodeRange(const uchar *data, const int size, const int stopAt, const bool atEnd, char *&dst)
+{
+    const signed char *hex = decodingTables().hex;
+    int i = 0;
+    while (i < stopAt) {
+        // The C library is very good at finding a character, so there's no need for custom SIMD code here
+        const uchar *escape = static_cast<const uchar *>(memchr(data + i, '=', stopAt - i));
+        const int run = escape ? escape - (data + i) : stopAt - i;
+        memcpy(dst, data + i, run);
+        dst += run;
+        i += run;
+        if (i == stopAt) {
+            break;
+        }
+
+        if (i + 2 >= size) {
+            if (!atEnd) {
+                break;
+            }
+            // A truncated escape sequence is ignored
+            ++i;
+            continue;
+        }
+
+        const uchar c1 = data[i + 1];
+        const uchar c2 = data[i + 2];
+        if (c1 == '\n') {
+            i += 2;
+        } else if (c1 == '\r' && c2 == '\n') {
+            i += 3;
+        } else if (hex[c1] >= 0 && hex[c2] >= 0) {
+            *dst++ = static_cast<char>((hex[c1] << 4) | hex[c2]);
+            i += 3;
+        } else {
+            ++i;
+        }
+    }
+    return i;
+}
+
+void QuotedPrintableDecoder::decode(const char *data, const int size, QByteArray *out)
+{
+    if (size <= 0) {
+        return;
+    }
+
+    const int start = out->size();
+    out->resize(start + m_pendingSize + size);
+    char *dst = out->data() + start;
+    const uchar *src = reinterpret_cast<const uchar *>(data);
+    int offset = 0;
+
+    if (m_pendingSize) {
+        // Finish the escape sequence which got split across the chunk boundary
+        uchar head[sizeof(m_pending)];
+        const int pending = m_pendingSize;
+        const int extra = qMin<int>(size, sizeof(head) - pending);
+        memcpy(head, m_pending, pending);
+        memcpy(head + pending, src, extra);
+        const int consumed = decodeRange(head, pending + extra, pending, false, dst);
+        if (consumed < pending) {
+            m_pendingSize = pending + extra - consumed;
+            memmove(m_pending, head + consumed, m_pendingSize);
+            out->resize(dst - out->constData());
+            return;
+        }
+        offset = consumed - pending;
+        m_pendingSize = 0;
+    }
+
+    const int consumed = offset + decodeRange(src + offset, size - offset, size - offset, false, dst);
+    m_pendingSize = size - consumed;
+    Q_ASSERT(m_pendingSize <= 2);
+    memcpy(m_pending, src + consumed, m_pendingSize);
+    out->resize(dst - out->constData());
+}
+
+void QuotedPrintableDecoder::decode(const QByteArray &data, QByteArray *out)
+{
+    decode(data.constData(), data.size(), out);
+}
+
+void QuotedPrintableDecoder::finish(QByteArray *out)
+{
+    if (m_pendingSize) {
+        const int start = out->size();
+        out->resize(start + m_pendingSize);
+        char *dst = out->data() + start;
+        decodeRange(m_pending, m_pendingSize, m_pendingSize, true, dst);
+        out->resize(dst - out->constData());
+    }
+    m_pendingSize = 0;
+}
+
+QByteArray QuotedPrintableDecoder::decode(const QByteArray &data)
+{
+    QuotedPrintableDecoder decoder;
+    QByteArray res;
+    decoder.decode(data, &res);
+    decoder.finish(&res);
+    return res;
+}
+
+}
+}
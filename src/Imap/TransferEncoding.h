@@ -0,0 +1,128 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef IMAP_TRANSFER_ENCODING_H
+#define IMAP_TRANSFER_ENCODING_H
+
+#include <QByteArray>
+
+namespace Imap {
+
+/** @short Incremental codecs for the MIME Content-Transfer-Encoding
+
+All of these work on arbitrary chunks of data and append their output to a caller-provided buffer, so that large
+message parts can be processed without materializing the whole encoded form and without allocating per line.
+On x86, the base64 codec uses SSSE3 when the CPU supports it and the quoted-printable one skips over runs of
+literal characters with SSE2. The portable code is used everywhere else.
+*/
+namespace TransferEncoding {
+
+/** @short Is the vectorized code path available and enabled? */
+bool simdEnabled();
+/** @short Disable or re-enable the vectorized code path; this is meant for unit tests and benchmarking */
+void setSimdEnabled(const bool enabled);
+
+/** @short Encode data as base64, in CRLF-terminated lines of 76 characters */
+class Base64Encoder
+{
+public:
+    Base64Encoder();
+    void encode(const char *data, const int size, QByteArray *out);
+    void encode(const QByteArray &data, QByteArray *out);
+    void finish(QByteArray *out);
+
+    static QByteArray encode(const QByteArray &data);
+
+private:
+    uchar m_pending[2];
+    int m_pendingSize;
+    int m_column;
+};
+
+/** @short Decode base64 data
+
+Just like QByteArray::fromBase64, anything which is not a part of the base64 alphabet (including line breaks and
+padding) is silently skipped.
+*/
+class Base64Decoder
+{
+public:
+    Base64Decoder();
+    void decode(const char *data, const int size, QByteArray *out);
+    void decode(const QByteArray &data, QByteArray *out);
+
+    static QByteArray decode(const QByteArray &data);
+
+private:
+    uint m_bits;
+    int m_bitCount;
+};
+
+/** @short Encode data as quoted-printable with CRLF line endings
+
+The output is identical to what KCodecs::quotedPrintableEncode produces when given the same data in one piece.
+*/
+class QuotedPrintableEncoder
+{
+public:
+    QuotedPrintableEncoder();
+    void encode(const char *data, const int size, QByteArray *out);
+    void encode(const QByteArray &data, QByteArray *out);
+    void finish(QByteArray *out);
+
+    static QByteArray encode(const QByteArray &data);
+
+private:
+    int encodeRange(const uchar *data, const int size, const int stopAt, const bool atEnd, char *&dst);
+
+    uchar m_pending[4];
+    int m_pendingSize;
+    int m_lineLength;
+    bool m_softBreakPending;
+};
+
+/** @short Decode quoted-printable data
+
+Soft line breaks are removed, escape sequences are accepted in both upper and lower case, and an equal sign which
+does not start a valid escape sequence is dropped.
+*/
+class QuotedPrintableDecoder
+{
+public:
+    QuotedPrintableDecoder();
+    void decode(const char *data, const int size, QByteArray *out);
+    void decode(const QByteArray &data, QByteArray *out);
+    void finish(QByteArray *out);
+
+    static QByteArray decode(const QByteArray &data);
+
+private:
+    int decodeRange(const uchar *data, const int size, const int stopAt, const bool atEnd, char *&dst);
+
+    uchar m_pending[4];
+    int m_pendingSize;
+};
+
+}
+
+}
+
+#endif // IMAP_TRANSFER_ENCODING_H
@@ -0,0 +1,113 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QTextStream>
+#include <QThread>
+
+#include "Common/BinaryLog.h"
+#include "Common/FileLogger.h"
+
+/** @short Render one binary log file into the text format which is used by the FileLogger
+
+In the replay mode, the records are printed with the same delays as they were originally logged, optionally sped up
+by the @arg speed factor.
+*/
+static bool dumpLog(const QString &fileName, QTextStream &out, const bool replay, const double speed)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning("%s: %s", qPrintable(fileName), qPrintable(file.errorString()));
+        return false;
+    }
+
+    Common::BinaryLogReader reader(&file);
+    if (!reader.isValid()) {
+        qWarning("%s: not a binary protocol log", qPrintable(fileName));
+        return false;
+    }
+
+    uint connectionId;
+    Common::LogMessage message;
+    qint64 lastTimestamp = -1;
+    while (reader.readNext(connectionId, message)) {
+        const qint64 timestamp = message.timestamp.toMSecsSinceEpoch();
+        if (replay && lastTimestamp != -1 && timestamp > lastTimestamp) {
+            out.flush();
+            QThread::msleep(static_cast<unsigned long>((timestamp - lastTimestamp) / speed));
+        }
+        lastTimestamp = timestamp;
+
+        QString formatted = Common::FileLogger::formatMessage(connectionId, message);
+        Common::FileLogger::escapeCrLf(formatted);
+        out << formatted << "\n";
+    }
+
+    if (reader.isDamaged()) {
+        qWarning("%s: the log ends with an incomplete or damaged record", qPrintable(fileName));
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("trojita-log-viewer"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Convert Trojita's binary protocol logs to text"));
+    parser.addHelpOption();
+    QCommandLineOption replayOption(QStringLiteral("replay"),
+                                    QStringLiteral("Print the records with the same timing as they were logged"));
+    parser.addOption(replayOption);
+    QCommandLineOption speedOption(QStringLiteral("speed"),
+                                   QStringLiteral("Speed up the replay by the given <factor>"),
+                                   QStringLiteral("factor"), QStringLiteral("1"));
+    parser.addOption(speedOption);
+    parser.addPositionalArgument(QStringLiteral("files"), QStringLiteral("Log files to show, oldest first"),
+                                 QStringLiteral("files..."));
+    parser.process(app);
+
+    const QStringList files = parser.positionalArguments();
+    if (files.isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    bool ok;
+    double speed = parser.value(speedOption).toDouble(&ok);
+    if (!ok || speed <= 0) {
+        qWarning("invalid replay speed: %s", qPrintable(parser.value(speedOption)));
+        return 1;
+    }
+
+    QTextStream out(stdout);
+    out.setCodec("UTF-8");
+    int res = 0;
+    for (const QString &fileName : files) {
+        if (!dumpLog(fileName, out, parser.isSet(replayOption), speed))
+            res = 2;
+    }
+    return res;
+}
@@ -28,13 +28,15 @@
 
 #include <QDir>
 #include <QFileSystemWatcher>
-#include <QRegularExpression>
 #include <QSettings>
 #include <QStandardItemModel>
 #include <QStringBuilder>
 #include <QTimer>
 #include "Common/SettingsCategoryGuard.h"
 
+/** @short Key under which the usage counters of the recipients' addresses are stored */
+static const QString usageKey = QStringLiteral("addressbook.abook.usage");
+
 class AbookAddressbookCompletionJob : public AddressbookCompletionJob
 {
 public:
@@ -89,7 +91,8 @@ private:
 
 };
 
-AbookAddressbook::AbookAddressbook(QObject *parent): AddressbookPlugin(parent), m_updateTimer(0)
+AbookAddressbook::AbookAddressbook(QObject *parent, QSettings *settings): AddressbookPlugin(parent), m_updateTimer(0),
+    m_settings(settings), m_readingAbook(false)
 {
 #define ADD(TYPE, KEY) \
     m_fields << qMakePair<Type,QString>(TYPE, QLatin1String(KEY))
@@ -112,6 +115,18 @@ AbookAddressbook::AbookAddressbook(QObject *parent): AddressbookPlugin(parent),
 #undef ADD
 
     m_contacts = new QStandardItemModel(this);
+    connect(m_contacts, &QStandardItemModel::itemChanged, this, &AbookAddressbook::slotContactChanged);
+    connect(m_contacts, &QAbstractItemModel::rowsInserted, this, &AbookAddressbook::slotContactsInserted);
+    connect(m_contacts, &QAbstractItemModel::rowsAboutToBeRemoved, this, &AbookAddressbook::slotContactsAboutToBeRemoved);
+
+    if (m_settings) {
+        QHash<QString, int> usage;
+        const QVariantMap stored = m_settings->value(usageKey).toMap();
+        for (auto it = stored.constBegin(); it != stored.constEnd(); ++it) {
+            usage[it.key()] = it.value().toInt();
+        }
+        m_index.setUsageCounts(usage);
+    }
 
     ensureAbookPath();
 
@@ -160,11 +175,60 @@ void AbookAddressbook::openContactWindow(const QString &email, const QString &di
     window->show();
 }
 
+void AbookAddressbook::recordSentMail(const QStringList &emails)
+{
+    Q_FOREACH (const QString &email, emails) {
+        m_index.recordUsage(email);
+    }
+    if (m_settings) {
+        QVariantMap stored;
+        const QHash<QString, int> usage = m_index.usageCounts();
+        for (auto it = usage.constBegin(); it != usage.constEnd(); ++it) {
+            stored[it.key()] = it.value();
+        }
+        m_settings->setValue(usageKey, stored);
+    }
+}
+
 QStandardItemModel *AbookAddressbook::model() const
 {
     return m_contacts;
 }
 
+/** @short Update the completion index with the current name and addresses of the contact */
+void AbookAddressbook::indexContact(QStandardItem *item)
+{
+    // several mail addresses per contact are stored newline delimited
+    m_index.setContact(reinterpret_cast<quintptr>(item), item->data(Name).toString(),
+                       item->data(Mail).toString().split(QLatin1Char('\n'), QString::SkipEmptyParts));
+}
+
+void AbookAddressbook::slotContactChanged(QStandardItem *item)
+{
+    // readAbook() sets the fields one by one and indexes each contact once it's done with it
+    if (m_readingAbook)
+        return;
+    indexContact(item);
+}
+
+void AbookAddressbook::slotContactsInserted(const QModelIndex &parent, int first, int last)
+{
+    if (parent.isValid() || m_readingAbook)
+        return;
+    for (int i = first; i <= last; ++i) {
+        indexContact(m_contacts->item(i));
+    }
+}
+
+void AbookAddressbook::slotContactsAboutToBeRemoved(const QModelIndex &parent, int first, int last)
+{
+    if (parent.isValid())
+        return;
+    for (int i = first; i <= last; ++i) {
+        m_index.removeContact(reinterpret_cast<quintptr>(m_contacts->item(i)));
+    }
+}
+
 void AbookAddressbook::remonitorAdressbook()
 {
     m_filesystemWatcher->addPath(QDir::homePath() + QLatin1String("/.abook/addressbook"));
@@ -231,6 +295,7 @@ void AbookAddressbook::readAbook(bool update)
     QSettings abook(QDir::homePath() + QLatin1String("/.abook/addressbook"), QSettings::IniFormat);
     abook.setIniCodec("UTF-8");
     QStringList contacts = abook.childGroups();
+    m_readingAbook = true;
     foreach (const QString &contact, contacts) {
         Common::SettingsCategoryGuard guard(&abook, contact);
         QStandardItem *item = 0;
@@ -291,7 +356,9 @@ void AbookAddressbook::readAbook(bool update)
 
         if (add)
             m_contacts->appendRow( item );
+        indexContact(item);
     }
+    m_readingAbook = false;
 
     m_contacts->sort(0);
 //     const qint64 elapsed = profile.elapsed();
@@ -327,66 +394,14 @@ void AbookAddressbook::saveContacts()
     m_filesystemWatcher->blockSignals(false);
 }
 
-static inline bool ignore(const QString &string, const QStringList &ignores)
-{
-    Q_FOREACH (const QString &ignore, ignores) {
-        if (ignore.contains(string, Qt::CaseInsensitive))
-            return true;
-    }
-    return false;
-}
-
 NameEmailList AbookAddressbook::complete(const QString &string, const QStringList &ignores, int max) const
 {
-    NameEmailList list;
-    if (string.isEmpty())
-        return list;
-    // In e-mail addresses, dot, dash, _ and @ shall be treated as delimiters
-    QRegularExpression mailMatch(QStringLiteral("[\\.\\-_@]%1").arg(QRegularExpression::escape(string)),
-                                 QRegularExpression::CaseInsensitiveOption);
-    // In human readable names, match on word boundaries
-    QRegularExpression nameMatch(QStringLiteral("\\b%1").arg(QRegularExpression::escape(string)),
-                                 QRegularExpression::CaseInsensitiveOption);
-    // These REs are still not perfect, they won't match on e.g. ".net" or "-project", but screw these I say
-    for (int i = 0; i < m_contacts->rowCount(); ++i) {
-        QStandardItem *item = m_contacts->item(i);
-        QString contactName = item->data(Name).toString();
-        // several mail addresses per contact are stored newline delimited
-        QStringList contactMails(item->data(Mail).toString().split(QLatin1Char('\n'), QString::SkipEmptyParts));
-        if (contactName.contains(nameMatch)) {
-            Q_FOREACH (const QString &mail, contactMails) {
-                if (ignore(mail, ignores))
-                    continue;
-                list << NameEmail(contactName, mail);
-                if (list.count() == max)
-                    return list;
-            }
-            continue;
-        }
-        Q_FOREACH (const QString &mail, contactMails) {
-            if (mail.startsWith(string, Qt::CaseInsensitive) ||
-                    // don't match on the TLD
-                    mail.section(QLatin1Char('.'), 0, -2).contains(mailMatch)) {
-                if (ignore(mail, ignores))
-                    continue;
-                list << NameEmail(contactName, mail);
-                if (list.count() == max)
-                    return list;
-            }
-        }
-    }
-    return list;
+    return m_index.complete(string, ignores, max);
 }
 
 QStringList AbookAddressbook::prettyNamesForAddress(const QString &mail) const
 {
-    QStringList res;
-    for (int i = 0; i < m_contacts->rowCount(); ++i) {
-        QStandardItem *item = m_contacts->item(i);
-        if (QString::compare(item->data(Mail).toString(), mail, Qt::CaseInsensitive) == 0)
-            res << item->data(Name).toString();
-    }
-    return res;
+    return m_index.namesForAddress(mail);
 }
 
 
@@ -400,7 +415,7 @@ QString trojita_plugin_AbookAddressbookPlugin::description() const
     return tr("Addressbook in ~/.abook/");
 }
 
-AddressbookPlugin *trojita_plugin_AbookAddressbookPlugin::create(QObject *parent, QSettings *)
+AddressbookPlugin *trojita_plugin_AbookAddressbookPlugin::create(QObject *parent, QSettings *settings)
 {
-    return new AbookAddressbook(parent);
+    return new AbookAddressbook(parent, settings);
 }
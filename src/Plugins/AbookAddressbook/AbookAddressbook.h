@@ -30,9 +30,13 @@
 #include <QPair>
 
 #include "Plugins/AddressbookPlugin.h"
+#include "Plugins/CompletionIndex.h"
 #include "Plugins/PluginInterface.h"
 
 class QFileSystemWatcher;
+class QModelIndex;
+class QSettings;
+class QStandardItem;
 class QStandardItemModel;
 class QTimer;
 
@@ -42,7 +46,7 @@ using namespace Plugins;
 class AbookAddressbook : public AddressbookPlugin {
     Q_OBJECT
 public:
-    AbookAddressbook(QObject *parent);
+    AbookAddressbook(QObject *parent, QSettings *settings = 0);
     virtual ~AbookAddressbook();
 
     virtual AddressbookPlugin::Features features() const;
@@ -63,6 +67,7 @@ public slots:
     virtual AddressbookNamesJob *requestPrettyNamesForAddress(const QString &email);
     virtual void openAddressbookWindow();
     virtual void openContactWindow(const QString &email, const QString &displayName);
+    virtual void recordSentMail(const QStringList &emails);
 
     void saveContacts();
     void readAbook(bool update = false);
@@ -70,14 +75,21 @@ public slots:
 
 private slots:
     void scheduleAbookUpdate();
+    void slotContactChanged(QStandardItem *item);
+    void slotContactsInserted(const QModelIndex &parent, int first, int last);
+    void slotContactsAboutToBeRemoved(const QModelIndex &parent, int first, int last);
 
 private:
     void ensureAbookPath();
     void remonitorAdressbook();
+    void indexContact(QStandardItem *item);
 
     QFileSystemWatcher *m_filesystemWatcher;
     QTimer *m_updateTimer;
     QStandardItemModel *m_contacts;
+    QSettings *m_settings;
+    Plugins::CompletionIndex m_index;
+    bool m_readingAbook;
 
     QList<QPair<Type,QString> > m_fields;
 };
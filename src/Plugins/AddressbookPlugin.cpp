@@ -43,6 +43,11 @@ AddressbookPlugin::AddressbookPlugin(QObject *parent) : QObject(parent)
 {
 }
 
+void AddressbookPlugin::recordSentMail(const QStringList &emails)
+{
+    Q_UNUSED(emails);
+}
+
 }
 
 // vim: set et ts=4 sts=4 sw=4
@@ -128,6 +128,12 @@ public slots:
      */
     virtual void openContactWindow(const QString &email, const QString &displayName) = 0;
 
+    /** @short Notify the addressbook that a message was sent to the given addresses
+     *  Implementations can use this for ranking the completion results. The default implementation does nothing.
+     *  @p emails is list of e-mail addresses of all recipients
+     */
+    virtual void recordSentMail(const QStringList &emails);
+
 protected:
     AddressbookPlugin(QObject *parent);
 };
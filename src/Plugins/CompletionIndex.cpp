@@ -0,0 +1,248 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include "CompletionIndex.h"
+
+namespace {
+
+/** @short In e-mail addresses, dot, dash, underscore and @ are treated as delimiters */
+bool isMailDelimiter(const QChar c)
+{
+    return c == QLatin1Char('.') || c == QLatin1Char('-') || c == QLatin1Char('_') || c == QLatin1Char('@');
+}
+
+bool isIgnored(const QString &string, const QStringList &ignores)
+{
+    Q_FOREACH (const QString &ignore, ignores) {
+        if (ignore.contains(string, Qt::CaseInsensitive))
+            return true;
+    }
+    return false;
+}
+
+}
+
+namespace Plugins
+{
+
+/** @short Once the sum of all usage counters reaches this value, they get halved */
+const int usageAgingThreshold = 10000;
+
+CompletionIndex::CompletionIndex(): m_deadEntries(0), m_sorted(true), m_usageTotal(0)
+{
+}
+
+void CompletionIndex::clear()
+{
+    m_entries.clear();
+    m_entriesByKey.clear();
+    m_entriesByEmail.clear();
+    m_tokens.clear();
+    m_deadEntries = 0;
+    m_sorted = true;
+}
+
+void CompletionIndex::setContact(const quintptr key, const QString &name, const QStringList &emails)
+{
+    removeContact(key);
+
+    QVector<int> &ids = m_entriesByKey[key];
+    Q_FOREACH (const QString &email, emails) {
+        if (email.isEmpty())
+            continue;
+        const int id = m_entries.size();
+        m_entries.append(Entry{key, name, email, true});
+        ids.append(id);
+        m_entriesByEmail[email.toCaseFolded()].append(id);
+        addTokens(id);
+    }
+    if (ids.isEmpty())
+        m_entriesByKey.remove(key);
+}
+
+void CompletionIndex::removeContact(const quintptr key)
+{
+    auto it = m_entriesByKey.find(key);
+    if (it == m_entriesByKey.end())
+        return;
+
+    Q_FOREACH (const int id, *it) {
+        Entry &entry = m_entries[id];
+        entry.alive = false;
+        auto byEmail = m_entriesByEmail.find(entry.email.toCaseFolded());
+        if (byEmail != m_entriesByEmail.end()) {
+            byEmail->removeOne(id);
+            if (byEmail->isEmpty())
+                m_entriesByEmail.erase(byEmail);
+        }
+        ++m_deadEntries;
+    }
+    m_entriesByKey.erase(it);
+    // The tokens of the removed entries are dropped during the next sort, but the entries themselves have to be
+    // purged once in a while, otherwise editing a contact over and over would make the index grow without bounds
+    m_sorted = false;
+    if (m_deadEntries > 64 && m_deadEntries > m_entries.size() / 2)
+        compact();
+}
+
+void CompletionIndex::addTokens(const int entryId)
+{
+    const Entry &entry = m_entries[entryId];
+
+    // Human-readable names are matched at the beginning of each word. Using the whole rest of the name as a token means
+    // that even an input like "john sm" matches
+    const QString name = entry.name.toCaseFolded();
+    for (int i = 0; i < name.size(); ++i) {
+        if (name[i].isLetterOrNumber() && (i == 0 || !name[i - 1].isLetterOrNumber()))
+            m_tokens.append(Token{name.mid(i), entryId});
+    }
+
+    const QString email = entry.email.toCaseFolded();
+    m_tokens.append(Token{email, entryId});
+    // don't match on the TLD
+    const int tldDot = email.lastIndexOf(QLatin1Char('.'));
+    for (int i = 0; i < tldDot; ++i) {
+        if (isMailDelimiter(email[i]) && i + 1 < email.size())
+            m_tokens.append(Token{email.mid(i + 1), entryId});
+    }
+    m_sorted = false;
+}
+
+void CompletionIndex::ensureSorted() const
+{
+    if (m_sorted)
+        return;
+
+    if (m_deadEntries) {
+        m_tokens.erase(std::remove_if(m_tokens.begin(), m_tokens.end(), [this](const Token &token) {
+            return !m_entries[token.entry].alive;
+        }), m_tokens.end());
+    }
+    std::sort(m_tokens.begin(), m_tokens.end());
+    m_sorted = true;
+}
+
+void CompletionIndex::compact()
+{
+    QVector<Entry> entries;
+    entries.swap(m_entries);
+    clear();
+    Q_FOREACH (const Entry &entry, entries) {
+        if (!entry.alive)
+            continue;
+        const int id = m_entries.size();
+        m_entries.append(entry);
+        m_entriesByKey[entry.key].append(id);
+        m_entriesByEmail[entry.email.toCaseFolded()].append(id);
+        addTokens(id);
+    }
+}
+
+void CompletionIndex::recordUsage(const QString &email, const int count)
+{
+    m_usage[email.toCaseFolded()] += count;
+    m_usageTotal += count;
+    if (m_usageTotal < usageAgingThreshold)
+        return;
+
+    m_usageTotal = 0;
+    for (auto it = m_usage.begin(); it != m_usage.end();) {
+        *it /= 2;
+        if (*it == 0) {
+            it = m_usage.erase(it);
+        } else {
+            m_usageTotal += *it;
+            ++it;
+        }
+    }
+}
+
+QHash<QString, int> CompletionIndex::usageCounts() const
+{
+    return m_usage;
+}
+
+void CompletionIndex::setUsageCounts(const QHash<QString, int> &usage)
+{
+    m_usage = usage;
+    m_usageTotal = 0;
+    Q_FOREACH (const int count, m_usage) {
+        m_usageTotal += count;
+    }
+}
+
+NameEmailList CompletionIndex::complete(const QString &input, const QStringList &ignores, int max) const
+{
+    NameEmailList list;
+    const QString prefix = input.toCaseFolded();
+    if (prefix.isEmpty())
+        return list;
+
+    ensureSorted();
+
+    QVector<int> matches;
+    for (auto it = std::lower_bound(m_tokens.constBegin(), m_tokens.constEnd(), Token{prefix, -1});
+         it != m_tokens.constEnd() && it->text.startsWith(prefix); ++it) {
+        matches.append(it->entry);
+    }
+    std::sort(matches.begin(), matches.end());
+    matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+
+    // Addresses which are used often go first, the rest is sorted by name
+    QVector<QPair<int, int> > ranked;
+    ranked.reserve(matches.size());
+    Q_FOREACH (const int id, matches) {
+        ranked.append(qMakePair(m_usage.value(m_entries[id].email.toCaseFolded()), id));
+    }
+    std::sort(ranked.begin(), ranked.end(), [this](const QPair<int, int> &a, const QPair<int, int> &b) {
+        if (a.first != b.first)
+            return a.first > b.first;
+        const Entry &ea = m_entries[a.second];
+        const Entry &eb = m_entries[b.second];
+        int res = QString::compare(ea.name, eb.name, Qt::CaseInsensitive);
+        if (res != 0)
+            return res < 0;
+        return a.second < b.second;
+    });
+
+    for (auto it = ranked.constBegin(); it != ranked.constEnd(); ++it) {
+        const Entry &entry = m_entries[it->second];
+        if (isIgnored(entry.email, ignores))
+            continue;
+        list << NameEmail(entry.name, entry.email);
+        if (list.count() == max)
+            break;
+    }
+    return list;
+}
+
+QStringList CompletionIndex::namesForAddress(const QString &email) const
+{
+    QStringList res;
+    Q_FOREACH (const int id, m_entriesByEmail.value(email.toCaseFolded())) {
+        res << m_entries[id].name;
+    }
+    return res;
+}
+
+}
@@ -0,0 +1,100 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TROJITA_PLUGINS_COMPLETIONINDEX_H
+#define TROJITA_PLUGINS_COMPLETIONINDEX_H
+
+#include <QHash>
+#include <QVector>
+
+#include "AddressbookPlugin.h"
+
+namespace Plugins
+{
+
+/** @short Prefix index for completing the e-mail addresses of contacts
+
+The index contains a sorted list of tokens; a query is answered through a binary search for its prefix, so the cost
+does not depend on the size of the address book. The tokens are the suffixes of contact names starting at a word
+boundary, the full e-mail addresses, and the parts of the addresses which follow a dot, dash, underscore or the "@"
+sign, with the exception of the TLD.
+
+Contacts are identified by an opaque key chosen by the plugin, which makes it possible to update the index
+incrementally. Changes are batched and the token list is only re-sorted when the next query arrives.
+
+Results are ranked by the number of times each address was used, as reported through recordUsage(). Once the counters
+grow too large, all of them are halved, so that the recently used addresses eventually overtake the ones which were
+popular a long time ago.
+*/
+class PLUGINMANAGER_EXPORT CompletionIndex
+{
+public:
+    CompletionIndex();
+
+    /** @short Add a contact or replace all addresses of an existing one */
+    void setContact(const quintptr key, const QString &name, const QStringList &emails);
+    void removeContact(const quintptr key);
+    void clear();
+
+    /** @short Remember that a message was sent to this address */
+    void recordUsage(const QString &email, const int count = 1);
+    QHash<QString, int> usageCounts() const;
+    void setUsageCounts(const QHash<QString, int> &usage);
+
+    NameEmailList complete(const QString &input, const QStringList &ignores, int max = -1) const;
+    QStringList namesForAddress(const QString &email) const;
+
+private:
+    struct Entry {
+        quintptr key;
+        QString name;
+        QString email;
+        bool alive;
+    };
+
+    struct Token {
+        QString text;
+        int entry;
+
+        bool operator<(const Token &other) const
+        {
+            return text < other.text;
+        }
+    };
+
+    void addTokens(const int entryId);
+    void ensureSorted() const;
+    void compact();
+
+    QVector<Entry> m_entries;
+    QHash<quintptr, QVector<int> > m_entriesByKey;
+    QHash<QString, QVector<int> > m_entriesByEmail;
+    int m_deadEntries;
+    mutable QVector<Token> m_tokens;
+    mutable bool m_sorted;
+    QHash<QString, int> m_usage;
+    int m_usageTotal;
+};
+
+}
+
+#endif // TROJITA_PLUGINS_COMPLETIONINDEX_H
@@ -95,6 +95,10 @@ bool Rfc1951Compressor::write(QIODevice *out, QByteArray *in)
 Rfc1951Decompressor::Rfc1951Decompressor(int chunkSize)
 {
     _chunkSize = chunkSize;
+    _outputOffset = 0;
+    _outputSize = 0;
+    _eolPos = -1;
+    _eolScanned = 0;
     _stagingBuffer = new char[_chunkSize];
 
     /* allocate inflate state */
@@ -128,7 +132,11 @@ bool Rfc1951Decompressor::consume(QIODevice *in)
                 result != Z_BUF_ERROR) {
                 return false;
             }
-            _output.append(_stagingBuffer, _chunkSize - _zStream.avail_out);
+            int inflated = _chunkSize - _zStream.avail_out;
+            if (inflated > 0) {
+                _output.append(QByteArray(_stagingBuffer, inflated));
+                _outputSize += inflated;
+            }
         } while (_zStream.avail_out == 0);
     }
     return true;
@@ -136,25 +144,80 @@ bool Rfc1951Decompressor::consume(QIODevice *in)
 
 bool Rfc1951Decompressor::canReadLine() const
 {
-    return _output.contains('\n');
+    return findEndOfLine() != -1;
 }
 
 QByteArray Rfc1951Decompressor::readLine()
 {
-    int eolPos = _output.indexOf('\n');
+    qint64 eolPos = findEndOfLine();
     if (eolPos == -1) {
         return QByteArray();
     }
-    
-    QByteArray result = _output.left(eolPos + 1);
-    _output = _output.mid(eolPos + 1);
-    return result;
+
+    return take(eolPos + 1);
 }
 
 QByteArray Rfc1951Decompressor::read(qint64 maxSize)
 {
-    QByteArray res = _output.left(maxSize);
-    _output = _output.mid(maxSize);
+    return take(qMin(maxSize, _outputSize));
+}
+
+qint64 Rfc1951Decompressor::findEndOfLine() const
+{
+    if (_eolPos != -1) {
+        return _eolPos;
+    }
+
+    // Only look at the data which have arrived since the last unsuccessful scan
+    qint64 chunkStart = -_outputOffset;
+    for (const QByteArray &chunk : _output) {
+        qint64 chunkEnd = chunkStart + chunk.size();
+        if (chunkEnd > _eolScanned) {
+            int pos = chunk.indexOf('\n', qMax<qint64>(_eolScanned - chunkStart, 0));
+            if (pos != -1) {
+                _eolPos = chunkStart + pos;
+                _eolScanned = _eolPos;
+                return _eolPos;
+            }
+        }
+        chunkStart = chunkEnd;
+    }
+    _eolScanned = _outputSize;
+    return -1;
+}
+
+QByteArray Rfc1951Decompressor::take(qint64 size)
+{
+    QByteArray res;
+    if (size <= 0) {
+        return res;
+    }
+
+    if (_outputOffset == 0 && _output.first().size() == size) {
+        // The common case of a whole chunk being consumed at once does not need any copying
+        res = _output.takeFirst();
+    } else {
+        res.reserve(size);
+        qint64 missing = size;
+        while (missing) {
+            const QByteArray &chunk = _output.first();
+            int chunkSize = chunk.size();
+            int n = qMin<qint64>(chunkSize - _outputOffset, missing);
+            res.append(chunk.constData() + _outputOffset, n);
+            missing -= n;
+            _outputOffset += n;
+            if (_outputOffset == chunkSize) {
+                _output.removeFirst();
+                _outputOffset = 0;
+            }
+        }
+    }
+
+    _outputSize -= size;
+    if (_eolPos != -1) {
+        _eolPos = _eolPos >= size ? _eolPos - size : -1;
+    }
+    _eolScanned = qMax<qint64>(_eolScanned - size, 0);
     return res;
 }
 
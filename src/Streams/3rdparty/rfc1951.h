@@ -43,6 +43,7 @@
 #define STREAMS_RFC1951_H
 
 #include <QIODevice>
+#include <QList>
 
 #include <zlib.h>
 
@@ -91,7 +92,21 @@ private:
     z_stream _zStream;
     QByteArray _inBuffer;
     char *_stagingBuffer;
-    QByteArray _output;
+
+    qint64 findEndOfLine() const;
+    QByteArray take(qint64 size);
+
+    /* The inflated data are kept as a queue of chunks, one per staging buffer, so that consuming a line
+       does not have to shift the rest of the decompressed data around. */
+    QList<QByteArray> _output;
+    /* Read position within the first chunk */
+    int _outputOffset;
+    /* Number of bytes which are available past the read position */
+    qint64 _outputSize;
+    /* Offset of the next LF relative to the read position, or -1 if not known yet */
+    mutable qint64 _eolPos;
+    /* Number of bytes past the read position which are known not to contain any LF */
+    mutable qint64 _eolScanned;
 };
 
 }
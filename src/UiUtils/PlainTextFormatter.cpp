@@ -524,6 +524,15 @@ QString plainTextToHtml(const QString &plaintext, const FlowedFormat flowed)
 
 QString htmlizedTextPart(const QModelIndex &partIndex, const QFontInfo &font, const QColor &backgroundColor, const QColor &textColor,
                          const QColor &linkColor, const QColor &visitedLinkColor)
+{
+    // We cannot rely on the QWebFrame's toPlainText because of https://bugs.kde.org/show_bug.cgi?id=321160
+    return htmlizedTextPart(plainTextToHtml(partIndex.data(Imap::Mailbox::RolePartUnicodeText).toString(), flowedFormatForPart(partIndex)),
+                            font, backgroundColor, textColor, linkColor, visitedLinkColor);
+}
+
+/** @short Wrap the @arg markup as produced by plainTextToHtml() into a complete HTML page, including the stylesheets */
+QString htmlizedTextPart(const QString &markup, const QFontInfo &font, const QColor &backgroundColor, const QColor &textColor,
+                         const QColor &linkColor, const QColor &visitedLinkColor)
 {
     static const QString defaultStyle = QString::fromUtf8(
         "pre{word-wrap: break-word; white-space: pre-wrap;}"
@@ -594,10 +603,6 @@ QString htmlizedTextPart(const QModelIndex &partIndex, const QFontInfo &font, co
                        QLatin1String("--></style></head><body><pre dir=\"auto\">"));
     static QString htmlFooter(QStringLiteral("\n</pre></body></html>"));
 
-
-    // We cannot rely on the QWebFrame's toPlainText because of https://bugs.kde.org/show_bug.cgi?id=321160
-    QString markup = plainTextToHtml(partIndex.data(Imap::Mailbox::RolePartUnicodeText).toString(), flowedFormatForPart(partIndex));
-
     return htmlHeader + markup + htmlFooter;
 }
 
@@ -44,6 +44,9 @@ QString plainTextToHtml(const QString &plaintext, const FlowedFormat flowed);
 QString htmlizedTextPart(const QModelIndex &partIndex, const QFontInfo &font,
                          const QColor &backgroundColor, const QColor &textColor,
                          const QColor &linkColor, const QColor &visitedLinkColor);
+QString htmlizedTextPart(const QString &markup, const QFontInfo &font,
+                         const QColor &backgroundColor, const QColor &textColor,
+                         const QColor &linkColor, const QColor &visitedLinkColor);
 
 FlowedFormat flowedFormatForPart(const QModelIndex &partIndex);
 
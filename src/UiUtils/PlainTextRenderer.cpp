@@ -0,0 +1,122 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QCoreApplication>
+#include <QModelIndex>
+#include <QPointer>
+#include "PlainTextRenderer.h"
+#include "Imap/Model/ItemRoles.h"
+
+namespace UiUtils {
+
+void PlainTextRenderWorker::render(const quint64 id, const QString &text, const int flowed)
+{
+    emit rendered(id, plainTextToHtml(text, static_cast<FlowedFormat>(flowed)));
+}
+
+PlainTextRenderer::PlainTextRenderer(QObject *parent)
+    : QObject(parent)
+    , m_worker(new PlainTextRenderWorker())
+    , m_cache(16 * 1024 * 1024)
+    , m_lastId(0)
+{
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(this, &PlainTextRenderer::requestRender, m_worker, &PlainTextRenderWorker::render);
+    connect(m_worker, &PlainTextRenderWorker::rendered, this, &PlainTextRenderer::slotRendered);
+    m_thread.start(QThread::LowPriority);
+}
+
+PlainTextRenderer::~PlainTextRenderer()
+{
+    m_thread.quit();
+    m_thread.wait();
+}
+
+/** @short Return the shared instance, owned by the application object */
+PlainTextRenderer *PlainTextRenderer::instance()
+{
+    static QPointer<PlainTextRenderer> renderer;
+    if (!renderer) {
+        renderer = new PlainTextRenderer(QCoreApplication::instance());
+    }
+    return renderer;
+}
+
+/** @short Build a key identifying the rendered form of the specified message part
+
+An empty string is returned for parts which cannot be identified reliably, e.g. parts of local messages which do not live
+in any mailbox. Such parts must not be cached.
+*/
+QString PlainTextRenderer::cacheKey(const QModelIndex &partIndex)
+{
+    const QString mailbox = partIndex.data(Imap::Mailbox::RoleMailboxName).toString();
+    const uint uid = partIndex.data(Imap::Mailbox::RoleMessageUid).toUInt();
+    if (mailbox.isEmpty() || !uid)
+        return QString();
+    return QStringLiteral("%1\n%2\n%3\n%4\n%5").arg(mailbox,
+                                                    QString::number(partIndex.data(Imap::Mailbox::RoleMailboxUidValidity).toUInt()),
+                                                    QString::number(uid),
+                                                    partIndex.data(Imap::Mailbox::RolePartPathToPart).toString(),
+                                                    QString::number(static_cast<int>(flowedFormatForPart(partIndex))));
+}
+
+/** @short Return the markup for the @arg key if available, a null QString otherwise */
+QString PlainTextRenderer::cachedMarkup(const QString &key) const
+{
+    if (key.isEmpty())
+        return QString();
+    const QString *markup = m_cache.object(key);
+    return markup ? *markup : QString();
+}
+
+/** @short Start converting the @arg text in the background
+
+The result is announced through the rendered() signal with the returned ID. When the @arg key is not empty, the result is
+also stored in the cache.
+*/
+quint64 PlainTextRenderer::render(const QString &key, const QString &text, const FlowedFormat flowed)
+{
+    const quint64 id = ++m_lastId;
+    if (!key.isEmpty())
+        m_pendingKeys[id] = key;
+    emit requestRender(id, text, static_cast<int>(flowed));
+    return id;
+}
+
+void PlainTextRenderer::slotRendered(const quint64 id, const QString &markup)
+{
+    auto it = m_pendingKeys.find(id);
+    if (it != m_pendingKeys.end()) {
+        m_cache.insert(*it, new QString(markup), qMax(1, markup.size()));
+        m_pendingKeys.erase(it);
+    }
+    emit rendered(id, markup);
+}
+
+/** @short Limit the total size of the cached markup, in characters */
+void PlainTextRenderer::setMaxCacheSize(const int characters)
+{
+    m_cache.setMaxCost(characters);
+}
+
+}
@@ -0,0 +1,93 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TROJITA_UIUTILS_PLAINTEXTRENDERER_H
+#define TROJITA_UIUTILS_PLAINTEXTRENDERER_H
+
+#include <QCache>
+#include <QHash>
+#include <QObject>
+#include <QThread>
+#include "PlainTextFormatter.h"
+
+class QModelIndex;
+
+namespace UiUtils {
+
+/** @short Worker which runs plainTextToHtml() in a background thread */
+class PlainTextRenderWorker: public QObject
+{
+    Q_OBJECT
+public slots:
+    void render(const quint64 id, const QString &text, const int flowed);
+signals:
+    void rendered(const quint64 id, const QString &markup);
+};
+
+/** @short Convert plain text message parts to HTML off the GUI thread and remember the results
+
+The conversion performed by plainTextToHtml() involves quite a few regular expressions and is far from cheap for long messages.
+This class offloads it to a background thread and keeps the resulting markup in a cache, so that reopening a message which
+was shown recently does not have to repeat the whole work.
+
+Only the markup is cached; the surrounding HTML page with the fonts and colors is cheap to produce, so it is built on demand
+via htmlizedTextPart().
+*/
+class PlainTextRenderer: public QObject
+{
+    Q_OBJECT
+public:
+    static PlainTextRenderer *instance();
+    virtual ~PlainTextRenderer();
+
+    static QString cacheKey(const QModelIndex &partIndex);
+
+    QString cachedMarkup(const QString &key) const;
+    quint64 render(const QString &key, const QString &text, const FlowedFormat flowed);
+
+    void setMaxCacheSize(const int characters);
+
+signals:
+    /** @short The background conversion requested through render() has finished */
+    void rendered(const quint64 id, const QString &markup);
+    void requestRender(const quint64 id, const QString &text, const int flowed);
+
+private slots:
+    void slotRendered(const quint64 id, const QString &markup);
+
+private:
+    explicit PlainTextRenderer(QObject *parent);
+
+    QThread m_thread;
+    PlainTextRenderWorker *m_worker;
+    QCache<QString, QString> m_cache;
+    /** @short Cache keys of the requests which are being processed right now */
+    QHash<quint64, QString> m_pendingKeys;
+    quint64 m_lastId;
+
+    PlainTextRenderer(const PlainTextRenderer &); // don't implement
+    PlainTextRenderer &operator=(const PlainTextRenderer &); // don't implement
+};
+
+}
+
+#endif // TROJITA_UIUTILS_PLAINTEXTRENDERER_H
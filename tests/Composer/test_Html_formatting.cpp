@@ -30,6 +30,7 @@
 #include "Composer/ReplaceSignature.h"
 #include "Composer/SenderIdentitiesModel.h"
 #include "Composer/SubjectMangling.h"
+#include "UiUtils/PlainTextRenderer.h"
 
 #if defined(__has_feature)
 #  if  __has_feature(address_sanitizer)
@@ -751,4 +752,39 @@ void HtmlFormattingTest::testSignatures_data()
     QTest::newRow("replacement-of-multiline") << QStringLiteral("foo\n-- \njohoho\nwtf\nbar") << QStringLiteral("sig") << QStringLiteral("foo\n-- \nsig");
 }
 
+/** @short Background rendering has to produce the same result as the synchronous conversion, and cache it */
+void HtmlFormattingTest::testBackgroundRendering()
+{
+    QString text;
+    for (int i = 0; i < 500; ++i) {
+        text += QStringLiteral("> quoted line %1 with a link to http://example.org/%1\n").arg(i);
+    }
+    text += QStringLiteral("\n-- \nsignature");
+    const QString expected = UiUtils::plainTextToHtml(text, UiUtils::FlowedFormat::FLOWED);
+
+    auto renderer = UiUtils::PlainTextRenderer::instance();
+    const QString key = QStringLiteral("some key");
+    QVERIFY(renderer->cachedMarkup(key).isNull());
+    QSignalSpy spy(renderer, SIGNAL(rendered(quint64,QString)));
+    const quint64 id = renderer->render(key, text, UiUtils::FlowedFormat::FLOWED);
+    QVERIFY(id);
+    QTRY_COMPARE(spy.size(), 1);
+    QCOMPARE(spy[0][0].value<quint64>(), id);
+    QCOMPARE(spy[0][1].toString(), expected);
+    QCOMPARE(renderer->cachedMarkup(key), expected);
+
+    // Requests without a key are not cached
+    spy.clear();
+    const quint64 uncached = renderer->render(QString(), QStringLiteral("foo"), UiUtils::FlowedFormat::PLAIN);
+    QVERIFY(uncached != id);
+    QTRY_COMPARE(spy.size(), 1);
+    QCOMPARE(spy[0][1].toString(), QStringLiteral("foo"));
+    QVERIFY(renderer->cachedMarkup(QString()).isNull());
+
+    // Trimming the cache evicts the old entries
+    renderer->setMaxCacheSize(1);
+    QVERIFY(renderer->cachedMarkup(key).isNull());
+    renderer->setMaxCacheSize(16 * 1024 * 1024);
+}
+
 QTEST_MAIN(HtmlFormattingTest)
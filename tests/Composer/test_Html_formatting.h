@@ -53,6 +53,8 @@ private slots:
 
     void testSignatures();
     void testSignatures_data();
+
+    void testBackgroundRendering();
 };
 
 class WebRenderingTester: public QObject
@@ -33,6 +33,7 @@
 #ifdef TROJITA_HAVE_CRYPTO_MESSAGES
 #  ifdef TROJITA_HAVE_GPGMEPP
 #    include "Cryptography/GpgMe++.h"
+#    include "Cryptography/SignatureCache.h"
 #  endif
 #endif
 
@@ -272,7 +273,8 @@ void CryptographyPGPTest::testVerification()
     Cryptography::MessageModel msgModel(0, msg);
 #ifdef TROJITA_HAVE_CRYPTO_MESSAGES
 #  ifdef TROJITA_HAVE_GPGMEPP
-    msgModel.registerPartHandler(std::make_shared<Cryptography::GpgMeReplacer>());
+    auto replacer = std::make_shared<Cryptography::GpgMeReplacer>();
+    msgModel.registerPartHandler(replacer);
 #  endif
 #endif
     QModelIndex mappedMsg = msgModel.index(0,0);
@@ -327,6 +329,23 @@ void CryptographyPGPTest::testVerification()
 
     cEmpty();
     QVERIFY(errorSpy->empty());
+
+#  ifdef TROJITA_HAVE_GPGMEPP
+    // Opening the same message once again reuses the result of the previous verification
+    Cryptography::MessageModel msgModel2(0, msg);
+    msgModel2.registerPartHandler(replacer);
+    QModelIndex mappedMsg2 = msgModel2.index(0,0);
+    QVERIFY(mappedMsg2.isValid());
+    QVERIFY(msgModel2.rowCount(mappedMsg2) > 0);
+    QModelIndex data2 = mappedMsg2.child(0, 0);
+    QVERIFY(data2.isValid());
+    QCoreApplication::processEvents();
+    QVERIFY(!data2.data(Imap::Mailbox::RolePartCryptoNotFinishedYet).toBool());
+    QCOMPARE(data2.data(Imap::Mailbox::RolePartCryptoTLDR).toString(), tldr);
+    QCOMPARE(data2.data(Imap::Mailbox::RolePartSignatureValidDisregardingTrust).toBool(), validDisregardingTrust);
+    QCOMPARE(data2.data(Imap::Mailbox::RolePartSignatureValidTrusted).toBool(), validCompletely);
+    cEmpty();
+#  endif
 #else
     QCOMPARE(msgModel.rowCount(data), 2);
     QCOMPARE(data.data(Imap::Mailbox::RoleIsFetched).toBool(), true);
@@ -572,4 +591,40 @@ void CryptographyPGPTest::testOffline_data()
             << QByteArray("UID FETCH 333 \\((BODY\\.PEEK\\[(1|2)\\] ?){2}\\)");
 }
 
+/** @short The results of signature verification survive a restart */
+void CryptographyPGPTest::testSignatureCache()
+{
+#if defined(TROJITA_HAVE_CRYPTO_MESSAGES) && defined(TROJITA_HAVE_GPGMEPP)
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + QLatin1String("/signatures.sqlite");
+    const QByteArray key = QCryptographicHash::hash("some signed data", QCryptographicHash::Sha256);
+    const QDateTime signDate = QDateTime(QDate(2016, 5, 6), QTime(7, 8, 9), Qt::UTC);
+    Cryptography::SignatureDataBundle result;
+
+    {
+        Cryptography::SignatureCache cache;
+        QVERIFY(cache.open(fileName));
+        QVERIFY(!cache.lookup(key, result));
+        cache.store(key, {true, true, false, QStringLiteral("Signed by stranger"), QStringLiteral("long\nstatus"),
+                          QStringLiteral("emblem-warning"), QStringLiteral("Valid <valid@test.trojita.flaska.net>"), signDate});
+    }
+
+    Cryptography::SignatureCache cache;
+    QVERIFY(cache.open(fileName));
+    QVERIFY(!cache.lookup(QCryptographicHash::hash("other data", QCryptographicHash::Sha256), result));
+    QVERIFY(cache.lookup(key, result));
+    QCOMPARE(result.wasSigned, true);
+    QCOMPARE(result.isValidDisregardingTrust, true);
+    QCOMPARE(result.isValidTrusted, false);
+    QCOMPARE(result.tldrStatus, QStringLiteral("Signed by stranger"));
+    QCOMPARE(result.longStatus, QStringLiteral("long\nstatus"));
+    QCOMPARE(result.statusIcon, QStringLiteral("emblem-warning"));
+    QCOMPARE(result.signatureUid, QStringLiteral("Valid <valid@test.trojita.flaska.net>"));
+    QCOMPARE(result.signatureDate, signDate);
+#else
+    QSKIP("Cannot test without GpgME++ support");
+#endif
+}
+
 QTEST_GUILESS_MAIN(CryptographyPGPTest)
@@ -42,6 +42,7 @@ private Q_SLOTS:
     void testMalformed_data();
     void testOffline();
     void testOffline_data();
+    void testSignatureCache();
 };
 
 Q_DECLARE_METATYPE(CryptographyPGPTest::pathList)
@@ -397,6 +397,170 @@ void BodyPartsTest::testFetchingRawParts()
     cEmpty();
 }
 
+/** @short Check that a part can be loaded chunk by chunk through partial fetches */
+void BodyPartsTest::testPartialFetch()
+{
+    model->setProperty("trojita-imap-delayed-fetch-part", 0);
+    helperSyncBNoMessages();
+    cServer("* 1 EXISTS\r\n");
+    cClient(t.mk("UID FETCH 1:* (FLAGS)\r\n"));
+    cServer("* 1 FETCH (UID 333 FLAGS ())\r\n" + t.last("OK fetched\r\n"));
+    QCOMPARE(model->rowCount(msgListB), 1);
+    QModelIndex msg = msgListB.child(0, 0);
+    QVERIFY(msg.isValid());
+    QCOMPARE(model->rowCount(msg), 0);
+    cClient(t.mk("UID FETCH 333 (" FETCH_METADATA_ITEMS ")\r\n"));
+    cServer("* 1 FETCH (UID 333 BODYSTRUCTURE (\"text\" \"plain\" () NIL NIL \"quoted-printable\" 70000 2 NIL NIL NIL NIL))\r\n"
+            + t.last("OK fetched\r\n"));
+    QCOMPARE(model->rowCount(msg), 1);
+    QModelIndex part = msg.child(0, 0);
+    QVERIFY(part.isValid());
+    QCOMPARE(part.data(RolePartId).toString(), QString("1"));
+
+    QSignalSpy dataChangedSpy(model, SIGNAL(dataChanged(QModelIndex,QModelIndex)));
+
+    // The first chunk ends in the middle of an escape sequence which must not make it to the decoded data yet
+    QByteArray chunk1 = QByteArray(65534, 'a') + "=4";
+    QVERIFY(part.data(RolePartLoadNextChunk).isNull());
+    cClient(t.mk("UID FETCH 333 (BODY.PEEK[1]<0.65536>)\r\n"));
+    cServer("* 1 FETCH (UID 333 BODY[1]<0> {65536}\r\n" + chunk1 + ")\r\n" + t.last("OK fetched\r\n"));
+    QCOMPARE(dataChangedSpy.size(), 1);
+    QCOMPARE(dataChangedSpy[0][0].toModelIndex(), part);
+    dataChangedSpy.clear();
+    QVERIFY(!part.data(RoleIsFetched).toBool());
+    QCOMPARE(part.data(RolePartPartialData).toByteArray(), QByteArray(65534, 'a'));
+    QCOMPARE(part.data(RolePartPartialOctets).toULongLong(), 65536ull);
+    QCOMPARE(model->cache()->messagePart("b", 333, "1.X-PARTIAL"), chunk1);
+    QVERIFY(model->cache()->messagePart("b", 333, "1").isNull());
+    cEmpty();
+
+    // Ask for the rest; one extra byte is requested so that the server returns less than what was asked for
+    QVERIFY(part.data(RolePartLoadRemainingChunks).isNull());
+    cClient(t.mk("UID FETCH 333 (BODY.PEEK[1]<65536.4465>)\r\n"));
+    cServer("* 1 FETCH (UID 333 BODY[1]<65536> \"1bc\")\r\n" + t.last("OK fetched\r\n"));
+    QCOMPARE(dataChangedSpy.size(), 1);
+    QCOMPARE(dataChangedSpy[0][0].toModelIndex(), part);
+    QVERIFY(part.data(RoleIsFetched).toBool());
+    QCOMPARE(part.data(RolePartData).toByteArray(), QByteArray(65534, 'a') + "Abc");
+    QCOMPARE(part.data(RolePartPartialData).toByteArray(), QByteArray(65534, 'a') + "Abc");
+    QCOMPARE(model->cache()->messagePart("b", 333, "1"), QByteArray(65534, 'a') + "Abc");
+    QVERIFY(model->cache()->messagePart("b", 333, "1.X-PARTIAL").isNull());
+
+    // Nothing more shall be requested
+    QVERIFY(part.data(RolePartLoadNextChunk).isNull());
+    cEmpty();
+}
+
+/** @short The preview is built from the beginning of the main text part when the server cannot provide one */
+void BodyPartsTest::testPreviewFromTextPart()
+{
+    model->setProperty("trojita-imap-delayed-fetch-part", 0);
+    helperSyncBNoMessages();
+    cServer("* 1 EXISTS\r\n");
+    cClient(t.mk("UID FETCH 1:* (FLAGS)\r\n"));
+    cServer("* 1 FETCH (UID 333 FLAGS ())\r\n" + t.last("OK fetched\r\n"));
+    QModelIndex msg = msgListB.child(0, 0);
+    QVERIFY(msg.isValid());
+
+    // Nothing is known about the message yet
+    QVERIFY(msg.data(RoleMessagePreview).isNull());
+    cClient(t.mk("UID FETCH 333 (" FETCH_METADATA_ITEMS ")\r\n"));
+    cServer("* 1 FETCH (UID 333 RFC822.SIZE 89 INTERNALDATE \"15-Jan-2013 12:17:06 +0000\" "
+            "ENVELOPE (NIL \"subject\" NIL NIL NIL NIL NIL NIL NIL NIL) "
+            "BODYSTRUCTURE ((\"text\" \"plain\" (\"charset\" \"utf-8\") NIL NIL \"7bit\" 71 5 NIL NIL NIL NIL)"
+            "(\"text\" \"html\" () NIL NIL \"7bit\" 50 2 NIL NIL NIL NIL) \"alternative\" NIL NIL NIL NIL))\r\n"
+            + t.last("OK fetched\r\n"));
+    QVERIFY(msg.data(RoleIsFetched).toBool());
+
+    // Only the beginning of the text/plain part is requested
+    QVERIFY(msg.data(RoleMessagePreview).isNull());
+    cClient(t.mk("UID FETCH 333 (BODY.PEEK[1]<0.1024>)\r\n"));
+    QByteArray text = "> quoted line\r\nHello   there,\r\n  second line\r\n-- \r\nsignature\r\n";
+    cServer("* 1 FETCH (UID 333 BODY[1]<0> {" + QByteArray::number(text.size()) + "}\r\n" + text + ")\r\n"
+            + t.last("OK fetched\r\n"));
+    QCOMPARE(msg.data(RoleMessagePreview).toString(), QStringLiteral("Hello there, second line"));
+    QCOMPARE(model->cache()->messageMetadata("b", 333).preview, QStringLiteral("Hello there, second line"));
+
+    // The whole part was shorter than the requested chunk, so it got fetched completely
+    QCOMPARE(model->cache()->messagePart("b", 333, "1"), text);
+    QVERIFY(model->cache()->messagePart("b", 333, "1.X-PARTIAL").isNull());
+    cEmpty();
+    QVERIFY(errorSpy->isEmpty());
+}
+
+/** @short The chunk which was only fetched for a preview does not stay in the cache */
+void BodyPartsTest::testPreviewOfLongPart()
+{
+    model->setProperty("trojita-imap-delayed-fetch-part", 0);
+    helperSyncBNoMessages();
+    cServer("* 1 EXISTS\r\n");
+    cClient(t.mk("UID FETCH 1:* (FLAGS)\r\n"));
+    cServer("* 1 FETCH (UID 333 FLAGS ())\r\n" + t.last("OK fetched\r\n"));
+    QModelIndex msg = msgListB.child(0, 0);
+    QVERIFY(msg.isValid());
+
+    QVERIFY(msg.data(RoleMessagePreview).isNull());
+    cClient(t.mk("UID FETCH 333 (" FETCH_METADATA_ITEMS ")\r\n"));
+    cServer("* 1 FETCH (UID 333 RFC822.SIZE 5089 INTERNALDATE \"15-Jan-2013 12:17:06 +0000\" "
+            "ENVELOPE (NIL \"subject\" NIL NIL NIL NIL NIL NIL NIL NIL) "
+            "BODYSTRUCTURE (\"text\" \"plain\" () NIL NIL \"7bit\" 5000 1 NIL NIL NIL NIL))\r\n"
+            + t.last("OK fetched\r\n"));
+    QVERIFY(msg.data(RoleMessagePreview).isNull());
+    const QByteArray text = "Hello" + QByteArray(4995, 'x');
+    cClient(t.mk("UID FETCH 333 (BODY.PEEK[1]<0.1024>)\r\n"));
+    cServer("* 1 FETCH (UID 333 BODY[1]<0> {1024}\r\n" + text.left(1024) + ")\r\n" + t.last("OK fetched\r\n"));
+    QVERIFY(msg.data(RoleMessagePreview).toString().startsWith(QLatin1String("Hello")));
+    QVERIFY(model->cache()->messagePart("b", 333, "1.X-PARTIAL").isNull());
+    cEmpty();
+
+    // The beginning is still used when the user asks for the whole part
+    QModelIndex part = msg.child(0, 0);
+    QVERIFY(part.isValid());
+    QVERIFY(part.data(RolePartLoadRemainingChunks).isNull());
+    cClient(t.mk("UID FETCH 333 (BODY.PEEK[1]<1024.3977>)\r\n"));
+    cServer("* 1 FETCH (UID 333 BODY[1]<1024> {3976}\r\n" + text.mid(1024) + ")\r\n" + t.last("OK fetched\r\n"));
+    QVERIFY(part.data(RoleIsFetched).toBool());
+    QCOMPARE(model->cache()->messagePart("b", 333, "1"), text);
+    QVERIFY(model->cache()->messagePart("b", 333, "1.X-PARTIAL").isNull());
+    cEmpty();
+    QVERIFY(errorSpy->isEmpty());
+}
+
+/** @short The RFC 8970 PREVIEW is fetched along with the rest of the metadata */
+void BodyPartsTest::testPreviewFromServer()
+{
+    FakeCapabilitiesInjector injector(model);
+    injector.injectCapability(QStringLiteral("PREVIEW"));
+    model->setProperty("trojita-imap-delayed-fetch-part", 0);
+    helperSyncBNoMessages();
+    cServer("* 2 EXISTS\r\n");
+    cClient(t.mk("UID FETCH 1:* (FLAGS)\r\n"));
+    cServer("* 1 FETCH (UID 333 FLAGS ())\r\n* 2 FETCH (UID 334 FLAGS ())\r\n" + t.last("OK fetched\r\n"));
+    QModelIndex msg1 = msgListB.child(0, 0);
+    QModelIndex msg2 = msgListB.child(1, 0);
+    QVERIFY(msg1.isValid());
+    QVERIFY(msg2.isValid());
+
+    QVERIFY(msg1.data(RoleMessagePreview).isNull());
+    QVERIFY(msg2.data(RoleMessagePreview).isNull());
+    cClient(t.mk("UID FETCH 333:334 (" FETCH_METADATA_ITEMS " PREVIEW)\r\n"));
+    cServer("* 1 FETCH (UID 333 RFC822.SIZE 89 INTERNALDATE \"15-Jan-2013 12:17:06 +0000\" "
+            "ENVELOPE (NIL \"subject\" NIL NIL NIL NIL NIL NIL NIL NIL) "
+            "BODYSTRUCTURE (\"text\" \"plain\" () NIL NIL NIL 19 2 NIL NIL NIL NIL) PREVIEW \"Hi there\")\r\n"
+            "* 2 FETCH (UID 334 RFC822.SIZE 89 INTERNALDATE \"15-Jan-2013 12:17:06 +0000\" "
+            "ENVELOPE (NIL \"subject\" NIL NIL NIL NIL NIL NIL NIL NIL) "
+            "BODYSTRUCTURE (\"text\" \"plain\" () NIL NIL NIL 19 2 NIL NIL NIL NIL) PREVIEW NIL)\r\n"
+            + t.last("OK fetched\r\n"));
+    QCOMPARE(msg1.data(RoleMessagePreview).toString(), QStringLiteral("Hi there"));
+    QCOMPARE(model->cache()->messageMetadata("b", 333).preview, QStringLiteral("Hi there"));
+    // NIL means that there's no preview, and it is not going to be asked for again
+    QCOMPARE(msg2.data(RoleMessagePreview).toString(), QString());
+    QVERIFY(!msg2.data(RoleMessagePreview).isNull());
+    QVERIFY(!model->cache()->messageMetadata("b", 334).preview.isNull());
+    cEmpty();
+    QVERIFY(errorSpy->isEmpty());
+}
+
 void BodyPartsTest::testFilenameExtraction()
 {
     QFETCH(QByteArray, bodystructure);
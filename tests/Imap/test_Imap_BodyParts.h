@@ -39,6 +39,12 @@ private slots:
 
     void testFetchingRawParts();
 
+    void testPartialFetch();
+
+    void testPreviewFromTextPart();
+    void testPreviewOfLongPart();
+    void testPreviewFromServer();
+
     void testFilenameExtraction();
     void testFilenameExtraction_data();
 
@@ -117,6 +117,48 @@ void CopyAndFlagTest::helperMove(const MoveFeatures serverFeatures)
     justKeepTask();
 }
 
+/** @short Check that the cached data are made available in the target mailbox when the server sends COPYUID */
+void CopyAndFlagTest::testMoveCopyUid()
+{
+    FakeCapabilitiesInjector injector(model);
+    injector.injectCapability(QStringLiteral("MOVE"));
+
+    existsA = 3;
+    uidNextA = 5;
+    uidValidityA = 666;
+    for (uint i = 1; i <= existsA; ++i)
+        uidMapA << i;
+    helperSyncAWithMessagesEmptyState();
+    helperCheckCache();
+    helperVerifyUidMapA();
+
+    QString mailboxA = QStringLiteral("a");
+    QString mailboxB = QStringLiteral("b");
+    QStringList flags = QStringList() << QStringLiteral("\\Seen") << QStringLiteral("$Label1");
+    model->cache()->setMsgFlags(mailboxA, 2, flags);
+    model->cache()->setMsgPart(mailboxA, 2, "1", "blesmrt");
+    Imap::Mailbox::SyncState syncStateB;
+    syncStateB.setUidValidity(333);
+    model->cache()->setMailboxSyncState(mailboxB, syncStateB);
+
+    auto aMailboxPtr = dynamic_cast<TreeItemMailbox *>(Model::realTreeItem(idxA));
+    Q_ASSERT(aMailboxPtr);
+    model->copyMoveMessages(aMailboxPtr, mailboxB, Imap::Uids() << 2, MOVE);
+    cClient(t.mk("UID MOVE 2 b\r\n"));
+    cServer("* OK [COPYUID 333 2 10] moved\r\n* 2 EXPUNGE\r\n" + t.last("OK done\r\n"));
+    --existsA;
+    uidMapA.remove(1);
+    helperCheckCache();
+    helperVerifyUidMapA();
+
+    QCOMPARE(model->cache()->msgFlags(mailboxB, 10), flags);
+    QCOMPARE(model->cache()->messagePart(mailboxB, 10, "1"), QByteArray("blesmrt"));
+    QVERIFY(model->cache()->messagePart(mailboxA, 2, "1").isNull());
+
+    cEmpty();
+    justKeepTask();
+}
+
 void CopyAndFlagTest::testUpdateAllFlags()
 {
     // Push the data to the cache
@@ -166,4 +208,124 @@ void CopyAndFlagTest::testUpdateAllFlags()
     justKeepTask();
 }
 
+/** @short Flag changes are visible before the server confirms them and reverted when the server refuses them */
+void CopyAndFlagTest::testOptimisticFlagUpdates()
+{
+    existsA = 4;
+    uidNextA = 5;
+    uidValidityA = 666;
+    for (uint i = 1; i <= existsA; ++i)
+        uidMapA << i;
+    QCOMPARE(model->rowCount(msgListA), 0);
+    cClient(t.mk("SELECT a\r\n"));
+    cServer("* 4 EXISTS\r\n"
+            "* OK [UIDVALIDITY 666] UIDs valid\r\n"
+            "* OK [UIDNEXT 5] Predicted next UID\r\n"
+            + t.last("OK selected\r\n"));
+    cClient(t.mk("UID SEARCH ALL\r\n"));
+    cServer("* SEARCH 1 2 3 4\r\n" + t.last("OK search\r\n"));
+    cClient(t.mk("FETCH 1:4 (FLAGS)\r\n"));
+    cServer("* 1 FETCH (FLAGS ())\r\n"
+            "* 2 FETCH (FLAGS (\\Seen))\r\n"
+            "* 3 FETCH (FLAGS (\\Answered \\Seen))\r\n"
+            "* 4 FETCH (FLAGS (\\Answered))\r\n"
+            + t.last("OK fetched\r\n"));
+    helperCheckCache();
+    helperVerifyUidMapA();
+    QString mailbox = QStringLiteral("a");
+    QString seen = QStringLiteral("\\Seen");
+    QString flagged = QStringLiteral("\\Flagged");
+
+    // The change is applied to the model before the server gets a chance to respond...
+    model->markMessagesRead(QModelIndexList() << msgListA.child(3, 0) << msgListA.child(0, 0), FLAG_ADD);
+    QVERIFY(msgListA.child(0, 0).data(RoleMessageIsMarkedRead).toBool());
+    QVERIFY(msgListA.child(3, 0).data(RoleMessageIsMarkedRead).toBool());
+    QCOMPARE(idxA.data(RoleUnreadMessageCount).toInt(), 0);
+    cClient(t.mk("UID STORE 1,4 +FLAGS (\\Seen)\r\n"));
+    // ...but the cache only gets updated once the server agrees
+    QVERIFY(!model->cache()->msgFlags(mailbox, 1).contains(seen));
+    cServer(t.last("NO you shall not pass\r\n"));
+    // The server has refused, so the change gets reverted
+    QVERIFY(!msgListA.child(0, 0).data(RoleMessageIsMarkedRead).toBool());
+    QVERIFY(!msgListA.child(3, 0).data(RoleMessageIsMarkedRead).toBool());
+    QCOMPARE(idxA.data(RoleUnreadMessageCount).toInt(), 2);
+    QVERIFY(!model->cache()->msgFlags(mailbox, 1).contains(seen));
+    QVERIFY(!model->cache()->msgFlags(mailbox, 4).contains(seen));
+
+    // Consecutive UIDs are sent as a range
+    QVERIFY(model->setMessageFlags(idxA, Imap::Uids() << 3 << 1 << 2, flagged, FLAG_ADD));
+    cClient(t.mk("UID STORE 1:3 +FLAGS (\\Flagged)\r\n"));
+    cServer(t.last("OK stored\r\n"));
+    for (uint uid = 1; uid <= 3; ++uid) {
+        QVERIFY(model->cache()->msgFlags(mailbox, uid).contains(flagged));
+    }
+    QVERIFY(!model->cache()->msgFlags(mailbox, 4).contains(flagged));
+    QCOMPARE(model->cache()->msgFlags(mailbox, 3), QStringList() << QStringLiteral("\\Answered") << flagged << seen);
+
+    cEmpty();
+    justKeepTask();
+}
+
+/** @short A conditional STORE leaves alone messages which were modified elsewhere and their optimistic update gets reverted */
+void CopyAndFlagTest::testConditionalStoreModified()
+{
+    FakeCapabilitiesInjector injector(model);
+    injector.injectCapability(QStringLiteral("CONDSTORE"));
+    QString mailbox = QStringLiteral("a");
+    Imap::Mailbox::SyncState sync;
+    sync.setExists(3);
+    sync.setUidValidity(666);
+    sync.setUidNext(15);
+    sync.setHighestModSeq(33);
+    sync.setUnSeenCount(3);
+    sync.setRecent(0);
+    Imap::Uids uidMap;
+    uidMap << 6 << 9 << 10;
+    model->cache()->setMailboxSyncState(mailbox, sync);
+    model->cache()->setUidMapping(mailbox, uidMap);
+    model->cache()->setMsgFlags(mailbox, 6, QStringList() << QStringLiteral("x"));
+    model->cache()->setMsgFlags(mailbox, 9, QStringList() << QStringLiteral("y"));
+    model->cache()->setMsgFlags(mailbox, 10, QStringList() << QStringLiteral("z"));
+    model->resyncMailbox(idxA);
+    cClient(t.mk("SELECT a (CONDSTORE)\r\n"));
+    cServer("* 3 EXISTS\r\n"
+            "* OK [UIDVALIDITY 666] .\r\n"
+            "* OK [UIDNEXT 15] .\r\n"
+            "* OK [HIGHESTMODSEQ 33] .\r\n"
+            + t.last("OK selected\r\n"));
+    cEmpty();
+    QCOMPARE(model->rowCount(msgListA), 3);
+    QCOMPARE(idxA.data(RoleUnreadMessageCount).toInt(), 3);
+
+    // Replacing all flags is guarded by UNCHANGEDSINCE, yet the change is visible right away
+    const QStringList seen = QStringList() << QStringLiteral("\\Seen");
+    QVERIFY(model->setMessageFlags(idxA, uidMap, QStringLiteral("\\Seen"), FLAG_USE_THESE));
+    cClient(t.mk("UID STORE 6,9:10 (UNCHANGEDSINCE 33) FLAGS (\\Seen)\r\n"));
+    for (int i = 0; i < 3; ++i) {
+        QCOMPARE(msgListA.child(i, 0).data(RoleMessageFlags).toStringList(), seen);
+    }
+    QCOMPARE(idxA.data(RoleUnreadMessageCount).toInt(), 0);
+
+    // Someone else has changed the second message in the meantime, so the server has left it alone
+    cServer(t.last("OK [MODIFIED 9] conditional store failed\r\n"));
+    QCOMPARE(msgListA.child(0, 0).data(RoleMessageFlags).toStringList(), seen);
+    QCOMPARE(msgListA.child(1, 0).data(RoleMessageFlags).toStringList(), QStringList() << QStringLiteral("y"));
+    QCOMPARE(msgListA.child(2, 0).data(RoleMessageFlags).toStringList(), seen);
+    QCOMPARE(idxA.data(RoleUnreadMessageCount).toInt(), 1);
+    QCOMPARE(model->cache()->msgFlags(mailbox, 6), seen);
+    QCOMPARE(model->cache()->msgFlags(mailbox, 9), QStringList() << QStringLiteral("y"));
+    QCOMPARE(model->cache()->msgFlags(mailbox, 10), seen);
+
+    // The flags which we have remembered for that message are stale, so the current ones are fetched from the server
+    cClient(t.mk("UID FETCH 9 (FLAGS)\r\n"));
+    cServer("* 2 FETCH (UID 9 FLAGS (\\Answered))\r\n" + t.last("OK fetched\r\n"));
+    const QStringList answered = QStringList() << QStringLiteral("\\Answered");
+    QCOMPARE(msgListA.child(1, 0).data(RoleMessageFlags).toStringList(), answered);
+    QCOMPARE(model->cache()->msgFlags(mailbox, 9), answered);
+    QCOMPARE(idxA.data(RoleUnreadMessageCount).toInt(), 1);
+
+    cEmpty();
+    justKeepTask();
+}
+
 QTEST_GUILESS_MAIN(CopyAndFlagTest)
@@ -38,8 +38,11 @@ private slots:
     void testMoveRfc3501();
     void testMoveUidPlus();
     void testMoveRfcMove();
+    void testMoveCopyUid();
 
     void testUpdateAllFlags();
+    void testOptimisticFlagUpdates();
+    void testConditionalStoreModified();
 };
 
 #endif
@@ -150,34 +150,63 @@ void ImapParserParseTest::testParseTagged_data()
                                                               new RespData<QPair<uint,Imap::Sequence> >(
                                                                   qMakePair(38505u, Imap::Sequence(3955)))
                                                               )));
-    /*
     QTest::newRow("appenduid-seq")
             << QByteArray("A003 OK [APPENDUID 38505 3955,333666] APPEND completed\r\n")
-            << QSharedPointer<AbstractResponse>(new State("A003", OK, "APPEND completed", APPENDUID,
+            << QSharedPointer<AbstractResponse>(new State("A003", OK, QStringLiteral("APPEND completed"), APPENDUID,
                                                           QSharedPointer<AbstractData>(
                                                               new RespData<QPair<uint,Imap::Sequence> >(
-                                                                  qMakePair(38505u, Imap::Sequence(3955)))
+                                                                  qMakePair(38505u, Imap::Sequence::fromVector(Imap::Uids() << 3955 << 333666)))
                                                               )));
 
+    QTest::newRow("modified")
+            << QByteArray("d105 OK [MODIFIED 7,9:11] Conditional STORE failed\r\n")
+            << QSharedPointer<AbstractResponse>(new State("d105", OK, QStringLiteral("Conditional STORE failed"), MODIFIED,
+                                                          QSharedPointer<AbstractData>(
+                                                              new RespData<Imap::Sequence>(
+                                                                  Imap::Sequence::fromVector(Imap::Uids() << 7 << 9 << 10 << 11)))));
+
     QTest::newRow("copyuid-simple")
             << QByteArray("A004 OK [COPYUID 38505 304 3956] Done\r\n")
-            << QSharedPointer<AbstractResponse>(new State("A004", OK, "Done", COPYUID,
+            << QSharedPointer<AbstractResponse>(new State("A004", OK, QStringLiteral("Done"), COPYUID,
                                                           QSharedPointer<AbstractData>(
-                                                              new RespData<QPair<uint,QPair<Imap::Sequence, Imap::Sequence> > >(
+                                                              new RespData<QPair<uint,QPair<Imap::Uids, Imap::Uids> > >(
                                                                   qMakePair(38505u,
-                                                                            qMakePair(Imap::Sequence(304), Imap::Sequence(3956))
+                                                                            qMakePair(Imap::Uids() << 304, Imap::Uids() << 3956)
                                                                             ))
                                                               )));
 
-
     QTest::newRow("copyuid-sequence")
             << QByteArray("A004 OK [COPYUID 38505 304,319:320 3956:3958] Done\r\n")
-            << QSharedPointer<AbstractResponse>(new State("A003", OK, "Done", APPENDUID,
+            << QSharedPointer<AbstractResponse>(new State("A004", OK, QStringLiteral("Done"), COPYUID,
                                                           QSharedPointer<AbstractData>(
-                                                              new RespData<QPair<uint,Imap::Sequence> >(
-                                                                  qMakePair(38505u, Imap::Sequence(3955)))
+                                                              new RespData<QPair<uint,QPair<Imap::Uids, Imap::Uids> > >(
+                                                                  qMakePair(38505u,
+                                                                            qMakePair(Imap::Uids() << 304 << 319 << 320,
+                                                                                      Imap::Uids() << 3956 << 3957 << 3958)
+                                                                            ))
+                                                              )));
+
+    QTest::newRow("copyuid-unordered")
+            << QByteArray("A004 OK [COPYUID 38505 10,3 20,21] Done\r\n")
+            << QSharedPointer<AbstractResponse>(new State("A004", OK, QStringLiteral("Done"), COPYUID,
+                                                          QSharedPointer<AbstractData>(
+                                                              new RespData<QPair<uint,QPair<Imap::Uids, Imap::Uids> > >(
+                                                                  qMakePair(38505u,
+                                                                            qMakePair(Imap::Uids() << 10 << 3, Imap::Uids() << 20 << 21)
+                                                                            ))
+                                                              )));
+
+    // RFC 4315 says that "4:2" is a valid range, too
+    QTest::newRow("copyuid-reversed-range")
+            << QByteArray("A004 OK [COPYUID 38505 1,4:2 20:22,10] Done\r\n")
+            << QSharedPointer<AbstractResponse>(new State("A004", OK, QStringLiteral("Done"), COPYUID,
+                                                          QSharedPointer<AbstractData>(
+                                                              new RespData<QPair<uint,QPair<Imap::Uids, Imap::Uids> > >(
+                                                                  qMakePair(38505u,
+                                                                            qMakePair(Imap::Uids() << 1 << 2 << 3 << 4,
+                                                                                      Imap::Uids() << 20 << 21 << 22 << 10)
+                                                                            ))
                                                               )));
-    */
 }
 
 /** @short Test untagged response parsing */
@@ -638,6 +667,32 @@ void ImapParserParseTest::testParseUntagged_data()
         << QByteArray("* 123 FETCH (rfc822.tExt abcdEf)\r\n")
         << QSharedPointer<AbstractResponse>( new Fetch( 123, fetchData ) );
 
+    fetchData.clear();
+    fetchData["BODY[1.2]<1024>"] = QSharedPointer<AbstractData>(new RespData<QByteArray>("0123456789"));
+    fetchData["UID"] = QSharedPointer<AbstractData>(new RespData<uint>(666));
+    QTest::newRow("fetch-body-partial")
+        << QByteArray("* 123 FETCH (UID 666 BODY[1.2]<1024> {10}\r\n0123456789)\r\n")
+        << QSharedPointer<AbstractResponse>(new Fetch(123, fetchData));
+
+    fetchData.clear();
+    fetchData["BINARY[1]<0>"] = QSharedPointer<AbstractData>(new RespData<QByteArray>(""));
+    QTest::newRow("fetch-binary-partial-empty")
+        << QByteArray("* 123 FETCH (binary[1]<0> \"\")\r\n")
+        << QSharedPointer<AbstractResponse>(new Fetch(123, fetchData));
+
+    fetchData.clear();
+    fetchData["UID"] = QSharedPointer<AbstractData>(new RespData<uint>(666));
+    fetchData["PREVIEW"] = QSharedPointer<AbstractData>(new RespData<QByteArray>("Hi there, how are you?"));
+    QTest::newRow("fetch-preview")
+        << QByteArray("* 123 FETCH (UID 666 PREVIEW \"Hi there, how are you?\")\r\n")
+        << QSharedPointer<AbstractResponse>(new Fetch(123, fetchData));
+
+    fetchData.clear();
+    fetchData["PREVIEW"] = QSharedPointer<AbstractData>(new RespData<QByteArray>(QByteArray()));
+    QTest::newRow("fetch-preview-nil")
+        << QByteArray("* 123 FETCH (PREVIEW NIL)\r\n")
+        << QSharedPointer<AbstractResponse>(new Fetch(123, fetchData));
+
     fetchData.clear();
     fetchData[ "INTERNALDATE" ] = QSharedPointer<AbstractData>(
             new RespData<QDateTime>( QDateTime( QDate(2007, 3, 7), QTime( 14, 3, 32 ), Qt::UTC ) ) );
@@ -1219,6 +1274,23 @@ void ImapParserParseTest::testSequences_data()
             QByteArray("1:4,6:7,99:102,333,666");
 }
 
+void ImapParserParseTest::testSequenceSplit()
+{
+    Imap::Sequence seq = Imap::Sequence::fromVector(Imap::Uids() << 1 << 2 << 3 << 10 << 12 << 100 << 101);
+    QCOMPARE(seq.split(1000).size(), 1);
+    QCOMPARE(seq.split(1000).first().toByteArray(), QByteArray("1:3,10,12,100:101"));
+
+    auto chunks = seq.split(6);
+    QCOMPARE(chunks.size(), 3);
+    QCOMPARE(chunks[0].toByteArray(), QByteArray("1:3,10"));
+    QCOMPARE(chunks[1].toByteArray(), QByteArray("12"));
+    QCOMPARE(chunks[2].toByteArray(), QByteArray("100:101"));
+
+    // ranges are never broken apart
+    QCOMPARE(seq.split(1).size(), 4);
+    QCOMPARE(Imap::Sequence::startingAt(3).split(1).first().toByteArray(), QByteArray("3:*"));
+}
+
 /** @short Test responses which fail to parse */
 void ImapParserParseTest::testThrow()
 {
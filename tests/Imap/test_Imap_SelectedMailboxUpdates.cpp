@@ -269,6 +269,7 @@ void ImapModelSelectedMailboxUpdatesTest::helperGenericTrafficFirstArrivals(bool
                               "References: <20121031120002.5C37D5807C@linuxized.com> "
                               "<CAKmKYaDZtfZ9wzKML8WgJ=evVhteyOG0RVfsASpBGViwncsaiQ@mail.gmail.com>\r\n"
                               " <50911AE6.8060402@gmail.com>\r\n"
+                              "List-Id: Gentoo Linux mail\r\n <gentoo-dev.gentoo.org>\r\n"
                               "\r\n");
         cServer("* 1 FETCH (BODY[HEADER.FIELDS (List-Post References fail)]" + asLiteral(headerData) + ")\r\n");
 
@@ -286,6 +287,8 @@ void ImapModelSelectedMailboxUpdatesTest::helperGenericTrafficFirstArrivals(bool
         QCOMPARE(uid43.data(Imap::Mailbox::RoleMessageHeaderListPost).toList(),
                  QVariantList() << QUrl("mailto:gentoo-dev@lists.gentoo.org"));
         QCOMPARE(uid43.data(Imap::Mailbox::RoleMessageHeaderListPostNo).toBool(), false);
+        QCOMPARE(uid43.data(Imap::Mailbox::RoleMessageHeaderListId).toByteArray(), QByteArray("gentoo-dev.gentoo.org"));
+        QCOMPARE(uid43.data(Imap::Mailbox::RoleMessageNormalizedSubject).toString(), QStringLiteral("A"));
     } else {
         // Requesting all envelopes at once
         cClient(t.mk("UID FETCH 43:45 (" FETCH_METADATA_ITEMS ")\r\n"));
@@ -301,6 +304,7 @@ void ImapModelSelectedMailboxUpdatesTest::helperGenericTrafficFirstArrivals(bool
         QCOMPARE(uid43.data(Imap::Mailbox::RoleMessageHeaderReferences).value<QList<QByteArray> >(), QList<QByteArray>());
         QCOMPARE(uid43.data(Imap::Mailbox::RoleMessageHeaderListPost).toList(), QVariantList());
         QCOMPARE(uid43.data(Imap::Mailbox::RoleMessageHeaderListPostNo).toBool(), true);
+        QCOMPARE(uid43.data(Imap::Mailbox::RoleMessageHeaderListId).toByteArray(), QByteArray());
     }
     helperCheckSubjects(QStringList() << QStringLiteral("A") << QStringLiteral("B") << QStringLiteral("C"));
     cEmpty();
@@ -1135,4 +1139,214 @@ void ImapModelSelectedMailboxUpdatesTest::testFetchMsgDuplicateBodystructure()
 
 }
 
+/** @short The metadata requests follow what a view shows, and the stale ones get dropped before they are sent */
+void ImapModelSelectedMailboxUpdatesTest::testMessageViewport()
+{
+    initialMessages(20);
+    auto messages = [this](const uint first, const uint last) {
+        QModelIndexList res;
+        for (uint uid = first; uid <= last; ++uid)
+            res << msgListA.child(uid - 1, 0);
+        return res;
+    };
+
+    model->setMessageViewport(messages(1, 3), messages(4, 5));
+    cClient(t.mk("UID FETCH 1:5 (" FETCH_METADATA_ITEMS ")\r\n"));
+    QByteArray resp1 = t.last("OK fetched\r\n");
+
+    // Only one batch is in flight at a time, the rest is kept in the queue
+    model->setMessageViewport(messages(10, 11), messages(12, 12));
+    cEmpty();
+
+    // The user has scrolled away before these got sent
+    model->setMessageViewport(messages(15, 15), QModelIndexList());
+    cEmpty();
+
+    QByteArray fetchResponses;
+    for (uint uid = 1; uid <= 5; ++uid) {
+        fetchResponses += helperCreateTrivialEnvelope(uid, uid, QStringLiteral("s%1").arg(uid));
+    }
+    cServer(fetchResponses + resp1);
+    cClient(t.mk("UID FETCH 15 (" FETCH_METADATA_ITEMS ")\r\n"));
+    cServer(helperCreateTrivialEnvelope(15, 15, QStringLiteral("s15")) + t.last("OK fetched\r\n"));
+    QCOMPARE(msgListA.child(14, 0).data(Imap::Mailbox::RoleIsFetched).toBool(), true);
+
+    // Coming back to the abandoned messages asks for them again, and there's no preloading of the neighbors
+    model->setMessageViewport(messages(10, 11), QModelIndexList());
+    cClient(t.mk("UID FETCH 10:11 (" FETCH_METADATA_ITEMS ")\r\n"));
+    cServer(helperCreateTrivialEnvelope(10, 10, QStringLiteral("s10")) + helperCreateTrivialEnvelope(11, 11, QStringLiteral("s11"))
+            + t.last("OK fetched\r\n"));
+    QCOMPARE(msgListA.child(9, 0).data(Imap::Mailbox::RoleIsFetched).toBool(), true);
+    cEmpty();
+
+    // Once no view shows anything, the queued requests do not wait for the previous batch anymore
+    model->setMessageViewport(messages(16, 16), QModelIndexList());
+    cClient(t.mk("UID FETCH 16 (" FETCH_METADATA_ITEMS ")\r\n"));
+    QByteArray resp16 = t.last("OK fetched\r\n");
+    model->setMessageViewport(messages(17, 17), QModelIndexList());
+    cEmpty();
+    model->setMessageViewport(QModelIndexList(), QModelIndexList());
+    cClient(t.mk("UID FETCH 17 (" FETCH_METADATA_ITEMS ")\r\n"));
+    QByteArray resp17 = t.last("OK fetched\r\n");
+    cServer(helperCreateTrivialEnvelope(16, 16, QStringLiteral("s16")) + resp16);
+    cServer(helperCreateTrivialEnvelope(17, 17, QStringLiteral("s17")) + resp17);
+    QCOMPARE(msgListA.child(16, 0).data(Imap::Mailbox::RoleIsFetched).toBool(), true);
+    cEmpty();
+    justKeepTask();
+}
+
+/** @short Messages which have not been shown for a long time give their metadata back */
+void ImapModelSelectedMailboxUpdatesTest::testViewportReleasesStaleMessages()
+{
+    initialMessages(20);
+    auto messages = [this](const uint first, const uint last) {
+        QModelIndexList res;
+        for (uint uid = first; uid <= last; ++uid)
+            res << msgListA.child(uid - 1, 0);
+        return res;
+    };
+    auto envelopes = [this](const uint first, const uint last) {
+        QByteArray res;
+        for (uint uid = first; uid <= last; ++uid)
+            res += helperCreateTrivialEnvelope(uid, uid, QStringLiteral("s%1").arg(uid));
+        return res;
+    };
+    model->setMaterializedMessagesLimit(4);
+
+    model->setMessageViewport(messages(1, 2), QModelIndexList());
+    cClient(t.mk("UID FETCH 1:2 (" FETCH_METADATA_ITEMS ")\r\n"));
+    cServer(envelopes(1, 2) + t.last("OK fetched\r\n"));
+    model->setMessageViewport(messages(3, 4), QModelIndexList());
+    cClient(t.mk("UID FETCH 3:4 (" FETCH_METADATA_ITEMS ")\r\n"));
+    cServer(envelopes(3, 4) + t.last("OK fetched\r\n"));
+    for (int row = 0; row < 4; ++row) {
+        QCOMPARE(msgListA.child(row, 0).data(Imap::Mailbox::RoleIsFetched).toBool(), true);
+        QCOMPARE(model->rowCount(msgListA.child(row, 0)), 1);
+    }
+
+    // The message which is opened somewhere stays
+    model->pinMessage(msgListA.child(0, 0));
+
+    // Going over the limit releases the messages which have been out of sight for the longest time, in a batch which brings
+    // the number of remembered messages down to three quarters of the limit
+    model->setMessageViewport(messages(5, 5), QModelIndexList());
+    QCOMPARE(msgListA.child(0, 0).data(Imap::Mailbox::RoleIsFetched).toBool(), true);
+    QCOMPARE(model->rowCount(msgListA.child(0, 0)), 1);
+    QCOMPARE(msgListA.child(1, 0).data(Imap::Mailbox::RoleIsFetched).toBool(), false);
+    QCOMPARE(msgListA.child(2, 0).data(Imap::Mailbox::RoleIsFetched).toBool(), false);
+    QCOMPARE(msgListA.child(3, 0).data(Imap::Mailbox::RoleIsFetched).toBool(), true);
+    QCOMPARE(model->rowCount(msgListA.child(3, 0)), 1);
+    cClient(t.mk("UID FETCH 5 (" FETCH_METADATA_ITEMS ")\r\n"));
+    cServer(envelopes(5, 5) + t.last("OK fetched\r\n"));
+
+    // Once it is not needed anymore, it can go away as well
+    model->unpinMessage(msgListA.child(0, 0));
+    model->setMessageViewport(messages(6, 7), QModelIndexList());
+    QCOMPARE(msgListA.child(0, 0).data(Imap::Mailbox::RoleIsFetched).toBool(), false);
+    QCOMPARE(msgListA.child(3, 0).data(Imap::Mailbox::RoleIsFetched).toBool(), false);
+    QCOMPARE(msgListA.child(4, 0).data(Imap::Mailbox::RoleIsFetched).toBool(), true);
+    cClient(t.mk("UID FETCH 6:7 (" FETCH_METADATA_ITEMS ")\r\n"));
+    cServer(envelopes(6, 7) + t.last("OK fetched\r\n"));
+    cEmpty();
+    justKeepTask();
+}
+
+/** @short Parts the user is waiting for are fetched before the background downloads */
+void ImapModelSelectedMailboxUpdatesTest::testPartFetchPriorities()
+{
+    initialMessages(3);
+    QModelIndex msg1 = msgListA.child(0, 0);
+    QCOMPARE(model->rowCount(msg1), 0);
+    cClient(t.mk("UID FETCH 1:3 (" FETCH_METADATA_ITEMS ")\r\n"));
+    cServer(helperCreateTrivialEnvelope(1, 1, QStringLiteral("a")) + helperCreateTrivialEnvelope(2, 2, QStringLiteral("b"))
+            + helperCreateTrivialEnvelope(3, 3, QStringLiteral("c")) + t.last("OK fetched\r\n"));
+    QPersistentModelIndex part1 = msgListA.child(0, 0).child(0, 0);
+    QPersistentModelIndex part2 = msgListA.child(1, 0).child(0, 0);
+    QPersistentModelIndex part3 = msgListA.child(2, 0).child(0, 0);
+    QVERIFY(part1.isValid());
+    QVERIFY(part2.isValid());
+    QVERIFY(part3.isValid());
+
+    // Background downloads are queued before the user clicks on a message
+    part1.data(Imap::Mailbox::RolePartPrefetch);
+    part2.data(Imap::Mailbox::RolePartPrefetch);
+    QCOMPARE(part3.data(Imap::Mailbox::RolePartData).toByteArray(), QByteArray());
+
+    // The interactive request goes first
+    QByteArray req3 = t.mk("UID FETCH 3 (BODY.PEEK[1])\r\n");
+    QByteArray resp3 = t.last("OK fetched\r\n");
+    QByteArray req12 = t.mk("UID FETCH 1:2 (BODY.PEEK[1])\r\n");
+    QByteArray resp12 = t.last("OK fetched\r\n");
+    cClient(req3 + req12);
+    cServer("* 3 FETCH (UID 3 BODY[1] three)\r\n" + resp3);
+    QCOMPARE(part3.data(Imap::Mailbox::RolePartData).toByteArray(), QByteArray("three"));
+    cServer("* 1 FETCH (UID 1 BODY[1] one)\r\n* 2 FETCH (UID 2 BODY[1] two)\r\n" + resp12);
+    QCOMPARE(part1.data(Imap::Mailbox::RolePartData).toByteArray(), QByteArray("one"));
+    QCOMPARE(part2.data(Imap::Mailbox::RolePartData).toByteArray(), QByteArray("two"));
+    cEmpty();
+    justKeepTask();
+}
+
+/** @short A background request for one part of a message does not ride along with an interactive one for another part */
+void ImapModelSelectedMailboxUpdatesTest::testPartFetchPrioritiesPerPart()
+{
+    initialMessages(1);
+    QModelIndex msg = msgListA.child(0, 0);
+    QCOMPARE(model->rowCount(msg), 0);
+    cClient(t.mk("UID FETCH 1 (" FETCH_METADATA_ITEMS ")\r\n"));
+    cServer(helperCreateTrivialEnvelope(1, 1, QStringLiteral("a"), QStringLiteral("foo@example.org"),
+                                        QStringLiteral("(\"text\" \"plain\" () NIL NIL NIL 19 2 NIL NIL NIL NIL)"
+                                                       "(\"text\" \"plain\" () NIL NIL NIL 19 2 NIL NIL NIL NIL) "
+                                                       "\"mixed\" NIL NIL NIL NIL"))
+            + t.last("OK fetched\r\n"));
+    QModelIndex rootMultipart = msg.child(0, 0);
+    QPersistentModelIndex part1 = rootMultipart.child(0, 0);
+    QPersistentModelIndex part2 = rootMultipart.child(1, 0);
+    QVERIFY(part1.isValid());
+    QVERIFY(part2.isValid());
+
+    part1.data(Imap::Mailbox::RolePartPrefetch);
+    QCOMPARE(part2.data(Imap::Mailbox::RolePartData).toByteArray(), QByteArray());
+    QByteArray req2 = t.mk("UID FETCH 1 (BODY.PEEK[2])\r\n");
+    QByteArray resp2 = t.last("OK fetched\r\n");
+    QByteArray req1 = t.mk("UID FETCH 1 (BODY.PEEK[1])\r\n");
+    QByteArray resp1 = t.last("OK fetched\r\n");
+    cClient(req2 + req1);
+    cServer("* 1 FETCH (UID 1 BODY[2] two)\r\n" + resp2);
+    QCOMPARE(part2.data(Imap::Mailbox::RolePartData).toByteArray(), QByteArray("two"));
+    cServer("* 1 FETCH (UID 1 BODY[1] one)\r\n" + resp1);
+    QCOMPARE(part1.data(Imap::Mailbox::RolePartData).toByteArray(), QByteArray("one"));
+    cEmpty();
+    justKeepTask();
+}
+
+/** @short Even the interactive part fetches respect the limit of parallel fetches */
+void ImapModelSelectedMailboxUpdatesTest::testInteractivePartFetchesAreBounded()
+{
+    model->setProperty("trojita-imap-limit-parallel-fetch-tasks", 1);
+    initialMessages(2);
+    QModelIndex msg1 = msgListA.child(0, 0);
+    QCOMPARE(model->rowCount(msg1), 0);
+    cClient(t.mk("UID FETCH 1:2 (" FETCH_METADATA_ITEMS ")\r\n"));
+    cServer(helperCreateTrivialEnvelope(1, 1, QStringLiteral("a")) + helperCreateTrivialEnvelope(2, 2, QStringLiteral("b"))
+            + t.last("OK fetched\r\n"));
+    QPersistentModelIndex part1 = msgListA.child(0, 0).child(0, 0);
+    QPersistentModelIndex part2 = msgListA.child(1, 0).child(0, 0);
+    QVERIFY(part1.isValid());
+    QVERIFY(part2.isValid());
+
+    QCOMPARE(part1.data(Imap::Mailbox::RolePartData).toByteArray(), QByteArray());
+    cClient(t.mk("UID FETCH 1 (BODY.PEEK[1])\r\n"));
+    QCOMPARE(part2.data(Imap::Mailbox::RolePartData).toByteArray(), QByteArray());
+    // The second request has to wait for the first one to finish
+    cEmpty();
+    cServer("* 1 FETCH (UID 1 BODY[1] one)\r\n" + t.last("OK fetched\r\n"));
+    QCOMPARE(part1.data(Imap::Mailbox::RolePartData).toByteArray(), QByteArray("one"));
+    cClient(t.mk("UID FETCH 2 (BODY.PEEK[1])\r\n"));
+    cServer("* 2 FETCH (UID 2 BODY[1] two)\r\n" + t.last("OK fetched\r\n"));
+    QCOMPARE(part2.data(Imap::Mailbox::RolePartData).toByteArray(), QByteArray("two"));
+    cEmpty();
+    justKeepTask();
+}
+
 QTEST_GUILESS_MAIN( ImapModelSelectedMailboxUpdatesTest )
@@ -52,6 +52,11 @@ private slots:
     void testLogoutClosed();
     void testFetchMsgMetadataPerPartes();
     void testFetchMsgDuplicateBodystructure();
+    void testMessageViewport();
+    void testViewportReleasesStaleMessages();
+    void testPartFetchPriorities();
+    void testPartFetchPrioritiesPerPart();
+    void testInteractivePartFetchesAreBounded();
 
     void helperDataChangedUidNonZero(const QModelIndex &a, const QModelIndex &b);
 private:
@@ -622,6 +622,58 @@ void ImapModelObtainSynchronizedMailboxTest::testCacheNoChange()
     justKeepTask();
 }
 
+/** @short Messages which nobody has asked for are not instantiated when resyncing from cache */
+void ImapModelObtainSynchronizedMailboxTest::testCacheLazyMessages()
+{
+    Imap::Mailbox::SyncState sync;
+    sync.setExists(4);
+    sync.setUidValidity(666);
+    sync.setUidNext(15);
+    sync.setUnSeenCount(4);
+    sync.setRecent(0);
+    Imap::Uids uidMap;
+    uidMap << 6 << 9 << 10 << 12;
+    model->cache()->setMailboxSyncState(QStringLiteral("a"), sync);
+    model->cache()->setUidMapping(QStringLiteral("a"), uidMap);
+    model->cache()->setMsgFlags(QStringLiteral("a"), 6, QStringList() << QStringLiteral("x"));
+    model->cache()->setMsgFlags(QStringLiteral("a"), 9, QStringList() << QStringLiteral("y"));
+    model->cache()->setMsgFlags(QStringLiteral("a"), 10, QStringList() << QStringLiteral("z"));
+    model->cache()->setMsgFlags(QStringLiteral("a"), 12, QStringList() << QStringLiteral("w"));
+    QCOMPARE(model->rowCount(msgListA), 0);
+    cClient(t.mk("SELECT a\r\n"));
+    cServer("* 4 EXISTS\r\n"
+            "* OK [UIDVALIDITY 666] .\r\n"
+            "* OK [UIDNEXT 15] .\r\n");
+    cServer(t.last("OK selected\r\n"));
+    cClient(t.mk("FETCH 1:4 (FLAGS)\r\n"));
+    cServer("* 1 FETCH (FLAGS (x))\r\n"
+            "* 2 FETCH (FLAGS (y))\r\n"
+            "* 3 FETCH (FLAGS (changed))\r\n"
+            "* 4 FETCH (FLAGS (w))\r\n");
+    cServer(t.last("OK fetch\r\n"));
+    cEmpty();
+    QCOMPARE(model->rowCount(msgListA), 4);
+
+    auto list = dynamic_cast<Imap::Mailbox::TreeItemMsgList *>(Imap::Mailbox::Model::realTreeItem(msgListA));
+    QVERIFY(list);
+    // The first "interesting" message is reported to the GUI, and the third one has got new flags
+    QVERIFY(list->existingMessageAt(0));
+    QVERIFY(!list->existingMessageAt(1));
+    QVERIFY(list->existingMessageAt(2));
+    QVERIFY(!list->existingMessageAt(3));
+    QCOMPARE(list->uidAt(3), 12u);
+    QCOMPARE(list->flagsAt(3), QStringList() << QStringLiteral("w"));
+    QCOMPARE(model->cache()->msgFlags("a", 10), QStringList() << QStringLiteral("changed"));
+
+    // Asking for the message through the MVC API creates it on demand
+    QModelIndex msg = msgListA.child(3, 0);
+    QVERIFY(msg.isValid());
+    QVERIFY(list->existingMessageAt(3));
+    QCOMPARE(msg.data(Imap::Mailbox::RoleMessageUid).toUInt(), 12u);
+    QCOMPARE(msg.data(Imap::Mailbox::RoleMessageFlags).toStringList(), QStringList() << QStringLiteral("w"));
+    justKeepTask();
+}
+
 /** @short Test UIDVALIDITY changes since the last cached state */
 void ImapModelObtainSynchronizedMailboxTest::testCacheUidValidity()
 {
@@ -58,6 +58,7 @@ private slots:
     void testMisingUidNextLess();
     void testReloadReadsFromCache();
     void testCacheNoChange();
+    void testCacheLazyMessages();
     void testCacheUidValidity();
     void testCacheArrivals();
     void testCacheArrivalRaceDuringUid();
@@ -0,0 +1,162 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QBuffer>
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+#include "test_BinaryLog.h"
+#include "Common/BinaryLog.h"
+#include "Common/FileLogger.h"
+
+using namespace Common;
+
+/** @short Both the raw protocol data and the textual messages survive a trip through the binary log */
+void BinaryLogTest::testRoundTrip()
+{
+    QByteArray data;
+    QBuffer buf(&data);
+    buf.open(QIODevice::WriteOnly);
+    QVERIFY(writeBinaryLogHeader(&buf));
+
+    const QDateTime ts = QDateTime::fromMSecsSinceEpoch(1234567890123);
+    LogMessage raw(ts, LOG_IO_READ, QStringLiteral("conn"), QByteArray("* OK ready\r\n\0\xff", 14));
+    raw.truncatedBytes = 333;
+    LogMessage text(ts.addMSecs(10), LOG_TASKS, QStringLiteral("task"), QStringLiteral("příliš"), 0);
+    QVERIFY(writeBinaryLogRecord(&buf, 3, raw) > 0);
+    QVERIFY(writeBinaryLogRecord(&buf, 42, text) > 0);
+    buf.close();
+
+    buf.open(QIODevice::ReadOnly);
+    BinaryLogReader reader(&buf);
+    QVERIFY(reader.isValid());
+
+    uint connectionId;
+    LogMessage message;
+    QVERIFY(reader.readNext(connectionId, message));
+    QCOMPARE(connectionId, 3u);
+    QCOMPARE(message.timestamp, raw.timestamp);
+    QCOMPARE(message.kind, LOG_IO_READ);
+    QCOMPARE(message.source, raw.source);
+    QCOMPARE(message.rawMessage, raw.rawMessage);
+    QCOMPARE(message.truncatedBytes, 333u);
+
+    QVERIFY(reader.readNext(connectionId, message));
+    QCOMPARE(connectionId, 42u);
+    QCOMPARE(message.timestamp, text.timestamp);
+    QCOMPARE(message.kind, LOG_TASKS);
+    QCOMPARE(message.source, text.source);
+    QVERIFY(message.rawMessage.isNull());
+    QCOMPARE(message.text(), text.message);
+
+    QVERIFY(!reader.readNext(connectionId, message));
+    QVERIFY(!reader.isDamaged());
+}
+
+/** @short An incomplete record at the end of the file, as left behind by a crash, is detected */
+void BinaryLogTest::testTruncatedRecord()
+{
+    QByteArray data;
+    QBuffer buf(&data);
+    buf.open(QIODevice::WriteOnly);
+    QVERIFY(writeBinaryLogHeader(&buf));
+    const QDateTime ts = QDateTime::currentDateTime();
+    QVERIFY(writeBinaryLogRecord(&buf, 1, LogMessage(ts, LOG_IO_WRITTEN, QStringLiteral("a"), QByteArray("y0 NOOP\r\n"))) > 0);
+    QVERIFY(writeBinaryLogRecord(&buf, 1, LogMessage(ts, LOG_IO_READ, QStringLiteral("b"), QByteArray("y0 OK done\r\n"))) > 0);
+    buf.close();
+    data.chop(3);
+
+    buf.open(QIODevice::ReadOnly);
+    BinaryLogReader reader(&buf);
+    QVERIFY(reader.isValid());
+    uint connectionId;
+    LogMessage message;
+    QVERIFY(reader.readNext(connectionId, message));
+    QCOMPARE(message.rawMessage, QByteArray("y0 NOOP\r\n"));
+    QVERIFY(!reader.readNext(connectionId, message));
+    QVERIFY(reader.isDamaged());
+}
+
+void BinaryLogTest::testInvalidHeader()
+{
+    QByteArray data("12:34:56.789 1  <<< conn * OK\n");
+    QBuffer buf(&data);
+    buf.open(QIODevice::ReadOnly);
+    BinaryLogReader reader(&buf);
+    QVERIFY(!reader.isValid());
+    uint connectionId;
+    LogMessage message;
+    QVERIFY(!reader.readNext(connectionId, message));
+}
+
+/** @short The log gets rotated once it grows past the limit, and only the configured number of old files is kept */
+void BinaryLogTest::testRotation()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + QLatin1String("/log.bin");
+    const LogMessage message(QDateTime::currentDateTime(), LOG_IO_READ, QStringLiteral("conn"), QByteArray(100, 'x'));
+    {
+        FileLogger logger;
+        QSignalSpy failures(&logger, SIGNAL(binaryLoggingFailed(QString)));
+        logger.setLogRotation(1000, 2);
+        logger.setBinaryLogging(true, fileName);
+        for (int i = 0; i < 50; ++i) {
+            logger.log(1, message);
+        }
+        QVERIFY(failures.isEmpty());
+    }
+    QVERIFY(QFile(fileName).size() <= 1000 + 200);
+    QVERIFY(QFile::exists(fileName + QLatin1String(".1")));
+    QVERIFY(QFile::exists(fileName + QLatin1String(".2")));
+    QVERIFY(!QFile::exists(fileName + QLatin1String(".3")));
+
+    QFile f(fileName + QLatin1String(".1"));
+    QVERIFY(f.open(QIODevice::ReadOnly));
+    QVERIFY(f.size() >= 1000);
+    BinaryLogReader reader(&f);
+    QVERIFY(reader.isValid());
+    uint connectionId;
+    LogMessage read;
+    int records = 0;
+    while (reader.readNext(connectionId, read))
+        ++records;
+    QVERIFY(!reader.isDamaged());
+    QVERIFY(records > 1);
+}
+
+/** @short Failures are reported instead of being silently ignored */
+void BinaryLogTest::testOpenFailure()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    FileLogger logger;
+    QSignalSpy failures(&logger, SIGNAL(binaryLoggingFailed(QString)));
+    logger.setBinaryLogging(true, dir.path() + QLatin1String("/nonexistent/log.bin"));
+    QCOMPARE(failures.size(), 1);
+    // Nothing else happens
+    logger.log(1, LogMessage(QDateTime::currentDateTime(), LOG_IO_READ, QStringLiteral("conn"), QByteArray("foo")));
+    QCOMPARE(failures.size(), 1);
+}
+
+QTEST_GUILESS_MAIN( BinaryLogTest )
@@ -0,0 +1,127 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QTest>
+#include "test_CompletionIndex.h"
+#include "Plugins/CompletionIndex.h"
+
+using namespace Plugins;
+
+namespace {
+
+QStringList emailsOf(const NameEmailList &list)
+{
+    QStringList res;
+    Q_FOREACH (const NameEmail &item, list) {
+        res << item.email;
+    }
+    return res;
+}
+
+}
+
+void CompletionIndexTest::testMatching()
+{
+    QFETCH(QString, input);
+    QFETCH(QStringList, expected);
+
+    CompletionIndex index;
+    index.setContact(1, QStringLiteral("John Smith"), QStringList() << QStringLiteral("jsmith@example.org"));
+    index.setContact(2, QStringLiteral("Jane Doe-Roe"), QStringList() << QStringLiteral("jane.doe@corp.example.com")
+                     << QStringLiteral("jane@home.net"));
+    index.setContact(3, QStringLiteral("Karel Čapek"), QStringList() << QStringLiteral("robot_factory@rur.cz"));
+
+    QCOMPARE(emailsOf(index.complete(input, QStringList())), expected);
+}
+
+void CompletionIndexTest::testMatching_data()
+{
+    QTest::addColumn<QString>("input");
+    QTest::addColumn<QStringList>("expected");
+
+    QTest::newRow("empty") << QString() << QStringList();
+    QTest::newRow("first-name") << QStringLiteral("jo") << (QStringList() << QStringLiteral("jsmith@example.org"));
+    QTest::newRow("surname-case") << QStringLiteral("SMI") << (QStringList() << QStringLiteral("jsmith@example.org"));
+    QTest::newRow("whole-name") << QStringLiteral("john sm") << (QStringList() << QStringLiteral("jsmith@example.org"));
+    QTest::newRow("mid-word") << QStringLiteral("mith") << QStringList();
+    QTest::newRow("dashed-name") << QStringLiteral("roe")
+        << (QStringList() << QStringLiteral("jane.doe@corp.example.com") << QStringLiteral("jane@home.net"));
+    QTest::newRow("local-part") << QStringLiteral("doe@")
+        << (QStringList() << QStringLiteral("jane.doe@corp.example.com"));
+    QTest::newRow("domain") << QStringLiteral("home")
+        << (QStringList() << QStringLiteral("jane@home.net"));
+    QTest::newRow("underscore") << QStringLiteral("fact")
+        << (QStringList() << QStringLiteral("robot_factory@rur.cz"));
+    QTest::newRow("no-tld") << QStringLiteral("net") << QStringList();
+    QTest::newRow("diacritics") << QStringLiteral("čap") << (QStringList() << QStringLiteral("robot_factory@rur.cz"));
+    QTest::newRow("both-jane") << QStringLiteral("jane")
+        << (QStringList() << QStringLiteral("jane.doe@corp.example.com") << QStringLiteral("jane@home.net"));
+}
+
+/** @short Contacts can be replaced and removed without rebuilding the whole index */
+void CompletionIndexTest::testUpdates()
+{
+    CompletionIndex index;
+    for (int i = 0; i < 200; ++i) {
+        index.setContact(i, QStringLiteral("Contact %1").arg(i), QStringList() << QStringLiteral("c%1@example.org").arg(i));
+    }
+    QCOMPARE(index.complete(QStringLiteral("contact"), QStringList()).size(), 200);
+
+    // Renaming a contact over and over must not leave any stale entries behind
+    for (int round = 0; round < 300; ++round) {
+        index.setContact(7, QStringLiteral("Renamed %1").arg(round), QStringList() << QStringLiteral("seven@example.org"));
+    }
+    QCOMPARE(index.complete(QStringLiteral("contact"), QStringList()).size(), 199);
+    QCOMPARE(emailsOf(index.complete(QStringLiteral("renamed"), QStringList())), QStringList() << QStringLiteral("seven@example.org"));
+    QCOMPARE(index.namesForAddress(QStringLiteral("SEVEN@example.org")), QStringList() << QStringLiteral("Renamed 299"));
+    QVERIFY(index.namesForAddress(QStringLiteral("c7@example.org")).isEmpty());
+
+    index.removeContact(7);
+    QVERIFY(index.complete(QStringLiteral("renamed"), QStringList()).isEmpty());
+    QCOMPARE(index.complete(QStringLiteral("contact 1"), QStringList(), 5).size(), 5);
+    QCOMPARE(index.complete(QStringLiteral("c1@"), QStringList() << QStringLiteral("c1@example.org")).size(), 0);
+}
+
+void CompletionIndexTest::testRanking()
+{
+    CompletionIndex index;
+    index.setContact(1, QStringLiteral("Alice"), QStringList() << QStringLiteral("alice@example.org"));
+    index.setContact(2, QStringLiteral("Alfred"), QStringList() << QStringLiteral("alfred@example.org"));
+    index.setContact(3, QStringLiteral("Albert"), QStringList() << QStringLiteral("albert@example.org"));
+
+    QCOMPARE(emailsOf(index.complete(QStringLiteral("al"), QStringList())), QStringList() << QStringLiteral("albert@example.org")
+             << QStringLiteral("alfred@example.org") << QStringLiteral("alice@example.org"));
+
+    index.recordUsage(QStringLiteral("Alice@example.org"), 2);
+    index.recordUsage(QStringLiteral("alfred@example.org"));
+    QCOMPARE(emailsOf(index.complete(QStringLiteral("al"), QStringList())), QStringList() << QStringLiteral("alice@example.org")
+             << QStringLiteral("alfred@example.org") << QStringLiteral("albert@example.org"));
+
+    // Old usage fades away
+    index.recordUsage(QStringLiteral("albert@example.org"), 9997);
+    index.recordUsage(QStringLiteral("nobody@example.org"), 100);
+    QCOMPARE(index.usageCounts().value(QStringLiteral("alice@example.org")), 1);
+    QVERIFY(!index.usageCounts().contains(QStringLiteral("alfred@example.org")));
+    QCOMPARE(emailsOf(index.complete(QStringLiteral("al"), QStringList(), 1)), QStringList() << QStringLiteral("albert@example.org"));
+}
+
+QTEST_GUILESS_MAIN( CompletionIndexTest )
@@ -0,0 +1,124 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTest>
+#include "test_PerformanceTrace.h"
+#include "Common/PerformanceTrace.h"
+
+using namespace Common;
+
+/** @short Spans, cache lookups and traffic are aggregated per their key */
+void PerformanceTraceTest::testStatistics()
+{
+    PerformanceTrace trace;
+    qint64 start = trace.timestamp();
+    QTest::qWait(5);
+    trace.recordSpan("imap", QStringLiteral("UID FETCH"), QStringLiteral("y1"), 1, start);
+    trace.recordSpan("imap", QStringLiteral("UID FETCH"), QStringLiteral("y2"), 1, trace.timestamp());
+    trace.recordSpan("task", QStringLiteral("Imap::Mailbox::IdTask"), QString(), 1, trace.timestamp());
+
+    auto spans = trace.spanStatistics();
+    QCOMPARE(spans.size(), 2);
+    // the slowest activity comes first
+    QCOMPARE(spans[0].category, QByteArray("imap"));
+    QCOMPARE(spans[0].name, QStringLiteral("UID FETCH"));
+    QCOMPARE(spans[0].count, quint64(2));
+    QVERIFY(spans[0].total >= 5000);
+    QVERIFY(spans[0].max >= 5000);
+    QVERIFY(spans[0].max <= spans[0].total);
+    QCOMPARE(spans[1].category, QByteArray("task"));
+    QCOMPARE(spans[1].count, quint64(1));
+
+    trace.recordCacheLookup("msgFlags", true);
+    trace.recordCacheLookup("msgFlags", true);
+    trace.recordCacheLookup("msgFlags", false);
+    trace.recordCacheLookup("uidMapping", false);
+    auto cache = trace.cacheStatistics();
+    QCOMPARE(cache.size(), 2);
+    QCOMPARE(cache["msgFlags"].hits, quint64(2));
+    QCOMPARE(cache["msgFlags"].misses, quint64(1));
+    QCOMPARE(cache["uidMapping"].hits, quint64(0));
+    QCOMPARE(cache["uidMapping"].misses, quint64(1));
+
+    trace.recordTraffic(1, 100, 0);
+    trace.recordTraffic(1, 0, 20);
+    trace.recordTraffic(2, 7, 3);
+    auto traffic = trace.trafficStatistics();
+    QCOMPARE(traffic.size(), 2);
+    QCOMPARE(traffic[1].bytesIn, quint64(100));
+    QCOMPARE(traffic[1].bytesOut, quint64(20));
+    QCOMPARE(traffic[2].bytesIn, quint64(7));
+    QCOMPARE(traffic[2].bytesOut, quint64(3));
+
+    trace.clear();
+    QVERIFY(trace.spanStatistics().isEmpty());
+    QVERIFY(trace.cacheStatistics().isEmpty());
+    QVERIFY(trace.trafficStatistics().isEmpty());
+}
+
+/** @short The export is a valid trace event document which only keeps the most recent events */
+void PerformanceTraceTest::testChromeTrace()
+{
+    PerformanceTrace trace(2);
+    trace.recordSpan("imap", QStringLiteral("NOOP"), QStringLiteral("y0"), 3, trace.timestamp());
+    trace.recordSpan("imap", QStringLiteral("NOOP"), QStringLiteral("y1"), 3, trace.timestamp());
+    trace.recordSpan("task", QStringLiteral("Imap::Mailbox::NoopTask"), QString(), 3, trace.timestamp());
+    trace.recordCacheLookup("messagePart", false);
+    trace.recordTraffic(3, 10, 20);
+
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(trace.toChromeTrace(), &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QVERIFY(doc.isObject());
+    QCOMPARE(doc.object()[QStringLiteral("otherData")].toObject()[QStringLiteral("droppedEvents")].toInt(), 1);
+
+    QStringList complete, counters, threads;
+    Q_FOREACH(const QJsonValue &value, doc.object()[QStringLiteral("traceEvents")].toArray()) {
+        QJsonObject event = value.toObject();
+        const QString ph = event[QStringLiteral("ph")].toString();
+        if (ph == QLatin1String("X")) {
+            QCOMPARE(event[QStringLiteral("tid")].toInt(), 3);
+            QVERIFY(event[QStringLiteral("dur")].toDouble() >= 0);
+            complete << event[QStringLiteral("name")].toString() + QLatin1Char(' ')
+                        + event[QStringLiteral("args")].toObject()[QStringLiteral("detail")].toString();
+        } else if (ph == QLatin1String("C")) {
+            counters << event[QStringLiteral("name")].toString();
+        } else if (ph == QLatin1String("M")) {
+            threads << event[QStringLiteral("args")].toObject()[QStringLiteral("name")].toString();
+        } else {
+            QFAIL(qPrintable(QStringLiteral("Unexpected event type %1").arg(ph)));
+        }
+    }
+    QCOMPARE(complete, QStringList() << QStringLiteral("NOOP y1") << QStringLiteral("Imap::Mailbox::NoopTask "));
+    counters.sort();
+    QCOMPARE(counters, QStringList() << QStringLiteral("Cache messagePart") << QStringLiteral("Traffic of connection 3"));
+    threads.sort();
+    QCOMPARE(threads, QStringList() << QStringLiteral("Connection 3") << QStringLiteral("Model"));
+
+    // the aggregated statistics are not subject to the limit on the number of events
+    QCOMPARE(trace.spanStatistics().size(), 2);
+}
+
+QTEST_GUILESS_MAIN( PerformanceTraceTest )
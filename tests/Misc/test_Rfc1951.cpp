@@ -0,0 +1,231 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QTest>
+#include "test_Rfc1951.h"
+#include "Streams/3rdparty/rfc1951.h"
+
+FakeWireDevice::FakeWireDevice(): m_offset(0)
+{
+    open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+}
+
+bool FakeWireDevice::isSequential() const
+{
+    return true;
+}
+
+qint64 FakeWireDevice::bytesAvailable() const
+{
+    return m_pending.size() - m_offset + QIODevice::bytesAvailable();
+}
+
+bool FakeWireDevice::canReadLine() const
+{
+    return m_pending.indexOf('\n', m_offset) != -1 || QIODevice::canReadLine();
+}
+
+/** @short Make the data available for reading and let everybody know about them */
+void FakeWireDevice::feed(const QByteArray &data)
+{
+    if (m_offset == m_pending.size()) {
+        m_pending = data;
+        m_offset = 0;
+    } else {
+        m_pending.append(data);
+    }
+    emit readyRead();
+}
+
+qint64 FakeWireDevice::readData(char *data, qint64 maxSize)
+{
+    qint64 n = qMin<qint64>(maxSize, m_pending.size() - m_offset);
+    memcpy(data, m_pending.constData() + m_offset, n);
+    m_offset += n;
+    return n;
+}
+
+qint64 FakeWireDevice::readLineData(char *data, qint64 maxSize)
+{
+    int eol = m_pending.indexOf('\n', m_offset);
+    qint64 lineLength = eol == -1 ? m_pending.size() - m_offset : eol - m_offset + 1;
+    return readData(data, qMin(maxSize, lineLength));
+}
+
+qint64 FakeWireDevice::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    return maxSize;
+}
+
+FakeWireSocket::FakeWireSocket(FakeWireDevice *device): IODeviceSocket(device)
+{
+}
+
+bool FakeWireSocket::isDead()
+{
+    return false;
+}
+
+void FakeWireSocket::close()
+{
+}
+
+void FakeWireSocket::handleStateChanged()
+{
+}
+
+void FakeWireSocket::delayedStart()
+{
+}
+
+/** @short Generate a somewhat realistic stream of untagged FETCH responses */
+static QByteArray fetchResponses(const int count)
+{
+    QByteArray res;
+    for (int i = 1; i <= count; ++i) {
+        res += "* " + QByteArray::number(i) + " FETCH (UID " + QByteArray::number(i * 3 + 1000)
+                + " FLAGS (\\Seen $Label" + QByteArray::number(i % 5) + ") RFC822.SIZE " + QByteArray::number((i * 7919) % 100000)
+                + " ENVELOPE (\"Mon, 1 Feb 2016 10:" + QByteArray::number(i % 60) + ":00 +0100\" \"Message number "
+                + QByteArray::number(i) + "\" ((\"Sender\" NIL \"sender" + QByteArray::number(i % 17)
+                + "\" \"example.org\")) NIL NIL ((NIL NIL \"list\" \"lists.example.org\")) NIL NIL NIL \"<"
+                + QByteArray::number(i) + "@example.org>\"))\r\n";
+    }
+    return res;
+}
+
+static QByteArray deflate(const QByteArray &data)
+{
+    QByteArray res;
+    QBuffer buf(&res);
+    buf.open(QIODevice::WriteOnly);
+    Streams::Rfc1951Compressor compressor;
+    QByteArray copy = data;
+    compressor.write(&buf, &copy);
+    return res;
+}
+
+/** @short Check that lines are returned intact no matter how they are split among the internal chunks */
+void Rfc1951Test::testReadLine()
+{
+    QFETCH(int, chunkSize);
+    QFETCH(int, sliceSize);
+
+    QByteArray plain = fetchResponses(200);
+    QByteArray compressed = deflate(plain);
+
+    FakeWireDevice wire;
+    Streams::Rfc1951Decompressor decompressor(chunkSize);
+    QByteArray received;
+    for (int i = 0; i < compressed.size(); i += sliceSize) {
+        wire.feed(compressed.mid(i, sliceSize));
+        QVERIFY(decompressor.consume(&wire));
+        while (decompressor.canReadLine()) {
+            QByteArray line = decompressor.readLine();
+            QVERIFY(line.endsWith('\n'));
+            QCOMPARE(line.count('\n'), 1);
+            received += line;
+        }
+    }
+    QVERIFY(!decompressor.canReadLine());
+    QCOMPARE(decompressor.readLine(), QByteArray());
+    QCOMPARE(received, plain);
+}
+
+void Rfc1951Test::testReadLine_data()
+{
+    QTest::addColumn<int>("chunkSize");
+    QTest::addColumn<int>("sliceSize");
+
+    QTest::newRow("default") << 8192 << 16384;
+    QTest::newRow("tiny-chunks") << 7 << 16384;
+    QTest::newRow("tiny-slices") << 8192 << 3;
+    QTest::newRow("tiny-both") << 13 << 5;
+}
+
+/** @short Literals are read through read() while the rest of the response is line-based */
+void Rfc1951Test::testMixedReads()
+{
+    QByteArray literal;
+    for (int i = 0; i < 100; ++i) {
+        literal += "line " + QByteArray::number(i) + "\r\n";
+    }
+    QByteArray plain = "* 1 FETCH (BODY[] {" + QByteArray::number(literal.size()) + "}\r\n" + literal + ")\r\n* OK done\r\n";
+
+    FakeWireDevice wire;
+    Streams::Rfc1951Decompressor decompressor(16);
+    wire.feed(deflate(plain));
+    QVERIFY(decompressor.consume(&wire));
+
+    QVERIFY(decompressor.canReadLine());
+    QCOMPARE(decompressor.readLine(), QByteArray("* 1 FETCH (BODY[] {" + QByteArray::number(literal.size()) + "}\r\n"));
+    QByteArray receivedLiteral = decompressor.read(10);
+    QCOMPARE(receivedLiteral.size(), 10);
+    receivedLiteral += decompressor.read(literal.size() - 10);
+    QCOMPARE(receivedLiteral, literal);
+    QVERIFY(decompressor.canReadLine());
+    QCOMPARE(decompressor.readLine(), QByteArray(")\r\n"));
+    QCOMPARE(decompressor.readLine(), QByteArray("* OK done\r\n"));
+    QVERIFY(!decompressor.canReadLine());
+    QCOMPARE(decompressor.read(666), QByteArray());
+}
+
+/** @short Measure how fast can the socket deliver lines to the parser, with and without COMPRESS=DEFLATE */
+void Rfc1951Test::benchmarkIngest()
+{
+    QFETCH(bool, compress);
+
+    const QByteArray plain = fetchResponses(20000);
+    const QByteArray wireData = compress ? deflate(plain) : plain;
+    // That's what a typical read from a TCP socket returns
+    const int sliceSize = 16384;
+
+    QBENCHMARK {
+        FakeWireDevice *wire = new FakeWireDevice();
+        qint64 received = 0;
+        {
+            FakeWireSocket sock(wire);
+            if (compress) {
+                sock.startDeflate();
+            }
+            for (int i = 0; i < wireData.size(); i += sliceSize) {
+                wire->feed(wireData.mid(i, sliceSize));
+                while (sock.canReadLine()) {
+                    received += sock.readLine().size();
+                }
+            }
+        }
+        QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+        QCOMPARE(received, static_cast<qint64>(plain.size()));
+    }
+}
+
+void Rfc1951Test::benchmarkIngest_data()
+{
+    QTest::addColumn<bool>("compress");
+    QTest::newRow("plain") << false;
+    QTest::newRow("deflate") << true;
+}
+
+QTEST_GUILESS_MAIN(Rfc1951Test)
@@ -25,6 +25,8 @@
 #include "test_Rfc5322.h"
 #include "Common/MetaTypes.h"
 #include "Imap/Model/ItemRoles.h"
+#include "Imap/Model/Utils.h"
+#include "Imap/Parser/LowLevelParser.h"
 #include "Imap/Parser/Rfc5322HeaderParser.h"
 
 namespace QTest {
@@ -166,5 +168,52 @@ void Rfc5322Test::testHeaders_data()
         << true << refs << lp << false << mi << irt;
 }
 
+void Rfc5322Test::testListId()
+{
+    QFETCH(QByteArray, input);
+    QFETCH(QByteArray, listId);
+    QCOMPARE(Imap::LowLevelParser::extractListId(input), listId);
+}
+
+void Rfc5322Test::testListId_data()
+{
+    QTest::addColumn<QByteArray>("input");
+    QTest::addColumn<QByteArray>("listId");
+
+    QTest::newRow("empty") << QByteArray() << QByteArray();
+    QTest::newRow("no-list-id") << QByteArray("List-Post: <mailto:a@b>\r\nList-Idx: <x.y>\r\n\r\n") << QByteArray();
+    QTest::newRow("bare") << QByteArray("List-Id: <trojita.kde.org>\r\n") << QByteArray("trojita.kde.org");
+    QTest::newRow("phrase-and-case")
+        << QByteArray("References: <a@b>\r\nLIST-ID : \"Trojita <devel>\" <trojita.kde.org>\r\n\r\n")
+        << QByteArray("trojita.kde.org");
+    QTest::newRow("folded")
+        << QByteArray("List-Id: Some list\r\n\t<some.list.example.org>\r\nList-Post: NO\r\n")
+        << QByteArray("some.list.example.org");
+    QTest::newRow("no-brackets") << QByteArray("List-Id: trojita.kde.org\r\n") << QByteArray();
+}
+
+void Rfc5322Test::testBaseSubject()
+{
+    QFETCH(QString, subject);
+    QFETCH(QString, base);
+    QCOMPARE(Imap::baseSubject(subject), base);
+}
+
+void Rfc5322Test::testBaseSubject_data()
+{
+    QTest::addColumn<QString>("subject");
+    QTest::addColumn<QString>("base");
+
+    QTest::newRow("empty") << QString() << QString();
+    QTest::newRow("plain") << QStringLiteral("Hello  world") << QStringLiteral("Hello world");
+    QTest::newRow("re-fwd") << QStringLiteral("Re: Fwd: hello") << QStringLiteral("hello");
+    QTest::newRow("list-tags") << QStringLiteral("[list] Re: [list] hello") << QStringLiteral("hello");
+    QTest::newRow("trailing-fwd") << QStringLiteral("RE:   hello   (fwd)") << QStringLiteral("hello");
+    QTest::newRow("fwd-wrapper") << QStringLiteral("Re: [Fwd: [list] Re: hi] (fwd)") << QStringLiteral("hi");
+    QTest::newRow("counted-re") << QStringLiteral("Re[2]: x") << QStringLiteral("x");
+    QTest::newRow("just-a-tag") << QStringLiteral("[list]") << QStringLiteral("[list]");
+    QTest::newRow("reply-word") << QStringLiteral("Reply to all") << QStringLiteral("Reply to all");
+}
+
 
 QTEST_GUILESS_MAIN(Rfc5322Test)
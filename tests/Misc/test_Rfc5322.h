@@ -34,6 +34,10 @@ private Q_SLOTS:
     void initTestCase();
     void testHeaders();
     void testHeaders_data();
+    void testListId();
+    void testListId_data();
+    void testBaseSubject();
+    void testBaseSubject_data();
 };
 
 #endif
@@ -20,8 +20,14 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <QFile>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
 #include <QTest>
 #include "test_SqlCache.h"
+#include "Imap/Model/CombinedCache.h"
+#include "Imap/Model/Correspondents.h"
 #include "Imap/Model/SQLCache.h"
 
 Q_DECLARE_METATYPE(QList<Imap::Mailbox::MailboxMetadata>)
@@ -88,4 +94,269 @@ void TestSqlCache::testMailboxOperation()
     QVERIFY(errorLog.empty());
 }
 
+/** @short Check the bookkeeping of the sizes and of the access times of the message parts */
+void TestSqlCache::testPartUsage()
+{
+    using namespace Imap::Mailbox;
+
+    const QString mailbox = QStringLiteral("parts");
+    QCOMPARE(cache->partsSize(), quint64(0));
+    CHECK_CACHE_ERRORS;
+
+    cache->setMsgPart(mailbox, 1, "1", QByteArray(1000, 'x'));
+    cache->setMsgPart(mailbox, 2, "1", QByteArray(1000, 'y'));
+    cache->setMsgPart(mailbox, 3, "1", QByteArray(1000, 'z'));
+    const QByteArray externalHash = SQLCache::contentHash("external");
+    cache->setExternalMsgPart(mailbox, 4, "2", externalHash, 666);
+    CHECK_CACHE_ERRORS;
+
+    auto usage = cache->usage();
+    CHECK_CACHE_ERRORS;
+    QVERIFY(usage.parts > 0);
+    QCOMPARE(usage.diskParts, quint64(666));
+    QCOMPARE(cache->partsSize(), usage.parts + usage.diskParts);
+    QVERIFY(usage.perMailbox.contains(mailbox));
+    QCOMPARE(usage.perMailbox[mailbox], usage.parts + usage.diskParts);
+
+    // Accessing a part makes it more valuable than the one which nobody looked at
+    QCOMPARE(cache->messagePart(mailbox, 1, "1"), QByteArray(1000, 'x'));
+    QCOMPARE(cache->messagePart(mailbox, 3, "1"), QByteArray(1000, 'z'));
+    cache->noteBlobAccessed(externalHash);
+    CHECK_CACHE_ERRORS;
+    auto victims = cache->leastRecentlyUsedBlobs(10);
+    CHECK_CACHE_ERRORS;
+    QCOMPARE(victims.size(), 4);
+    QCOMPARE(victims[0].hash, SQLCache::contentHash(QByteArray(1000, 'y')));
+    QCOMPARE(victims[0].external, false);
+
+    // Removing the data shall also remove the bookkeeping
+    cache->forgetMessagePart(mailbox, 2, "1");
+    cache->clearMessage(mailbox, 4);
+    CHECK_CACHE_ERRORS;
+    QCOMPARE(cache->takeOrphanedExternalBlobs(), QVector<QByteArray>() << externalHash);
+    QCOMPARE(cache->leastRecentlyUsedBlobs(10).size(), 2);
+    cache->evictBlob(SQLCache::contentHash(QByteArray(1000, 'x')));
+    CHECK_CACHE_ERRORS;
+    QCOMPARE(cache->messagePart(mailbox, 1, "1"), QByteArray());
+    cache->clearAllMessages(mailbox);
+    CHECK_CACHE_ERRORS;
+    QCOMPARE(cache->partsSize(), quint64(0));
+    CHECK_CACHE_ERRORS;
+
+    QVERIFY(errorLog.empty());
+}
+
+/** @short Identical parts are stored just once, and copies of messages share their data */
+void TestSqlCache::testPartDeduplication()
+{
+    using namespace Imap::Mailbox;
+
+    const QByteArray data(10000, 'a');
+    cache->setMsgPart(QStringLiteral("a"), 1, "2", data);
+    cache->setMsgPart(QStringLiteral("b"), 10, "1", data);
+    CHECK_CACHE_ERRORS;
+    QCOMPARE(cache->leastRecentlyUsedBlobs(10).size(), 1);
+    const quint64 oneCopy = cache->partsSize();
+
+    cache->copyMessageParts(QStringLiteral("a"), 1, QStringLiteral("c"), 666);
+    CHECK_CACHE_ERRORS;
+    QCOMPARE(cache->messagePart(QStringLiteral("c"), 666, "2"), data);
+    QCOMPARE(cache->partsSize(), oneCopy);
+
+    // The data shall survive for as long as anybody refers to them
+    cache->clearAllMessages(QStringLiteral("a"));
+    cache->forgetMessagePart(QStringLiteral("b"), 10, "1");
+    CHECK_CACHE_ERRORS;
+    QCOMPARE(cache->messagePart(QStringLiteral("c"), 666, "2"), data);
+
+    // Overwriting a part with different data releases the old ones
+    cache->setMsgPart(QStringLiteral("c"), 666, "2", QByteArray("foo"));
+    CHECK_CACHE_ERRORS;
+    QCOMPARE(cache->messagePart(QStringLiteral("c"), 666, "2"), QByteArray("foo"));
+    QCOMPARE(cache->leastRecentlyUsedBlobs(10).size(), 1);
+    cache->clearMessage(QStringLiteral("c"), 666);
+    CHECK_CACHE_ERRORS;
+    QCOMPARE(cache->partsSize(), quint64(0));
+
+    QVERIFY(errorLog.empty());
+}
+
+/** @short Message parts stored by the v7 schema survive the upgrade and get deduplicated */
+void TestSqlCache::testUpgradeFromV7()
+{
+    using namespace Imap::Mailbox;
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + QLatin1String("/cache.sqlite");
+    {
+        SQLCache sqlCache;
+        QVERIFY(sqlCache.open(QStringLiteral("upgrade-1"), fileName));
+    }
+    {
+        // Turn the part storage back into what the v7 used to have
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), QStringLiteral("upgrade-raw"));
+        db.setDatabaseName(fileName);
+        QVERIFY(db.open());
+        QSqlQuery q(QString(), db);
+        QVERIFY(q.exec(QStringLiteral("DROP TABLE parts")));
+        QVERIFY(q.exec(QStringLiteral("DROP TABLE part_blobs")));
+        QVERIFY(q.exec(QStringLiteral("CREATE TABLE parts (mailbox STRING NOT NULL, uid INT NOT NULL, part_id BINARY, "
+                                      "data BINARY, PRIMARY KEY (mailbox, uid, part_id))")));
+        QVERIFY(q.prepare(QStringLiteral("INSERT INTO parts (mailbox, uid, part_id, data) VALUES (?, ?, ?, ?)")));
+        q.bindValue(0, QStringLiteral("a"));
+        q.bindValue(1, 1);
+        q.bindValue(2, QByteArray("1"));
+        q.bindValue(3, qCompress(QByteArray(1000, 'x')));
+        QVERIFY(q.exec());
+        q.bindValue(0, QStringLiteral("b"));
+        q.bindValue(1, 2);
+        q.bindValue(2, QByteArray("2"));
+        q.bindValue(3, qCompress(QByteArray(1000, 'x')));
+        QVERIFY(q.exec());
+        q.bindValue(0, QStringLiteral("b"));
+        q.bindValue(1, 3);
+        q.bindValue(2, QByteArray("1"));
+        q.bindValue(3, qCompress(QByteArray("foo")));
+        QVERIFY(q.exec());
+        QVERIFY(q.exec(QStringLiteral("UPDATE trojita SET version = 7")));
+        q.finish();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(QStringLiteral("upgrade-raw"));
+
+    SQLCache sqlCache;
+    std::vector<QString> errors;
+    sqlCache.setErrorHandler([&errors](const QString &e) { errors.push_back(e); });
+    QVERIFY(sqlCache.open(QStringLiteral("upgrade-2"), fileName));
+    QVERIFY(errors.empty());
+    QVERIFY(sqlCache.partStorageWasUpgraded());
+    QCOMPARE(sqlCache.messagePart(QStringLiteral("a"), 1, "1"), QByteArray(1000, 'x'));
+    QCOMPARE(sqlCache.messagePart(QStringLiteral("b"), 2, "2"), QByteArray(1000, 'x'));
+    QCOMPARE(sqlCache.messagePart(QStringLiteral("b"), 3, "1"), QByteArray("foo"));
+    QCOMPARE(sqlCache.leastRecentlyUsedBlobs(10).size(), 2);
+
+    // The reference counts were set up properly
+    sqlCache.clearAllMessages(QStringLiteral("a"));
+    QCOMPARE(sqlCache.messagePart(QStringLiteral("b"), 2, "2"), QByteArray(1000, 'x'));
+    sqlCache.clearAllMessages(QStringLiteral("b"));
+    QCOMPARE(sqlCache.partsSize(), quint64(0));
+    QVERIFY(errors.empty());
+}
+
+/** @short The addresses from the cached envelopes are offered for completion */
+void TestSqlCache::testCorrespondents()
+{
+    using namespace Imap::Mailbox;
+    using Imap::Message::MailAddress;
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + QLatin1String("/cache.sqlite");
+    const QDateTime now = QDateTime::currentDateTime();
+    const MailAddress john(QStringLiteral("John Smith"), QString(), QStringLiteral("john"), QStringLiteral("example.org"));
+    const MailAddress jane(QStringLiteral("Jane"), QString(), QStringLiteral("jane"), QStringLiteral("example.org"));
+    const MailAddress joe(QString(), QString(), QStringLiteral("joe"), QStringLiteral("example.org"));
+    {
+        SQLCache sqlCache;
+        QVERIFY(sqlCache.open(QStringLiteral("correspondents"), fileName));
+        sqlCache.setMessageMetadata(QStringLiteral("INBOX"), 1, AbstractCache::MessageDataBundle(
+            1, Imap::Message::Envelope(now, QStringLiteral("hi"), QList<MailAddress>() << john, QList<MailAddress>(),
+                                       QList<MailAddress>(), QList<MailAddress>() << jane, QList<MailAddress>() << joe,
+                                       QList<MailAddress>(), QList<QByteArray>(), QByteArrayLiteral("<1@example.org>")),
+            now, 100, QByteArray(), QList<QByteArray>(), QList<QUrl>(), false));
+        // The same message in another mailbox shall not count twice
+        sqlCache.setMessageMetadata(QStringLiteral("Archive"), 5, AbstractCache::MessageDataBundle(
+            5, Imap::Message::Envelope(now, QStringLiteral("hi"), QList<MailAddress>() << john, QList<MailAddress>(),
+                                       QList<MailAddress>(), QList<MailAddress>() << jane, QList<MailAddress>() << joe,
+                                       QList<MailAddress>(), QList<QByteArray>(), QByteArrayLiteral("<1@example.org>")),
+            now, 100, QByteArray(), QList<QByteArray>(), QList<QUrl>(), false));
+        sqlCache.setMessageMetadata(QStringLiteral("INBOX"), 2, AbstractCache::MessageDataBundle(
+            2, Imap::Message::Envelope(now, QStringLiteral("re: hi"), QList<MailAddress>() << jane, QList<MailAddress>(),
+                                       QList<MailAddress>(), QList<MailAddress>() << john, QList<MailAddress>(),
+                                       QList<MailAddress>(), QList<QByteArray>(), QByteArrayLiteral("<2@example.org>")),
+            now, 100, QByteArray(), QList<QByteArray>(), QList<QUrl>(), false));
+    }
+
+    CorrespondentsAddressbook addressbook(nullptr, fileName);
+    QTRY_COMPARE(addressbook.complete(QStringLiteral("j"), QStringList()).size(), 3);
+    // Joe only appeared once, so he goes last
+    QCOMPARE(addressbook.complete(QStringLiteral("j"), QStringList()).last().email, QStringLiteral("joe@example.org"));
+    QCOMPARE(addressbook.complete(QStringLiteral("smi"), QStringList()).size(), 1);
+    QCOMPARE(addressbook.prettyNamesForAddress(QStringLiteral("jane@example.org")), QStringList() << QStringLiteral("Jane"));
+
+    addressbook.recordSentMail(QStringList() << QStringLiteral("joe@example.org") << QStringLiteral("Joe@example.org"));
+    QCOMPARE(addressbook.complete(QStringLiteral("j"), QStringList()).first().email, QStringLiteral("joe@example.org"));
+}
+
+/** @short Data used during one session are restored from the snapshot, which is only used once */
+void TestSqlCache::testStartupSnapshot()
+{
+    using namespace Imap::Mailbox;
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString inbox = QStringLiteral("INBOX");
+    const QString snapshotFile = dir.path() + QLatin1String("/startup.snapshot");
+
+    QList<MailboxMetadata> toplevel;
+    toplevel << MailboxMetadata(inbox, QStringLiteral("."), QStringList());
+    toplevel << MailboxMetadata(QStringLiteral("a"), QStringLiteral("."), QStringList() << QStringLiteral("\\HASCHILDREN"));
+    SyncState syncState;
+    syncState.setExists(3);
+    syncState.setRecent(0);
+    syncState.setUnSeenCount(1);
+    syncState.setUidNext(10);
+    syncState.setUidValidity(666);
+    const Imap::Uids uids = Imap::Uids() << 4 << 5 << 9;
+    const QDateTime now = QDateTime::currentDateTime();
+    const AbstractCache::MessageDataBundle metadata(
+            5, Imap::Message::Envelope(now, QStringLiteral("subject"), QList<Imap::Message::MailAddress>(),
+                                       QList<Imap::Message::MailAddress>(), QList<Imap::Message::MailAddress>(),
+                                       QList<Imap::Message::MailAddress>(), QList<Imap::Message::MailAddress>(),
+                                       QList<Imap::Message::MailAddress>(), QList<QByteArray>(), QByteArrayLiteral("<5@example.org>")),
+            now, 100, QByteArray(), QList<QByteArray>(), QList<QUrl>(), false);
+
+    {
+        CombinedCache cache(QStringLiteral("snapshot-1"), dir.path());
+        QVERIFY(cache.open());
+        QVERIFY(!cache.childMailboxesFresh(QString()));
+        cache.setChildMailboxes(QString(), toplevel);
+        cache.setMailboxSyncState(inbox, syncState);
+        QCOMPARE(cache.uidMapping(inbox), Imap::Uids());
+        cache.setUidMapping(inbox, uids);
+        cache.setMessageMetadata(inbox, 5, metadata);
+        cache.setMsgFlags(inbox, 5, QStringList() << QStringLiteral("\\Seen"));
+    }
+    QVERIFY(QFile::exists(snapshotFile));
+
+    {
+        CombinedCache cache(QStringLiteral("snapshot-2"), dir.path());
+        QVERIFY(cache.open());
+        // The snapshot is consumed right away, so that a crash cannot leave outdated data behind
+        QVERIFY(!QFile::exists(snapshotFile));
+        QVERIFY(cache.childMailboxesFresh(QString()));
+        QVERIFY(!cache.childMailboxesFresh(QStringLiteral("a")));
+        QCOMPARE(cache.childMailboxes(QString()), toplevel);
+        QVERIFY(cache.mailboxSyncState(inbox).completelyEqualTo(syncState));
+        QCOMPARE(cache.uidMapping(inbox), uids);
+        QCOMPARE(cache.messageMetadata(inbox, 5).uid, 5u);
+        QCOMPARE(cache.messageMetadata(inbox, 5).envelope.messageId, QByteArrayLiteral("<5@example.org>"));
+        QCOMPARE(cache.msgFlags(inbox, 5), QStringList() << QStringLiteral("\\Seen"));
+
+        // Changes go to both the snapshot and the database
+        toplevel.removeLast();
+        cache.setChildMailboxes(QString(), toplevel);
+        cache.clearAllMessages(inbox);
+        QCOMPARE(cache.childMailboxes(QString()), toplevel);
+        QCOMPARE(cache.uidMapping(inbox), Imap::Uids());
+        QCOMPARE(cache.messageMetadata(inbox, 5).uid, 0u);
+    }
+
+    SQLCache sqlCache;
+    QVERIFY(sqlCache.open(QStringLiteral("snapshot-3"), dir.path() + QLatin1String("/imap.cache.sqlite")));
+    QCOMPARE(sqlCache.childMailboxes(QString()), toplevel);
+    QCOMPARE(sqlCache.uidMapping(inbox), Imap::Uids());
+}
+
 QTEST_GUILESS_MAIN(TestSqlCache)
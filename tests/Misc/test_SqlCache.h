@@ -39,6 +39,11 @@ private Q_SLOTS:
     void initTestCase();
     void cleanupTestCase();
     void testMailboxOperation();
+    void testPartUsage();
+    void testPartDeduplication();
+    void testUpgradeFromV7();
+    void testCorrespondents();
+    void testStartupSnapshot();
 
 private:
     std::shared_ptr<Imap::Mailbox::SQLCache> cache;
@@ -0,0 +1,235 @@
+/* Copyright (C) 2006 - 2016 Jan Kundrát <jkt@flaska.net>
+
+   This file is part of the Trojita Qt IMAP e-mail client,
+   http://trojita.flaska.net/
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License or (at your option) version 3 or any later version
+   accepted by the membership of KDE e.V. (or its successor approved
+   by the membership of KDE e.V.), which shall act as a proxy
+   defined in Section 14 of version 3 of the license.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QTest>
+#include "test_TransferEncoding.h"
+#include "Imap/TransferEncoding.h"
+#include "Imap/Parser/3rdparty/kcodecs.h"
+
+using namespace Imap::TransferEncoding;
+
+namespace {
+
+/** @short Generate some data for the codecs to work with; the @arg alphabet is used as a source of characters */
+QByteArray randomData(const int size, const QByteArray &alphabet, uint seed)
+{
+    QByteArray res;
+    res.reserve(size);
+    for (int i = 0; i < size; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        const uchar value = (seed >> 16) & 0xff;
+        res.append(alphabet.isEmpty() ? static_cast<char>(value) : alphabet[value % alphabet.size()]);
+    }
+    return res;
+}
+
+/** @short This is how the MessageComposer used to produce base64 output */
+QByteArray referenceBase64(const QByteArray &data)
+{
+    QByteArray res;
+    for (int i = 0; i < data.size(); i += 57) {
+        res += data.mid(i, 57).toBase64() + "\r\n";
+    }
+    return res;
+}
+
+template <typename Codec>
+void feed(Codec &codec, const QByteArray &data, const int chunkSize, QByteArray *out);
+
+template <>
+void feed(Base64Encoder &codec, const QByteArray &data, const int chunkSize, QByteArray *out)
+{
+    for (int i = 0; i < data.size(); i += chunkSize) {
+        codec.encode(data.constData() + i, qMin(chunkSize, data.size() - i), out);
+    }
+}
+
+template <>
+void feed(QuotedPrintableEncoder &codec, const QByteArray &data, const int chunkSize, QByteArray *out)
+{
+    for (int i = 0; i < data.size(); i += chunkSize) {
+        codec.encode(data.constData() + i, qMin(chunkSize, data.size() - i), out);
+    }
+}
+
+template <>
+void feed(Base64Decoder &codec, const QByteArray &data, const int chunkSize, QByteArray *out)
+{
+    for (int i = 0; i < data.size(); i += chunkSize) {
+        codec.decode(data.constData() + i, qMin(chunkSize, data.size() - i), out);
+    }
+}
+
+template <>
+void feed(QuotedPrintableDecoder &codec, const QByteArray &data, const int chunkSize, QByteArray *out)
+{
+    for (int i = 0; i < data.size(); i += chunkSize) {
+        codec.decode(data.constData() + i, qMin(chunkSize, data.size() - i), out);
+    }
+}
+
+/** @short Columns shared by the data-driven tests */
+void addCodecRows()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<bool>("simd");
+    QTest::addColumn<int>("chunkSize");
+
+    const QList<QPair<QByteArray, QByteArray>> sources = {
+        qMakePair(QByteArray("empty"), QByteArray()),
+        qMakePair(QByteArray("short"), QByteArray("meh wtf")),
+        qMakePair(QByteArray("text"), randomData(5000, "Lorem ipsum dolor sit amet,\r\n", 1)),
+        qMakePair(QByteArray("trailing-whitespace"), randomData(5000, "ab \r\n\t=", 2)),
+        qMakePair(QByteArray("bare-newlines"), randomData(5000, "abc \r\n\n\r", 3)),
+        qMakePair(QByteArray("binary"), randomData(100000, QByteArray(), 4)),
+    };
+    const QList<int> chunkSizes = {1, 2, 3, 5, 57, 1000, 1 << 20};
+    for (const auto &source : sources) {
+        for (const bool simd : {false, true}) {
+            for (const int chunkSize : chunkSizes) {
+                QTest::newRow(QByteArray(source.first + (simd ? "-simd-" : "-scalar-") + QByteArray::number(chunkSize)).constData())
+                        << source.second << simd << chunkSize;
+            }
+        }
+    }
+}
+
+}
+
+void TransferEncodingTest::testBase64()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(bool, simd);
+    QFETCH(int, chunkSize);
+    setSimdEnabled(simd);
+
+    QByteArray encoded;
+    Base64Encoder encoder;
+    feed(encoder, data, chunkSize, &encoded);
+    encoder.finish(&encoded);
+    QCOMPARE(encoded, referenceBase64(data));
+
+    QByteArray decoded;
+    Base64Decoder decoder;
+    feed(decoder, encoded, chunkSize, &decoded);
+    QCOMPARE(decoded, data);
+
+    // Garbage shall be handled just like Qt does it
+    decoded.clear();
+    Base64Decoder garbageDecoder;
+    feed(garbageDecoder, data, chunkSize, &decoded);
+    QCOMPARE(decoded, QByteArray::fromBase64(data));
+
+    setSimdEnabled(true);
+}
+
+void TransferEncodingTest::testBase64_data()
+{
+    addCodecRows();
+}
+
+void TransferEncodingTest::testQuotedPrintable()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(bool, simd);
+    QFETCH(int, chunkSize);
+    setSimdEnabled(simd);
+
+    QByteArray encoded;
+    QuotedPrintableEncoder encoder;
+    feed(encoder, data, chunkSize, &encoded);
+    encoder.finish(&encoded);
+    QCOMPARE(encoded, KCodecs::quotedPrintableEncode(data));
+
+    QByteArray decoded;
+    QuotedPrintableDecoder decoder;
+    feed(decoder, encoded, chunkSize, &decoded);
+    decoder.finish(&decoded);
+    QCOMPARE(decoded, KCodecs::quotedPrintableDecode(encoded));
+
+    setSimdEnabled(true);
+}
+
+void TransferEncodingTest::testQuotedPrintable_data()
+{
+    addCodecRows();
+}
+
+void TransferEncodingTest::testQuotedPrintableDecoding()
+{
+    QFETCH(QByteArray, encoded);
+    QFETCH(QByteArray, decoded);
+
+    for (int chunkSize = 1; chunkSize <= encoded.size() + 1; ++chunkSize) {
+        QByteArray res;
+        QuotedPrintableDecoder decoder;
+        feed(decoder, encoded, chunkSize, &res);
+        decoder.finish(&res);
+        QCOMPARE(res, decoded);
+    }
+}
+
+void TransferEncodingTest::testQuotedPrintableDecoding_data()
+{
+    QTest::addColumn<QByteArray>("encoded");
+    QTest::addColumn<QByteArray>("decoded");
+
+    QTest::newRow("plain") << QByteArray("foo bar") << QByteArray("foo bar");
+    QTest::newRow("escapes") << QByteArray("a=3Db=20=C3=A1") << QByteArray("a=b \xc3\xa1");
+    QTest::newRow("lowercase-escapes") << QByteArray("=c3=a1") << QByteArray("\xc3\xa1");
+    QTest::newRow("soft-breaks") << QByteArray("foo=\r\nbar=\nbaz") << QByteArray("foobarbaz");
+    QTest::newRow("hard-breaks") << QByteArray("foo\r\nbar\n") << QByteArray("foo\r\nbar\n");
+    QTest::newRow("invalid-escape") << QByteArray("a=ZZb") << QByteArray("aZZb");
+    QTest::newRow("truncated-escape") << QByteArray("abc=4") << QByteArray("abc4");
+    QTest::newRow("trailing-equals") << QByteArray("abc=") << QByteArray("abc");
+}
+
+void TransferEncodingTest::benchmarkBase64()
+{
+    QFETCH(bool, simd);
+    setSimdEnabled(simd);
+
+    const QByteArray data = randomData(8 * 1024 * 1024, QByteArray(), 5);
+    QByteArray encoded;
+    QByteArray decoded;
+    QBENCHMARK {
+        encoded.resize(0);
+        decoded.resize(0);
+        Base64Encoder encoder;
+        encoder.encode(data, &encoded);
+        encoder.finish(&encoded);
+        Base64Decoder decoder;
+        decoder.decode(encoded, &decoded);
+    }
+    QCOMPARE(decoded, data);
+
+    setSimdEnabled(true);
+}
+
+void TransferEncodingTest::benchmarkBase64_data()
+{
+    QTest::addColumn<bool>("simd");
+    QTest::newRow("scalar") << false;
+    QTest::newRow("simd") << true;
+}
+
+QTEST_GUILESS_MAIN(TransferEncodingTest)
@@ -138,9 +138,9 @@ void LibMailboxSync::modelLogged(uint parserId, const Common::LogMessage &messag
     if (!m_verbose)
         return;
 
+    const QString text = message.text();
     qDebug() << "LOG" << parserId << message.source <<
-                (message.message.endsWith(QLatin1String("\r\n")) ?
-                     message.message.left(message.message.size() - 2) : message.message);
+                (text.endsWith(QLatin1String("\r\n")) ? text.left(text.size() - 2) : text);
 }
 
 void LibMailboxSync::helperInitialListing()